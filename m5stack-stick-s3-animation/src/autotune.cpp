@@ -0,0 +1,82 @@
+#include "autotune.h"
+#include <stdlib.h>
+#include "platform.h"
+
+// Placements worth timing; PLACE_HEAP always lands in one of them
+static const BufferPlace TUNE_PLACES[] = { PLACE_INTERNAL, PLACE_DMA, PLACE_PSRAM };
+
+bool autotune(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+              const TuneConfig &cfg, TuneResult *out) {
+  *out = TuneResult();
+  if (cfg.first >= v.total_frames || !cfg.count) return false;
+  uint8_t *rle = (uint8_t *)malloc(MAX_RLE_SIZE);
+  if (!rle) return false;
+
+  uint32_t first = find_keyframe(read, ctx, cfg.first, rle, MAX_RLE_SIZE);
+  uint32_t count = cfg.count;
+  if (count > v.total_frames - first) count = v.total_frames - first;
+  log_printf("tune: frames %u..%u, heap reserve %u KB\n", (unsigned)first,
+             (unsigned)(first + count - 1), (unsigned)(cfg.heapReserve / 1024));
+
+  RefStore refs;
+  RenderParams params = { 0xFFFF, 0x0000, cfg.angle, (v.flags & FLAG_REFS) ? &refs : nullptr,
+                          1, 0.5f, 0.5f };
+  for (int id = 0; id < PATH_COUNT; id++) {
+    RenderPath *path = render_path((RenderPathId)id);
+    if (path->insetOnly() || !path->supports(panel, v, cfg.angle)) continue;
+    BufferPlace was = path->place;
+    for (size_t k = 0; k < sizeof(TUNE_PLACES) / sizeof(TUNE_PLACES[0]); k++) {
+      BufferPlace place = TUNE_PLACES[k];
+      if (!place_available(place) || !path->placeable(place)) continue;
+      path->place = place;
+      if (!path->begin(panel, v)) {
+        log_printf("tune: %-13s %-8s out of memory\n", path->name(), place_name(place));
+        continue;
+      }
+      panel.fillScreen(0x0000);
+      refs.reset(v.width, v.height);
+      if (params.refs) prime_refs(refs, read, ctx, first, rle, MAX_RLE_SIZE);
+
+      uint32_t renderUs = 0;
+      uint32_t heap = 0;
+      bool ok = true;
+      for (uint32_t i = 0; i < count; i++) {
+        size_t len;
+        if (!read(ctx, first + i, rle, MAX_RLE_SIZE, &len)) { ok = false; break; }
+        uint32_t t0 = now_us();
+        path->render(rle, len, params, nullptr);
+        renderUs += now_us() - t0;
+        if (i == 0) heap = free_heap();    // sprites are created on the first frame
+      }
+      path->end();
+      if (!ok) {
+        log_printf("tune: read error\n");
+        path->place = was;
+        free(rle);
+        return false;
+      }
+
+      uint32_t frameUs = renderUs / count;
+      bool fits = !cfg.heapReserve || heap >= cfg.heapReserve;
+      log_printf("tune: %-13s %-8s %6u us/frame  heap %4u KB%s\n", path->name(),
+                 place_name(place), (unsigned)frameUs, (unsigned)(heap / 1024),
+                 fits ? "" : "  over budget");
+      out->tried++;
+      if (fits && (out->path == PATH_COUNT || frameUs < out->frameUs)) {
+        out->path = (RenderPathId)id;
+        out->place = place;
+        out->frameUs = frameUs;
+      }
+    }
+    path->place = was;
+  }
+  free(rle);
+
+  if (out->path == PATH_COUNT) {
+    log_printf("tune: nothing fits\n");
+    return false;
+  }
+  log_printf("tune: picked %s, buffers in %s, %.1f ms/frame\n",
+             render_path(out->path)->name(), place_name(out->place), out->frameUs / 1000.0f);
+  return true;
+}
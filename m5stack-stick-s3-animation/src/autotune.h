@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include "bench.h"
+#include "render.h"
+
+// ---- Boot-time render path autotuner ----
+// Which path is fastest, and whether its buffers are best in internal RAM,
+// DMA-capable RAM or PSRAM, depends on the board and on how much heap is
+// left. autotune() plays a short segment through every path that can show
+// the video, once per placement it accepts, and picks the fastest one that
+// leaves `heapReserve` bytes of internal heap free while it plays. The
+// firmware caches the pick in NVS (main.cpp).
+
+struct TuneConfig {
+  uint32_t first = 0;         // the segment starts at the keyframe at or before this
+  uint32_t count = 20;        // frames timed per combination
+  float angle = 90.0f;
+  uint32_t heapReserve = 0;   // 0: no budget (host)
+};
+
+struct TuneResult {
+  RenderPathId path = PATH_COUNT;
+  BufferPlace place = PLACE_HEAP;
+  uint32_t frameUs = 0;       // mean render time per frame
+  uint32_t tried = 0;         // combinations that ran
+};
+
+// Prints one line per combination and the pick. Leaves every path's
+// `place` as it found it and no path begun. False if nothing fit.
+bool autotune(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+              const TuneConfig &cfg, TuneResult *out);
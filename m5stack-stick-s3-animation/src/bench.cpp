@@ -0,0 +1,616 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+#include "cost_model.h"
+#include "indexed.h"
+#include "platform.h"
+#include "render.h"
+#include "rgb565.h"
+
+static float nonNegative(double v) { return v > 0 ? (float)v : 0.0f; }
+
+uint32_t find_keyframe(FrameReader read, void *ctx, uint32_t idx, uint8_t *buf, size_t cap) {
+  size_t len;
+  while (idx > 0 && read(ctx, idx, buf, cap, &len) && !frame_is_key(buf, len)) idx--;
+  return idx;
+}
+
+void prime_refs(RefStore &refs, FrameReader read, void *ctx, uint32_t idx,
+                uint8_t *buf, size_t cap) {
+  size_t len;
+  for (uint32_t i = 0; i < idx; i++) {
+    if (read(ctx, i, buf, cap, &len)) refs.store(buf, len);
+  }
+}
+
+bool find_segment(const FileHeader &v, FrameReader read, void *ctx, const BenchConfig &cfg,
+                  uint8_t *buf, size_t cap, Segment *seg) {
+  if (cfg.first >= v.total_frames) return false;
+  seg->count = cfg.count;
+  if (seg->count > v.total_frames - cfg.first) seg->count = v.total_frames - cfg.first;
+  seg->key = find_keyframe(read, ctx, cfg.first, buf, cap);
+  return true;
+}
+
+void reset_refs(RefStore &refs, const FileHeader &v, FrameReader read, void *ctx,
+                uint32_t key, uint8_t *buf, size_t cap) {
+  refs.reset(v.width, v.height);
+  if (v.flags & FLAG_REFS) prime_refs(refs, read, ctx, key, buf, cap);
+}
+
+void preroll(RenderPath *path, const FileHeader &v, FrameReader read, void *ctx,
+             const RenderParams &params, uint32_t key, uint32_t first,
+             uint8_t *buf, size_t cap) {
+  if (params.refs) reset_refs(*params.refs, v, read, ctx, key, buf, cap);
+  for (uint32_t i = key; i < first; i++) {
+    size_t len;
+    if (read(ctx, i, buf, cap, &len)) path->render(buf, len, params, nullptr);
+  }
+}
+
+bool run_bench(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+               const BenchConfig &cfg, CostModel *fitted) {
+  uint8_t *rle = (uint8_t *)malloc(MAX_RLE_SIZE);
+  if (!rle) {
+    log_printf("bench: no memory for frame buffer\n");
+    return false;
+  }
+  Segment seg;
+  if (!find_segment(v, read, ctx, cfg, rle, MAX_RLE_SIZE, &seg)) {
+    log_printf("bench: first frame %u past end (%u frames)\n",
+               (unsigned)cfg.first, (unsigned)v.total_frames);
+    free(rle);
+    return false;
+  }
+  uint32_t key = seg.key, count = seg.count;
+  log_printf("bench: %ux%u, frames %u..%u, angle %.0f\n", v.width, v.height,
+             (unsigned)cfg.first, (unsigned)(cfg.first + count - 1), cfg.angle);
+  if (key < cfg.first) log_printf("bench: decoding from keyframe %u first\n", (unsigned)key);
+  log_printf("%-13s %7s %7s %7s %7s %7s %8s %7s %8s %s\n",
+             "path", "fps", "read", "decode", "compose", "push",
+             "SPI KB/f", "buf KB", "heap KB", "checksum");
+
+  CostModel model;
+  cost_model_defaults(&model);
+  for (int id = 0; id < PATH_COUNT; id++) model.path[id].valid = false;
+  LinearFit readFit;
+
+  RefStore refs;
+  RenderParams params = { cfg.fg, cfg.bg, cfg.angle, (v.flags & FLAG_REFS) ? &refs : nullptr,
+                          cfg.zoom, 0.5f, 0.5f };
+  uint32_t pixels = (uint32_t)v.width * v.height;
+  uint32_t refSum = 0;
+  bool haveRef = false;
+  int ran = 0;
+
+  for (int id = 0; id < PATH_COUNT; id++) {
+    RenderPath *path = render_path((RenderPathId)id);
+    if (!path->supports(panel, v, cfg.angle)) continue;
+    // the others always show everything
+    if (cfg.zoom > 1 && id != PATH_ZOOM && id != PATH_VECTOR) continue;
+
+    if (!path->begin(panel, v)) {
+      log_printf("%-13s out of memory\n", path->name());
+      continue;
+    }
+    panel.fillScreen(0x0000);
+
+    preroll(path, v, read, ctx, params, key, cfg.first, rle, MAX_RLE_SIZE);
+    panel.spiBytes = 0;
+    panel.pushes = 0;
+
+    StageTimes t;
+    LinearFit decodeFit;          // decode cycles against runs
+    uint32_t readUs = 0;
+    size_t bufBytes = 0;
+    uint32_t heapDuring = 0;
+    bool ok = true;
+    uint32_t start = now_us();
+    for (uint32_t i = 0; i < count; i++) {
+      size_t len = 0;
+      uint32_t r0 = now_us();
+      if (!read(ctx, cfg.first + i, rle, MAX_RLE_SIZE, &len)) {
+        log_printf("%-13s read error at frame %u\n", path->name(), (unsigned)(cfg.first + i));
+        ok = false;
+        break;
+      }
+      uint32_t r = now_us() - r0;
+      readUs += r;
+      readFit.add(len, (double)r * COST_CPU_MHZ);
+      uint32_t decodeBefore = t.decodeUs;
+      path->render(rle, len, params, &t);
+      decodeFit.add(rle_run_count(rle, len), (double)(t.decodeUs - decodeBefore) * COST_CPU_MHZ);
+      if (i == 0) {
+        // sprites are created lazily on the first frame
+        bufBytes = path->bufferBytes();
+        heapDuring = free_heap();
+      }
+    }
+    uint32_t elapsed = now_us() - start;
+    uint32_t sum = panel.checksum();
+    uint32_t composePixels = path->composePixels();
+    path->end();
+    if (!ok) continue;
+    ran++;
+
+    // ---- Fit this path's coefficients ----
+    double slope, intercept;
+    decodeFit.solve(&slope, &intercept);
+    PathCost &pc = model.path[id];
+    pc.valid = true;
+    pc.run = nonNegative(slope);
+    pc.fill = nonNegative(intercept / pixels);
+    pc.compose = composePixels
+        ? nonNegative((double)t.composeUs * COST_CPU_MHZ / ((double)composePixels * count)) : 0.0f;
+    pc.spi = panel.spiBytes
+        ? nonNegative((double)t.pushUs * COST_CPU_MHZ / panel.spiBytes) : 0.0f;
+
+    float fps = elapsed ? count * 1e6f / elapsed : 0.0f;
+    const char *verdict = "";
+    if (path->insetOnly()) {
+      verdict = "inset";          // shrunk: not the picture the other paths show
+    } else if (sum) {
+      if (!haveRef) { refSum = sum; haveRef = true; }
+      verdict = sum == refSum ? "OK" : "DIFF";
+    }
+    log_printf("%-13s %7.1f %7u %7u %7u %7u %8.1f %7.1f %8u %08x %s\n",
+               path->name(), fps,
+               (unsigned)(readUs / count), (unsigned)(t.decodeUs / count),
+               (unsigned)(t.composeUs / count), (unsigned)(t.pushUs / count),
+               panel.spiBytes / 1024.0f / count, bufBytes / 1024.0f,
+               (unsigned)(heapDuring / 1024), (unsigned)sum, verdict);
+  }
+  free(rle);
+
+  double slope, intercept;
+  readFit.solve(&slope, &intercept);
+  model.readOp = nonNegative(intercept);
+  model.readByte = nonNegative(slope);
+  if (ran) cost_model_print(model);
+
+  if (fitted) {
+    fitted->readOp = model.readOp;
+    fitted->readByte = model.readByte;
+    for (int id = 0; id < PATH_COUNT; id++) {
+      if (model.path[id].valid) fitted->path[id] = model.path[id];
+    }
+  }
+  return ran > 0;
+}
+
+// ---- Bitmap kernel check ----
+static uint32_t xorshift(uint32_t *s) {
+  *s ^= *s << 13;
+  *s ^= *s >> 17;
+  *s ^= *s << 5;
+  return *s;
+}
+
+// Random ranges over a small buffer, both kernels against their references
+static bool checkRanges(uint32_t trials) {
+  static const size_t BYTES = 64;
+  uint32_t a[BYTES / 4], b[BYTES / 4];
+  uint32_t seed = 0x1234567u;
+  for (uint32_t t = 0; t < trials; t++) {
+    for (size_t i = 0; i < BYTES / 4; i++) a[i] = b[i] = xorshift(&seed);
+    size_t first = xorshift(&seed) % (BYTES * 8);
+    size_t count = xorshift(&seed) % (BYTES * 8 - first + 1);
+    static const char *const NAMES[] = { "set", "flip", "pattern" };
+    uint32_t op = t % 3;
+    uint8_t row = xorshift(&seed) & 0x0F;
+    if (op == 1) {
+      bits_flip((uint8_t *)a, first, count);
+      bits_flip_ref((uint8_t *)b, first, count);
+    } else if (op == 2) {
+      bits_pattern((uint8_t *)a, first, count, row);
+      bits_pattern_ref((uint8_t *)b, first, count, row);
+    } else {
+      bits_set((uint8_t *)a, first, count);
+      bits_set_ref((uint8_t *)b, first, count);
+    }
+    if (memcmp(a, b, BYTES)) {
+      log_printf("kernels: bits_%s(first %u, count %u) differs from reference\n",
+                 NAMES[op], (unsigned)first, (unsigned)count);
+      return false;
+    }
+  }
+  log_printf("kernels: %u random ranges OK\n", (unsigned)trials);
+  return true;
+}
+
+// Same for the RGB565 run kernels, at every start alignment
+static bool checkRuns565(uint32_t trials) {
+  static const size_t PIXELS = 64;
+  uint16_t a[PIXELS], b[PIXELS], c[PIXELS];
+  uint32_t seed = 0x7654321u;
+  for (uint32_t t = 0; t < trials; t++) {
+    for (size_t i = 0; i < PIXELS; i++) a[i] = b[i] = c[i] = (uint16_t)xorshift(&seed);
+    size_t first = xorshift(&seed) % PIXELS;
+    size_t count = xorshift(&seed) % (PIXELS - first + 1);
+    uint16_t color = (uint16_t)xorshift(&seed);
+    static const char *const NAMES[] = { "fill", "xor", "pattern" };
+    uint32_t op = t % 3;
+    if (op == 1) {
+      xor565(a + first, color, count);
+      xor565_portable(b + first, color, count);
+      for (size_t i = first; i < first + count; i++) c[i] ^= color;
+    } else if (op == 2) {         // one version on every target
+      uint8_t row = xorshift(&seed) & 0x0F;
+      unsigned phase = xorshift(&seed) & 3;
+      uint16_t bg = ~color;
+      pattern565(a + first, row, phase, count, color, bg);
+      memcpy(b, a, sizeof(b));
+      for (size_t i = first; i < first + count; i++) {
+        c[i] = (row & (0x8 >> ((phase + i - first) & 3))) ? color : bg;
+      }
+    } else {
+      fill565(a + first, color, count);
+      fill565_portable(b + first, color, count);
+      for (size_t i = first; i < first + count; i++) c[i] = color;
+    }
+    if (memcmp(a, c, sizeof(a)) || memcmp(b, c, sizeof(b))) {
+      log_printf("kernels: %s565(first %u, count %u) differs from reference\n",
+                 NAMES[op], (unsigned)first, (unsigned)count);
+      return false;
+    }
+  }
+  log_printf("kernels: %u random RGB565 runs OK\n", (unsigned)trials);
+  return true;
+}
+
+// A small intra frame with a row index, cut short at every length and with
+// a corrupt entry count: the row decoder zoom uses must agree with the whole
+// frame decode and stay inside the bytes it was given
+static bool checkTruncatedRows() {
+  static const uint16_t W = 16, H = 16, K = 4;
+  static const size_t HDR = 3 + 4 * (H / K - 1);
+  uint8_t frame[HDR + 2 * W * H];
+  size_t runs = 0, px = 0;
+  frame[0] = FRAME_ROWS;
+  frame[1] = K;
+  frame[2] = H / K - 1;
+  for (size_t n = 1; px < (size_t)W * H; n = n % 13 + 1, runs++) {
+    if (n > W * H - px) n = W * H - px;
+    for (size_t row = px / (K * W) + 1; row * K * W < px + n; row++) {
+      if (row * K * W < px || row >= H / K) continue;
+      uint8_t *e = frame + 3 + 4 * (row - 1);
+      size_t skip = row * K * W - px;
+      e[0] = runs & 0xFF;
+      e[1] = runs >> 8;
+      e[2] = skip & 0xFF;
+      e[3] = skip >> 8;
+    }
+    frame[HDR + 2 * runs] = n & 0xFF;
+    frame[HDR + 2 * runs + 1] = n >> 8;
+    px += n;
+  }
+  size_t full = HDR + 2 * runs;
+  size_t stride = bitmap_stride(W);
+  uint32_t whole[bitmap_bytes(W, H) / 4], band[bitmap_bytes(W, H) / 4];   // aligned for the word kernels
+  bool ok = true;
+  for (size_t len = 1; ok && len <= full + 1; len++) {
+    uint8_t *f = (uint8_t *)malloc(len < full ? len : full);    // exact size: overreads show
+    if (!f) return false;
+    memcpy(f, frame, len < full ? len : full);
+    if (len > full) f[2] = 0xFF;            // entries past the end of the frame
+    size_t n = len < full ? len : full;
+    decode_bit_rle_to_1bpp(f, n, (uint8_t *)whole, W, H, stride);
+    for (uint16_t first = 0; ok && first < H; first++) {
+      memset(band, 0xA5, sizeof(band));
+      decode_bit_rle_rows_to_1bpp(f, n, (uint8_t *)band, W, H, stride, first, H);
+      if (memcmp((uint8_t *)whole + first * stride, (uint8_t *)band + first * stride,
+                 (H - first) * stride)) {
+        log_printf("kernels: row index frame of %u bytes%s decodes rows %u.. differently\n",
+                   (unsigned)n, len > full ? " (bad count)" : "", first);
+        ok = false;
+      }
+    }
+    free(f);
+  }
+  if (ok) log_printf("kernels: truncated and corrupt row indexes OK\n");
+  return ok;
+}
+
+// The per-bit 1-bpp decoder the packed one replaced
+static void decodeNaive(const uint8_t *rle, size_t rleLen, uint8_t *out,
+                        uint16_t width, uint16_t height, size_t stride) {
+  if (!frame_is_delta(rle, rleLen)) memset(out, 0, stride * height);
+  if (rleLen < 1) return;
+  uint8_t curBit = rle[0] & 1;
+  bool patterns = frame_has_patterns(rle, rleLen);
+  size_t totalPixels = (size_t)width * height;
+  size_t pixel = 0;
+  uint16_t x = 0, y = 0;
+  size_t pos = frame_header_size(rle, rleLen);
+  while (pos + 1 < rleLen && pixel < totalPixels) {
+    uint16_t word = rle[pos] | (rle[pos + 1] << 8);
+    pos += 2;
+    size_t end = pixel + run_length(word, patterns);
+    if (end > totalPixels) end = totalPixels;
+    int level = run_level(word, patterns);
+    for (size_t i = pixel; i < end; i++) {
+      uint8_t &b = out[y * stride + (x >> 3)];
+      uint8_t m = 0x80 >> (x & 7);
+      if (level >= 0) b = (DITHER_ROWS[level][y & 3] & (0x8 >> (x & 3))) ? b | m : b & ~m;
+      else if (curBit) b ^= m;
+      if (++x == width) { x = 0; y++; }
+    }
+    pixel = end;
+    curBit = 1 - curBit;
+  }
+}
+
+// The per-pixel RGB565 decoder the run kernels replaced
+static void decodeNaive565(const uint8_t *rle, size_t rleLen, uint16_t *out,
+                           uint16_t width, uint16_t height, uint16_t fg, uint16_t bg) {
+  if (rleLen < 1) return;
+  bool delta = frame_is_delta(rle, rleLen);
+  bool patterns = frame_has_patterns(rle, rleLen);
+  uint16_t flip = fg ^ bg;
+  uint8_t curBit = rle[0] & 1;
+  size_t totalPixels = (size_t)width * height;
+  size_t pixel = 0;
+  size_t pos = frame_header_size(rle, rleLen);
+  while (pos + 1 < rleLen && pixel < totalPixels) {
+    uint16_t word = rle[pos] | (rle[pos + 1] << 8);
+    pos += 2;
+    size_t end = pixel + run_length(word, patterns);
+    if (end > totalPixels) end = totalPixels;
+    int level = run_level(word, patterns);
+    for (size_t i = pixel; i < end; i++) {
+      size_t x = i % width, y = i / width;
+      if (level >= 0) out[i] = (DITHER_ROWS[level][y & 3] & (0x8 >> (x & 3))) ? fg : bg;
+      else if (delta) out[i] ^= curBit ? flip : 0;
+      else out[i] = curBit ? fg : bg;
+    }
+    pixel = end;
+    curBit = 1 - curBit;
+  }
+  for (size_t i = pixel; !delta && i < totalPixels; i++) out[i] = bg;
+}
+
+// RGB565 decode of frames [key, first+count) three ways: per pixel, with the
+// portable run kernels and with fill565/xor565 (Xtensa on the device).
+static bool checkFrames565(const FileHeader &v, FrameReader read, void *ctx,
+                           const BenchConfig &cfg, uint32_t key, uint32_t count) {
+  size_t pixels = (size_t)v.width * v.height;
+  uint8_t *rle = (uint8_t *)malloc(MAX_RLE_SIZE);
+  uint16_t *naive = (uint16_t *)alloc_large(pixels * 2);
+  uint16_t *portable = (uint16_t *)alloc_large(pixels * 2);
+  uint16_t *kernel = (uint16_t *)alloc_large(pixels * 2);
+  bool ok = rle && naive && portable && kernel;
+  if (!ok) log_printf("kernels: no memory for RGB565 buffers\n");
+
+  RefStore refs;
+  if (ok) reset_refs(refs, v, read, ctx, key, rle, MAX_RLE_SIZE);
+  uint32_t naiveCycles = 0, portableCycles = 0, kernelCycles = 0;
+  uint32_t last = cfg.first + count;
+  for (uint32_t i = key; ok && i < last; i++) {
+    size_t len;
+    if (!read(ctx, i, rle, MAX_RLE_SIZE, &len)) {
+      log_printf("kernels: read error at frame %u\n", (unsigned)i);
+      ok = false;
+      break;
+    }
+    refs.store(rle, len);
+    if (const uint8_t *ref = refs.reference(rle, len)) {
+      expand_1bpp_to_rgb565(ref, refs.stride(), v.width, v.height, naive, cfg.fg, cfg.bg);
+      memcpy(portable, naive, pixels * 2);
+      memcpy(kernel, naive, pixels * 2);
+    }
+    uint32_t c0 = cycle_count();
+    decodeNaive565(rle, len, naive, v.width, v.height, cfg.fg, cfg.bg);
+    uint32_t c1 = cycle_count();
+    decode_bit_rle_to_rgb565_portable(rle, len, portable, v.width, v.height, cfg.fg, cfg.bg);
+    uint32_t c2 = cycle_count();
+    decode_bit_rle_to_rgb565(rle, len, kernel, v.width, v.height, cfg.fg, cfg.bg);
+    uint32_t c3 = cycle_count();
+    if (i >= cfg.first) {
+      naiveCycles += c1 - c0;
+      portableCycles += c2 - c1;
+      kernelCycles += c3 - c2;
+    }
+    if (memcmp(naive, portable, pixels * 2) || memcmp(naive, kernel, pixels * 2)) {
+      log_printf("kernels: frame %u decodes differently to RGB565\n", (unsigned)i);
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    log_printf("kernels: frames %u..%u, RGB565 decode OK\n",
+               (unsigned)cfg.first, (unsigned)(last - 1));
+    log_printf("%-8s %10u\n", "px565", (unsigned)(naiveCycles / count));
+    log_printf("%-8s %10u  (%.1fx)\n", "port565", (unsigned)(portableCycles / count),
+               portableCycles ? (float)naiveCycles / portableCycles : 0.0f);
+    if (rgb565_kernels_native()) {
+      log_printf("%-8s %10u  (%.1fx)\n", "xt565", (unsigned)(kernelCycles / count),
+                 kernelCycles ? (float)naiveCycles / kernelCycles : 0.0f);
+    }
+  }
+  free(rle);
+  free(naive);
+  free(portable);
+  free(kernel);
+  return ok;
+}
+
+// The per-pixel indexed decoder: one palette lookup per pixel
+static void decodeNaiveIndexed(const uint8_t *frame, size_t len, uint16_t *out,
+                               uint16_t width, uint16_t height, IndexedPalette *pal) {
+  if (!len) return;
+  indexed_palette(frame, len, pal);
+  size_t totalPixels = (size_t)width * height;
+  size_t pixel = 0;
+  size_t pos = frame_header_size(frame, len);
+  while (pos + 1 < len && pixel < totalPixels) {
+    uint16_t word = frame[pos] | (frame[pos + 1] << 8);
+    pos += 2;
+    if (!word) {
+      if (pos + 1 >= len) break;
+      pixel += frame[pos] | (frame[pos + 1] << 8);
+      pos += 2;
+      continue;
+    }
+    for (size_t n = word & INDEX_RUN_LENGTH; n && pixel < totalPixels; n--) {
+      out[pixel++] = pal->lut[word >> INDEX_SHIFT];
+    }
+  }
+  for (size_t i = pixel; !frame_is_delta(frame, len) && i < totalPixels; i++) {
+    out[i] = pal->lut[0];
+  }
+}
+
+// Indexed frames [key, first+count) decoded per pixel, with the portable
+// fill and with fill565, each keeping its own palette
+static bool checkIndexed(const FileHeader &v, FrameReader read, void *ctx,
+                         const BenchConfig &cfg, uint32_t key, uint32_t count) {
+  size_t pixels = (size_t)v.width * v.height;
+  uint8_t *rle = (uint8_t *)malloc(MAX_RLE_SIZE);
+  uint16_t *naive = (uint16_t *)alloc_large(pixels * 2);
+  uint16_t *portable = (uint16_t *)alloc_large(pixels * 2);
+  uint16_t *kernel = (uint16_t *)alloc_large(pixels * 2);
+  bool ok = rle && naive && portable && kernel;
+  if (!ok) log_printf("kernels: no memory for RGB565 buffers\n");
+
+  IndexedPalette pals[3] = {};
+  uint32_t naiveCycles = 0, portableCycles = 0, kernelCycles = 0, worst = 0, swaps = 0;
+  uint32_t last = cfg.first + count;
+  for (uint32_t i = key; ok && i < last; i++) {
+    size_t len;
+    if (!read(ctx, i, rle, MAX_RLE_SIZE, &len)) {
+      log_printf("kernels: read error at frame %u\n", (unsigned)i);
+      ok = false;
+      break;
+    }
+    IndexedPalette was = pals[2];
+    uint32_t c0 = cycle_count();
+    decodeNaiveIndexed(rle, len, naive, v.width, v.height, &pals[0]);
+    uint32_t c1 = cycle_count();
+    decode_indexed_to_rgb565_portable(rle, len, portable, v.width, v.height, &pals[1]);
+    uint32_t c2 = cycle_count();
+    decode_indexed_to_rgb565(rle, len, kernel, v.width, v.height, &pals[2]);
+    uint32_t c3 = cycle_count();
+    if (i >= cfg.first) {
+      naiveCycles += c1 - c0;
+      portableCycles += c2 - c1;
+      kernelCycles += c3 - c2;
+      if (c3 - c2 > worst) worst = c3 - c2;
+      swaps += memcmp(&was, &pals[2], sizeof(was)) != 0;
+    }
+    if (memcmp(naive, portable, pixels * 2) || memcmp(naive, kernel, pixels * 2)) {
+      log_printf("kernels: frame %u decodes differently (indexed)\n", (unsigned)i);
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    log_printf("kernels: frames %u..%u, indexed decode OK, %u palette changes, "
+               "%u colours last\n", (unsigned)cfg.first, (unsigned)(last - 1),
+               (unsigned)swaps, pals[2].count);
+    log_printf("%-8s %10s\n", "decoder", "cyc/frame");
+    log_printf("%-8s %10u\n", "px-lut", (unsigned)(naiveCycles / count));
+    log_printf("%-8s %10u  (%.1fx)\n", "port565", (unsigned)(portableCycles / count),
+               portableCycles ? (float)naiveCycles / portableCycles : 0.0f);
+    log_printf("%-8s %10u  (%.1fx, worst frame %u)\n",
+               rgb565_kernels_native() ? "xt565" : "fill565", (unsigned)(kernelCycles / count),
+               kernelCycles ? (float)naiveCycles / kernelCycles : 0.0f, (unsigned)worst);
+  }
+  free(rle);
+  free(naive);
+  free(portable);
+  free(kernel);
+  return ok;
+}
+
+bool run_kernel_check(const FileHeader &v, FrameReader read, void *ctx,
+                      const BenchConfig &cfg) {
+  if (!checkRanges(20000) || !checkRuns565(20000) || !checkTruncatedRows()) return false;
+  if (v.flags & FLAG_VECTOR) {
+    log_printf("kernels: vector file, no bit-RLE frames to check\n");
+    return true;
+  }
+
+  uint8_t *rle = (uint8_t *)malloc(MAX_RLE_SIZE);
+  if (!rle) {
+    log_printf("kernels: no memory for frame buffers\n");
+    return false;
+  }
+  Segment seg;
+  if (!find_segment(v, read, ctx, cfg, rle, MAX_RLE_SIZE, &seg)) {
+    log_printf("kernels: first frame %u past end (%u frames)\n",
+               (unsigned)cfg.first, (unsigned)v.total_frames);
+    free(rle);
+    return false;
+  }
+  uint32_t key = seg.key, count = seg.count;
+  if (v.flags & FLAG_INDEXED) {
+    free(rle);            // allocated again with the RGB565 buffers
+    return checkIndexed(v, read, ctx, cfg, key, count);
+  }
+
+  size_t stride = bitmap_stride(v.width);
+  size_t bytes = bitmap_bytes(v.width, v.height);
+  uint8_t *packed = (uint8_t *)malloc(bytes);
+  uint8_t *naive = (uint8_t *)malloc(bytes);
+  uint8_t *band = (uint8_t *)malloc(bytes);     // middle half of the rows, as zoom 2 decodes
+  bool ok = packed && naive && band;
+  if (!ok) log_printf("kernels: no memory for frame buffers\n");
+
+  RefStore refs;
+  if (ok) reset_refs(refs, v, read, ctx, key, rle, MAX_RLE_SIZE);
+
+  uint16_t bandFirst = v.height / 4, bandEnd = bandFirst + v.height / 2;
+  size_t bandAt = bandFirst * stride, bandBytes = (bandEnd - bandFirst) * stride;
+  uint32_t packedCycles = 0, naiveCycles = 0, bandCycles = 0;
+  uint32_t last = cfg.first + count;
+  for (uint32_t i = key; ok && i < last; i++) {
+    size_t len;
+    if (!read(ctx, i, rle, MAX_RLE_SIZE, &len)) {
+      log_printf("kernels: read error at frame %u\n", (unsigned)i);
+      ok = false;
+      break;
+    }
+    refs.store(rle, len);
+    if (const uint8_t *ref = refs.reference(rle, len)) {
+      memcpy(packed, ref, stride * v.height);
+      memcpy(naive, ref, stride * v.height);
+      memcpy(band, ref, stride * v.height);
+    }
+    uint32_t c0 = cycle_count();
+    decode_bit_rle_to_1bpp(rle, len, packed, v.width, v.height, stride);
+    uint32_t c1 = cycle_count();
+    decodeNaive(rle, len, naive, v.width, v.height, stride);
+    uint32_t c2 = cycle_count();
+    decode_bit_rle_rows_to_1bpp(rle, len, band, v.width, v.height, stride, bandFirst, bandEnd);
+    uint32_t c3 = cycle_count();
+    if (i >= cfg.first) {
+      packedCycles += c1 - c0;
+      naiveCycles += c2 - c1;
+      bandCycles += c3 - c2;
+    }
+    if (memcmp(packed, naive, stride * v.height)) {
+      log_printf("kernels: frame %u decodes differently\n", (unsigned)i);
+      ok = false;
+    } else if (memcmp(packed + bandAt, band + bandAt, bandBytes)) {
+      log_printf("kernels: frame %u rows %u..%u decode differently\n",
+                 (unsigned)i, bandFirst, bandEnd - 1);
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    log_printf("kernels: frames %u..%u, 1-bpp decode OK\n",
+               (unsigned)cfg.first, (unsigned)(last - 1));
+    log_printf("%-8s %10s\n", "decoder", "cyc/frame");
+    log_printf("%-8s %10u\n", "per-bit", (unsigned)(naiveCycles / count));
+    log_printf("%-8s %10u  (%.1fx)\n", "packed", (unsigned)(packedCycles / count),
+               packedCycles ? (float)naiveCycles / packedCycles : 0.0f);
+    log_printf("%-8s %10u  (rows %u..%u, %s)\n", "band", (unsigned)(bandCycles / count),
+               bandFirst, bandEnd - 1, (v.flags & FLAG_ROW_INDEX) ? "row index" : "no index");
+  }
+  free(band);
+  free(rle);
+  free(packed);
+  free(naive);
+  return ok && checkFrames565(v, read, ctx, cfg, key, count);
+}
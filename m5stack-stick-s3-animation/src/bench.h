@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "codec.h"
+#include "panel.h"
+
+struct CostModel;
+struct RenderParams;
+class RenderPath;
+
+// ---- Benchmark: play a fixed segment unpaced through every render path ----
+
+// Fetch frame `idx` into `buf`; false on read error or if it doesn't fit.
+typedef bool (*FrameReader)(void *ctx, uint32_t idx, uint8_t *buf, size_t cap, size_t *len);
+
+// Keyframe that frame `idx` is decoded from (idx itself for key frames);
+// walks back through the file reading frame headers.
+uint32_t find_keyframe(FrameReader read, void *ctx, uint32_t idx, uint8_t *buf, size_t cap);
+
+// Fill `refs` from the FRAME_STORE frames before `idx`, so decoding can
+// start at a keyframe mid-file.
+void prime_refs(RefStore &refs, FrameReader read, void *ctx, uint32_t idx,
+                uint8_t *buf, size_t cap);
+
+struct BenchConfig {
+  uint32_t first = 0;       // first frame of the segment
+  uint32_t count = 100;     // frames per path
+  float angle = 90.0f;      // 0 for native-profile files
+  uint16_t fg = 0xFFFF;
+  uint16_t bg = 0x0000;
+  uint8_t zoom = 1;         // >1 runs only the paths that zoom, centred
+};
+
+// ---- Segment setup shared by the bench and the host checks ----
+
+struct Segment {
+  uint32_t key;             // keyframe cfg.first is decoded from
+  uint32_t count;           // frames from cfg.first, clamped to the file
+};
+
+// False if cfg.first is past the end; `buf` is scratch for frame headers.
+bool find_segment(const FileHeader &v, FrameReader read, void *ctx, const BenchConfig &cfg,
+                  uint8_t *buf, size_t cap, Segment *seg);
+
+// Empty `refs`, then (files with reference slots) fill them for decoding
+// from keyframe `key`.
+void reset_refs(RefStore &refs, const FileHeader &v, FrameReader read, void *ctx,
+                uint32_t key, uint8_t *buf, size_t cap);
+
+// Untimed: resets params.refs and renders [key, first) through `path`, so
+// the frames from `first` on land on the right picture.
+void preroll(RenderPath *path, const FileHeader &v, FrameReader read, void *ctx,
+             const RenderParams &params, uint32_t key, uint32_t first,
+             uint8_t *buf, size_t cap);
+
+// Prints one table row per path that supports the video, then the cost
+// model fitted from the per-frame timings (`model ...` lines, see
+// cost_model.h). Paths that didn't run keep their entries in `fitted`.
+// Returns false if nothing could run (bad segment, no memory).
+bool run_bench(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+               const BenchConfig &cfg, CostModel *fitted = nullptr);
+
+// ---- Bitmap kernel check ----
+// Compares the word-level bit kernels (bitmap.h) with their one-bit
+// references on random ranges, then decodes the segment to 1-bpp with both
+// the packed decoder and a naive per-bit one, checking every frame and
+// printing cycles per frame. Also decodes the middle half of the rows on
+// its own (what zoom 2 needs) and checks it against the full decode.
+// Returns false on any mismatch.
+bool run_kernel_check(const FileHeader &v, FrameReader read, void *ctx,
+                      const BenchConfig &cfg);
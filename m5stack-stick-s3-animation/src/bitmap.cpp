@@ -0,0 +1,76 @@
+#include "bitmap.h"
+
+// Pixel order inside a 32-bit word is big-endian (pixel 0 = bit 31 of the
+// byte-swapped load), so a pixel range is a contiguous mask in that order
+// and just needs swapping into memory order.
+static inline uint32_t to_memory_order(uint32_t m) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return m;
+#else
+  return __builtin_bswap32(m);
+#endif
+}
+
+// Pixels [a, b) of a word, 0 <= a < b <= 32
+static inline uint32_t range_mask(unsigned a, unsigned b) {
+  uint32_t head = 0xFFFFFFFFu >> a;
+  uint32_t tail = b == 32 ? 0xFFFFFFFFu : ~(0xFFFFFFFFu >> b);
+  return to_memory_order(head & tail);
+}
+
+enum RangeOp { OP_SET, OP_FLIP, OP_PATTERN };
+
+// `pattern` (OP_PATTERN): the word the masked bits are copied from
+template <RangeOp Op>
+static inline void apply(uint32_t *w, uint32_t mask, uint32_t pattern) {
+  if (Op == OP_FLIP) *w ^= mask;
+  else if (Op == OP_SET) *w |= mask;
+  else *w = (*w & ~mask) | (pattern & mask);
+}
+
+template <RangeOp Op>
+static void bits_range(uint8_t *buf, size_t first, size_t count, uint32_t pattern = 0) {
+  if (!count) return;
+  uint32_t *w = (uint32_t *)buf + (first >> 5);
+  unsigned a = first & 31;
+  size_t end = a + count;            // relative to the first word
+
+  if (end <= 32) {                   // within one word
+    apply<Op>(w, range_mask(a, (unsigned)end), pattern);
+    return;
+  }
+  if (a) {                           // head
+    apply<Op>(w++, range_mask(a, 32), pattern);
+    end -= 32;
+  }
+  for (; end >= 32; end -= 32) apply<Op>(w++, 0xFFFFFFFFu, pattern);
+  if (end) apply<Op>(w, range_mask(0, (unsigned)end), pattern);   // tail
+}
+
+void bits_set(uint8_t *buf, size_t first, size_t count) {
+  bits_range<OP_SET>(buf, first, count);
+}
+
+void bits_flip(uint8_t *buf, size_t first, size_t count) {
+  bits_range<OP_FLIP>(buf, first, count);
+}
+
+void bits_pattern(uint8_t *buf, size_t first, size_t count, uint8_t row) {
+  // every nibble is the row, so the word reads the same in any byte order
+  bits_range<OP_PATTERN>(buf, first, count, (row & 0x0F) * 0x11111111u);
+}
+
+void bits_set_ref(uint8_t *buf, size_t first, size_t count) {
+  for (size_t i = first; i < first + count; i++) buf[i >> 3] |= 0x80 >> (i & 7);
+}
+
+void bits_flip_ref(uint8_t *buf, size_t first, size_t count) {
+  for (size_t i = first; i < first + count; i++) buf[i >> 3] ^= 0x80 >> (i & 7);
+}
+
+void bits_pattern_ref(uint8_t *buf, size_t first, size_t count, uint8_t row) {
+  for (size_t i = first; i < first + count; i++) {
+    uint8_t m = 0x80 >> (i & 7);
+    buf[i >> 3] = (row & (0x8 >> (i & 3))) ? buf[i >> 3] | m : buf[i >> 3] & ~m;
+  }
+}
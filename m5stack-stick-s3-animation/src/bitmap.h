@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- Packed 1-bpp bitmaps ----
+// Bit `i` of a buffer is pixel i in MSB-first byte order (the layout of a
+// 1-bit M5Canvas), so bit 0 is 0x80 of byte 0. Rows are `stride` bytes.
+//
+// The range kernels work on whole 32-bit words with precomputed head/tail
+// masks. Buffers they touch must be 4-byte aligned and sized with
+// bitmap_bytes(), so the last word of a range never runs past the end.
+
+static constexpr size_t bitmap_stride(uint16_t width) { return (width + 7) / 8; }
+
+static constexpr size_t bitmap_bytes(uint16_t width, uint16_t height) {
+  return (bitmap_stride(width) * height + 3) & ~(size_t)3;
+}
+
+// Set / toggle bits [first, first + count)
+void bits_set(uint8_t *buf, size_t first, size_t count);
+void bits_flip(uint8_t *buf, size_t first, size_t count);
+
+// Copy a 4-pixel pattern row into bits [first, first + count): bit i
+// becomes bit 0x8 >> (i & 3) of `row`, so rows must start at multiples of 4.
+void bits_pattern(uint8_t *buf, size_t first, size_t count, uint8_t row);
+
+// One bit at a time; reference for checking the kernels
+void bits_set_ref(uint8_t *buf, size_t first, size_t count);
+void bits_flip_ref(uint8_t *buf, size_t first, size_t count);
+void bits_pattern_ref(uint8_t *buf, size_t first, size_t count, uint8_t row);
@@ -0,0 +1,399 @@
+#include "codec.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "platform.h"
+#include "rgb565.h"
+
+// ---- Dither patterns ----
+// DITHER_ROWS[k][y] has bit 0x8 >> x set where the 4x4 Bayer threshold at
+// (x, y) is below k.
+const uint8_t DITHER_ROWS[DITHER_LEVELS][4] = {
+  { 0x0, 0x0, 0x0, 0x0 }, { 0x8, 0x0, 0x0, 0x0 }, { 0x8, 0x0, 0x2, 0x0 },
+  { 0xA, 0x0, 0x2, 0x0 }, { 0xA, 0x0, 0xA, 0x0 }, { 0xA, 0x4, 0xA, 0x0 },
+  { 0xA, 0x4, 0xA, 0x1 }, { 0xA, 0x5, 0xA, 0x1 }, { 0xA, 0x5, 0xA, 0x5 },
+  { 0xE, 0x5, 0xA, 0x5 }, { 0xE, 0x5, 0xB, 0x5 }, { 0xF, 0x5, 0xB, 0x5 },
+  { 0xF, 0x5, 0xF, 0x5 }, { 0xF, 0xD, 0xF, 0x5 }, { 0xF, 0xD, 0xF, 0x7 },
+  { 0xF, 0xF, 0xF, 0x7 },
+};
+
+// Pixels [from, end) of a width-wide RGB565 picture set to dither `level`,
+// one pattern row at a time
+static void pattern565Span(uint16_t *out, size_t from, size_t end, uint16_t width, int level,
+                           uint16_t fg, uint16_t bg) {
+  size_t y = from / width, x = from - y * width;
+  for (; from < end; y++, x = 0) {
+    size_t n = width - x < end - from ? width - x : end - from;
+    pattern565(out + from, DITHER_ROWS[level][y & 3], x & 3, n, fg, bg);
+    from += n;
+  }
+}
+
+// ---- Bit-RLE decoder → RGB565 ----
+template <void (*Fill)(uint16_t *, uint16_t, size_t), void (*Flip)(uint16_t *, uint16_t, size_t)>
+static void decodeRgb565(const uint8_t *rle, size_t rleLen,
+                         uint16_t *out, uint16_t width, uint16_t height,
+                         uint16_t fg, uint16_t bg) {
+  if (rleLen < 1 || !width) return;
+  uint8_t curBit = rle[0] & 1;
+  const bool patterns = frame_has_patterns(rle, rleLen);
+  const size_t totalPixels = (size_t)width * height;
+
+  size_t pixel = 0;
+  size_t pos = frame_header_size(rle, rleLen);
+  if (frame_is_delta(rle, rleLen)) {
+    uint16_t flip = fg ^ bg;
+    while (pos + 1 < rleLen && pixel < totalPixels) {
+      uint16_t word = rle[pos] | (rle[pos + 1] << 8);
+      pos += 2;
+      size_t end = pixel + run_length(word, patterns);
+      if (end > totalPixels) end = totalPixels;
+      int level = run_level(word, patterns);
+      if (level >= 0) pattern565Span(out, pixel, end, width, level, fg, bg);
+      else if (curBit) Flip(out + pixel, flip, end - pixel);
+      pixel = end;
+      curBit = 1 - curBit;
+    }
+    return;
+  }
+
+  while (pos + 1 < rleLen && pixel < totalPixels) {
+    uint16_t word = rle[pos] | (rle[pos + 1] << 8);
+    pos += 2;
+    size_t end = pixel + run_length(word, patterns);
+    if (end > totalPixels) end = totalPixels;
+    int level = run_level(word, patterns);
+    if (level >= 0) pattern565Span(out, pixel, end, width, level, fg, bg);
+    else Fill(out + pixel, curBit ? fg : bg, end - pixel);
+    pixel = end;
+    curBit = 1 - curBit;
+  }
+  Fill(out + pixel, bg, totalPixels - pixel);
+}
+
+void decode_bit_rle_to_rgb565(const uint8_t *rle, size_t rleLen,
+                              uint16_t *out, uint16_t width, uint16_t height,
+                              uint16_t fg, uint16_t bg) {
+  decodeRgb565<fill565, xor565>(rle, rleLen, out, width, height, fg, bg);
+}
+
+void decode_bit_rle_to_rgb565_portable(const uint8_t *rle, size_t rleLen,
+                                       uint16_t *out, uint16_t width, uint16_t height,
+                                       uint16_t fg, uint16_t bg) {
+  decodeRgb565<fill565_portable, xor565_portable>(rle, rleLen, out, width, height, fg, bg);
+}
+
+void recolor_rgb565(uint16_t *px, int w, int h, size_t stride,
+                    uint16_t oldFg, uint16_t fg, uint16_t bg) {
+  for (int y = 0; y < h; y++, px += stride) {
+    for (int x = 0; x < w; x++) px[x] = px[x] == oldFg ? fg : bg;
+  }
+}
+
+// ---- Row-restart index ----
+RowRestart frame_row_restart(const uint8_t *rle, size_t rleLen, uint16_t width, uint16_t row) {
+  size_t hdr = frame_header_size(rle, rleLen);
+  RowRestart r = { hdr, 0, (uint8_t)(rleLen ? rle[0] & 1 : 0) };
+  if (!rleLen || !(rle[0] & FRAME_ROWS)) return r;
+  size_t at = frame_slots_end(rle, rleLen);
+  if (at + 2 > rleLen) return r;                      // truncated: walk from the top
+  uint8_t k = rle[at];
+  uint8_t n = rle[at + 1];
+  if (at + 2 + 4 * (size_t)n > rleLen) return r;
+  if (!k || !n || row < k) return r;
+  size_t i = row / k;
+  if (i > n) i = n;
+  const uint8_t *e = rle + at + 2 + 4 * (i - 1);
+  uint16_t run = e[0] | (e[1] << 8);
+  uint16_t skip = e[2] | (e[3] << 8);
+  size_t start = (size_t)i * k * width;
+  if (skip > start || hdr + 2 * (size_t)run > rleLen) return r;   // bad entry: walk from the top
+  r.pos = hdr + 2 * (size_t)run;
+  r.pixel = start - skip;
+  r.bit ^= run & 1;
+  return r;
+}
+
+// ---- Bit-RLE decoder → packed 1-bpp ----
+// Only 1-runs touch the bitmap: intra frames set them on a cleared picture,
+// delta frames flip them. Runs are split at row ends when rows are padded.
+static void applyRun1bpp(void (*op)(uint8_t *, size_t, size_t), uint8_t *out,
+                         size_t from, size_t end, uint16_t width, size_t rowBits) {
+  if (rowBits == width) {
+    op(out, from, end - from);
+    return;
+  }
+  size_t y = from / width, x = from - y * width;
+  for (size_t left = end - from; left; y++, x = 0) {
+    size_t n = width - x < left ? width - x : left;
+    op(out, y * rowBits + x, n);
+    left -= n;
+  }
+}
+
+// Pattern runs always go row by row: each row has its own pattern row.
+// Rows start at whole bytes, so a pixel's pattern phase is its bit's.
+static void applyPattern1bpp(uint8_t *out, size_t from, size_t end, uint16_t width,
+                             size_t rowBits, int level) {
+  size_t y = from / width, x = from - y * width;
+  for (size_t left = end - from; left; y++, x = 0) {
+    size_t n = width - x < left ? width - x : left;
+    bits_pattern(out, y * rowBits + x, n, DITHER_ROWS[level][y & 3]);
+    left -= n;
+  }
+}
+
+void decode_bit_rle_to_1bpp(const uint8_t *rle, size_t rleLen,
+                            uint8_t *out, uint16_t width, uint16_t height,
+                            size_t strideBytes) {
+  decode_bit_rle_rows_to_1bpp(rle, rleLen, out, width, height, strideBytes, 0, height);
+}
+
+void decode_bit_rle_rows_to_1bpp(const uint8_t *rle, size_t rleLen,
+                                 uint8_t *out, uint16_t width, uint16_t height,
+                                 size_t strideBytes, uint16_t rowFirst, uint16_t rowEnd) {
+  if (rowEnd > height) rowEnd = height;
+  if (rowFirst >= rowEnd) return;
+  bool delta = frame_is_delta(rle, rleLen);
+  if (!delta) memset(out + rowFirst * strideBytes, 0, (rowEnd - rowFirst) * strideBytes);
+  if (rleLen < 1 || !width) return;
+  void (*op)(uint8_t *, size_t, size_t) = delta ? bits_flip : bits_set;
+  const bool patterns = frame_has_patterns(rle, rleLen);
+  size_t rowBits = strideBytes * 8;
+
+  RowRestart r = frame_row_restart(rle, rleLen, width, rowFirst);
+  uint8_t curBit = r.bit;
+  size_t firstPixel = (size_t)rowFirst * width;
+  size_t endPixel = (size_t)rowEnd * width;
+  size_t pixel = r.pixel;
+  size_t pos = r.pos;
+  while (pos + 1 < rleLen && pixel < endPixel) {
+    uint16_t word = rle[pos] | (rle[pos + 1] << 8);
+    pos += 2;
+    size_t end = pixel + run_length(word, patterns);
+    if (end > endPixel) end = endPixel;
+    size_t from = pixel > firstPixel ? pixel : firstPixel;
+    int level = run_level(word, patterns);
+    if (from < end && level >= 0) applyPattern1bpp(out, from, end, width, rowBits, level);
+    else if (curBit && from < end) applyRun1bpp(op, out, from, end, width, rowBits);
+    pixel = end;
+    curBit = 1 - curBit;
+  }
+}
+
+void rle_cursor_begin(const uint8_t *rle, size_t rleLen, uint8_t *out, uint16_t height,
+                      size_t strideBytes, RleCursor *c) {
+  if (!frame_is_delta(rle, rleLen)) memset(out, 0, height * strideBytes);
+  c->pos = frame_header_size(rle, rleLen);
+  c->pixel = 0;
+  c->bit = rleLen ? rle[0] & 1 : 0;
+}
+
+bool decode_bit_rle_step_1bpp(const uint8_t *rle, size_t rleLen, uint8_t *out,
+                              uint16_t width, uint16_t height, size_t strideBytes,
+                              RleCursor *c, uint32_t maxRuns) {
+  void (*op)(uint8_t *, size_t, size_t) = frame_is_delta(rle, rleLen) ? bits_flip : bits_set;
+  const bool patterns = frame_has_patterns(rle, rleLen);
+  size_t endPixel = (size_t)height * width;
+  for (; maxRuns && c->pos + 1 < rleLen && c->pixel < endPixel; maxRuns--) {
+    uint16_t word = rle[c->pos] | (rle[c->pos + 1] << 8);
+    c->pos += 2;
+    size_t end = c->pixel + run_length(word, patterns);
+    if (end > endPixel) end = endPixel;
+    int level = run_level(word, patterns);
+    if (c->pixel < end && level >= 0) {
+      applyPattern1bpp(out, c->pixel, end, width, strideBytes * 8, level);
+    } else if (c->bit && c->pixel < end) {
+      applyRun1bpp(op, out, c->pixel, end, width, strideBytes * 8);
+    }
+    c->pixel = end;
+    c->bit ^= 1;
+  }
+  return c->pos + 1 >= rleLen || c->pixel >= endPixel;
+}
+
+// ---- Quarter-turn placement ----
+bool quarter_map(float angle, uint16_t srcW, uint16_t srcH,
+                 uint16_t dstW, uint16_t dstH, QuarterMap *m) {
+  float turns = angle / 90.0f;
+  int q = (int)lroundf(turns);
+  if (fabsf(turns - q) > 0.001f) return false;
+  q = ((q % 4) + 4) % 4;
+
+  int w = srcW, h = srcH;
+  switch (q) {
+    case 0:   // dx = sx, dy = sy
+      *m = { 1, 0, (dstW - w) / 2,   0, 1, (dstH - h) / 2 };
+      break;
+    case 1:   // 90° clockwise: dx = h-1-sy, dy = sx
+      *m = { 0, -1, (dstW - h) / 2 + h - 1,   1, 0, (dstH - w) / 2 };
+      break;
+    case 2:   // dx = w-1-sx, dy = h-1-sy
+      *m = { -1, 0, (dstW - w) / 2 + w - 1,   0, -1, (dstH - h) / 2 + h - 1 };
+      break;
+    default:  // 270°: dx = sy, dy = w-1-sx
+      *m = { 0, 1, (dstW - h) / 2,   -1, 0, (dstH - w) / 2 + w - 1 };
+      break;
+  }
+  return true;
+}
+
+QuarterMap quarter_map_inverse(const QuarterMap &m) {
+  // The matrix is a rotation, so its inverse is the transpose:
+  // s = M^T (d - c)
+  QuarterMap inv;
+  inv.ax = m.ax; inv.bx = m.ay;
+  inv.ay = m.bx; inv.by = m.by;
+  inv.cx = -(inv.ax * m.cx + inv.bx * m.cy);
+  inv.cy = -(inv.ay * m.cx + inv.by * m.cy);
+  return inv;
+}
+
+// ---- Bit-RLE decoder fused with the rotation ----
+// Walks the runs in source order and writes each row segment along its
+// display direction, so the frame never exists unrotated.
+void decode_bit_rle_rotated(const uint8_t *rle, size_t rleLen,
+                            uint16_t srcW, uint16_t srcH, const QuarterMap &m,
+                            uint16_t *canvas, uint16_t dstW, uint16_t dstH,
+                            uint16_t fg, uint16_t bg) {
+  if (rleLen < 1) return;
+  uint8_t curBit = rle[0] & 1;
+  const bool delta = frame_is_delta(rle, rleLen);
+  const bool patterns = frame_has_patterns(rle, rleLen);
+  const uint16_t flip = fg ^ bg;
+  const int step = m.ax + m.ay * dstW;    // canvas stride per source x
+
+  // Visible source-x range: the coordinate driven by sx must stay on screen
+  int lo, hi;
+  {
+    int a = m.ax ? m.ax : m.ay;
+    int c = m.ax ? m.cx : m.cy;
+    int lim = m.ax ? dstW : dstH;
+    if (a > 0) { lo = -c; hi = lim - c; }
+    else       { lo = c - lim + 1; hi = c + 1; }
+    if (lo < 0) lo = 0;
+    if (hi > srcW) hi = srcW;
+  }
+
+  size_t totalPixels = (size_t)srcW * srcH;
+  size_t pixel = 0;
+  int sx = 0, sy = 0;
+  size_t pos = frame_header_size(rle, rleLen);
+  uint16_t color = curBit ? fg : bg;
+  size_t runLeft = 0;
+  int level = -1;                         // dither level of the run, -1 if plain
+  bool haveRun = false;
+
+  while (sy < srcH) {
+    // Constant coordinate of this source row
+    int rowX = m.bx * sy + m.cx;
+    int rowY = m.by * sy + m.cy;
+    bool rowVisible = m.ax ? (rowY >= 0 && rowY < dstH) : (rowX >= 0 && rowX < dstW);
+
+    while (sx < srcW) {
+      if (!runLeft) {
+        if (haveRun) { curBit = 1 - curBit; color = curBit ? fg : bg; }
+        if (pos + 1 < rleLen) {
+          uint16_t word = rle[pos] | (rle[pos + 1] << 8);
+          pos += 2;
+          runLeft = run_length(word, patterns);
+          level = run_level(word, patterns);
+        } else {
+          runLeft = totalPixels - pixel;        // pad with background
+          curBit = 0;
+          color = bg;
+          level = -1;
+        }
+        haveRun = true;
+        if (!runLeft) continue;
+      }
+      int segEnd = sx + (int)runLeft;
+      if (segEnd > srcW) segEnd = srcW;
+      if (rowVisible && (curBit || !delta || level >= 0)) {
+        int a = sx > lo ? sx : lo;
+        int b = segEnd < hi ? segEnd : hi;
+        if (a < b) {
+          uint16_t *p = canvas + (m.ay * a + rowY) * dstW + (m.ax * a + rowX);
+          if (level >= 0) {
+            uint8_t row = DITHER_ROWS[level][sy & 3];
+            for (int i = a; i < b; i++, p += step) *p = (row & (0x8 >> (i & 3))) ? fg : bg;
+          } else if (delta) {
+            for (int i = a; i < b; i++, p += step) *p ^= flip;
+          } else {
+            for (int i = a; i < b; i++, p += step) *p = color;
+          }
+        }
+      }
+      runLeft -= segEnd - sx;
+      pixel += segEnd - sx;
+      sx = segEnd;
+    }
+    sx = 0;
+    sy++;
+  }
+}
+
+// ---- 1-bpp expansion ----
+void expand_1bpp_to_rgb565(const uint8_t *bits, size_t stride, uint16_t w, uint16_t h,
+                           uint16_t *out, uint16_t fg, uint16_t bg) {
+  for (uint16_t y = 0; y < h; y++, bits += stride) {
+    for (uint16_t x = 0; x < w; x++) {
+      *out++ = (bits[x >> 3] & (0x80 >> (x & 7))) ? fg : bg;
+    }
+  }
+}
+
+void expand_1bpp_rotated(const uint8_t *bits, size_t stride, uint16_t w, uint16_t h,
+                         const QuarterMap &m, uint16_t *canvas, uint16_t dstW, uint16_t dstH,
+                         uint16_t fg, uint16_t bg) {
+  for (int sy = 0; sy < h; sy++, bits += stride) {
+    for (int sx = 0; sx < w; sx++) {
+      int dx = m.ax * sx + m.bx * sy + m.cx;
+      int dy = m.ay * sx + m.by * sy + m.cy;
+      if ((unsigned)dx >= dstW || (unsigned)dy >= dstH) continue;
+      canvas[dy * dstW + dx] = (bits[sx >> 3] & (0x80 >> (sx & 7))) ? fg : bg;
+    }
+  }
+}
+
+// ---- Long-term reference slots ----
+void RefStore::reset(uint16_t width, uint16_t height) {
+  for (uint8_t i = 0; i < MAX_REF_SLOTS; i++) {
+    free(slot_[i]);
+    slot_[i] = nullptr;
+  }
+  w_ = width;
+  h_ = height;
+  stride_ = bitmap_stride(width);
+}
+
+bool RefStore::store(const uint8_t *rle, size_t rleLen) {
+  int s = frame_store_slot(rle, rleLen);
+  if (s < 0) return true;
+  if (s >= MAX_REF_SLOTS) return false;
+  // deltas are stored by XORing onto a copy of their reference, which must
+  // stay intact for reference() on the same frame
+  const uint8_t *ref = nullptr;
+  if (frame_is_delta(rle, rleLen)) {
+    ref = reference(rle, rleLen);
+    if (!ref || ref == slot_[s]) return false;
+  }
+  if (!slot_[s]) slot_[s] = (uint8_t *)alloc_large(bitmap_bytes(w_, h_));
+  if (!slot_[s]) return false;
+  if (ref) memcpy(slot_[s], ref, stride_ * h_);
+  decode_bit_rle_to_1bpp(rle, rleLen, slot_[s], w_, h_, stride_);
+  return true;
+}
+
+const uint8_t *RefStore::reference(const uint8_t *rle, size_t rleLen) const {
+  int s = frame_ref_slot(rle, rleLen);
+  return s >= 0 && s < MAX_REF_SLOTS ? slot_[s] : nullptr;
+}
+
+size_t RefStore::residentBytes() const {
+  size_t n = 0;
+  for (uint8_t i = 0; i < MAX_REF_SLOTS; i++) {
+    if (slot_[i]) n += stride_ * h_;
+  }
+  return n;
+}
@@ -0,0 +1,302 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "bitmap.h"
+
+// ---- Video file header (12 bytes, packed) ----
+#pragma pack(push, 1)
+struct FileHeader {
+  uint16_t width;
+  uint16_t height;
+  uint32_t total_frames;
+  uint16_t fps;
+  uint16_t flags;
+};
+#pragma pack(pop)
+
+// ---- Header flags ----
+static const uint16_t FLAG_NATIVE = 0x0001;   // frames encoded in panel orientation/size
+static const uint16_t FLAG_DELTA  = 0x0002;   // file contains delta frames
+static const uint16_t FLAG_REFS   = 0x0004;   // file uses long-term reference slots
+static const uint16_t FLAG_ROW_INDEX = 0x0008; // frames carry row-restart indexes
+static const uint16_t FLAG_VECTOR = 0x0010;    // frames are polygon outlines (vector.h)
+static const uint16_t FLAG_LAYERS = 0x0020;    // base layer + droppable frames (index bit 31)
+static const uint16_t FLAG_COST_HINTS = 0x0040; // index bits 24..30 hold predicted frame costs
+static const uint16_t FLAG_THUMBS = 0x0080;     // thumbnail track before frame 0 (ThumbTrack)
+static const uint16_t FLAG_DITHER = 0x0100;     // frames may hold dither pattern runs
+static const uint16_t FLAG_INDEXED = 0x0200;    // frames are palette-indexed colour (indexed.h)
+
+// ---- Frame index ----
+// uint32 per frame: offset into the frame data. Bit 31 marks a droppable
+// frame -- nothing is coded against it, so a late player may skip it.
+// Bits 24..30 are the encoder's predicted decode + push time of the frame in
+// COST_HINT_US steps (FLAG_COST_HINTS files; saturates at 127). Offsets are
+// below 16 MB.
+static const uint32_t INDEX_DROPPABLE = 0x80000000u;
+static const uint32_t INDEX_OFFSET_MASK = 0x00FFFFFFu;
+static const int INDEX_HINT_SHIFT = 24;
+static const uint32_t COST_HINT_US = 500;
+
+static inline uint32_t index_offset(uint32_t entry) { return entry & INDEX_OFFSET_MASK; }
+static inline bool index_droppable(uint32_t entry) { return entry & INDEX_DROPPABLE; }
+static inline uint32_t index_cost_hint(uint32_t entry) { return (entry >> INDEX_HINT_SHIFT) & 0x7F; }
+
+// ---- Thumbnail track (FLAG_THUMBS) ----
+// Scrub previews: a tiny packed 1-bpp picture (MSB = leftmost pixel, rows
+// padded to whole bytes) of every `interval`-th frame, all the same size,
+// so thumbnail i is one read at a known offset and needs no decoding. The
+// track opens the frame data section and frame 0's index offset points
+// past it; players that don't scrub never see it.
+#pragma pack(push, 1)
+struct ThumbTrack {
+  uint16_t width, height;   // thumbnail pixels
+  uint16_t interval;        // thumbnail i shows frame i * interval
+  uint16_t count;
+};
+#pragma pack(pop)
+
+static inline size_t thumb_stride(const ThumbTrack &t) { return (t.width + 7) / 8; }
+static inline size_t thumb_bytes(const ThumbTrack &t) { return thumb_stride(t) * t.height; }
+
+// Offset of thumbnail i into the frame data section
+static inline size_t thumb_offset(const ThumbTrack &t, uint32_t i) {
+  return sizeof(ThumbTrack) + (size_t)i * thumb_bytes(t);
+}
+
+// Thumbnail nearest to `frame`
+static inline uint32_t thumb_for(const ThumbTrack &t, uint32_t frame) {
+  uint32_t i = (frame + t.interval / 2) / t.interval;
+  return i < t.count ? i : t.count - 1;
+}
+
+// False if the track is empty or doesn't fit before frame 0 (`frame0` is
+// its index offset)
+static inline bool thumb_track_valid(const ThumbTrack &t, uint32_t frame0) {
+  return t.count && t.interval && t.width && t.height && thumb_offset(t, t.count) <= frame0;
+}
+
+// ---- Display ----
+static const uint16_t DISP_W = 240;
+static const uint16_t DISP_H = 135;
+
+static const size_t MAX_RLE_SIZE = 16384;
+
+// ---- Bit-RLE decoders ----
+// Frame: uint8 type, [uint8 ref slot], [uint8 store slot], [row index], then
+// alternating uint16 run lengths (LE).
+//   type bit 0: value of the first run
+//   type bit 1: delta frame -- the runs are the XOR of this picture with the
+//               previous one, so 1-runs flip pixels and 0-runs keep them.
+//   type bit 2: (delta only) XOR against long-term reference `ref slot`
+//               instead of the previous frame
+//   type bit 3: also keep this picture in `store slot` (intra frames, or
+//               deltas against a reference slot other than `store slot`)
+//   type bit 4: a row-restart index follows the slot bytes:
+//               uint8 K, uint8 n, then n x {uint16 run, uint16 skip}: row
+//               (i+1)*K starts `skip` pixels into run number `run`
+//   type bit 5: (plain delta only) the picture is the previous one moved up
+//               by int8 dy rows (down if negative), new rows coming in at
+//               the edge; dy follows the slot bytes. The runs are still the
+//               XOR with the previous picture, so a decoder may ignore it;
+//               paths that hold the whole screen scroll the panel instead.
+//   type bit 6: a run word with bit 15 set is a dither pattern run: bits
+//               11..14 hold level k, bits 0..10 its length. Its pixels
+//               are set to ordered-dither level k (on where the 4x4 Bayer
+//               threshold at x & 3, y & 3 is below k) in intra and delta
+//               frames alike; it takes one place in the alternation.
+//   type bit 7: (FLAG_INDEXED files) a palette follows the slot bytes:
+//               uint8 n, n x uint16 RGB565; the runs are indexed runs
+//               (indexed.h) instead of alternating ones.
+// Intra frames (type 0/1) are the original format.
+static const uint8_t FRAME_DELTA = 0x02;
+static const uint8_t FRAME_REF   = 0x04;
+static const uint8_t FRAME_STORE = 0x08;
+static const uint8_t FRAME_ROWS  = 0x10;
+static const uint8_t FRAME_SCROLL = 0x20;
+static const uint8_t FRAME_PATTERN = 0x40;
+static const uint8_t FRAME_PALETTE = 0x80;
+
+static const uint8_t MAX_REF_SLOTS = 8;
+
+static inline bool frame_is_delta(const uint8_t *rle, size_t rleLen) {
+  return rleLen && (rle[0] & FRAME_DELTA);
+}
+
+// Decodable without the previous frame (intra, or delta against a slot)
+static inline bool frame_is_key(const uint8_t *rle, size_t rleLen) {
+  return !frame_is_delta(rle, rleLen) || (rle[0] & FRAME_REF);
+}
+
+static inline bool frame_has_patterns(const uint8_t *rle, size_t rleLen) {
+  return rleLen && (rle[0] & FRAME_PATTERN);
+}
+
+// ---- Dither pattern runs (FRAME_PATTERN) ----
+static const uint16_t RUN_PATTERN = 0x8000;
+static const int RUN_LEVEL_SHIFT = 11;
+static const uint16_t RUN_PATTERN_LENGTH = 0x07FF;
+static const uint8_t DITHER_LEVELS = 16;
+
+// Level k's pixels in row y: bit 0x8 >> (x & 3) of DITHER_ROWS[k][y & 3]
+extern const uint8_t DITHER_ROWS[DITHER_LEVELS][4];
+
+// Pixels a run word covers, and its dither level (-1 for a plain run)
+static inline uint16_t run_length(uint16_t word, bool patterns) {
+  return patterns && (word & RUN_PATTERN) ? word & RUN_PATTERN_LENGTH : word;
+}
+static inline int run_level(uint16_t word, bool patterns) {
+  return patterns && (word & RUN_PATTERN) ? (word >> RUN_LEVEL_SHIFT) & 0x0F : -1;
+}
+
+// Bytes before the row index (or the runs)
+static inline size_t frame_slots_end(const uint8_t *rle, size_t rleLen) {
+  if (!rleLen) return 0;
+  return 1 + ((rle[0] & FRAME_REF) ? 1 : 0) + ((rle[0] & FRAME_STORE) ? 1 : 0) +
+         ((rle[0] & FRAME_SCROLL) ? 1 : 0);
+}
+
+// Bytes before the first run
+static inline size_t frame_header_size(const uint8_t *rle, size_t rleLen) {
+  size_t at = frame_slots_end(rle, rleLen);
+  if (rleLen && (rle[0] & FRAME_ROWS)) {
+    if (rleLen <= at + 1) return rleLen;
+    at += 2 + 4 * (size_t)rle[at + 1];
+  }
+  if (rleLen && (rle[0] & FRAME_PALETTE)) at = rleLen > at ? at + 1 + 2 * (size_t)rle[at] : rleLen;
+  return at;
+}
+
+// Slot a frame references / stores into, -1 if none
+static inline int frame_ref_slot(const uint8_t *rle, size_t rleLen) {
+  return rleLen > 1 && (rle[0] & FRAME_REF) ? rle[1] : -1;
+}
+static inline int frame_store_slot(const uint8_t *rle, size_t rleLen) {
+  if (!rleLen) return -1;
+  size_t at = (rle[0] & FRAME_REF) ? 2 : 1;
+  return rleLen > at && (rle[0] & FRAME_STORE) ? rle[at] : -1;
+}
+
+// Rows a FRAME_SCROLL delta moved the picture up by, 0 for other frames
+static inline int frame_scroll(const uint8_t *rle, size_t rleLen) {
+  size_t at = frame_slots_end(rle, rleLen);
+  return rleLen >= at && at && (rle[0] & FRAME_SCROLL) ? (int8_t)rle[at - 1] : 0;
+}
+
+// Where decoding must start to reach row `row`: the latest restart point at
+// or before it, or the first run for frames without an index.
+struct RowRestart {
+  size_t pos;       // byte offset of the run
+  size_t pixel;     // first pixel of that run
+  uint8_t bit;      // its value
+};
+RowRestart frame_row_restart(const uint8_t *rle, size_t rleLen, uint16_t width, uint16_t row);
+
+// Decode to RGB565, one uint16 per pixel. Pixels past the last run get `bg`.
+// Delta frames swap fg/bg in place, so `out` must hold the previous frame.
+void decode_bit_rle_to_rgb565(const uint8_t *rle, size_t rleLen,
+                              uint16_t *out, uint16_t width, uint16_t height,
+                              uint16_t fg, uint16_t bg);
+
+// Same with the portable run kernels (rgb565.h), for checking the Xtensa ones
+void decode_bit_rle_to_rgb565_portable(const uint8_t *rle, size_t rleLen,
+                                       uint16_t *out, uint16_t width, uint16_t height,
+                                       uint16_t fg, uint16_t bg);
+
+// Decode to a packed 1-bpp bitmap, MSB = leftmost pixel, rows padded to
+// `strideBytes` (the layout of a 1-bit M5Canvas). Delta frames are XORed
+// into `out`. `out` must be 4-byte aligned and bitmap_bytes() long.
+void decode_bit_rle_to_1bpp(const uint8_t *rle, size_t rleLen,
+                            uint8_t *out, uint16_t width, uint16_t height,
+                            size_t strideBytes);
+
+// Same for rows [rowFirst, rowEnd) only; other rows are left untouched.
+// With a row index this skips the runs above rowFirst and stops after rowEnd.
+void decode_bit_rle_rows_to_1bpp(const uint8_t *rle, size_t rleLen,
+                                 uint8_t *out, uint16_t width, uint16_t height,
+                                 size_t strideBytes, uint16_t rowFirst, uint16_t rowEnd);
+
+// ---- Resumable 1-bpp decode ----
+// decode_bit_rle_to_1bpp in slices, for the cooperative player (coop.h).
+struct RleCursor {
+  size_t pos;       // next run
+  size_t pixel;     // where it starts
+  uint8_t bit;      // its value
+};
+
+// Clears `out` for intra frames and points the cursor at the first run.
+void rle_cursor_begin(const uint8_t *rle, size_t rleLen, uint8_t *out, uint16_t height,
+                      size_t strideBytes, RleCursor *c);
+
+// Decodes up to `maxRuns` more runs; true once the frame is complete.
+bool decode_bit_rle_step_1bpp(const uint8_t *rle, size_t rleLen, uint8_t *out,
+                              uint16_t width, uint16_t height, size_t strideBytes,
+                              RleCursor *c, uint32_t maxRuns);
+
+// Number of runs in a frame (decode work scales with this)
+static inline uint32_t rle_run_count(const uint8_t *rle, size_t rleLen) {
+  size_t hdr = frame_header_size(rle, rleLen);
+  return rleLen > hdr ? (rleLen - hdr) / 2 : 0;
+}
+
+// Expand a 1-bpp picture to RGB565 (1 -> fg, 0 -> bg).
+void expand_1bpp_to_rgb565(const uint8_t *bits, size_t stride, uint16_t w, uint16_t h,
+                           uint16_t *out, uint16_t fg, uint16_t bg);
+
+// ---- Quarter-turn placement of a video frame on the display ----
+// Maps source (sx, sy) to display (dx, dy) = (ax*sx + bx*sy + cx, ay*sx + by*sy + cy),
+// rotated clockwise by a multiple of 90° and centered like pushRotateZoom.
+struct QuarterMap {
+  int ax, bx, cx;
+  int ay, by, cy;
+};
+
+// Returns false if `angle` isn't a multiple of 90°.
+bool quarter_map(float angle, uint16_t srcW, uint16_t srcH,
+                 uint16_t dstW, uint16_t dstH, QuarterMap *m);
+
+// Display -> source mapping of a quarter turn.
+QuarterMap quarter_map_inverse(const QuarterMap &m);
+
+// Decode straight into a dstW-wide RGB565 canvas through `m`, clipping to
+// dstW x dstH. Canvas pixels outside the video are left untouched; delta
+// frames swap fg/bg of the pixels they flip.
+void decode_bit_rle_rotated(const uint8_t *rle, size_t rleLen,
+                            uint16_t srcW, uint16_t srcH, const QuarterMap &m,
+                            uint16_t *canvas, uint16_t dstW, uint16_t dstH,
+                            uint16_t fg, uint16_t bg);
+
+// Same, placed through a quarter-turn map into a dstW x dstH canvas
+void expand_1bpp_rotated(const uint8_t *bits, size_t stride, uint16_t w, uint16_t h,
+                         const QuarterMap &m, uint16_t *canvas, uint16_t dstW, uint16_t dstH,
+                         uint16_t fg, uint16_t bg);
+
+// ---- Long-term reference slots ----
+// 1-bpp pictures kept by FRAME_STORE frames for FRAME_REF deltas. Slots are
+// allocated on first use (PSRAM when present), ~4 KB each at 135x240.
+class RefStore {
+ public:
+  ~RefStore() { reset(0, 0); }
+
+  // Drop all slots; set the picture size for the next video.
+  void reset(uint16_t width, uint16_t height);
+
+  // Keep the picture of a FRAME_STORE frame; no-op for other frames.
+  // False if the slot can't be allocated or a delta's reference is empty.
+  bool store(const uint8_t *rle, size_t rleLen);
+
+  // Picture a FRAME_REF frame is coded against, null if none/empty.
+  const uint8_t *reference(const uint8_t *rle, size_t rleLen) const;
+
+  size_t stride() const { return stride_; }
+  size_t residentBytes() const;
+
+ private:
+  uint16_t w_ = 0, h_ = 0;
+  size_t stride_ = 0;
+  uint8_t *slot_[MAX_REF_SLOTS] = {};
+};
+
+// Repaint a decoded RGB565 picture after a colour change, so later delta
+// frames flip between the new colours. `stride` is in pixels.
+void recolor_rgb565(uint16_t *px, int w, int h, size_t stride,
+                    uint16_t oldFg, uint16_t fg, uint16_t bg);
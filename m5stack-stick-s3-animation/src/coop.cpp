@@ -0,0 +1,337 @@
+#include "coop.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "platform.h"
+
+static const uint32_t FAR_US = 1000000;       // wake hint of a task waiting on another
+static const uint32_t LOAD_SLICE_US = 1000;
+
+// Other work first: it is what must not starve
+static const CoopTaskId TASK_ORDER[TASK_COUNT] = { TASK_LOAD, TASK_INPUT, TASK_READER,
+                                                   TASK_DECODER, TASK_RENDERER };
+
+const char *CoopPlayer::taskName(int id) {
+  static const char *const names[TASK_COUNT] = { "input", "reader", "decoder", "renderer",
+                                                 "load" };
+  return id >= 0 && id < TASK_COUNT ? names[id] : "?";
+}
+
+bool CoopPlayer::begin(Panel &panel, const FileHeader &v, FrameReader read, void *readCtx,
+                       const uint32_t *index, CoopClock &clock, const CoopConfig &cfg,
+                       const CoopHooks &hooks, const RenderParams &params) {
+  end();
+  QuarterMap m;
+  if ((v.flags & (FLAG_VECTOR | FLAG_INDEXED)) || cfg.first >= v.total_frames ||
+      !quarter_map(cfg.angle, v.width, v.height, panel.width(), panel.height(), &m)) {
+    return false;
+  }
+  panel_ = &panel;
+  clock_ = &clock;
+  v_ = v;
+  read_ = read;
+  readCtx_ = readCtx;
+  index_ = index;
+  cfg_ = cfg;
+  hooks_ = hooks;
+  params_ = params;
+  params_.refs = nullptr;
+  inv_ = quarter_map_inverse(m);
+  stride_ = bitmap_stride(v.width);
+  end_ = cfg.first + (cfg.count < v.total_frames - cfg.first ? cfg.count
+                                                             : v.total_frames - cfg.first);
+  if (cfg.model) {
+    cost_ = cfg.model->path[PATH_ROW_STRIP];   // same CPU work; the push is DMA'd
+    readOp_ = cfg.model->readOp;
+    readByte_ = cfg.model->readByte;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    rle_[i] = (uint8_t *)alloc_large(MAX_RLE_SIZE);
+    pic_[i] = (uint8_t *)malloc(bitmap_bytes(v.width, v.height));
+    strip_[i] = (uint16_t *)alloc_in(PLACE_DMA, (size_t)panel.width() * STRIP_ROWS * 2);
+    if (!rle_[i] || !pic_[i] || !strip_[i]) { end(); return false; }
+    picState_[i] = PIC_FREE;
+  }
+  refs_.reset(v.width, v.height);
+  if (v.flags & FLAG_REFS) prime_refs(refs_, read, readCtx, cfg.first, rle_[0], MAX_RLE_SIZE);
+
+  readNext_ = decodeNext_ = cfg.first;
+  decodingPic_ = lastPic_ = showPic_ = -1;
+  rstate_ = R_WAIT;
+  shownFrames_ = 0;
+  paused_ = stopped_ = readError = false;
+  memset(taskSteps, 0, sizeof(taskSteps));
+  memset(taskUs, 0, sizeof(taskUs));
+  idleUs = dmaWaitUs = 0;
+
+  uint32_t now = clock.now();
+  uint32_t period = 1000000 / (v.fps ? v.fps : 15);
+  pacer.start(now, period, v.flags & FLAG_LAYERS);
+  nextInput_ = now;
+  loadLeft_ = 0;
+  loadRefill_ = now;
+  return true;
+}
+
+void CoopPlayer::end() {
+  for (int i = 0; i < 2; i++) {
+    free(rle_[i]);
+    free(pic_[i]);
+    free(strip_[i]);
+    rle_[i] = pic_[i] = nullptr;
+    strip_[i] = nullptr;
+  }
+  if (panel_ && rstate_ != R_WAIT) {
+    panel_->waitDMA();
+    panel_->endWrite();
+  }
+  rstate_ = R_WAIT;
+  refs_.reset(0, 0);
+}
+
+// ---- Scheduler ----
+bool CoopPlayer::step() {
+  if (stopped_ || readError) return false;
+  if (shownFrames_ >= end_ - cfg_.first && rendererIdle()) return false;
+
+  uint32_t wake = clock_->now() + FAR_US;
+  bool worked = false;
+  for (int n = 0; n < TASK_COUNT; n++) {
+    CoopTaskId id = TASK_ORDER[n];
+    uint32_t t0 = clock_->now();
+    uint32_t w = t0 + FAR_US;
+    stepStart_ = t0;
+    bool did;
+    switch (id) {
+      case TASK_INPUT:    did = input(t0, &w); break;
+      case TASK_READER:   did = reader(t0, &w); break;
+      case TASK_DECODER:  did = decoder(t0, &w); break;
+      case TASK_RENDERER: did = renderer(t0, &w); break;
+      case TASK_LOAD:     did = load(t0, &w); break;
+      default:            did = false; break;
+    }
+    if (did) {
+      worked = true;
+      taskSteps[id]++;
+      taskUs[id] += clock_->now() - t0;
+    } else if ((int32_t)(w - wake) < 0) {
+      wake = w;
+    }
+  }
+  if (!worked) {
+    uint32_t now = clock_->now();
+    if ((int32_t)(wake - now) > 0) {
+      stepStart_ = now;
+      if (wake - now >= 100) trace("idle     %.2f ms", (wake - now) / 1000.0f);
+      idleUs += wake - now;
+    }
+    clock_->idleUntil(wake);
+  }
+  return true;
+}
+
+bool CoopPlayer::rendererIdle() const {
+  return rstate_ == R_WAIT;
+}
+
+// ---- Input: buttons, serial link, pause ----
+bool CoopPlayer::input(uint32_t now, uint32_t *wake) {
+  if (!hooks_.input) return false;
+  if ((int32_t)(now - nextInput_) < 0) {
+    *wake = nextInput_;
+    return false;
+  }
+  nextInput_ = now + cfg_.inputPeriodUs;
+  bool was = paused_;
+  if (!hooks_.input(hooks_.ctx, &params_, &paused_)) stopped_ = true;
+  params_.refs = nullptr;
+  if (was && !paused_) pacer.restart(now);
+  return true;
+}
+
+// ---- Reader: keeps up to two frames read ahead ----
+bool CoopPlayer::reader(uint32_t now, uint32_t *wake) {
+  if (readNext_ >= end_ || readNext_ >= decodeNext_ + 2) return false;
+  if (cfg_.serial) {
+    bool idle = readNext_ == decodeNext_ && decodingPic_ < 0 && rendererIdle() &&
+                picState_[0] != PIC_READY && picState_[1] != PIC_READY;
+    if (!idle || loadLeft_) return false;       // other work had the core first
+    if ((int32_t)(now - pacer.due()) < 0) {   // the blocking loop sleeps first
+      *wake = pacer.due();
+      return false;
+    }
+  }
+  int slot = readNext_ % 2;
+  if (!read_(readCtx_, readNext_, rle_[slot], MAX_RLE_SIZE, &rleLen_[slot])) {
+    log_printf("coop: read error at frame %u\n", (unsigned)readNext_);
+    readError = true;
+    return true;
+  }
+  charge(readOp_ + readByte_ * rleLen_[slot]);
+  trace("reader   f%u, %u bytes", (unsigned)readNext_, (unsigned)rleLen_[slot]);
+  readNext_++;
+  return true;
+}
+
+// ---- Decoder: run batches into a free picture ----
+bool CoopPlayer::decoder(uint32_t now, uint32_t *wake) {
+  if (decodingPic_ < 0) {
+    if (decodeNext_ >= readNext_) return false;
+    bool nothingQueued = rendererIdle() && picState_[0] != PIC_READY &&
+                         picState_[1] != PIC_READY;
+    if (cfg_.serial && !nothingQueued) return false;
+    const uint8_t *rle = rle_[decodeNext_ % 2];
+    size_t len = rleLen_[decodeNext_ % 2];
+
+    // Late and the renderer is starving: skip enhancement frames
+    if (nothingQueued && index_ && pacer.drop(now, index_droppable(index_[decodeNext_]))) {
+      trace("decoder  f%u dropped", (unsigned)decodeNext_);
+      decodeNext_++;
+      shownFrames_++;
+      return true;
+    }
+
+    // the last picture doubles as the delta base when it's already shown
+    int k = lastPic_ >= 0 && picState_[lastPic_] == PIC_FREE ? lastPic_
+          : picState_[0] == PIC_FREE ? 0 : picState_[1] == PIC_FREE ? 1 : -1;
+    if (k < 0) return false;
+    refs_.store(rle, len);
+    if (const uint8_t *ref = refs_.reference(rle, len)) {
+      memcpy(pic_[k], ref, stride_ * v_.height);
+    } else if (frame_is_delta(rle, len) && lastPic_ >= 0 && lastPic_ != k) {
+      memcpy(pic_[k], pic_[lastPic_], stride_ * v_.height);
+    }
+    rle_cursor_begin(rle, len, pic_[k], v_.height, stride_, &cursor_);
+    charge(cost_.fill * v_.width * v_.height);
+    picState_[k] = PIC_DECODING;
+    picFrame_[k] = decodeNext_;
+    decodingPic_ = k;
+    trace("decoder  f%u start (%u runs)", (unsigned)decodeNext_,
+          (unsigned)rle_run_count(rle, len));
+    return true;
+  }
+
+  int k = decodingPic_;
+  const uint8_t *rle = rle_[decodeNext_ % 2];
+  size_t len = rleLen_[decodeNext_ % 2];
+  size_t from = cursor_.pos;
+  bool done = decode_bit_rle_step_1bpp(rle, len, pic_[k], v_.width, v_.height, stride_,
+                                       &cursor_, cfg_.serial ? 0xFFFFFFFFu : cfg_.runBatch);
+  uint32_t runs = (uint32_t)(cursor_.pos - from) / 2;
+  charge(cost_.run * runs);
+  trace("decoder  f%u %u runs%s", (unsigned)decodeNext_, (unsigned)runs, done ? ", done" : "");
+  if (done) {
+    picState_[k] = PIC_READY;
+    lastPic_ = k;
+    decodingPic_ = -1;
+    decodeNext_++;
+  }
+  return true;
+}
+
+// ---- Renderer: compose a strip, hand it to DMA, compose the next ----
+bool CoopPlayer::renderer(uint32_t now, uint32_t *wake) {
+  uint16_t w = panel_->width(), h = panel_->height();
+  switch (rstate_) {
+    case R_WAIT: {
+      int k = -1;
+      for (int i = 0; i < 2; i++) {
+        if (picState_[i] == PIC_READY && (k < 0 || picFrame_[i] < picFrame_[k])) k = i;
+      }
+      if (k < 0 || paused_) return false;
+      if ((int32_t)(now - pacer.due()) < 0) {
+        *wake = pacer.due();
+        return false;
+      }
+      showPic_ = k;
+      showFrame_ = picFrame_[k];
+      picState_[k] = PIC_SHOWING;
+      stripY_ = stripK_ = 0;
+      panel_->beginWrite();
+      rstate_ = R_COMPOSE;
+    }
+    // fall through
+    case R_COMPOSE: {
+      stripRows_ = h - stripY_ < STRIP_ROWS ? h - stripY_ : STRIP_ROWS;
+      compose_strip(pic_[showPic_], stride_, v_.width, v_.height, inv_, strip_[stripK_], w,
+                    stripY_, stripRows_, params_.fg, params_.bg);
+      charge(cost_.compose * w * stripRows_);
+      trace("renderer f%u compose rows %d..%d", (unsigned)showFrame_, stripY_,
+            stripY_ + stripRows_ - 1);
+      if (stripY_ + stripRows_ >= h) picState_[showPic_] = PIC_FREE;   // all read
+      rstate_ = R_PUSH;
+      return true;
+    }
+    case R_PUSH:
+    case R_FLUSH:
+      if (clock_->dmaBusy(*panel_)) {
+        if (!cfg_.serial) {
+          *wake = clock_->dmaDoneAt(*panel_);
+          return false;
+        }
+        uint32_t t0 = clock_->now();
+        while (clock_->dmaBusy(*panel_)) clock_->idleUntil(clock_->dmaDoneAt(*panel_));
+        dmaWaitUs += clock_->now() - t0;
+      }
+      if (rstate_ == R_PUSH) {
+        panel_->pushBlockDMA(0, stripY_, w, stripRows_, strip_[stripK_]);
+        clock_->dmaStarted((uint32_t)w * stripRows_ * 2);
+        trace("renderer f%u dma rows %d..%d", (unsigned)showFrame_, stripY_,
+              stripY_ + stripRows_ - 1);
+        stripY_ += stripRows_;
+        stripK_ ^= 1;
+        rstate_ = stripY_ >= h ? R_FLUSH : R_COMPOSE;
+        return true;
+      }
+      panel_->endWrite();
+      pacer.next(clock_->now());
+      shownFrames_++;
+      trace("renderer f%u shown", (unsigned)showFrame_);
+      showPic_ = -1;
+      rstate_ = R_WAIT;
+      if (hooks_.shown) hooks_.shown(hooks_.ctx, showFrame_);
+      return true;
+  }
+  return false;
+}
+
+// ---- Other work on the core (simulator) ----
+bool CoopPlayer::load(uint32_t now, uint32_t *wake) {
+  if (!cfg_.loadUs) return false;
+  // the blocking loop only gets to other work between frames
+  if (cfg_.serial && (decodingPic_ >= 0 || !rendererIdle() || picState_[0] == PIC_READY ||
+                      picState_[1] == PIC_READY)) {
+    return false;
+  }
+  uint32_t period = 1000000 / (v_.fps ? v_.fps : 15);
+  while ((int32_t)(now - loadRefill_) >= 0) {    // unfinished work carries over
+    loadLeft_ += cfg_.loadUs;
+    loadRefill_ += period;
+  }
+  if (!loadLeft_) {
+    *wake = loadRefill_;
+    return false;
+  }
+  uint32_t slice = loadLeft_ < LOAD_SLICE_US ? loadLeft_ : LOAD_SLICE_US;
+  charge((float)slice * COST_CPU_MHZ);
+  loadLeft_ -= slice;
+  trace("load     %.1f ms", slice / 1000.0f);
+  return true;
+}
+
+// ---- Trace of the first frames ----
+bool CoopPlayer::tracing() const {
+  return shownFrames_ < cfg_.traceFrames;
+}
+
+void CoopPlayer::trace(const char *fmt, ...) {
+  if (!tracing()) return;
+  char buf[96];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  log_printf("%9.2f ms  %s\n", stepStart_ / 1000.0f, buf);
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <stdint.h>
+#include "bench.h"
+#include "cost_model.h"
+#include "pacing.h"
+#include "render.h"
+
+// ---- Cooperative player for single-core builds ----
+// When WiFi or audio claims a core, playback shares the other one, and the
+// blocking loop spins in waitDMA() while strips go out. Here reading,
+// decoding, rendering and input are tasks that do a bounded slice per step
+// (one frame read, a batch of runs, one strip composed or pushed) and
+// return; a round-robin scheduler runs whichever is ready, so the next
+// frame is decoded while the current one is still on its way to the LCD.
+//
+// The tasks are resumable state machines rather than C++20 coroutines: the
+// ESP32 Arduino toolchain is GCC 8 building gnu++11. Pictures take the
+// row-strip pipeline (1-bpp decode, rotated strips, DMA ping-pong), so
+// bit-RLE files at quarter-turn angles only.
+
+// Scheduler time: the real clock on the device; in the host simulator a
+// virtual one that charges cost-model time for the work done.
+class CoopClock {
+ public:
+  virtual ~CoopClock() {}
+  virtual uint32_t now() = 0;                       // µs
+  // CPU work just done, in cycles at COST_CPU_MHZ (virtual clocks only)
+  virtual void spent(float cycles) {}
+  // A DMA push of `bytes` has started
+  virtual void dmaStarted(uint32_t bytes) {}
+  virtual bool dmaBusy(Panel &panel) { return panel.dmaBusy(); }
+  // When a running DMA should be done; now() means poll again
+  virtual uint32_t dmaDoneAt(Panel &panel) { return now(); }
+  // Nothing is ready before `us`
+  virtual void idleUntil(uint32_t us) = 0;
+};
+
+struct CoopConfig {
+  uint32_t first = 0;             // decoding starts here: a keyframe
+  uint32_t count = 0;
+  float angle = 90.0f;
+  uint32_t runBatch = 64;         // runs per decoder step
+  uint32_t inputPeriodUs = 20000;
+  // Other work on the same core (audio, WiFi), as CPU time per frame
+  // period taken in 1 ms slices -- all of it between frames in serial
+  // order, a slice per scheduler round otherwise. Simulator only.
+  uint32_t loadUs = 0;
+  // Straight-line order: read, decode and show one frame at a time and
+  // spin while DMA runs -- what the blocking loop does, for comparison.
+  bool serial = false;
+  const CostModel *model = nullptr;   // coefficients charged to the clock
+  uint32_t traceFrames = 0;       // log every step of the first N frames
+};
+
+struct CoopHooks {
+  // Buttons, link, ...: may change colours and pause; false stops playback
+  bool (*input)(void *ctx, RenderParams *p, bool *paused) = nullptr;
+  // A frame has gone out to the panel completely
+  void (*shown)(void *ctx, uint32_t frame) = nullptr;
+  void *ctx = nullptr;
+};
+
+enum CoopTaskId { TASK_INPUT, TASK_READER, TASK_DECODER, TASK_RENDERER, TASK_LOAD, TASK_COUNT };
+
+class CoopPlayer {
+ public:
+  ~CoopPlayer() { end(); }
+
+  // Allocates the frame, picture and strip buffers; false on OOM or if the
+  // video can't take the strip pipeline.
+  bool begin(Panel &panel, const FileHeader &v, FrameReader read, void *readCtx,
+             const uint32_t *index, CoopClock &clock, const CoopConfig &cfg,
+             const CoopHooks &hooks, const RenderParams &params);
+  void end();
+
+  // One scheduler round (idles if nothing was ready); false once every
+  // frame is shown or dropped, or input stopped playback.
+  bool step();
+
+  static const char *taskName(int id);
+
+  FramePacer pacer;
+  uint32_t taskSteps[TASK_COUNT] = {};
+  uint32_t taskUs[TASK_COUNT] = {};   // time inside each task's steps
+  uint32_t idleUs = 0;
+  uint32_t dmaWaitUs = 0;             // renderer spinning on DMA (serial only)
+  bool readError = false;
+
+ private:
+  enum PicState { PIC_FREE, PIC_DECODING, PIC_READY, PIC_SHOWING };
+  enum RenderState { R_WAIT, R_COMPOSE, R_PUSH, R_FLUSH };
+
+  bool input(uint32_t now, uint32_t *wake);
+  bool reader(uint32_t now, uint32_t *wake);
+  bool decoder(uint32_t now, uint32_t *wake);
+  bool renderer(uint32_t now, uint32_t *wake);
+  bool load(uint32_t now, uint32_t *wake);
+  bool rendererIdle() const;
+  void charge(float cycles) { clock_->spent(cycles); }
+  bool tracing() const;
+  void trace(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  Panel *panel_ = nullptr;
+  CoopClock *clock_ = nullptr;
+  FileHeader v_ = {};
+  FrameReader read_ = nullptr;
+  void *readCtx_ = nullptr;
+  const uint32_t *index_ = nullptr;
+  CoopConfig cfg_;
+  CoopHooks hooks_;
+  RenderParams params_ = {};
+  PathCost cost_ = {};
+  float readOp_ = 0, readByte_ = 0;
+  QuarterMap inv_ = {};
+  size_t stride_ = 0;
+  uint32_t end_ = 0;
+  bool paused_ = false, stopped_ = false;
+
+  // ---- Read frames: frame i sits in slot i % 2 ----
+  uint8_t *rle_[2] = { nullptr, nullptr };
+  size_t rleLen_[2] = { 0, 0 };
+  uint32_t readNext_ = 0;       // next frame to read
+  uint32_t decodeNext_ = 0;     // next frame to decode; slots below are free
+
+  // ---- Decoded pictures ----
+  RefStore refs_;
+  uint8_t *pic_[2] = { nullptr, nullptr };
+  PicState picState_[2] = { PIC_FREE, PIC_FREE };
+  uint32_t picFrame_[2] = { 0, 0 };
+  int decodingPic_ = -1;
+  int lastPic_ = -1;            // latest complete decode (delta base)
+  RleCursor cursor_ = {};
+
+  // ---- Renderer ----
+  RenderState rstate_ = R_WAIT;
+  int showPic_ = -1;
+  uint16_t *strip_[2] = { nullptr, nullptr };
+  int stripY_ = 0, stripK_ = 0, stripRows_ = 0;
+  uint32_t shownFrames_ = 0;    // shown + dropped
+
+  uint32_t nextInput_ = 0;
+  uint32_t loadLeft_ = 0, loadRefill_ = 0;
+  uint32_t stepStart_ = 0;
+  uint32_t showFrame_ = 0;
+};
@@ -0,0 +1,78 @@
+#include "cost_model.h"
+#include <stdio.h>
+#include <string.h>
+#include "platform.h"
+
+void cost_model_defaults(CostModel *m) {
+  memset(m, 0, sizeof(*m));
+  m->readOp = 48000;       // ~200 µs seek + read call
+  m->readByte = 20;
+  //                          valid  run fill compose spi (cycles)
+  m->path[PATH_ROTATE_ZOOM]  = { true, 40,  2,  20,  48 };
+  m->path[PATH_NATIVE]       = { true, 40,  2,   0,  48 };
+  m->path[PATH_FUSED_ROTATE] = { true, 50,  3,   0,  48 };
+  m->path[PATH_ROW_STRIP]    = { true, 40, 12,  10,  48 };
+  m->path[PATH_PALETTE_1BPP] = { true, 40, 12,  20,  48 };
+  m->path[PATH_DMA_PINGPONG] = { true, 40, 12,  10,  30 };  // push partly hidden
+  m->path[PATH_ZOOM]         = { true, 40, 12,  12,  48 };
+  m->path[PATH_VECTOR]       = { true, 60,  3,   0,  48 };
+  m->path[PATH_SHRINK]       = { true, 40, 12,  14,  48 };
+}
+
+bool cost_model_parse_line(CostModel *m, const char *line) {
+  char name[24];
+  float a, b, c, d;
+  if (sscanf(line, "model read op=%f byte=%f", &a, &b) == 2) {
+    m->readOp = a;
+    m->readByte = b;
+    return true;
+  }
+  if (sscanf(line, "model path %23s run=%f fill=%f compose=%f spi=%f",
+             name, &a, &b, &c, &d) != 5) {
+    return false;
+  }
+  for (int id = 0; id < PATH_COUNT; id++) {
+    if (strcmp(render_path((RenderPathId)id)->name(), name) != 0) continue;
+    PathCost pc = { true, a, b, c, d };
+    m->path[id] = pc;
+    return true;
+  }
+  return false;
+}
+
+void cost_model_print(const CostModel &m) {
+  log_printf("model read op=%.0f byte=%.2f\n", m.readOp, m.readByte);
+  for (int id = 0; id < PATH_COUNT; id++) {
+    const PathCost &p = m.path[id];
+    if (!p.valid) continue;
+    log_printf("model path %s run=%.2f fill=%.3f compose=%.3f spi=%.3f\n",
+               render_path((RenderPathId)id)->name(), p.run, p.fill, p.compose, p.spi);
+  }
+}
+
+float cost_model_predict(const CostModel &m, RenderPathId id, const FrameWork &w,
+                         StageTimes *t) {
+  const PathCost &p = m.path[id];
+  float read = m.readOp + m.readByte * w.readBytes;
+  float decode = p.run * w.runs + p.fill * w.fillPixels;
+  float compose = p.compose * w.composePixels;
+  float push = p.spi * w.spiBytes;
+  if (t) {
+    t->decodeUs += (uint32_t)(decode / COST_CPU_MHZ);
+    t->composeUs += (uint32_t)(compose / COST_CPU_MHZ);
+    t->pushUs += (uint32_t)(push / COST_CPU_MHZ);
+  }
+  return (read + decode + compose + push) / COST_CPU_MHZ;
+}
+
+bool LinearFit::solve(double *slope, double *intercept) const {
+  double den = n_ * sxx_ - sx_ * sx_;
+  if (n_ < 2 || den <= 1e-9 * n_ * sxx_) {
+    *slope = 0;
+    *intercept = meanY();
+    return false;
+  }
+  *slope = (n_ * sxy_ - sx_ * sy_) / den;
+  *intercept = (sy_ - *slope * sx_) / n_;
+  return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "render.h"
+
+// ---- Device frame-time model ----
+// Per-frame cost in CPU cycles:
+//   read    = readOp + readByte * frameBytes                (LittleFS)
+//   decode  = run * runs + fill * videoPixels               (per path)
+//   compose = compose * path->composePixels()               (per path)
+//   push    = spi * spiBytes                                (per path)
+// The device bench fits the coefficients and prints them as `model` lines;
+// the host build reads those lines back to predict device frame times.
+
+static const uint32_t COST_CPU_MHZ = 240;
+
+struct PathCost {
+  bool valid;
+  float run, fill, compose, spi;
+};
+
+struct CostModel {
+  float readOp, readByte;
+  PathCost path[PATH_COUNT];
+};
+
+// Work one frame puts through a path
+struct FrameWork {
+  uint32_t readBytes;
+  uint32_t runs;
+  uint32_t fillPixels;
+  uint32_t composePixels;
+  uint32_t spiBytes;
+};
+
+// Rough ESP32 @ 240 MHz / 40 MHz SPI figures, until a device run replaces them
+void cost_model_defaults(CostModel *m);
+
+// Parse one `model ...` line (as printed by cost_model_print); false if the
+// line isn't one.
+bool cost_model_parse_line(CostModel *m, const char *line);
+void cost_model_print(const CostModel &m);
+
+// Predicted stage times in µs; returns the total.
+float cost_model_predict(const CostModel &m, RenderPathId id, const FrameWork &w,
+                         StageTimes *t = nullptr);
+
+// ---- Least-squares line y = slope * x + intercept ----
+class LinearFit {
+ public:
+  void add(double x, double y) {
+    n_++; sx_ += x; sy_ += y; sxx_ += x * x; sxy_ += x * y;
+  }
+  uint32_t count() const { return n_; }
+  double meanY() const { return n_ ? sy_ / n_ : 0.0; }
+
+  // False when x never varied; slope is then 0 and intercept the mean.
+  bool solve(double *slope, double *intercept) const;
+
+ private:
+  uint32_t n_ = 0;
+  double sx_ = 0, sy_ = 0, sxx_ = 0, sxy_ = 0;
+};
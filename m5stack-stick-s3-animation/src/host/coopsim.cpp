@@ -0,0 +1,121 @@
+#include "coopsim.h"
+#include <vector>
+#include "../coop.h"
+#include "../platform.h"
+#include "../render.h"
+
+class VirtualClock : public CoopClock {
+ public:
+  explicit VirtualClock(float spiCycles) : spi_(spiCycles) {}
+
+  uint32_t now() override { return (uint32_t)t_; }
+  void spent(float cycles) override { t_ += cycles / COST_CPU_MHZ; }
+  void dmaStarted(uint32_t bytes) override {
+    dmaEnd_ = (dmaEnd_ > t_ ? dmaEnd_ : t_) + (bytes + 11) * spi_ / COST_CPU_MHZ;
+  }
+  bool dmaBusy(Panel &) override { return t_ < dmaEnd_; }
+  uint32_t dmaDoneAt(Panel &) override { return (uint32_t)dmaEnd_ + 1; }
+  void idleUntil(uint32_t us) override {
+    if (us > t_) t_ = us;
+  }
+
+ private:
+  float spi_;
+  double t_ = 0, dmaEnd_ = 0;
+};
+
+struct ShownCheck {
+  Panel *panel;
+  const std::vector<uint32_t> *sums;
+  uint32_t first;
+  uint32_t corrupt;
+};
+
+static void checkShown(void *ctx, uint32_t frame) {
+  ShownCheck &c = *(ShownCheck *)ctx;
+  if (c.panel->checksum() != (*c.sums)[frame - c.first]) c.corrupt++;
+}
+
+bool run_coop_sim(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                  const uint32_t *index, const CostModel &model, const BenchConfig &cfg,
+                  const float *loadMs, int loads, uint32_t traceFrames) {
+  RenderPath *ref = render_path(PATH_ROW_STRIP);
+  if (!ref->supports(panel, v, cfg.angle) || !model.path[PATH_ROW_STRIP].valid) {
+    log_printf("coop: needs a bit-RLE file at a quarter-turn angle\n");
+    return false;
+  }
+  std::vector<uint8_t> rle(MAX_RLE_SIZE);
+  Segment seg;
+  if (!find_segment(v, read, ctx, cfg, rle.data(), rle.size(), &seg)) return false;
+  uint32_t first = seg.key, count = seg.count + cfg.first - seg.key;
+
+  // ---- Reference: every frame through row-strip, unpaced ----
+  RefStore refs;
+  RenderParams params = { cfg.fg, cfg.bg, cfg.angle, (v.flags & FLAG_REFS) ? &refs : nullptr,
+                          1, 0.5f, 0.5f };
+  std::vector<uint32_t> sums(count);
+  if (!ref->begin(panel, v)) return false;
+  panel.fillScreen(0x0000);
+  reset_refs(refs, v, read, ctx, first, rle.data(), rle.size());
+  for (uint32_t i = 0; i < count; i++) {
+    size_t len;
+    if (!read(ctx, first + i, rle.data(), rle.size(), &len)) return false;
+    ref->render(rle.data(), len, params, nullptr);
+    sums[i] = panel.checksum();
+  }
+  ref->end();
+
+  uint32_t periodUs = 1000000 / (v.fps ? v.fps : 15);
+  log_printf("coop: frames %u..%u @ %u fps, budget %.1f ms, row-strip costs, "
+             "DMA at %.0f cycles/byte\n", (unsigned)first, (unsigned)(first + count - 1),
+             v.fps, periodUs / 1000.0f, model.path[PATH_ROW_STRIP].spi);
+  log_printf("%-8s %7s %7s %7s %7s %7s %8s %7s %7s %8s\n", "mode", "load ms", "shown",
+             "dropped", "late", "resync", "time s", "cpu %", "spin %", "corrupt");
+
+  for (int l = 0; l < loads; l++) {
+    if (loadMs[l] * 1000 >= periodUs) {    // the player would never get the core
+      log_printf("%-8s %7.1f  skipped: a whole frame period\n", "", loadMs[l]);
+      continue;
+    }
+    for (int serial = 1; serial >= 0; serial--) {
+      VirtualClock clock(model.path[PATH_ROW_STRIP].spi);
+      CoopConfig cc;
+      cc.first = first;
+      cc.count = count;
+      cc.angle = cfg.angle;
+      cc.loadUs = (uint32_t)(loadMs[l] * 1000);
+      cc.serial = serial;
+      cc.model = &model;
+      cc.traceFrames = !serial && l == 0 ? traceFrames : 0;
+      ShownCheck check = { &panel, &sums, first, 0 };
+      CoopHooks hooks;
+      hooks.shown = checkShown;
+      hooks.ctx = &check;
+
+      CoopPlayer player;
+      panel.fillScreen(0x0000);
+      if (!player.begin(panel, v, read, ctx, index, clock, cc, hooks, params)) {
+        log_printf("coop: out of memory\n");
+        return false;
+      }
+      if (cc.traceFrames) log_printf("coop: trace of the first %u frames\n", (unsigned)traceFrames);
+      while (player.step()) {}
+      player.end();
+
+      uint32_t elapsed = clock.now();
+      uint32_t busy = 0;
+      for (int t = 0; t < TASK_COUNT; t++) {
+        if (t != TASK_LOAD) busy += player.taskUs[t];
+      }
+      const FramePacer &p = player.pacer;
+      log_printf("%-8s %7.1f %7u %7u %7u %7u %8.1f %7.1f %7.1f %8u\n",
+                 serial ? "blocking" : "coop", loadMs[l], (unsigned)p.shown, (unsigned)p.dropped,
+                 (unsigned)p.late, (unsigned)p.resyncs, elapsed / 1e6f,
+                 elapsed ? 100.0f * busy / elapsed : 0.0f,
+                 elapsed ? 100.0f * player.dmaWaitUs / elapsed : 0.0f, (unsigned)check.corrupt);
+    }
+  }
+  log_printf("coop: nominal %.1f s; cpu = player tasks incl. DMA spin\n",
+             count * periodUs / 1e6f);
+  return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "../bench.h"
+#include "../cost_model.h"
+
+// ---- Cooperative player on a virtual clock ----
+// Plays frames [first, first+count) with CoopPlayer (coop.h) twice per
+// load: in serial order, like the blocking loop (read, decode, show, spin
+// on DMA), and interleaved. CPU work costs cost-model time, the DMA moves
+// strips at the model's SPI rate in parallel with it, and `loadMs` per
+// frame period of other work shares the core. Every shown frame is checked
+// against an unpaced row-strip run. `traceFrames` logs each step of the
+// first frames of the interleaved run.
+bool run_coop_sim(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                  const uint32_t *index, const CostModel &model, const BenchConfig &cfg,
+                  const float *loadMs, int loads, uint32_t traceFrames);
@@ -0,0 +1,261 @@
+// Host build (pio run -e native): runs the render benchmark against an
+// in-memory panel, so codec and render changes can be checked off-device,
+// predicts device frame times from a calibrated cost model, simulates paced
+// playback under artificial CPU load, runs the cooperative player on a
+// virtual clock, checks the bytes sent to the panel and the panel's hardware
+// scroll, replays recorded input traces, times scrub previews against
+// seeking by decoding and plays a picture-in-picture inset.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../autotune.h"
+#include "../bench.h"
+#include "../codec.h"
+#include "coopsim.h"
+#include "mock_panel.h"
+#include "panel_check.h"
+#include "pip_check.h"
+#include "playsim.h"
+#include "predict.h"
+#include "replay.h"
+#include "scroll_check.h"
+#include "thumb_check.h"
+
+// ---- Whole container in memory ----
+struct Video {
+  FileHeader hdr;
+  std::vector<uint8_t> data;       // file contents
+  const uint32_t *index = nullptr;
+  size_t dataStart = 0;
+};
+
+static bool loadVideo(const char *path, Video *v) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  v->data.resize(size > 0 ? size : 0);
+  bool ok = size > 0 && fread(v->data.data(), 1, size, f) == (size_t)size;
+  fclose(f);
+  if (!ok || v->data.size() < sizeof(FileHeader)) return false;
+  memcpy(&v->hdr, v->data.data(), sizeof(FileHeader));
+  v->dataStart = sizeof(FileHeader) + (size_t)v->hdr.total_frames * 4;
+  if (!v->hdr.total_frames || v->dataStart > v->data.size()) return false;
+  v->index = (const uint32_t *)(v->data.data() + sizeof(FileHeader));
+  return true;
+}
+
+static bool readFrame(void *ctx, uint32_t idx, uint8_t *buf, size_t cap, size_t *len) {
+  const Video *v = (const Video *)ctx;
+  if (idx >= v->hdr.total_frames) return false;
+  size_t dataLen = v->data.size() - v->dataStart;
+  size_t start = index_offset(v->index[idx]);
+  size_t end = idx + 1 < v->hdr.total_frames ? index_offset(v->index[idx + 1]) : dataLen;
+  if (start > end || end > dataLen || end - start > cap) return false;
+  memcpy(buf, v->data.data() + v->dataStart + start, end - start);
+  *len = end - start;
+  return true;
+}
+
+// `model ...` lines as printed by the device bench; other lines are ignored
+static bool loadModel(const char *path, CostModel *m) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  char line[256];
+  int n = 0;
+  while (fgets(line, sizeof(line), f)) {
+    const char *p = strstr(line, "model ");     // tolerate monitor prefixes
+    if (p && cost_model_parse_line(m, p)) n++;
+  }
+  fclose(f);
+  return n > 0;
+}
+
+static bool loadFile(const char *path, std::vector<uint8_t> *out) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out->insert(out->end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+// -1 for none or an unknown name
+static int pathByName(const char *name) {
+  for (int id = 0; name && id < PATH_COUNT; id++) {
+    if (!strcmp(render_path((RenderPathId)id)->name(), name)) return id;
+  }
+  return -1;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: bad_apple_host bench <video.bin> [--first K] [--frames N]\n"
+          "                              [--angle DEG] [--zoom Z] [--dump out.ppm]\n"
+          "       bad_apple_host predict <video.bin> [--model FILE] [--path NAME]\n"
+          "                              [--first K] [--frames N] [--angle DEG]\n"
+          "       bad_apple_host kernels <video.bin> [--first K] [--frames N]\n"
+          "       bad_apple_host tune <video.bin> [--first K] [--frames N] [--angle DEG]\n"
+          "       bad_apple_host panel <video.bin> [--first K] [--frames N] [--angle DEG]\n"
+          "       bad_apple_host scroll <video.bin> [--first K] [--frames N] [--angle DEG]\n"
+          "       bad_apple_host coop <video.bin> [--load MS]... [--trace N] [--model FILE]\n"
+          "                              [--first K] [--frames N] [--angle DEG]\n"
+          "       bad_apple_host play <video.bin> [--load MS]... [--model FILE] [--path NAME]\n"
+          "                              [--first K] [--frames N] [--angle DEG]\n"
+          "       bad_apple_host replay <video.bin> --input TRACE [--path NAME]\n"
+          "                              [--frames N] [--angle DEG] [--dump out.ppm]\n"
+          "       bad_apple_host thumbs <video.bin> [--path NAME] [--frames N] [--angle DEG]\n"
+          "       bad_apple_host pip <video.bin> [--inset FILE] [--at SEC] [--path NAME]\n"
+          "                              [--frames N] [--angle DEG] [--dump out.ppm]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) { usage(); return 2; }
+  bool predict = !strcmp(argv[1], "predict");
+  bool kernels = !strcmp(argv[1], "kernels");
+  bool play = !strcmp(argv[1], "play");
+  bool panelCheck = !strcmp(argv[1], "panel");
+  bool tune = !strcmp(argv[1], "tune");
+  bool coop = !strcmp(argv[1], "coop");
+  bool scroll = !strcmp(argv[1], "scroll");
+  bool replay = !strcmp(argv[1], "replay");
+  bool thumbs = !strcmp(argv[1], "thumbs");
+  bool pip = !strcmp(argv[1], "pip");
+  if (!predict && !kernels && !play && !panelCheck && !tune && !coop && !scroll && !replay &&
+      !thumbs && !pip &&
+      strcmp(argv[1], "bench") != 0) {
+    usage();
+    return 2;
+  }
+
+  Video v;
+  if (!loadVideo(argv[2], &v)) {
+    fprintf(stderr, "cannot read %s\n", argv[2]);
+    return 1;
+  }
+
+  BenchConfig cfg;
+  if (v.hdr.flags & FLAG_NATIVE) cfg.angle = 0.0f;
+  if (predict || kernels || play || panelCheck || coop || scroll || replay || pip) {
+    cfg.count = v.hdr.total_frames;
+  }
+  if (tune) cfg.count = TuneConfig().count;
+  std::vector<float> loads;
+  const char *dump = nullptr;
+  const char *modelFile = nullptr;
+  const char *pathName = nullptr;
+  const char *inputFile = nullptr;
+  const char *insetFile = nullptr;
+  float insetAt = -1.0f;
+  uint32_t traceFrames = 0;
+  for (int i = 3; i < argc; i++) {
+    bool hasArg = i + 1 < argc;
+    if (!strcmp(argv[i], "--first") && hasArg) cfg.first = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--frames") && hasArg) cfg.count = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--angle") && hasArg) cfg.angle = strtof(argv[++i], nullptr);
+    else if (!strcmp(argv[i], "--zoom") && hasArg) cfg.zoom = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--dump") && hasArg) dump = argv[++i];
+    else if (!strcmp(argv[i], "--model") && hasArg) modelFile = argv[++i];
+    else if (!strcmp(argv[i], "--path") && hasArg) pathName = argv[++i];
+    else if (!strcmp(argv[i], "--input") && hasArg) inputFile = argv[++i];
+    else if (!strcmp(argv[i], "--inset") && hasArg) insetFile = argv[++i];
+    else if (!strcmp(argv[i], "--at") && hasArg) insetAt = strtof(argv[++i], nullptr);
+    else if (!strcmp(argv[i], "--trace") && hasArg) traceFrames = strtoul(argv[++i], nullptr, 0);
+    else if (!strcmp(argv[i], "--load") && hasArg) loads.push_back(strtof(argv[++i], nullptr));
+    else { usage(); return 2; }
+  }
+  int onlyPath = pathByName(pathName);      // --path, for the commands that take one
+  if (pathName && onlyPath < 0) {
+    fprintf(stderr, "unknown path %s\n", pathName);
+    return 2;
+  }
+  if (onlyPath >= 0 && render_path((RenderPathId)onlyPath)->insetOnly()) {
+    fprintf(stderr, "%s is for picture-in-picture insets only\n", pathName);
+    return 2;
+  }
+
+  // Portrait native files run on a portrait panel, like on the device
+  bool portrait = (v.hdr.flags & FLAG_NATIVE) && v.hdr.width == DISP_H && v.hdr.height == DISP_W;
+  MockPanel panel(portrait ? DISP_H : DISP_W, portrait ? DISP_W : DISP_H);
+
+  if (kernels) {
+    if (!run_kernel_check(v.hdr, readFrame, &v, cfg)) return 1;
+  } else if (tune) {
+    TuneConfig tc;
+    tc.first = cfg.first;
+    tc.count = cfg.count;
+    tc.angle = cfg.angle;
+    TuneResult r;
+    if (!autotune(panel, v.hdr, readFrame, &v, tc, &r)) return 1;
+  } else if (panelCheck) {
+    if (!run_panel_check(panel, v.hdr, readFrame, &v, cfg)) return 1;
+  } else if (scroll) {
+    if (!run_scroll_check(panel, v.hdr, readFrame, &v, cfg)) return 1;
+  } else if (thumbs) {
+    size_t trackLen = index_offset(v.index[0]);
+    if (!run_thumb_check(panel, v.hdr, readFrame, &v, v.data.data() + v.dataStart, trackLen,
+                         cfg, onlyPath)) {
+      return 1;
+    }
+  } else if (pip) {
+    // a second copy even of the same file: the streams share nothing
+    Video inset;
+    if (!loadVideo(insetFile ? insetFile : argv[2], &inset)) {
+      fprintf(stderr, "cannot read %s\n", insetFile ? insetFile : argv[2]);
+      return 1;
+    }
+    // by default the same clip half-way through, another from its start
+    uint32_t first = insetAt >= 0 ? (uint32_t)(insetAt * inset.hdr.fps)
+                     : insetFile ? 0 : inset.hdr.total_frames / 2;
+    if (!run_pip_check(panel, v.hdr, readFrame, &v, inset.hdr, readFrame, &inset, first, cfg,
+                       onlyPath)) {
+      return 1;
+    }
+  } else if (replay) {
+    std::vector<uint8_t> trace;
+    if (!inputFile || !loadFile(inputFile, &trace)) {
+      fprintf(stderr, "replay needs --input TRACE\n");
+      return 2;
+    }
+    if (!run_replay(panel, v.hdr, readFrame, &v, trace.data(), trace.size(), cfg, onlyPath)) {
+      return 1;
+    }
+  } else if (predict || play || coop) {
+    CostModel model;
+    cost_model_defaults(&model);
+    if (modelFile && !loadModel(modelFile, &model)) {
+      fprintf(stderr, "no model lines in %s\n", modelFile);
+      return 1;
+    }
+    if (!modelFile) printf("(uncalibrated default model)\n");
+    if (coop) {
+      if (loads.empty()) {     // up to nearly the whole frame period
+        float period = 1000.0f / (v.hdr.fps ? v.hdr.fps : 15);
+        static const float FRACTIONS[] = { 0.0f, 0.8f, 0.85f, 0.9f, 0.95f };
+        for (float f : FRACTIONS) loads.push_back(period * f);
+      }
+      if (!run_coop_sim(panel, v.hdr, readFrame, &v, v.index, model, cfg, loads.data(),
+                        (int)loads.size(), traceFrames)) return 1;
+    } else if (play) {
+      // default sweep: no load up to one and a half frame periods
+      float period = 1000.0f / (v.hdr.fps ? v.hdr.fps : 15);
+      bool sweep = loads.empty();
+      for (int k = 0; sweep && k <= 6; k++) loads.push_back(period * k / 4);
+      if (!run_play_sim(panel, v.hdr, readFrame, &v, v.index, model, cfg, onlyPath,
+                        loads.data(), (int)loads.size(), sweep)) return 1;
+    } else if (!run_predict(panel, v.hdr, readFrame, &v, model, cfg, onlyPath)) {
+      return 1;
+    }
+  } else if (!run_bench(panel, v.hdr, readFrame, &v, cfg)) {
+    return 1;
+  }
+
+  if (dump && !panel.dumpPpm(dump)) {
+    fprintf(stderr, "cannot write %s\n", dump);
+    return 1;
+  }
+  return 0;
+}
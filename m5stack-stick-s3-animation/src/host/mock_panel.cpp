@@ -0,0 +1,128 @@
+#include "mock_panel.h"
+#include <math.h>
+#include <algorithm>
+#include <stdio.h>
+#include "../codec.h"
+
+MockPanel::MockPanel(uint16_t w, uint16_t h) : w_(w), h_(h), fb_((size_t)w * h, 0) {}
+
+void MockPanel::pushBlock(int x, int y, int w, int h, const uint16_t *px) {
+  if (muted) return;
+  PanelRect parts[4];
+  int n = visibleParts(x, y, w, h, parts);
+  for (int i = 0; i < n; i++) {
+    const PanelRect &p = parts[i];
+    for (int dy = p.y; dy < p.y + p.h; dy++) {
+      if (dy < 0 || dy >= h_) continue;
+      for (int dx = p.x; dx < p.x + p.w; dx++) {
+        if (dx >= 0 && dx < w_) fb_[dy * w_ + dx] = px[(dy - y) * w + dx - x];
+      }
+    }
+    count(p.w, p.h);
+  }
+}
+
+void MockPanel::fillScreen(uint16_t color) {
+  std::fill(fb_.begin(), fb_.end(), color);
+  count(w_, h_);
+}
+
+template <typename Sample>
+void MockPanel::rotateInto(int w, int h, float angle, Sample sample) {
+  canvas_.assign((size_t)w_ * h_, 0x0000);
+  QuarterMap m;
+  if (quarter_map(angle, w, h, w_, h_, &m)) {
+    for (int sy = 0; sy < h; sy++) {
+      for (int sx = 0; sx < w; sx++) {
+        int dx = m.ax * sx + m.bx * sy + m.cx;
+        int dy = m.ay * sx + m.by * sy + m.cy;
+        if (dx >= 0 && dx < w_ && dy >= 0 && dy < h_) canvas_[dy * w_ + dx] = sample(sx, sy);
+      }
+    }
+    return;
+  }
+  // Arbitrary angle: sample the source at each canvas pixel center
+  float rad = angle * (float)M_PI / 180.0f;
+  float c = cosf(rad), s = sinf(rad);
+  for (int dy = 0; dy < h_; dy++) {
+    for (int dx = 0; dx < w_; dx++) {
+      float px = dx + 0.5f - w_ / 2.0f;
+      float py = dy + 0.5f - h_ / 2.0f;
+      int sx = (int)floorf(c * px + s * py + w / 2.0f);
+      int sy = (int)floorf(-s * px + c * py + h / 2.0f);
+      if (sx >= 0 && sx < w && sy >= 0 && sy < h) canvas_[dy * w_ + dx] = sample(sx, sy);
+    }
+  }
+}
+
+bool MockPanel::composeRotateZoom16(const uint16_t *frame, int w, int h, float angle) {
+  rotateInto(w, h, angle, [&](int sx, int sy) { return frame[sy * w + sx]; });
+  spriteBytes_ = (size_t)w_ * h_ * 2 + (size_t)w * h * 2;
+  return true;
+}
+
+bool MockPanel::composeRotateZoom1bpp(const uint8_t *bits, size_t stride, int w, int h,
+                                      float angle, uint16_t fg, uint16_t bg) {
+  rotateInto(w, h, angle, [&](int sx, int sy) {
+    return (bits[sy * stride + (sx >> 3)] & (0x80 >> (sx & 7))) ? fg : bg;
+  });
+  spriteBytes_ = (size_t)w_ * h_ * 2 + stride * h;
+  return true;
+}
+
+void MockPanel::pushCanvas() {
+  if (muted || canvas_.empty()) return;
+  if (!hole.w) {
+    fb_ = canvas_;
+    count(w_, h_);
+    return;
+  }
+  pushBlock(0, 0, w_, h_, canvas_.data());     // around the hole
+}
+
+void MockPanel::releaseSprites() {
+  canvas_.clear();
+  spriteBytes_ = 0;
+}
+
+size_t MockPanel::spriteBytes() const { return spriteBytes_; }
+
+void MockPanel::setScroll(uint16_t offset) {
+  scroll_ = offset % (w_ > h_ ? w_ : h_);
+  spiBytes += SCROLL_OVERHEAD;
+}
+
+std::vector<uint16_t> MockPanel::screen() const {
+  if (!scroll_) return fb_;
+  std::vector<uint16_t> out(fb_.size());
+  for (int y = 0; y < h_; y++) {
+    for (int x = 0; x < w_; x++) {
+      int rx = w_ > h_ ? (x + scroll_) % w_ : x;
+      int ry = w_ > h_ ? y : (y + scroll_) % h_;
+      out[y * w_ + x] = fb_[ry * w_ + rx];
+    }
+  }
+  return out;
+}
+
+uint32_t MockPanel::checksum() const {
+  uint32_t h = 2166136261u;      // FNV-1a
+  for (uint16_t px : screen()) {
+    h = (h ^ (px & 0xFF)) * 16777619u;
+    h = (h ^ (px >> 8)) * 16777619u;
+  }
+  return h;
+}
+
+bool MockPanel::dumpPpm(const char *path) const {
+  FILE *f = fopen(path, "wb");
+  if (!f) return false;
+  fprintf(f, "P6\n%u %u\n255\n", w_, h_);
+  for (uint16_t stored : screen()) {
+    uint16_t px = panel_to_rgb565(stored);
+    uint8_t rgb[3] = { (uint8_t)((px >> 8) & 0xF8), (uint8_t)((px >> 3) & 0xFC),
+                       (uint8_t)((px << 3) & 0xF8) };
+    fwrite(rgb, 1, 3, f);
+  }
+  return fclose(f) == 0;
+}
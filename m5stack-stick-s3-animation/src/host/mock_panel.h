@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include "../panel.h"
+
+// ---- In-memory panel for the host build ----
+// Keeps a framebuffer so paths can be compared by checksum and dumped.
+// The framebuffer is panel RAM; the scroll offset is applied on the way
+// out (checksum, screen, dumpPpm), like the ST7789 scans it out. The
+// sprite canvas rotates by exact quarter turns like M5GFX does for
+// 90° steps; other angles use nearest-neighbour sampling.
+class MockPanel : public Panel {
+ public:
+  MockPanel(uint16_t w, uint16_t h);
+
+  uint16_t width() const override { return w_; }
+  uint16_t height() const override { return h_; }
+
+  void pushBlock(int x, int y, int w, int h, const uint16_t *px) override;
+  void fillScreen(uint16_t color) override;
+
+  bool composeRotateZoom16(const uint16_t *frame, int w, int h, float angle) override;
+  bool composeRotateZoom1bpp(const uint8_t *bits, size_t stride, int w, int h,
+                             float angle, uint16_t fg, uint16_t bg) override;
+  void pushCanvas() override;
+  void releaseSprites() override;
+  size_t spriteBytes() const override;
+
+  // Scrolls along the native rows like the device: x in landscape
+  ScrollAxis scrollAxis() const override {
+    return !scrollable || hole.w ? SCROLL_NONE : w_ > h_ ? SCROLL_X : SCROLL_Y;
+  }
+  void setScroll(uint16_t offset) override;
+  bool scrollable = true;       // false to compare against plain pushes
+
+  uint32_t checksum() const override;
+
+  // Panel RAM as it arrived over SPI: 2 bytes per pixel, row-major
+  const uint8_t *ram() const { return (const uint8_t *)fb_.data(); }
+
+  // What is on screen: RAM through the scroll offset, same layout
+  std::vector<uint16_t> screen() const;
+
+  // Binary PPM of the screen
+  bool dumpPpm(const char *path) const;
+
+ private:
+  template <typename Sample>
+  void rotateInto(int w, int h, float angle, Sample sample);
+
+  uint16_t w_, h_;
+  std::vector<uint16_t> fb_;
+  std::vector<uint16_t> canvas_;
+  size_t spriteBytes_ = 0;
+  uint16_t scroll_ = 0;
+};
@@ -0,0 +1,138 @@
+#include "panel_check.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../indexed.h"
+#include "../platform.h"
+#include "../render.h"
+
+static const uint16_t CHECK_FG = 0x07E0;    // green, RGB565
+static const uint16_t CHECK_BG = 0x001F;    // blue
+
+// Indexed frame onto `rgb` (RGB565) a pixel at a time, through `palette` as
+// stored in the file: the reference for the LUT + fill565 decoder
+static void decodeIndexedReference(const uint8_t *frame, size_t len, uint16_t *rgb,
+                                   size_t pixels, uint16_t *palette) {
+  if (!len) return;
+  size_t at = frame_slots_end(frame, len);
+  if ((frame[0] & FRAME_PALETTE) && at < len && frame[at] && frame[at] <= MAX_PALETTE &&
+      at + 1 + 2 * (size_t)frame[at] <= len) {
+    for (int i = 0; i < MAX_PALETTE; i++) {
+      palette[i] = i < frame[at] ? frame[at + 1 + 2 * i] | (frame[at + 2 + 2 * i] << 8) : 0;
+    }
+  }
+  size_t pixel = 0;
+  for (size_t pos = frame_header_size(frame, len); pos + 1 < len && pixel < pixels; pos += 2) {
+    uint16_t word = frame[pos] | (frame[pos + 1] << 8);
+    if (!word) {
+      if (pos + 3 >= len) break;
+      pixel += frame[pos + 2] | (frame[pos + 3] << 8);
+      pos += 2;
+      continue;
+    }
+    for (size_t n = word & INDEX_RUN_LENGTH; n && pixel < pixels; n--) {
+      rgb[pixel++] = palette[word >> INDEX_SHIFT];
+    }
+  }
+  while (!(frame[0] & FRAME_DELTA) && pixel < pixels) rgb[pixel++] = palette[0];
+}
+
+// Bytes of the whole screen showing `rgb` (RGB565, one per pixel) through
+// quarter map `m`
+static void expectedRam(const uint16_t *rgb, const FileHeader &v, const QuarterMap &m,
+                        uint16_t w, uint16_t h, uint8_t *out) {
+  memset(out, 0, (size_t)w * h * 2);
+  for (int sy = 0; sy < v.height; sy++) {
+    for (int sx = 0; sx < v.width; sx++) {
+      int dx = m.ax * sx + m.bx * sy + m.cx;
+      int dy = m.ay * sx + m.by * sy + m.cy;
+      if (dx < 0 || dx >= w || dy < 0 || dy >= h) continue;
+      uint16_t c = rgb[sy * v.width + sx];
+      uint8_t *px = out + ((size_t)dy * w + dx) * 2;
+      px[0] = c >> 8;
+      px[1] = c & 0xFF;
+    }
+  }
+}
+
+bool run_panel_check(MockPanel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                     const BenchConfig &cfg) {
+  if (v.flags & FLAG_VECTOR) {
+    log_printf("panel: vector file, nothing to check\n");
+    return true;
+  }
+  QuarterMap m;
+  if (!quarter_map(cfg.angle, v.width, v.height, panel.width(), panel.height(), &m)) {
+    log_printf("panel: needs a quarter-turn angle\n");
+    return false;
+  }
+
+  bool indexed = v.flags & FLAG_INDEXED;
+  size_t stride = bitmap_stride(v.width);
+  size_t pixels = (size_t)v.width * v.height;
+  std::vector<uint8_t> rle(MAX_RLE_SIZE);
+  Segment seg;
+  if (!find_segment(v, read, ctx, cfg, rle.data(), rle.size(), &seg)) return false;
+  uint32_t key = seg.key, count = seg.count;
+  uint8_t *bits = (uint8_t *)malloc(bitmap_bytes(v.width, v.height));
+  std::vector<uint16_t> rgb(pixels);
+  uint16_t palette[MAX_PALETTE];
+  std::vector<uint8_t> want((size_t)panel.width() * panel.height() * 2);
+  if (!bits) return false;
+
+  RefStore refs, pathRefs;
+  RenderParams params = { rgb565_to_panel(CHECK_FG), rgb565_to_panel(CHECK_BG), cfg.angle,
+                          (v.flags & FLAG_REFS) ? &pathRefs : nullptr, 1, 0.5f, 0.5f };
+  log_printf("panel: frames %u..%u, %s, angle %.0f\n", (unsigned)cfg.first,
+             (unsigned)(cfg.first + count - 1),
+             indexed ? "indexed colour" : "0x07E0 on 0x001F", cfg.angle);
+  bool allOk = true;
+  for (int id = 0; id < PATH_COUNT; id++) {
+    RenderPath *path = render_path((RenderPathId)id);
+    if (path->insetOnly() || !path->supports(panel, v, cfg.angle) || !path->begin(panel, v)) {
+      continue;
+    }
+    panel.fillScreen(0x0000);
+    memset(palette, 0, sizeof(palette));
+    reset_refs(refs, v, read, ctx, key, rle.data(), rle.size());
+    reset_refs(pathRefs, v, read, ctx, key, rle.data(), rle.size());
+    uint32_t bad = 0, firstBad = 0;
+    for (uint32_t i = key; i < cfg.first + count; i++) {
+      size_t len;
+      if (!read(ctx, i, rle.data(), rle.size(), &len)) { bad++; break; }
+      if (indexed) {
+        decodeIndexedReference(rle.data(), len, rgb.data(), pixels, palette);
+      } else {
+        refs.store(rle.data(), len);
+        if (const uint8_t *ref = refs.reference(rle.data(), len)) {
+          memcpy(bits, ref, stride * v.height);
+        }
+        decode_bit_rle_to_1bpp(rle.data(), len, bits, v.width, v.height, stride);
+      }
+      path->render(rle.data(), len, params, nullptr);
+      if (i < cfg.first) continue;
+      if (!indexed) {
+        for (size_t p = 0; p < pixels; p++) {
+          size_t x = p % v.width;
+          bool on = bits[p / v.width * stride + (x >> 3)] & (0x80 >> (x & 7));
+          rgb[p] = on ? CHECK_FG : CHECK_BG;
+        }
+      }
+      expectedRam(rgb.data(), v, m, panel.width(), panel.height(), want.data());
+      if (memcmp(panel.screen().data(), want.data(), want.size())) {
+        if (!bad) firstBad = i;
+        bad++;
+      }
+    }
+    path->end();
+    if (bad) {
+      log_printf("%-13s %u frames differ (first %u)\n", path->name(), (unsigned)bad,
+                 (unsigned)firstBad);
+      allOk = false;
+    } else {
+      log_printf("%-13s OK\n", path->name());
+    }
+  }
+  free(bits);
+  return allOk;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "../bench.h"
+#include "mock_panel.h"
+
+// ---- Byte-exact panel output ----
+// Plays frames [first, first+count) through every path with asymmetric
+// colours (green on blue, in panel order) and after each frame compares the
+// bytes the mock panel shows (its RAM through the scroll offset) with the
+// picture built independently from the 1-bpp reference decode (indexed
+// files: a per-pixel palette lookup): each pixel must be the colour's RGB565
+// high byte first, and black outside the video. Catches any path that
+// converts or swaps pixels on the way to the panel. Not for vector files.
+bool run_panel_check(MockPanel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                     const BenchConfig &cfg);
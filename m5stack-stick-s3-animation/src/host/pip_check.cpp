@@ -0,0 +1,172 @@
+#include "pip_check.h"
+#include <thread>
+#include <vector>
+#include "../pip.h"
+#include "../platform.h"
+
+static const uint16_t FG = 0xFFFF, BG = 0x0000;
+
+// The main video through a path instance of its own, frames in order
+class MainStream {
+ public:
+  ~MainStream() {
+    if (begun_) path_->end();
+    delete path_;
+  }
+
+  bool begin(Panel &panel, const FileHeader &v, FrameReader read, void *ctx, RenderPathId id,
+             float angle) {
+    panel_ = &panel;
+    angle_ = angle;
+    path_ = new_render_path(id);
+    stream.attach(read, ctx);
+    begun_ = path_->supports(panel, v, angle) && stream.begin(v) && path_->begin(panel, v);
+    return begun_;
+  }
+
+  bool show(uint32_t idx) {
+    size_t len;
+    if (!stream.read(idx, &len)) return false;
+    RenderParams p = { FG, BG, angle_, nullptr, 1, 0.5f, 0.5f };
+    stream.render(path_, *panel_, len, p);
+    return true;
+  }
+
+  const char *name() const { return path_->name(); }
+  DecodeStream stream;
+
+ private:
+  Panel *panel_ = nullptr;
+  RenderPath *path_ = nullptr;
+  float angle_ = 0.0f;
+  bool begun_ = false;
+};
+
+// Screens equal inside (or outside) the rectangle
+static bool sameIn(const MockPanel &a, const MockPanel &b, const PanelRect &r, bool inside) {
+  std::vector<uint16_t> sa = a.screen(), sb = b.screen();
+  for (int y = 0; y < a.height(); y++) {
+    for (int x = 0; x < a.width(); x++) {
+      bool in = x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h;
+      if (in == inside && sa[y * a.width() + x] != sb[y * a.width() + x]) return false;
+    }
+  }
+  return true;
+}
+
+// One stream alone on its own panel: µs taken, final screen checksum
+struct SoloRun {
+  uint32_t us = 0;
+  uint32_t checksum = 0;
+  bool ok = false;
+};
+
+static void soloMain(const FileHeader *v, FrameReader read, void *ctx, RenderPathId id,
+                     float angle, uint32_t count, SoloRun *out) {
+  MockPanel panel(DISP_W, DISP_H);
+  MainStream m;
+  uint32_t t0 = now_us();
+  out->ok = m.begin(panel, *v, read, ctx, id, angle);
+  for (uint32_t i = 0; out->ok && i < count; i++) out->ok = m.show(i);
+  out->us = now_us() - t0;
+  out->checksum = panel.checksum();
+}
+
+static void soloInset(const FileHeader *iv, FrameReader read, void *ctx, uint32_t first,
+                      float angle, uint32_t count, uint16_t mainFps, SoloRun *out) {
+  MockPanel panel(DISP_W, DISP_H);
+  Inset inset;
+  uint32_t t0 = now_us();
+  out->ok = inset.begin(panel, pip_rect(DISP_W, DISP_H), *iv, read, ctx, first, angle);
+  for (uint32_t i = 0; out->ok && i < count; i++) out->ok = inset.show(i, mainFps, FG, BG);
+  out->us = now_us() - t0;
+  out->checksum = panel.checksum();
+}
+
+static double meanMs(const StreamStats &s) {
+  return s.rendered ? s.sumUs / 1000.0 / s.rendered : 0.0;
+}
+
+bool run_pip_check(MockPanel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                   const FileHeader &iv, FrameReader iread, void *ictx, uint32_t insetFirst,
+                   const BenchConfig &cfg, int pathId) {
+  if (panel.width() != DISP_W || panel.height() != DISP_H) {
+    log_printf("pip: landscape panel only (the inset is turned with the main video)\n");
+    return false;
+  }
+  if (pathId < 0) {
+    bool native = (v.flags & FLAG_NATIVE) && cfg.angle == 0.0f;
+    pathId = (v.flags & FLAG_VECTOR) ? PATH_VECTOR : native ? PATH_NATIVE : PATH_ROTATE_ZOOM;
+  }
+  // a native inset is upright as it is, others turn like the main video
+  float insetAngle = (iv.flags & FLAG_NATIVE) ? 0.0f : cfg.angle ? cfg.angle : 90.0f;
+  uint32_t count = cfg.count < v.total_frames ? cfg.count : v.total_frames;
+  PanelRect rect = pip_rect(panel.width(), panel.height());
+
+  // ---- One thread, in turn, as the player runs them ----
+  MockPanel mainAlone(panel.width(), panel.height()), insetAlone(panel.width(), panel.height());
+  mainAlone.hole = rect;
+  Inset inset, insetRef;
+  MainStream mainView, mainRef;
+  if (!inset.begin(panel, rect, iv, iread, ictx, insetFirst, insetAngle) ||
+      !insetRef.begin(insetAlone, rect, iv, iread, ictx, insetFirst, insetAngle)) {
+    log_printf("pip: no path shows the inset at angle %.0f\n", insetAngle);
+    return false;
+  }
+  if (!mainView.begin(panel, v, read, ctx, (RenderPathId)pathId, cfg.angle) ||
+      !mainRef.begin(mainAlone, v, read, ctx, (RenderPathId)pathId, cfg.angle)) {
+    log_printf("pip: path %s can't show the main video\n", mainView.name());
+    return false;
+  }
+  log_printf("pip: main %ux%u through %s, inset %ux%u at %d,%d through %s from frame %u; "
+             "%u frames\n", v.width, v.height, mainView.name(), iv.width, iv.height, rect.x, rect.y,
+             inset.pathName(), (unsigned)insetFirst, (unsigned)count);
+
+  uint32_t wallUs = 0, bad = 0, firstBad = 0;
+  bool ok = true;
+  for (uint32_t i = 0; i < count && ok; i++) {
+    uint32_t t0 = now_us();
+    ok = mainView.show(i) && inset.show(i, v.fps, FG, BG);
+    wallUs += now_us() - t0;
+    ok = ok && mainRef.show(i) && insetRef.show(i, v.fps, FG, BG);
+    if (ok && !(sameIn(panel, mainAlone, rect, false) && sameIn(panel, insetAlone, rect, true)) &&
+        !bad++) {
+      firstBad = i;
+    }
+  }
+  if (!ok) {
+    log_printf("pip: read error\n");
+    return false;
+  }
+  const StreamStats &ms = mainView.stream.stats, &is = inset.stream.stats;
+  log_printf("  one thread: main %.3f ms/frame mean, %.3f max; inset %.3f mean, %.3f max, "
+             "%.2f decoded per shown; %.0f fps combined (host)\n",
+             meanMs(ms), ms.maxUs / 1000.0, meanMs(is), is.maxUs / 1000.0,
+             is.shown ? (double)is.rendered / is.shown : 0.0,
+             wallUs ? (ms.shown + is.shown) * 1e6 / wallUs : 0.0);
+  if (bad) {
+    log_printf("  %u of %u screens differ from the streams played alone, first at frame %u\n",
+               (unsigned)bad, (unsigned)count, (unsigned)firstBad);
+    return false;
+  }
+  log_printf("  %u screens are the main video and the inset played alone\n", (unsigned)count);
+
+  // ---- Share-nothing: the same two passes on two threads ----
+  SoloRun seqMain, seqInset, parMain, parInset;
+  uint32_t t0 = now_us();
+  soloMain(&v, read, ctx, (RenderPathId)pathId, cfg.angle, count, &seqMain);
+  soloInset(&iv, iread, ictx, insetFirst, insetAngle, count, v.fps, &seqInset);
+  uint32_t seqUs = now_us() - t0;
+  t0 = now_us();
+  std::thread a(soloMain, &v, read, ctx, (RenderPathId)pathId, cfg.angle, count, &parMain);
+  std::thread b(soloInset, &iv, iread, ictx, insetFirst, insetAngle, count, v.fps, &parInset);
+  a.join();
+  b.join();
+  uint32_t parUs = now_us() - t0;
+  bool same = parMain.checksum == seqMain.checksum && parInset.checksum == seqInset.checksum;
+  log_printf("  two threads on %u cores: %.1f ms (main %.1f, inset %.1f) vs %.1f ms in turn, "
+             "%.2fx; screens %s\n", std::thread::hardware_concurrency(), parUs / 1000.0,
+             parMain.us / 1000.0, parInset.us / 1000.0, seqUs / 1000.0,
+             parUs ? (double)seqUs / parUs : 0.0, same ? "match" : "DIFFER");
+  return seqMain.ok && seqInset.ok && parMain.ok && parInset.ok && same;
+}
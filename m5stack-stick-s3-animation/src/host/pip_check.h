@@ -0,0 +1,16 @@
+#pragma once
+#include "../bench.h"
+#include "mock_panel.h"
+
+// ---- Picture-in-picture on the mock LCD ----
+// Plays `count` frames of the main video with an inset of `iv` (read
+// through `iread`/`ictx`, from frame `insetFirst`) in the corner, as the
+// player does: both streams in turn on one thread. Each screen must be the
+// main video played alone outside the inset and the inset played alone
+// inside it. Reports per-stream render times and the combined frame rate,
+// then plays the two share-nothing streams on two threads, each on a panel
+// of its own, against the same two passes one after the other.
+// `pathId` < 0 picks the main path the player would use.
+bool run_pip_check(MockPanel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                   const FileHeader &iv, FrameReader iread, void *ictx, uint32_t insetFirst,
+                   const BenchConfig &cfg, int pathId);
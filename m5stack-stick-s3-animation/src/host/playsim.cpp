@@ -0,0 +1,129 @@
+#include "playsim.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "../pacing.h"
+#include "../platform.h"
+#include "../render.h"
+
+bool run_play_sim(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                  const uint32_t *index, const CostModel &model, const BenchConfig &cfg,
+                  int pathId, const float *loadMs, int loads, bool edgeLoads) {
+  std::vector<uint8_t> rle(MAX_RLE_SIZE);
+  Segment seg;
+  if (!find_segment(v, read, ctx, cfg, rle.data(), rle.size(), &seg)) return false;
+  uint32_t key = seg.key, count = seg.count;
+
+  if (pathId < 0) {
+    bool native = (v.flags & FLAG_NATIVE) && cfg.angle == 0.0f;
+    pathId = (v.flags & FLAG_VECTOR) ? PATH_VECTOR : native ? PATH_NATIVE : PATH_ROTATE_ZOOM;
+  }
+  RenderPath *path = render_path((RenderPathId)pathId);
+  if (!model.path[pathId].valid || !path->supports(panel, v, cfg.angle)) {
+    log_printf("play: path %s can't show this video\n", path->name());
+    return false;
+  }
+
+  RefStore refs;
+  RenderParams params = { cfg.fg, cfg.bg, cfg.angle, (v.flags & FLAG_REFS) ? &refs : nullptr,
+                          cfg.zoom, 0.5f, 0.5f };
+  uint32_t droppable = 0;
+  for (uint32_t i = 0; i < count; i++) droppable += index_droppable(index[cfg.first + i]);
+
+  // ---- Reference run: every frame, unpaced ----
+  if (!path->begin(panel, v)) return false;
+  panel.fillScreen(0x0000);
+  preroll(path, v, read, ctx, params, key, cfg.first, rle.data(), rle.size());
+  std::vector<uint32_t> sums(count), costUs(count);
+  for (uint32_t i = 0; i < count; i++) {
+    size_t len = 0;
+    if (!read(ctx, cfg.first + i, rle.data(), rle.size(), &len)) {
+      log_printf("play: read error at frame %u\n", (unsigned)(cfg.first + i));
+      path->end();
+      return false;
+    }
+    uint64_t spiBefore = panel.spiBytes;
+    path->render(rle.data(), len, params, nullptr);
+    FrameWork w;
+    w.readBytes = len;
+    w.runs = rle_run_count(rle.data(), len);
+    w.fillPixels = (uint32_t)v.width * v.height;
+    w.composePixels = path->composePixels();
+    w.spiBytes = (uint32_t)(panel.spiBytes - spiBefore);
+    costUs[i] = (uint32_t)cost_model_predict(model, (RenderPathId)pathId, w);
+    sums[i] = panel.checksum();
+  }
+  path->end();
+
+  uint32_t periodUs = 1000000 / (v.fps ? v.fps : 15);
+  bool hinted = v.flags & FLAG_COST_HINTS;
+  log_printf("play: %s path, frames %u..%u @ %u fps (%u droppable), budget %.1f ms%s\n",
+             path->name(), (unsigned)cfg.first, (unsigned)(cfg.first + count - 1), v.fps,
+             (unsigned)droppable, periodUs / 1000.0f, hinted ? ", cost hints" : "");
+
+  // Hints only matter near the edge: loads that leave the budget at the
+  // median and the 90th percentile frame time
+  std::vector<float> sweep(loadMs, loadMs + loads);
+  if (hinted && edgeLoads) {
+    std::vector<uint32_t> sorted(costUs);
+    std::sort(sorted.begin(), sorted.end());
+    for (int pct : { 50, 90 }) {
+      float ms = roundf((periodUs - (float)sorted[(count - 1) * pct / 100]) / 100.0f) / 10.0f;
+      if (ms > 0.0f && (sweep.empty() || ms != sweep.back())) sweep.push_back(ms);
+    }
+  }
+  log_printf("%8s %6s %7s %7s %7s %7s %7s %7s %8s %8s\n", "load ms", "sched", "shown",
+             "dropped", "late", "ahead", "resync", "fps", "time s", "corrupt");
+
+  // ---- Paced runs, one per load: on schedule, then looking ahead ----
+  std::vector<uint32_t> lateDue, lateAhead;
+  for (float load : sweep) {
+    uint32_t loadUs = (uint32_t)(load * 1000);
+    for (int ahead = 0; ahead <= (int)hinted; ahead++) {
+      if (!path->begin(panel, v)) return false;
+      panel.fillScreen(0x0000);
+      preroll(path, v, read, ctx, params, key, cfg.first, rle.data(), rle.size());
+
+      FramePacer pacer;
+      CostHints hints;
+      hints.begin(index, v.total_frames, (float)COST_HINT_US);
+      uint32_t costs[CostHints::LOOKAHEAD];
+      uint32_t clock = 0;
+      uint32_t corrupt = 0;
+      pacer.start(clock, periodUs, v.flags & FLAG_LAYERS);
+      for (uint32_t i = 0; i < count; i++) {
+        if (pacer.drop(clock, index_droppable(index[cfg.first + i]))) continue;
+        uint32_t turn = clock;
+        size_t len = 0;
+        if (!read(ctx, cfg.first + i, rle.data(), rle.size(), &len)) break;
+        path->render(rle.data(), len, params, nullptr);
+        if (panel.checksum() != sums[i]) corrupt++;
+        clock += costUs[i] + loadUs;
+        if (!ahead) {
+          clock += pacer.next(clock);
+          continue;
+        }
+        hints.measured(cfg.first + i, clock - turn);
+        int n = hints.predict(cfg.first + i + 1, costs);
+        if (i + n >= count) n = (int)(count - 1 - i);
+        clock += pacer.nextAhead(clock, costs, n);
+      }
+      path->end();
+      bool kept = !pacer.dropped && !pacer.resyncs;
+      (ahead ? lateAhead : lateDue).push_back(kept ? pacer.late : 0);
+      float seconds = clock / 1e6f;
+      log_printf("%8.1f %6s %7u %7u %7u %7u %7u %7.1f %8.1f %8u\n", load,
+                 ahead ? "ahead" : "due", (unsigned)pacer.shown, (unsigned)pacer.dropped,
+                 (unsigned)pacer.late, (unsigned)pacer.ahead, (unsigned)pacer.resyncs,
+                 seconds > 0 ? pacer.shown / seconds : 0.0f, seconds, (unsigned)corrupt);
+    }
+  }
+  // Late frames at loads the player keeps up with without dropping
+  for (size_t l = 0; l < lateAhead.size(); l++) {
+    if (!lateDue[l]) continue;
+    log_printf("play: at %.1f ms load looking ahead avoided %d of %u late frames\n",
+               sweep[l], (int)lateDue[l] - (int)lateAhead[l], (unsigned)lateDue[l]);
+  }
+  log_printf("play: nominal %.1f s\n", count * periodUs / 1e6f);
+  return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "../bench.h"
+#include "../cost_model.h"
+
+// ---- Paced playback on a virtual clock ----
+// Plays frames [first, first+count) through one path with the player's
+// FramePacer (pacing.h). Each shown frame takes its cost-model time plus
+// `loadMs` of artificial CPU load, so load shedding (dropping INDEX_DROPPABLE
+// frames of FLAG_LAYERS files) can be watched without hardware. Every shown
+// frame is checked against what an unpaced run shows for it. Prints one row
+// per load; `pathId` < 0 picks the path the player would use.
+// FLAG_COST_HINTS files run each load a second time with FramePacer::nextAhead
+// on the encoder's hints; `edgeLoads` adds the loads where that matters.
+bool run_play_sim(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                  const uint32_t *index, const CostModel &model, const BenchConfig &cfg,
+                  int pathId, const float *loadMs, int loads, bool edgeLoads);
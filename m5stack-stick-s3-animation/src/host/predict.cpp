@@ -0,0 +1,75 @@
+#include "predict.h"
+#include <algorithm>
+#include <vector>
+#include "../platform.h"
+#include "../render.h"
+
+bool run_predict(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                 const CostModel &model, const BenchConfig &cfg, int onlyPath) {
+  std::vector<uint8_t> rle(MAX_RLE_SIZE);
+  Segment seg;
+  if (!find_segment(v, read, ctx, cfg, rle.data(), rle.size(), &seg)) return false;
+  uint32_t count = seg.count;
+  float budgetUs = 1e6f / (v.fps ? v.fps : 15);
+  RefStore refs;
+  RenderParams params = { cfg.fg, cfg.bg, cfg.angle, (v.flags & FLAG_REFS) ? &refs : nullptr,
+                          cfg.zoom, 0.5f, 0.5f };
+
+  log_printf("predict: %ux%u @ %u fps, frames %u..%u, angle %.0f, budget %.1f ms\n",
+             v.width, v.height, v.fps, (unsigned)cfg.first,
+             (unsigned)(cfg.first + count - 1), cfg.angle, budgetUs / 1000);
+  log_printf("%-13s %7s %8s %8s %8s %7s %7s %7s %7s %6s\n",
+             "path", "fps", "mean ms", "p95 ms", "max ms",
+             "read", "decode", "compose", "push", "late");
+
+  int ran = 0;
+  for (int id = 0; id < PATH_COUNT; id++) {
+    if (onlyPath >= 0 && id != onlyPath) continue;
+    RenderPath *path = render_path((RenderPathId)id);
+    if (!model.path[id].valid || path->insetOnly() || !path->supports(panel, v, cfg.angle)) {
+      continue;
+    }
+    if (!path->begin(panel, v)) continue;
+
+    preroll(path, v, read, ctx, params, seg.key, cfg.first, rle.data(), rle.size());
+
+    std::vector<float> frameUs;
+    frameUs.reserve(count);
+    StageTimes t;
+    double readUs = 0;
+    uint32_t late = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      size_t len = 0;
+      if (!read(ctx, cfg.first + i, rle.data(), rle.size(), &len)) break;
+      uint64_t spiBefore = panel.spiBytes;
+      path->render(rle.data(), len, params, nullptr);
+
+      FrameWork w;
+      w.readBytes = len;
+      w.runs = rle_run_count(rle.data(), len);
+      w.fillPixels = (uint32_t)v.width * v.height;
+      w.composePixels = path->composePixels();
+      w.spiBytes = (uint32_t)(panel.spiBytes - spiBefore);
+      float us = cost_model_predict(model, (RenderPathId)id, w, &t);
+      readUs += (model.readOp + model.readByte * len) / COST_CPU_MHZ;
+      frameUs.push_back(us);
+      if (us > budgetUs) late++;
+    }
+    path->end();
+    if (frameUs.empty()) continue;
+    ran++;
+
+    size_t n = frameUs.size();
+    double total = 0;
+    for (float us : frameUs) total += us;
+    std::vector<float> sorted(frameUs);
+    std::sort(sorted.begin(), sorted.end());
+    float p95 = sorted[std::min(n - 1, n * 95 / 100)];
+    float mean = total / n;
+    log_printf("%-13s %7.1f %8.2f %8.2f %8.2f %7u %7u %7u %7u %6u\n",
+               path->name(), 1e6f / mean, mean / 1000, p95 / 1000, sorted[n - 1] / 1000,
+               (unsigned)(readUs / n), (unsigned)(t.decodeUs / n),
+               (unsigned)(t.composeUs / n), (unsigned)(t.pushUs / n), (unsigned)late);
+  }
+  return ran > 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "../bench.h"
+#include "../cost_model.h"
+
+// ---- Device frame-time prediction on the host ----
+// Runs frames [first, first+count) through each path on `panel` (for exact
+// SPI byte counts) and prices every frame with `model`. Prints mean/p95/max
+// predicted frame time and how many frames would miss the video's frame
+// budget. `onlyPath` < 0 means every path.
+bool run_predict(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                 const CostModel &model, const BenchConfig &cfg, int onlyPath);
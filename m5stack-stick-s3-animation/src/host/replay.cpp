@@ -0,0 +1,168 @@
+#include "replay.h"
+#include <stdio.h>
+#include <vector>
+#include "../platform.h"
+#include "../render.h"
+
+static const uint8_t MAX_ZOOM = 8;     // as the player
+static const uint32_t NO_SEEK = 0xFFFFFFFFu;
+
+// What the player's globals hold, for one pass
+struct ReplayState {
+  uint16_t fg = 0xFFFF, bg = 0x0000;
+  bool invert = false, paused = false;
+  uint8_t zoom = 1;
+  float panX = 0.5f, panY = 0.5f;
+  uint32_t seek = NO_SEEK;
+};
+
+class Replayer {
+ public:
+  Replayer(Panel &panel, const FileHeader &v, float angle, int pathId)
+      : panel_(panel), v_(v), angle_(angle), pathId_(pathId) {}
+
+  RenderPath *pathFor(const ReplayState &s) const {
+    if (v_.flags & FLAG_VECTOR) return render_path(PATH_VECTOR);
+    if (s.zoom > 1) return render_path(PATH_ZOOM);
+    return render_path((RenderPathId)pathId_);
+  }
+
+  bool begin() {
+    path = pathFor(s);
+    return path->supports(panel_, v_, angle_) && path->begin(panel_, v_);
+  }
+
+  // Same effects as applyInput() on the device; false on OOM
+  bool apply(const InputEvent &e) {
+    if (e.type <= INPUT_SEEK) byType[e.type]++;
+    switch (e.type) {
+      case INPUT_INVERT: s.invert = !s.invert; break;
+      case INPUT_PAUSE:  s.paused = !s.paused; break;
+      case INPUT_COLORS: s.fg = (uint16_t)e.x; s.bg = (uint16_t)e.y; break;
+      case INPUT_TILT:   input_pan(e, s.zoom, &s.panX, &s.panY); break;
+      case INPUT_ZOOM: {
+        // setZoom(): delta files recover at the next keyframe
+        ReplayState want = s;
+        want.zoom = e.x < 1 ? 1 : e.x > MAX_ZOOM ? MAX_ZOOM : e.x;
+        RenderPath *next = pathFor(want);
+        if (!next->supports(panel_, v_, angle_)) {
+          refused++;
+          break;
+        }
+        s.zoom = want.zoom;
+        if (s.zoom == 1) s.panX = s.panY = 0.5f;
+        if (next != path) return restart(next);
+        break;
+      }
+      case INPUT_SEEK: {
+        bool first = s.seek == NO_SEEK;
+        s.seek = input_seek_frame(e) < v_.total_frames ? input_seek_frame(e) : v_.total_frames - 1;
+        if (first) return restart(path);     // thumbnails aren't drawn here
+        break;
+      }
+    }
+    return true;
+  }
+
+  ReplayState s;
+  RenderPath *path = nullptr;
+  uint32_t byType[INPUT_SEEK + 1] = {};
+  uint32_t refused = 0;
+
+ private:
+  bool restart(RenderPath *next) {
+    path->end();
+    path = next;
+    if (!path->begin(panel_, v_)) {
+      log_printf("replay: no memory for %s\n", path->name());
+      return false;
+    }
+    panel_.fillScreen(0x0000);
+    return true;
+  }
+
+  Panel &panel_;
+  const FileHeader &v_;
+  float angle_;
+  int pathId_;
+};
+
+bool run_replay(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                const uint8_t *trace, size_t traceLen, const BenchConfig &cfg, int pathId) {
+  InputReplay replay;
+  if (!replay.begin(trace, traceLen)) {
+    log_printf("replay: not an input trace (version %u)\n", (unsigned)INPUT_TRACE_VERSION);
+    return false;
+  }
+  if (pathId < 0) {
+    bool native = (v.flags & FLAG_NATIVE) && cfg.angle == 0.0f;
+    pathId = native ? PATH_NATIVE : PATH_ROTATE_ZOOM;
+  }
+
+  Replayer r(panel, v, cfg.angle, pathId);
+  if (!r.begin()) {
+    log_printf("replay: path %s can't show this video\n", r.path->name());
+    return false;
+  }
+  std::vector<uint8_t> rle(MAX_RLE_SIZE);
+  RefStore refs;
+  refs.reset(v.width, v.height);
+  panel.fillScreen(0x0000);
+
+  uint32_t shown = 0, unseen = 0, sumUs = 0, maxUs = 0, catchUpTo = NO_SEEK;
+  uint32_t hash = 2166136261u;
+  bool ok = true;
+  for (uint32_t i = 0; i < v.total_frames && shown < cfg.count && ok; i++) {
+    // The player's order: inputs up to a pause or seek, the pause loop's
+    // (not waited out), then the jump
+    InputEvent e;
+    while (ok && !r.s.paused && r.s.seek == NO_SEEK && replay.next(i, &e)) ok = r.apply(e);
+    while (ok && r.s.paused) {
+      if (replay.next(i, &e)) ok = r.apply(e);
+      else r.s.paused = false;
+    }
+    if (!ok) break;
+    if (r.s.seek != NO_SEEK) {
+      catchUpTo = r.s.seek;
+      r.s.seek = NO_SEEK;
+      i = find_keyframe(read, ctx, catchUpTo, rle.data(), rle.size());
+      reset_refs(refs, v, read, ctx, i, rle.data(), rle.size());
+    }
+    bool muted = catchUpTo != NO_SEEK && i < catchUpTo;
+    if (!muted) catchUpTo = NO_SEEK;
+
+    size_t len;
+    if (!read(ctx, i, rle.data(), rle.size(), &len)) { ok = false; break; }
+    const ReplayState &s = r.s;
+    RenderParams p = { s.invert ? s.bg : s.fg, s.invert ? s.fg : s.bg, cfg.angle,
+                       (v.flags & FLAG_REFS) ? &refs : nullptr, s.zoom, s.panX, s.panY };
+    uint32_t t0 = now_us();
+    panel.muted = muted;
+    r.path->render(rle.data(), len, p, nullptr);
+    panel.muted = false;
+    uint32_t us = now_us() - t0;
+    sumUs += us;
+    if (us > maxUs) maxUs = us;
+    if (muted) {
+      unseen++;
+      continue;
+    }
+    shown++;
+    uint32_t sum = panel.checksum();
+    for (int b = 0; b < 4; b++) hash = (hash ^ (uint8_t)(sum >> (8 * b))) * 16777619u;
+  }
+  r.path->end();
+
+  uint32_t rendered = shown + unseen;
+  log_printf("replay: %u frames shown, %u decoded unseen after seeks; %u of %u events "
+             "(invert %u, pause %u, colors %u, zoom %u, tilt %u, seek %u), %u zooms refused\n",
+             (unsigned)shown, (unsigned)unseen, (unsigned)replay.applied(),
+             (unsigned)replay.count(), (unsigned)r.byType[INPUT_INVERT],
+             (unsigned)r.byType[INPUT_PAUSE], (unsigned)r.byType[INPUT_COLORS],
+             (unsigned)r.byType[INPUT_ZOOM], (unsigned)r.byType[INPUT_TILT],
+             (unsigned)r.byType[INPUT_SEEK], (unsigned)r.refused);
+  log_printf("  render %.3f ms/frame mean, %.3f max (host); screens 0x%08x; ends on %s, %ux%s\n",
+             rendered ? sumUs / 1000.0 / rendered : 0.0, maxUs / 1000.0, (unsigned)hash,
+             r.path->name(), (unsigned)r.s.zoom, r.s.invert ? ", inverted" : "");
+  return ok;
+}
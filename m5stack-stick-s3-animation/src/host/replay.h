@@ -0,0 +1,16 @@
+#pragma once
+#include "../bench.h"
+#include "../input_trace.h"
+
+// ---- Input trace replay ----
+// Plays the video from frame 0 (cfg.count frames shown at most) with the
+// trace's inputs applied before the frames they were recorded on, as the
+// player does: invert and recolour change the colours, zoom switches to the
+// zoom path (refused where it can't show the angle), tilt pans, a seek
+// restarts at the keyframe before its target and decodes up to it with the
+// panel muted. Pauses are counted but not waited out. Prints the events applied, host render time
+// per frame and one checksum over every frame's screen, which matches
+// between builds that draw the same pictures. `pathId` < 0 picks the path
+// the player would use at 1x.
+bool run_replay(Panel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                const uint8_t *trace, size_t traceLen, const BenchConfig &cfg, int pathId);
@@ -0,0 +1,91 @@
+#include "scroll_check.h"
+#include <stdio.h>
+#include <vector>
+#include "../platform.h"
+#include "../render.h"
+
+struct ScrollRun {
+  std::vector<uint32_t> sums;     // screen checksum after each frame
+  uint64_t spiBytes = 0;
+  uint32_t pushes = 0;
+};
+
+static bool play(MockPanel &panel, RenderPath *path, const FileHeader &v, FrameReader read,
+                 void *ctx, uint32_t key, uint32_t end, const RenderParams &base,
+                 RefStore &refs, ScrollRun *run) {
+  if (!path->begin(panel, v)) return false;
+  std::vector<uint8_t> rle(MAX_RLE_SIZE);
+  RenderParams params = base;
+  reset_refs(refs, v, read, ctx, key, rle.data(), rle.size());
+  panel.fillScreen(0x0000);
+  uint64_t spi0 = panel.spiBytes;
+  uint32_t pushes0 = panel.pushes;
+  bool ok = true;
+  for (uint32_t i = key; i < end; i++) {
+    size_t len;
+    if (!read(ctx, i, rle.data(), rle.size(), &len)) { ok = false; break; }
+    path->render(rle.data(), len, params, nullptr);
+    run->sums.push_back(panel.checksum());
+  }
+  path->end();
+  run->spiBytes = panel.spiBytes - spi0;
+  run->pushes = panel.pushes - pushes0;
+  return ok;
+}
+
+bool run_scroll_check(MockPanel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                      const BenchConfig &cfg) {
+  if (v.flags & FLAG_VECTOR) {
+    log_printf("scroll: vector file, nothing to check\n");
+    return true;
+  }
+  std::vector<uint8_t> rle(MAX_RLE_SIZE);
+  Segment seg;
+  if (!find_segment(v, read, ctx, cfg, rle.data(), rle.size(), &seg)) return false;
+  uint32_t key = seg.key, end = cfg.first + seg.count, marked = 0;
+  for (uint32_t i = key; i < end; i++) {
+    size_t len;
+    if (read(ctx, i, rle.data(), rle.size(), &len) && frame_scroll(rle.data(), len)) marked++;
+  }
+
+  RefStore refs;
+  RenderParams params = { rgb565_to_panel(0xFFFF), 0x0000, cfg.angle,
+                          (v.flags & FLAG_REFS) ? &refs : nullptr, 1, 0.5f, 0.5f };
+  const char *axis = panel.scrollAxis() == Panel::SCROLL_X ? "x" : "y";
+  log_printf("scroll: frames %u..%u, %u marked, angle %.0f, %ux%u panel scrolling along %s\n",
+             (unsigned)key, (unsigned)(end - 1), (unsigned)marked, cfg.angle,
+             panel.width(), panel.height(), axis);
+  log_printf("%-13s %9s %12s %12s %8s %9s\n", "path", "result", "SPI plain", "SPI scroll",
+             "saved", "pushes");
+  bool allOk = true;
+  for (int id = 0; id < PATH_COUNT; id++) {
+    RenderPath *path = render_path((RenderPathId)id);
+    if (path->insetOnly() || !path->supports(panel, v, cfg.angle)) continue;
+    ScrollRun plain, scrolled;
+    panel.scrollable = false;
+    bool ok = play(panel, path, v, read, ctx, key, end, params, refs, &plain);
+    panel.scrollable = true;
+    ok = ok && play(panel, path, v, read, ctx, key, end, params, refs, &scrolled);
+    if (!ok) {
+      log_printf("%-13s %9s\n", path->name(), "no memory");
+      continue;
+    }
+    uint32_t bad = 0, firstBad = 0;
+    for (size_t i = 0; i < plain.sums.size(); i++) {
+      if (plain.sums[i] == scrolled.sums[i]) continue;
+      if (!bad) firstBad = key + i;
+      bad++;
+    }
+    if (bad) allOk = false;
+    char result[24] = "OK";
+    if (bad) snprintf(result, sizeof(result), "%u differ", (unsigned)bad);
+    double saved = plain.spiBytes ? 100.0 * ((double)plain.spiBytes - (double)scrolled.spiBytes) /
+                                        (double)plain.spiBytes : 0.0;
+    log_printf("%-13s %9s %12llu %12llu %7.2f%% %4u/%-4u\n", path->name(), result,
+               (unsigned long long)plain.spiBytes, (unsigned long long)scrolled.spiBytes, saved,
+               (unsigned)plain.pushes, (unsigned)scrolled.pushes);
+    if (bad) log_printf("  first difference at frame %u\n", (unsigned)firstBad);
+  }
+  panel.scrollable = true;
+  return allOk;
+}
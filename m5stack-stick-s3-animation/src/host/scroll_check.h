@@ -0,0 +1,12 @@
+#pragma once
+#include "../bench.h"
+#include "mock_panel.h"
+
+// ---- Hardware scroll on the mock LCD ----
+// Plays frames [first, first+count) through every path twice: with the
+// mock's scroll register off, so every frame is pushed whole, and on, so
+// paths scroll FRAME_SCROLL frames and push only the new lines. After each
+// frame the two screens must match. Reports the scroll frames each path
+// took and the SPI bytes they saved.
+bool run_scroll_check(MockPanel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                      const BenchConfig &cfg);
@@ -0,0 +1,95 @@
+#include "thumb_check.h"
+#include <string.h>
+#include <vector>
+#include "../platform.h"
+#include "../render.h"
+
+bool run_thumb_check(MockPanel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                     const uint8_t *track, size_t trackLen, const BenchConfig &cfg,
+                     int pathId) {
+  ThumbTrack t;
+  if (!(v.flags & FLAG_THUMBS) || trackLen < sizeof(t)) {
+    log_printf("thumbs: no thumbnail track (tools/thumbnails.py adds one)\n");
+    return false;
+  }
+  memcpy(&t, track, sizeof(t));
+  if (!thumb_track_valid(t, trackLen)) {
+    log_printf("thumbs: thumbnail track doesn't fit before frame 0\n");
+    return false;
+  }
+  if (pathId < 0) {
+    bool native = (v.flags & FLAG_NATIVE) && cfg.angle == 0.0f;
+    pathId = (v.flags & FLAG_VECTOR) ? PATH_VECTOR : native ? PATH_NATIVE : PATH_ROTATE_ZOOM;
+  }
+  RenderPath *path = render_path((RenderPathId)pathId);
+  if (!path->supports(panel, v, cfg.angle) || !path->begin(panel, v)) {
+    log_printf("thumbs: path %s can't show this video\n", path->name());
+    return false;
+  }
+  std::vector<uint8_t> rle(MAX_RLE_SIZE);
+  RefStore refs;
+  RenderParams params = { cfg.fg, cfg.bg, cfg.angle, (v.flags & FLAG_REFS) ? &refs : nullptr,
+                          1, 0.5f, 0.5f };
+
+  // What straight playback shows at each thumbnail's frame
+  std::vector<uint32_t> straight;
+  refs.reset(v.width, v.height);
+  panel.fillScreen(0x0000);
+  for (uint32_t i = 0; i < v.total_frames; i++) {
+    size_t len;
+    if (!read(ctx, i, rle.data(), rle.size(), &len)) break;
+    path->render(rle.data(), len, params, nullptr);
+    if (i % t.interval == 0) straight.push_back(panel.checksum());
+  }
+
+  uint32_t count = t.count < cfg.count ? t.count : cfg.count;
+  if (straight.size() < count) count = straight.size();
+  uint64_t thumbUs = 0, seekUs = 0, decoded = 0;
+  uint32_t thumbMax = 0, seekMax = 0, decodedMax = 0, bad = 0, firstBad = 0;
+  for (uint32_t k = 0; k < count; k++) {
+    uint32_t frame = k * t.interval;
+    // The player's seek: new path state, preview, then the unseen catch-up
+    path->end();
+    path->begin(panel, v);
+    uint32_t t0 = now_us();
+    show_thumbnail(panel, v, t, track + thumb_offset(t, k), cfg.angle, cfg.fg, cfg.bg);
+    uint32_t us = now_us() - t0;
+    thumbUs += us;
+    if (us > thumbMax) thumbMax = us;
+
+    t0 = now_us();
+    uint32_t key = find_keyframe(read, ctx, frame, rle.data(), rle.size());
+    if (params.refs) reset_refs(refs, v, read, ctx, key, rle.data(), rle.size());
+    for (uint32_t i = key; i <= frame; i++) {
+      size_t len;
+      if (!read(ctx, i, rle.data(), rle.size(), &len)) break;
+      panel.muted = i < frame;
+      path->render(rle.data(), len, params, nullptr);
+    }
+    panel.muted = false;
+    us = now_us() - t0;
+    seekUs += us;
+    if (us > seekMax) seekMax = us;
+    decoded += frame - key + 1;
+    if (frame - key + 1 > decodedMax) decodedMax = frame - key + 1;
+    if (panel.checksum() != straight[k] && !bad++) firstBad = frame;
+  }
+  path->end();
+
+  size_t bytes = thumb_offset(t, t.count);
+  log_printf("thumbs: %u of %ux%u every %u frames, %u bytes; %s path, angle %.0f\n",
+             (unsigned)t.count, t.width, t.height, t.interval, (unsigned)bytes, path->name(),
+             cfg.angle);
+  if (!count) return true;
+  log_printf("  preview %.3f ms mean, %.3f max; seek by decoding %.3f ms mean, %.3f max, "
+             "%.1f frames decoded (max %u) (host)\n",
+             thumbUs / 1000.0 / count, thumbMax / 1000.0, seekUs / 1000.0 / count,
+             seekMax / 1000.0, (double)decoded / count, (unsigned)decodedMax);
+  if (bad) {
+    log_printf("  %u of %u seeks end on the wrong screen, first at frame %u\n", (unsigned)bad,
+               (unsigned)count, (unsigned)firstBad);
+    return false;
+  }
+  log_printf("  %u seeks end on the straight-playback screen\n", (unsigned)count);
+  return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "../bench.h"
+#include "mock_panel.h"
+
+// ---- Scrub previews against seeking by decoding ----
+// For each thumbnail of a FLAG_THUMBS file (`track`: the bytes before frame
+// 0), times showing it on the mock panel against the player's seek to its
+// frame: restart the path, decode from the keyframe before the frame with
+// the panel muted, show the frame. Each seek must end on the screen that
+// straight playback shows for that frame. `pathId` < 0 picks the path the
+// player would use.
+bool run_thumb_check(MockPanel &panel, const FileHeader &v, FrameReader read, void *ctx,
+                     const uint8_t *track, size_t trackLen, const BenchConfig &cfg,
+                     int pathId);
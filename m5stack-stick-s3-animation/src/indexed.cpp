@@ -0,0 +1,54 @@
+#include "indexed.h"
+#include "codec.h"
+#include "panel.h"
+#include "rgb565.h"
+
+bool indexed_palette(const uint8_t *frame, size_t len, IndexedPalette *pal) {
+  if (!len || !(frame[0] & FRAME_PALETTE)) return false;
+  size_t at = frame_slots_end(frame, len);
+  if (at >= len) return false;
+  uint8_t n = frame[at];
+  if (!n || n > MAX_PALETTE || at + 1 + 2 * (size_t)n > len) return false;
+  const uint8_t *c = frame + at + 1;
+  for (uint8_t i = 0; i < MAX_PALETTE; i++) {
+    pal->lut[i] = i < n ? rgb565_to_panel(c[2 * i] | (c[2 * i + 1] << 8)) : 0x0000;
+  }
+  pal->count = n;
+  return true;
+}
+
+template <void (*Fill)(uint16_t *, uint16_t, size_t)>
+static void decodeIndexed(const uint8_t *frame, size_t len, uint16_t *out,
+                          uint16_t width, uint16_t height, IndexedPalette *pal) {
+  if (!len) return;
+  indexed_palette(frame, len, pal);
+  size_t totalPixels = (size_t)width * height;
+  size_t pixel = 0;
+  size_t pos = frame_header_size(frame, len);
+  while (pos + 1 < len && pixel < totalPixels) {
+    uint16_t word = frame[pos] | (frame[pos + 1] << 8);
+    pos += 2;
+    size_t n = word & INDEX_RUN_LENGTH;
+    if (!word) {                      // keep run
+      if (pos + 1 >= len) break;
+      n = frame[pos] | (frame[pos + 1] << 8);
+      pos += 2;
+    }
+    if (n > totalPixels - pixel) n = totalPixels - pixel;
+    if (word) Fill(out + pixel, pal->lut[word >> INDEX_SHIFT], n);
+    pixel += n;
+  }
+  if (!(frame[0] & FRAME_DELTA) && pixel < totalPixels) {
+    Fill(out + pixel, pal->lut[0], totalPixels - pixel);
+  }
+}
+
+void decode_indexed_to_rgb565(const uint8_t *frame, size_t len, uint16_t *out,
+                              uint16_t width, uint16_t height, IndexedPalette *pal) {
+  decodeIndexed<fill565>(frame, len, out, width, height, pal);
+}
+
+void decode_indexed_to_rgb565_portable(const uint8_t *frame, size_t len, uint16_t *out,
+                                       uint16_t width, uint16_t height, IndexedPalette *pal) {
+  decodeIndexed<fill565_portable>(frame, len, out, width, height, pal);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- Indexed-colour frames (FLAG_INDEXED, written by tools/palette.py) ----
+// Clips of up to 16 colours. Frame: uint8 type (bit 1 delta, bit 7
+// FRAME_PALETTE), with bit 7 uint8 n and n x uint16 RGB565 (LE), then
+// uint16 run words (LE):
+//   bits 12..15  palette index
+//   bits 0..11   run length
+// A zero word is followed by a uint16 count of pixels kept from the previous
+// picture (delta frames). Every intra frame carries its scene's palette, so
+// a keyframe needs nothing before it and a palette change is a table swap.
+
+static const uint8_t MAX_PALETTE = 16;
+static const int INDEX_SHIFT = 12;
+static const uint16_t INDEX_RUN_LENGTH = 0x0FFF;
+
+// The palette in panel byte order, ready for fill565; entries past `count`
+// are black.
+struct IndexedPalette {
+  uint16_t lut[MAX_PALETTE];
+  uint8_t count;
+};
+
+// Take a FRAME_PALETTE frame's palette; false (and `pal` unchanged) for
+// other frames or a malformed palette.
+bool indexed_palette(const uint8_t *frame, size_t len, IndexedPalette *pal);
+
+// Decode to RGB565, one fill565 of lut[index] per run, after taking the
+// frame's palette if it has one. Intra frames paint every pixel (colour 0
+// past the last run); delta frames leave kept pixels alone, so `out` must
+// hold the previous picture.
+void decode_indexed_to_rgb565(const uint8_t *frame, size_t len, uint16_t *out,
+                              uint16_t width, uint16_t height, IndexedPalette *pal);
+
+// Same with the portable fill (rgb565.h), for checking the Xtensa one
+void decode_indexed_to_rgb565_portable(const uint8_t *frame, size_t len, uint16_t *out,
+                                       uint16_t width, uint16_t height, IndexedPalette *pal);
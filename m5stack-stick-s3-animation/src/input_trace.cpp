@@ -0,0 +1,59 @@
+#include "input_trace.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char MAGIC[4] = { 'B', 'A', 'I', 'T' };
+
+void input_pan(const InputEvent &tilt, uint8_t zoom, float *panX, float *panY) {
+  if (zoom <= 1) return;
+  float x = *panX + tilt.x / 1000.0f * PAN_SPEED / zoom;
+  float y = *panY + tilt.y / 1000.0f * PAN_SPEED / zoom;
+  *panX = x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x;
+  *panY = y < 0.0f ? 0.0f : y > 1.0f ? 1.0f : y;
+}
+
+void input_trace_header(uint8_t out[INPUT_TRACE_HEADER]) {
+  memcpy(out, MAGIC, 4);
+  out[4] = INPUT_TRACE_VERSION & 0xFF;
+  out[5] = INPUT_TRACE_VERSION >> 8;
+  out[6] = out[7] = 0;
+}
+
+bool InputReplay::begin(const uint8_t *data, size_t len) {
+  events_ = nullptr;
+  count_ = next_ = 0;
+  if (len < INPUT_TRACE_HEADER || memcmp(data, MAGIC, 4) != 0) return false;
+  if ((data[4] | data[5] << 8) != INPUT_TRACE_VERSION) return false;
+  events_ = data + INPUT_TRACE_HEADER;
+  count_ = (len - INPUT_TRACE_HEADER) / sizeof(InputEvent);
+  return true;
+}
+
+bool InputReplay::peek(uint32_t frame, InputEvent *e) const {
+  if (next_ >= count_) return false;
+  memcpy(e, events_ + (size_t)next_ * sizeof(InputEvent), sizeof(InputEvent));
+  return e->frame <= frame;
+}
+
+bool InputReplay::next(uint32_t frame, InputEvent *e) {
+  if (!peek(frame, e)) return false;
+  next_++;
+  return true;
+}
+
+const char *input_type_name(uint8_t type) {
+  switch (type) {
+    case INPUT_INVERT: return "invert";
+    case INPUT_PAUSE:  return "pause";
+    case INPUT_COLORS: return "colors";
+    case INPUT_ZOOM:   return "zoom";
+    case INPUT_TILT:   return "tilt";
+    case INPUT_SEEK:   return "seek";
+    default:           return "?";
+  }
+}
+
+int input_event_format(const InputEvent &e, char *buf, size_t cap) {
+  return snprintf(buf, cap, "%u %u %s %d %d %d", (unsigned)e.frame, (unsigned)e.ms,
+                  input_type_name(e.type), e.x, e.y, e.z);
+}
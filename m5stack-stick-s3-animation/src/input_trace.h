@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- Input trace: buttons and tilt, recorded and replayed ----
+// The player's inputs as it acted on them, each keyed on the frame it was
+// applied before (plus the time into the pass, for pauses), so a replay
+// hits the same frames with the same invert/recolour/pause/zoom/pan however
+// fast the build renders. Recorded on the device to /input.trace, replayed
+// there (`trace play`) and by the host's `replay` subcommand;
+// tools/input_trace.py converts to and from text.
+//
+// File: "BAIT", uint16 version, uint16 reserved, then 16-byte events.
+
+static const uint16_t INPUT_TRACE_VERSION = 1;
+static const size_t INPUT_TRACE_HEADER = 8;
+
+enum InputType : uint8_t {
+  INPUT_INVERT = 1,    // BtnA short: swap fg/bg
+  INPUT_PAUSE,         // BtnA long: pause or resume
+  INPUT_COLORS,        // BtnB short: x, y = new fg, bg (panel order)
+  INPUT_ZOOM,          // BtnB long or `zoom N`: x = new zoom level
+  INPUT_TILT,          // accelerometer sample the zoomed view panned by: x, y, z in mg
+  INPUT_SEEK,          // scrub or `seek S`: frame x + 65536 * y (unsigned halves)
+};
+
+
+struct InputEvent {
+  uint32_t frame;      // applied before this frame is shown
+  uint32_t ms;         // since the pass started
+  uint8_t type;        // InputType
+  uint8_t reserved;
+  int16_t x, y, z;
+};
+static_assert(sizeof(InputEvent) == 16, "InputEvent is the file layout");
+
+// Target of an INPUT_SEEK
+static inline uint32_t input_seek_frame(const InputEvent &e) {
+  return (uint16_t)e.x | (uint32_t)(uint16_t)e.y << 16;
+}
+
+// Pan the zoomed view by one tilt sample
+static const float PAN_SPEED = 0.03f;       // display widths per frame at 1 g, 1x
+void input_pan(const InputEvent &tilt, uint8_t zoom, float *panX, float *panY);
+
+// Header bytes for a new trace file
+void input_trace_header(uint8_t out[INPUT_TRACE_HEADER]);
+
+// ---- Replay cursor over a whole trace file in memory (not copied) ----
+class InputReplay {
+ public:
+  // False if `data` isn't a trace
+  bool begin(const uint8_t *data, size_t len);
+  void rewind() { next_ = 0; }
+
+  // Next event due before `frame`, in order; false when there is none yet.
+  // peek() leaves it pending (a paused player waits out its `ms`).
+  bool peek(uint32_t frame, InputEvent *e) const;
+  bool next(uint32_t frame, InputEvent *e);
+
+  uint32_t count() const { return count_; }
+  uint32_t applied() const { return next_; }
+
+ private:
+  const uint8_t *events_ = nullptr;
+  uint32_t count_ = 0, next_ = 0;
+};
+
+// One event as a text line: "frame ms name x y z" (no newline)
+int input_event_format(const InputEvent &e, char *buf, size_t cap);
+const char *input_type_name(uint8_t type);
@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// ---- Jitter buffer for streamed frames ----
+// Byte ring of variable-size frames, each stored as uint16 length + data.
+// The ring memory is owned by the caller (PSRAM when available).
+class JitterBuffer {
+ public:
+  static const size_t ENTRY_OVERHEAD = 2;
+
+  void attach(uint8_t *mem, size_t capacity) {
+    buf_ = mem;
+    cap_ = capacity;
+    clear();
+  }
+
+  void clear() { head_ = tail_ = used_ = 0; frames_ = 0; }
+
+  size_t capacity() const { return cap_; }
+  size_t usedBytes() const { return used_; }
+  size_t freeBytes() const { return cap_ - used_; }
+  uint16_t frames() const { return frames_; }
+
+  // Cost in ring bytes of a frame of `len` bytes (what flow credits count).
+  static size_t cost(size_t len) { return len + ENTRY_OVERHEAD; }
+
+  bool push(const uint8_t *data, uint16_t len) {
+    if (cost(len) > freeBytes()) return false;
+    uint8_t lenBytes[ENTRY_OVERHEAD] = { (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+    write(lenBytes, ENTRY_OVERHEAD);
+    write(data, len);
+    frames_++;
+    return true;
+  }
+
+  // Pop the oldest frame into `out`; frames larger than `outCap` are truncated.
+  bool pop(uint8_t *out, size_t outCap, size_t *len) {
+    if (!frames_) return false;
+    uint8_t lenBytes[ENTRY_OVERHEAD];
+    read(lenBytes, ENTRY_OVERHEAD);
+    size_t n = lenBytes[0] | (lenBytes[1] << 8);
+    size_t keep = n < outCap ? n : outCap;
+    read(out, keep);
+    skip(n - keep);
+    frames_--;
+    *len = keep;
+    return true;
+  }
+
+ private:
+  void write(const uint8_t *src, size_t n) {
+    size_t first = cap_ - head_;
+    if (first > n) first = n;
+    memcpy(buf_ + head_, src, first);
+    memcpy(buf_, src + first, n - first);
+    head_ = (head_ + n) % cap_;
+    used_ += n;
+  }
+
+  void read(uint8_t *dst, size_t n) {
+    size_t first = cap_ - tail_;
+    if (first > n) first = n;
+    memcpy(dst, buf_ + tail_, first);
+    memcpy(dst + first, buf_, n - first);
+    skip(n);
+  }
+
+  void skip(size_t n) {
+    tail_ = (tail_ + n) % cap_;
+    used_ -= n;
+  }
+
+  uint8_t *buf_ = nullptr;
+  size_t cap_ = 0;
+  size_t head_ = 0, tail_ = 0, used_ = 0;
+  uint16_t frames_ = 0;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+// ---- Log byte ring ----
+// One producer (the loop task) and one consumer (the log drain task), no
+// locks: the producer only moves head_, the consumer only moves tail_. A
+// message goes in whole or not at all, in time bounded by its length; when
+// it doesn't fit it is counted as dropped rather than waited for.
+template <size_t N>
+class LogRing {
+  static_assert((N & (N - 1)) == 0, "LogRing size must be a power of two");
+
+ public:
+  bool push(const char *msg, size_t len) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t used = head - tail_.load(std::memory_order_acquire);
+    if (len > N - used) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      droppedBytes.fetch_add(len, std::memory_order_relaxed);
+      return false;
+    }
+    size_t at = head & (N - 1);
+    size_t first = N - at < len ? N - at : len;
+    memcpy(buf_ + at, msg, first);
+    memcpy(buf_, msg + first, len - first);
+    head_.store(head + len, std::memory_order_release);
+    if (used + len > peak) peak = used + len;
+    return true;
+  }
+
+  // Oldest unread bytes that are contiguous in memory
+  size_t peek(const char **p) const {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    size_t n = head_.load(std::memory_order_acquire) - tail;
+    size_t at = tail & (N - 1);
+    if (n > N - at) n = N - at;
+    *p = buf_ + at;
+    return n;
+  }
+
+  void consume(size_t n) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+
+  size_t used() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  static size_t capacity() { return N; }
+
+  std::atomic<uint32_t> dropped{0}, droppedBytes{0};   // written by the producer
+  uint32_t peak = 0;                                  // most bytes held at once
+
+ private:
+  char buf_[N];
+  std::atomic<uint32_t> head_{0}, tail_{0};           // free-running byte counts
+};
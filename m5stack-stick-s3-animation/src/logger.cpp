@@ -0,0 +1,117 @@
+#include "logger.h"
+#include <stdio.h>
+
+bool log_emit(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  bool ok = log_vemit(false, fmt, ap);
+  va_end(ap);
+  return ok;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "log_ring.h"
+
+static const uint32_t LOG_DRAIN_MS = 2;     // poll period when idle or the UART is full
+static const int LOG_DRAIN_CORE = 0;        // loop() runs on core 1
+static const int LOG_DRAIN_PRIORITY = 1;    // lowest above idle
+
+static LogRing<LOG_RING_SIZE> ring;
+static SemaphoreHandle_t portLock = nullptr;
+static TaskHandle_t drainTask = nullptr;
+static uint32_t reportedDrops = 0;
+
+void log_port_lock() {
+  if (portLock) xSemaphoreTake(portLock, portMAX_DELAY);
+}
+
+void log_port_unlock() {
+  if (portLock) xSemaphoreGive(portLock);
+}
+
+// Write what the UART takes without waiting (all of it with `block`).
+// Consumers hold the port lock, so the task and log_flush() can't both
+// move the tail. Returns false when there was nothing to do.
+static bool drain(bool block) {
+  log_port_lock();
+  const char *p;
+  size_t n = ring.peek(&p);
+  if (n && !block) {
+    int room = Serial.availableForWrite();
+    n = room > 0 ? (n < (size_t)room ? n : (size_t)room) : 0;
+  }
+  if (n) {
+    Serial.write((const uint8_t *)p, n);
+    ring.consume(n);
+  } else if (!ring.used()) {
+    uint32_t drops = ring.dropped.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      Serial.printf("[log] %u messages dropped\n", (unsigned)(drops - reportedDrops));
+      reportedDrops = drops;
+      n = 1;
+    }
+  }
+  log_port_unlock();
+  return n > 0;
+}
+
+static void drainLoop(void *) {
+  for (;;) {
+    if (!drain(false)) vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+  }
+}
+
+void log_begin() {
+  if (drainTask) return;
+  portLock = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(drainLoop, "log", 2048, nullptr, LOG_DRAIN_PRIORITY, &drainTask,
+                          LOG_DRAIN_CORE);
+}
+
+bool log_vemit(bool wait, const char *fmt, va_list ap) {
+  char buf[LOG_MAX_MESSAGE];
+  int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+  if (len <= 0) return len == 0;
+  if ((size_t)len >= sizeof(buf)) len = sizeof(buf) - 1;
+  if (!drainTask) {
+    Serial.write((const uint8_t *)buf, len);
+    return true;
+  }
+  while (wait && ring.capacity() - ring.used() < (size_t)len) vTaskDelay(1);
+  return ring.push(buf, len);
+}
+
+void log_flush() {
+  if (!drainTask) return;
+  while (drain(true)) {}
+  Serial.flush();
+}
+
+LogStats log_stats() {
+  LogStats s;
+  s.dropped = ring.dropped.load(std::memory_order_relaxed);
+  s.droppedBytes = ring.droppedBytes.load(std::memory_order_relaxed);
+  s.peak = ring.peak;
+  s.capacity = ring.capacity();
+  return s;
+}
+
+#else
+void log_begin() {}
+
+bool log_vemit(bool wait, const char *fmt, va_list ap) {
+  vprintf(fmt, ap);
+  return true;
+}
+
+void log_flush() { fflush(stdout); }
+
+void log_port_lock() {}
+void log_port_unlock() {}
+
+LogStats log_stats() { return LogStats{ 0, 0, 0, 0 }; }
+#endif
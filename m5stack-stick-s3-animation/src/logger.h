@@ -0,0 +1,56 @@
+#pragma once
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- Non-blocking log ----
+// LOG_* format the message and copy it into a ring (log_ring.h) without
+// waiting; a low-priority task on the other core drains the ring to Serial
+// as the UART has room. At 115200 baud a character takes 87 us, so printing
+// straight from loop() could eat into the frame budget. A message that
+// doesn't fit is dropped and counted, and the drain reports the count once
+// it catches up. Levels above LOG_LEVEL compile away (-DLOG_LEVEL=...).
+// Before log_begin() and in the host build messages are written directly.
+
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_AT(level, ...) \
+  do { if ((level) <= LOG_LEVEL) log_emit(__VA_ARGS__); } while (0)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+static const size_t LOG_RING_SIZE = 4096;
+static const size_t LOG_MAX_MESSAGE = 192;   // longer messages are cut
+
+// Start the drain task (device; once Serial is up)
+void log_begin();
+
+// False if the message was dropped
+bool log_emit(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// `wait`: block until the ring has room instead of dropping. For report
+// output (bench tables, model lines) outside playback; see log_printf().
+bool log_vemit(bool wait, const char *fmt, va_list ap);
+
+// Write out everything queued, from the caller: before halting or changing
+// the baud rate.
+void log_flush();
+
+// Other writers of the port (serial link packets) hold this so the drain
+// can't split their bytes.
+void log_port_lock();
+void log_port_unlock();
+
+struct LogStats {
+  uint32_t dropped, droppedBytes;
+  uint32_t peak, capacity;         // ring bytes
+};
+LogStats log_stats();
@@ -1,31 +1,44 @@
 #include <assert.h>
+#include <ctype.h>
 #include <M5Unified.h>
 #include <LittleFS.h>
+#include <Preferences.h>
+#include <math.h>
 #include <stdlib.h>
+#include "autotune.h"
+#include "bench.h"
+#include "codec.h"
+#include "coop.h"
+#include "input_trace.h"
+#include "jitter_buffer.h"
+#include "logger.h"
+#include "pacing.h"
+#include "panel_m5.h"
+#include "pip.h"
+#include "render.h"
+#include "serial_link.h"
+#include "upload_rx.h"
 
 // ---- File paths ----
 static const char *VIDEO_FILE = "/bad_apple.bin";
 
-// ---- Video file header (12 bytes, packed) ----
-#pragma pack(push, 1)
-struct FileHeader {
-  uint16_t width;
-  uint16_t height;
-  uint32_t total_frames;
-  uint16_t fps;
-  uint16_t flags;
-};
-#pragma pack(pop)
-
 // ---- Display ----
-static const uint16_t DISP_W = 240;
-static const uint16_t DISP_H = 135;
+static const uint8_t LANDSCAPE_ROTATION = 3;   // USB on right
+static const uint8_t PORTRAIT_ROTATION = 0;    // what the legacy 90° rotate ends up showing
 
-// ---- Sprites for flicker-free rendering ----
-static M5Canvas canvas;       // full-screen buffer (240x135)
-static M5Canvas videoSprite;  // video frame buffer (vidW x vidH)
+// ---- Rendering (sprites live in the panel, buffers in the path) ----
+static M5Panel panel;
+static RenderPath *activePath = nullptr;
 
-// ---- Color state ----
+// ---- Render path autotuning (result cached in NVS) ----
+#ifndef TUNE_FRAMES
+#define TUNE_FRAMES 20
+#endif
+static const char *TUNE_NAMESPACE = "autotune";
+static const uint32_t TUNE_HEAP_RESERVE = 32 * 1024;   // left for LittleFS, link, uploads
+static RenderPathId tunedPath = PATH_COUNT;            // PATH_COUNT: built-in choice
+
+// ---- Color state (panel byte order, see panel.h) ----
 static volatile uint16_t fgColor = 0xFFFF;
 static volatile uint16_t bgColor = 0x0000;
 static volatile bool invertColors = false;
@@ -33,6 +46,9 @@ static volatile bool invertColors = false;
 // ---- Pause state ----
 static volatile bool paused = false;
 
+// ---- Cooperative player running (coop env) ----
+static bool coopActive = false;
+
 // ---- Glitch (unused without IMU, but kept for compatibility) ----
 static volatile int glitchFrames = 0;
 
@@ -40,17 +56,119 @@ static volatile int glitchFrames = 0;
 static float smoothAngle = 0.0f;
 static const float ANGLE_SMOOTHING = 0.25f;
 
+// ---- Zoom + pan (BtnB long cycles 1x/2x/4x, tilt pans) ----
+static uint8_t zoomLevel = 1;
+static float panX = 0.5f, panY = 0.5f;      // view centre, 0..1 across the display
+static const uint8_t MAX_ZOOM = 8;
+
+// ---- Input trace (input_trace.h): `trace rec` records a pass, `trace play` replays ----
+static const char *TRACE_FILE = "/input.trace";
+static const size_t TRACE_BATCH = 64;        // events per flash write while recording
+enum TraceMode { TRACE_OFF, TRACE_RECORD, TRACE_REPLAY };
+static TraceMode traceMode = TRACE_OFF;
+static bool tracing = false;                 // a recorded or replayed pass is running
+static File traceOut;
+static InputEvent traceBatch[TRACE_BATCH];
+static size_t traceBatched = 0;
+static uint32_t traceEvents = 0;
+static uint8_t *traceData = nullptr;         // the replayed file
+static InputReplay replay;
+static uint32_t traceFrame = 0;              // frame the next input applies before
+static uint32_t traceStartMs = 0;
+static uint32_t pauseEventMs = 0;            // pass time of the last pause event
+
+void inputEvent(uint8_t type, int16_t x = 0, int16_t y = 0, int16_t z = 0);
+
+// ---- Seeking: paused tilt scrubs the thumbnails, `seek S` jumps ----
+static const uint32_t NO_SEEK = 0xFFFFFFFFu;
+static const uint32_t SCRUB_MS = 150;          // one scrub step per period at most
+static const float SCRUB_TILT = 0.35f;         // sideways g before tilt scrubs
+static const float SCRUB_FAST_TILT = 0.7f;     // ... and steps SCRUB_FAST thumbnails
+static const int32_t SCRUB_FAST = 4;
+static ThumbTrack thumbs = {};                 // count 0: the video has none
+static uint8_t *thumbData = nullptr;
+static uint32_t seekTarget = NO_SEEK;          // frame the player jumps to next
+static uint32_t catchUpTo = NO_SEEK;           // frames before it decode unseen
+
 // ---- Video state ----
-static uint16_t vidW, vidH;
-static uint32_t totalFrames;
-static uint16_t vidFps;
-static uint32_t *frameIndex = nullptr;
-static size_t frameDataStart;
+// A video on LittleFS: header and frame index, read once. Frames are read
+// through a VideoHandle, a file handle of each reader's own.
+struct VideoFile {
+  FileHeader hdr;
+  uint32_t *index;                // normal RAM
+  size_t dataStart;
+};
+struct VideoHandle {
+  const VideoFile *video;
+  File file;
+};
+static VideoFile video = {};
+static bool nativeBlit = false;   // frame matches the panel: push 1:1, no rotation
+// Frame buffer and long-term reference pictures (FLAG_REFS files)
+static DecodeStream mainStream;
+
+// ---- Picture-in-picture: a second clip (or another part of this one) in a corner ----
+enum PipMode { PIP_OFF, PIP_SAME, PIP_FILE };
+static PipMode pipMode = PIP_OFF;            // takes effect at the next pass
+static uint32_t pipFirst = 0;                // inset's first frame
+static char pipPath[32] = "";                // PIP_FILE: the inset video
+static Inset inset;
+static VideoFile insetVideo = {};
+static VideoHandle insetHandle;
+static uint32_t pipTicks = 0, pipStartMs = 0;
+
+// ---- Button state ----
+static bool btnALongHandled = false;
+static bool btnBLongHandled = false;
+
+// ---- Serial link (stream input + content upload) ----
+#ifdef STREAM_INPUT
+#ifndef STREAM_BAUD
+#define STREAM_BAUD 1500000
+#endif
+static const uint32_t LINK_BAUD = STREAM_BAUD;
+#else
+static const uint32_t LINK_BAUD = 115200;
+#endif
+static const size_t LINK_RX_BUFFER = 16384;       // UART driver ring
+static const size_t UPLOAD_WINDOW = 12288;        // unprocessed bytes the host may have in flight
+static const uint32_t UPLOAD_TIMEOUT_MS = 5000;
+static const uint32_t NAK_RETRY_MS = 100;
+static const uint32_t CREDIT_INTERVAL_MS = 100;
+
+static uint8_t *linkBuf = nullptr;
+static LinkParser *linkParser = nullptr;
+static uint8_t linkMode = 0;           // LINK_MODE_*, 0 = no session
+static uint8_t rxExpectSeq = 0;
+static uint8_t txSeq = 0;
+static uint32_t acceptedCost = 0;      // sum of credit costs of accepted packets
+static uint32_t lastNakMs = 0;
+static bool nakPending = false;
+static uint32_t lastCreditMs = 0;
+static uint32_t lastPacketMs = 0;
+static bool videoChanged = false;      // an upload replaced or removed the video file
+
+#ifdef STREAM_INPUT
+// ---- Serial stream input ----
+static const size_t JITTER_BYTES_PSRAM = 256 * 1024;
+static const size_t JITTER_BYTES_RAM = 32 * 1024;
+static const uint32_t JITTER_PREFILL_MS = 500;    // buffered time before playback starts
+
+static JitterBuffer jitter;
 
-// ---- Buffers (now in normal RAM) ----
-static uint8_t *rleBuf = nullptr;
-static uint16_t *rgb565Buf = nullptr;
-static const size_t MAX_RLE_SIZE = 16384;
+enum StreamState { STREAM_WAITING, STREAM_BUFFERING, STREAM_PLAYING };
+static StreamState streamState = STREAM_WAITING;
+static bool streamEnded = false;
+static uint32_t nextFrameMs = 0;
+#endif
+
+// ---- Link statistics (reset every report) ----
+static uint32_t statRxBytes = 0;
+static uint32_t statFrames = 0;
+static uint32_t statUnderruns = 0;
+static uint32_t statNaks = 0;
+static uint32_t statMinFrames = 0xFFFF;
+static uint32_t statLastMs = 0;
 
 // ---- HSV to RGB565 ----
 uint16_t hsvToRgb565(uint16_t h, uint8_t s, uint8_t v) {
@@ -74,34 +192,10 @@ uint16_t hsvToRgb565(uint16_t h, uint8_t s, uint8_t v) {
 void pickRandomColors() {
   uint16_t hue1 = esp_random() % 360;
   uint16_t hue2 = (hue1 + 120 + esp_random() % 120) % 360;
-  fgColor = hsvToRgb565(hue1, 255, 255);
-  bgColor = hsvToRgb565(hue2, 255, 80);
-  Serial.printf("Colors: hue %u/%u\n", hue1, hue2);
-}
-
-// ---- Bit-RLE decoder → RGB565 ----
-void decode_bit_rle_to_rgb565(const uint8_t *rle, size_t rleLen,
-                               uint16_t *out, size_t totalPixels) {
-  if (rleLen < 1) return;
-  uint8_t curBit = rle[0];
-  bool inv = invertColors;
-  uint16_t fg = fgColor;
-  uint16_t bg = bgColor;
-  if (inv) { uint16_t tmp = fg; fg = bg; bg = tmp; }
-
-  size_t pixel = 0;
-  size_t pos = 1;
-  while (pos + 1 < rleLen && pixel < totalPixels) {
-    uint16_t runLen = rle[pos] | (rle[pos + 1] << 8);
-    pos += 2;
-    uint16_t color = curBit ? fg : bg;
-    size_t end = pixel + runLen;
-    if (end > totalPixels) end = totalPixels;
-    for (size_t i = pixel; i < end; i++) out[i] = color;
-    pixel = end;
-    curBit = 1 - curBit;
-  }
-  for (size_t i = pixel; i < totalPixels; i++) out[i] = bgColor;
+  uint16_t fg = rgb565_to_panel(hsvToRgb565(hue1, 255, 255));   // buffers are panel order
+  uint16_t bg = rgb565_to_panel(hsvToRgb565(hue2, 255, 80));
+  LOG_INFO("Colors: hue %u/%u\n", hue1, hue2);
+  inputEvent(INPUT_COLORS, (int16_t)fg, (int16_t)bg);
 }
 
 // ---- Glitch effect (unused, but kept) ----
@@ -123,7 +217,8 @@ void updateSmoothAngle(float targetDeg) {
 }
 
 void errorHold(const char *msg) {
-  Serial.printf("ERROR: %s\n", msg);
+  LOG_ERROR("ERROR: %s\n", msg);
+  log_flush();
   M5.Lcd.fillScreen(TFT_RED);
   M5.Lcd.setTextColor(TFT_WHITE);
   M5.Lcd.setCursor(10, 10);
@@ -132,142 +227,1199 @@ void errorHold(const char *msg) {
   while (true) { M5.update(); delay(1000); }
 }
 
+// ---- Render path for the current video and zoom ----
+RenderPath *playbackPath() {
+  if (video.hdr.flags & FLAG_VECTOR) return render_path(PATH_VECTOR);   // zooms by itself
+  if (zoomLevel > 1) return render_path(PATH_ZOOM);
+  if (tunedPath != PATH_COUNT) return render_path(tunedPath);
+  return render_path(nativeBlit ? PATH_NATIVE : PATH_ROTATE_ZOOM);
+}
+
+void applyTune(RenderPathId id, BufferPlace place) {
+  if (tunedPath != PATH_COUNT) render_path(tunedPath)->place = PLACE_HEAP;
+  tunedPath = id;
+  if (id != PATH_COUNT) render_path(id)->place = place;
+}
+
+// A tuned choice that no longer fits falls back to the built-in one
+void beginPlaybackPath() {
+  activePath = playbackPath();
+  if (activePath->begin(panel, video.hdr)) return;
+  if (tunedPath != PATH_COUNT && activePath == render_path(tunedPath)) {
+    LOG_WARN("Autotune: tuned path out of memory, using default\n");
+    applyTune(PATH_COUNT, PLACE_HEAP);
+    activePath = playbackPath();
+    if (activePath->begin(panel, video.hdr)) return;
+  }
+  errorHold("OOM: render buffers");
+}
+
+// ---- Allocate decode buffers + pick the render path for the video's size ----
+void initVideoBuffers() {
+  if (!mainStream.begin(video.hdr)) errorHold("OOM: buffers");
+  if (activePath) activePath->end();
+
+  // ---- Native profiles: blit straight to the panel, no scaler/rotator ----
+  const FileHeader &v = video.hdr;
+  nativeBlit = (v.flags & FLAG_NATIVE) && ((v.width == DISP_W && v.height == DISP_H) ||
+                                          (v.width == DISP_H && v.height == DISP_W));
+  M5.Lcd.setRotation(nativeBlit && v.width == DISP_H ? PORTRAIT_ROTATION : LANDSCAPE_ROTATION);
+
+  beginPlaybackPath();
+}
+
+// ---- Read a video's header + index from LittleFS ----
+// False if there is no such video; halts when the index doesn't fit.
+bool readVideoFile(const char *path, VideoFile *v) {
+  File vf = LittleFS.open(path, "r");
+  if (!vf) return false;
+  FileHeader hdr;
+  if (vf.read((uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr) || !hdr.total_frames) {
+    vf.close();
+    return false;
+  }
+  v->hdr = hdr;
+  size_t indexSize = hdr.total_frames * sizeof(uint32_t);
+  free(v->index);
+  v->index = (uint32_t *)malloc(indexSize);
+  if (!v->index) { vf.close(); errorHold("OOM: index"); }
+  if (vf.read((uint8_t *)v->index, indexSize) != indexSize) {   // cut short
+    free(v->index);
+    v->index = nullptr;
+    vf.close();
+    return false;
+  }
+  v->dataStart = sizeof(FileHeader) + indexSize;
+  vf.close();
+  return true;
+}
+
+bool loadVideo() {
+  if (upload_incomplete(VIDEO_FILE)) {
+    LOG_WARN("Video: an upload stopped half way through patching it\n");
+    return false;
+  }
+  if (!readVideoFile(VIDEO_FILE, &video)) return false;
+  const FileHeader &v = video.hdr;
+  LOG_INFO("Video: %ux%u, %u frames, %u fps, flags 0x%04x\n",
+           v.width, v.height, v.total_frames, v.fps, v.flags);
+
+  // ---- Thumbnail track: kept in memory so previews need no file access ----
+  free(thumbData);
+  thumbData = nullptr;
+  thumbs.count = 0;
+  seekTarget = catchUpTo = NO_SEEK;
+  if (video.hdr.flags & FLAG_THUMBS) {
+    File vf = LittleFS.open(VIDEO_FILE, "r");
+    vf.seek(video.dataStart);
+    size_t bytes = 0;
+    if (vf.read((uint8_t *)&thumbs, sizeof(thumbs)) == sizeof(thumbs) &&
+        thumb_track_valid(thumbs, index_offset(video.index[0]))) {
+      bytes = thumb_offset(thumbs, thumbs.count) - sizeof(thumbs);
+      thumbData = (uint8_t *)alloc_large(bytes);
+    }
+    if (thumbData && vf.read(thumbData, bytes) == bytes) {
+      LOG_INFO("Thumbnails: %u at %ux%u, every %u frames\n", thumbs.count, thumbs.width,
+               thumbs.height, thumbs.interval);
+    } else {
+      free(thumbData);
+      thumbData = nullptr;
+      thumbs.count = 0;
+      LOG_WARN("Thumbnails: track unreadable, seeking without previews\n");
+    }
+    vf.close();
+  }
+
+  // ---- Decode buffers (placed as the autotuner chose) and render path ----
+  initVideoBuffers();
+  return true;
+}
+
+// ---- Decode the RLE frame in the main stream's buffer and show it ----
+void renderFrame(size_t rleSize) {
+  RenderParams p;
+  p.fg = invertColors ? bgColor : fgColor;
+  p.bg = invertColors ? fgColor : bgColor;
+  p.angle = nativeBlit ? 0.0f : smoothAngle;
+  p.zoom = zoomLevel;
+  p.panX = panX;
+  p.panY = panY;
+  mainStream.render(activePath, panel, rleSize, p);     // with its reference slots
+}
+
+void clearScreen() {
+  panel.fillScreen(TFT_BLACK);
+}
+
+// ---- Zoom: switches to the zoom path; delta files recover at the next keyframe ----
+void setZoom(int z) {
+  if (z < 1) z = 1;
+  if (z > MAX_ZOOM) z = MAX_ZOOM;
+  if (coopActive) {
+    LOG_WARN("Zoom: not in the cooperative player\n");
+    return;
+  }
+  float angle = nativeBlit ? 0.0f : smoothAngle;
+  uint8_t was = zoomLevel;
+  zoomLevel = z;
+  RenderPath *want = playbackPath();
+  if (!want->supports(panel, video.hdr, angle)) {
+    zoomLevel = was;
+    LOG_WARN("Zoom: %s\n", (video.hdr.flags & FLAG_INDEXED) ? "not for indexed-colour clips"
+                                                            : "needs a quarter-turn angle");
+    return;
+  }
+  if (want != activePath && video.index) {
+    activePath->end();
+    beginPlaybackPath();
+    clearScreen();
+  }
+  if (z == 1) panX = panY = 0.5f;
+  LOG_INFO("Zoom: %dx%s\n", z, (video.hdr.flags & FLAG_ROW_INDEX) ? " (row index)" : "");
+}
+
+// Tilt pans the zoomed view; x/y follow the landscape panel axes
+void updatePan() {
+  if (zoomLevel <= 1 || !M5.Imu.isEnabled()) return;
+  float ax, ay, az;
+  M5.Imu.update();
+  if (!M5.Imu.getAccel(&ax, &ay, &az)) return;
+  inputEvent(INPUT_TILT, lroundf(ax * 1000), lroundf(ay * 1000), lroundf(az * 1000));   // mg
+}
+
+// Preview of `frame` from the thumbnail track; false without one
+bool showThumbnail(uint32_t frame) {
+  if (!thumbs.count) return false;
+  const uint8_t *bits = thumbData + (size_t)thumb_for(thumbs, frame) * thumb_bytes(thumbs);
+  return show_thumbnail(panel, video.hdr, thumbs, bits, nativeBlit ? 0.0f : smoothAngle,
+                        invertColors ? bgColor : fgColor, invertColors ? fgColor : bgColor);
+}
+
+// ---- Inputs: buttons, tilt, `zoom N` and `seek S` all act through here ----
+void applyInput(const InputEvent &e) {
+  switch (e.type) {
+    case INPUT_INVERT:
+      invertColors = !invertColors;
+      LOG_INFO("Invert: %s\n", invertColors ? "ON" : "OFF");
+      break;
+    case INPUT_PAUSE:
+      paused = !paused;
+      pauseEventMs = e.ms;
+      if (paused) {
+        LOG_INFO("PAUSED\n");
+      } else {
+        LOG_INFO("RESUMED\n");
+      }
+      break;
+    case INPUT_COLORS:
+      fgColor = (uint16_t)e.x;
+      bgColor = (uint16_t)e.y;
+      break;
+    case INPUT_ZOOM:
+      setZoom(e.x);
+      break;
+    case INPUT_TILT:
+      input_pan(e, zoomLevel, &panX, &panY);
+      break;
+    case INPUT_SEEK:
+      if (coopActive) {
+        LOG_WARN("Seek: not in the cooperative player\n");
+        break;
+      }
+      // The path's picture and scroll offset go; decoding restarts at a keyframe
+      if (seekTarget == NO_SEEK) {
+        activePath->end();
+        beginPlaybackPath();
+      }
+      seekTarget = input_seek_frame(e) < video.hdr.total_frames ? input_seek_frame(e)
+                                                                : video.hdr.total_frames - 1;
+      if (!showThumbnail(seekTarget)) clearScreen();
+      LOG_INFO("Seek: frame %u\n", (unsigned)seekTarget);
+      break;
+  }
+}
+
+static bool replaying() { return tracing && traceMode == TRACE_REPLAY; }
+
+void flushTrace() {
+  traceOut.write((const uint8_t *)traceBatch, traceBatched * sizeof(InputEvent));
+  traceBatched = 0;
+}
+
+// A live input: ignored while a trace replays, appended to it while recording
+void inputEvent(uint8_t type, int16_t x, int16_t y, int16_t z) {
+  if (replaying()) return;
+  InputEvent e = { traceFrame, (uint32_t)(millis() - traceStartMs), type, 0, x, y, z };
+  if (tracing) {
+    traceBatch[traceBatched++] = e;
+    traceEvents++;
+    if (traceBatched == TRACE_BATCH) flushTrace();
+  }
+  applyInput(e);
+}
+
+// Events due before `frame`; a pause holds the rest for the pause loop, a
+// seek for after the jump
+void replayInputs(uint32_t frame) {
+  InputEvent e;
+  while (!paused && seekTarget == NO_SEEK && replay.next(frame, &e)) applyInput(e);
+}
+
+void seekEvent(uint32_t frame) {
+  if (frame >= video.hdr.total_frames) frame = video.hdr.total_frames - 1;
+  inputEvent(INPUT_SEEK, (int16_t)(frame & 0xFFFF), (int16_t)(frame >> 16));
+}
+
+// Paused: tilting sideways steps through the thumbnails, faster when steeper
+void scrubByTilt(uint32_t frame) {
+  static uint32_t lastStepMs = 0;
+  if (!thumbs.count || !M5.Imu.isEnabled() || millis() - lastStepMs < SCRUB_MS) return;
+  float ax, ay, az;
+  M5.Imu.update();
+  if (!M5.Imu.getAccel(&ax, &ay, &az) || fabsf(ax) < SCRUB_TILT) return;
+  lastStepMs = millis();
+  int32_t step = fabsf(ax) >= SCRUB_FAST_TILT ? SCRUB_FAST : 1;
+  int32_t at = thumb_for(thumbs, seekTarget != NO_SEEK ? seekTarget : frame);
+  int32_t i = at + (ax > 0 ? step : -step);
+  i = i < 0 ? 0 : i >= (int32_t)thumbs.count ? thumbs.count - 1 : i;
+  if (i != at || seekTarget == NO_SEEK) seekEvent(i * thumbs.interval);
+}
+
+// ---- Input trace passes: both start from the same controls ----
+bool loadTrace() {
+  File tf = LittleFS.open(TRACE_FILE, "r");
+  if (!tf) return false;
+  size_t len = tf.size();
+  free(traceData);
+  traceData = (uint8_t *)alloc_large(len ? len : 1);
+  bool ok = traceData && tf.read(traceData, len) == len && replay.begin(traceData, len);
+  tf.close();
+  return ok;
+}
+
+void traceBegin() {
+  tracing = false;
+  if (traceMode == TRACE_RECORD) {
+    traceOut = LittleFS.open(TRACE_FILE, "w");
+    if (!traceOut) {
+      LOG_WARN("Trace: cannot create %s\n", TRACE_FILE);
+      traceMode = TRACE_OFF;
+      return;
+    }
+    uint8_t hdr[INPUT_TRACE_HEADER];
+    input_trace_header(hdr);
+    traceOut.write(hdr, sizeof(hdr));
+    traceBatched = traceEvents = 0;
+  } else if (traceMode == TRACE_REPLAY) {
+    replay.rewind();
+  } else {
+    return;
+  }
+  invertColors = paused = false;
+  fgColor = 0xFFFF;
+  bgColor = 0x0000;
+  if (zoomLevel != 1) setZoom(1);
+  panX = panY = 0.5f;
+  traceFrame = 0;
+  tracing = true;
+  traceStartMs = millis();
+  LOG_INFO("Trace: %s pass\n", traceMode == TRACE_RECORD ? "recording" : "replaying");
+}
+
+void traceEnd() {
+  if (!tracing) return;
+  tracing = false;
+  const StreamStats &st = mainStream.stats;
+  float mean = st.rendered ? st.sumUs / 1000.0f / st.rendered : 0.0f;
+  if (traceMode == TRACE_RECORD) {
+    flushTrace();
+    traceOut.close();
+    traceMode = TRACE_OFF;
+    LOG_INFO("Trace: recorded %u events to %s; render %.2f ms/frame mean, %.2f max\n",
+             (unsigned)traceEvents, TRACE_FILE, mean, st.maxUs / 1000.0f);
+  } else {
+    LOG_INFO("Trace: replayed %u of %u events; render %.2f ms/frame mean, %.2f max\n",
+             (unsigned)replay.applied(), (unsigned)replay.count(), mean, st.maxUs / 1000.0f);
+  }
+}
+
+void traceCommand(const char *arg) {
+  if (!strcmp(arg, "rec")) {
+    traceEnd();
+    traceMode = TRACE_RECORD;
+    LOG_INFO("Trace: recording from the next pass\n");
+  } else if (!strcmp(arg, "play")) {
+    traceEnd();
+    if (!loadTrace()) {
+      traceMode = TRACE_OFF;
+      LOG_WARN("Trace: no trace in %s\n", TRACE_FILE);
+      return;
+    }
+    traceMode = TRACE_REPLAY;
+    LOG_INFO("Trace: %u events, replaying from the next pass\n", (unsigned)replay.count());
+  } else if (!strcmp(arg, "off")) {
+    traceEnd();
+    traceMode = TRACE_OFF;
+  } else if (!strcmp(arg, "show")) {
+    File tf = LittleFS.open(TRACE_FILE, "r");
+    uint8_t hdr[INPUT_TRACE_HEADER];
+    InputReplay check;
+    InputEvent e;
+    char line[64];
+    if (!tf || tf.read(hdr, sizeof(hdr)) != sizeof(hdr) || !check.begin(hdr, sizeof(hdr))) {
+      LOG_WARN("Trace: no trace in %s\n", TRACE_FILE);
+    } else {
+      while (tf.read((uint8_t *)&e, sizeof(e)) == sizeof(e)) {
+        input_event_format(e, line, sizeof(line));
+        log_printf("%s\n", line);
+      }
+    }
+    if (tf) tf.close();
+  } else {
+    LOG_WARN("trace: rec | play | off | show\n");
+  }
+}
+
+// ---- Benchmark: every render path over a fixed segment of the file ----
+#ifndef BENCH_FIRST
+#define BENCH_FIRST 300
+#endif
+#ifndef BENCH_FRAMES
+#define BENCH_FRAMES 100
+#endif
+
+// FrameReader over an open video file (ctx: VideoHandle *)
+static bool readVideoFrame(void *ctx, uint32_t idx, uint8_t *buf, size_t cap, size_t *len) {
+  VideoHandle &h = *(VideoHandle *)ctx;
+  const VideoFile &v = *h.video;
+  if (idx >= v.hdr.total_frames) return false;
+  size_t offset = index_offset(v.index[idx]);
+  size_t next = idx + 1 < v.hdr.total_frames ? index_offset(v.index[idx + 1])
+                                             : h.file.size() - v.dataStart;
+  if (next < offset || next - offset > cap) return false;
+  *len = next - offset;
+  h.file.seek(v.dataStart + offset);
+  return h.file.read(buf, *len) == *len;
+}
+
+void runBench() {
+  if (!video.index) {
+    LOG_WARN("bench: no video loaded\n");
+    return;
+  }
+  VideoHandle vh = { &video, LittleFS.open(VIDEO_FILE, "r") };
+  if (!vh.file) {
+    LOG_WARN("bench: cannot open video\n");
+    return;
+  }
+  // The bench drives the same path objects the player uses
+  activePath->end();
+
+  BenchConfig cfg;
+  cfg.first = video.hdr.total_frames > BENCH_FIRST ? BENCH_FIRST : 0;
+  cfg.count = BENCH_FRAMES;
+  cfg.angle = nativeBlit ? 0.0f : 90.0f;
+  cfg.fg = fgColor;
+  cfg.bg = bgColor;
+  run_bench(panel, video.hdr, readVideoFrame, &vh, cfg);
+  vh.file.close();
+
+  beginPlaybackPath();
+  clearScreen();
+}
+
+// ---- Autotune: fastest path + buffer placement for this board and video ----
+// Keyed on the video header and size, PSRAM and the firmware build, so a new
+// video or firmware recalibrates and every other boot reads the pick back.
+static uint32_t tuneKey(size_t fileSize) {
+  static const char BUILD[] = __DATE__ " " __TIME__;
+  FileHeader hdr = video.hdr;
+  uint32_t h = 2166136261u;
+  auto mix = [&h](const void *p, size_t n) {
+    for (size_t i = 0; i < n; i++) h = (h ^ ((const uint8_t *)p)[i]) * 16777619u;
+  };
+  mix(&hdr, sizeof(hdr));
+  mix(&fileSize, sizeof(fileSize));
+  mix(BUILD, sizeof(BUILD));
+  bool psram = psramFound();
+  mix(&psram, sizeof(psram));
+  return h;
+}
+
+void tuneRenderPath(bool force) {
+  if (!video.index || (video.hdr.flags & FLAG_VECTOR)) return;   // vector files have one path
+  VideoHandle vh = { &video, LittleFS.open(VIDEO_FILE, "r") };
+  if (!vh.file) return;
+  uint32_t key = tuneKey(vh.file.size());
+  float angle = nativeBlit ? 0.0f : smoothAngle;
+
+  Preferences prefs;
+  prefs.begin(TUNE_NAMESPACE, false);
+  if (!force && prefs.getUInt("key", 0) == key) {
+    RenderPathId id = (RenderPathId)prefs.getUChar("path", PATH_COUNT);
+    BufferPlace place = (BufferPlace)prefs.getUChar("place", PLACE_HEAP);
+    if (id < PATH_COUNT && place < PLACE_COUNT && !render_path(id)->insetOnly() &&
+        render_path(id)->supports(panel, video.hdr, angle) && place_available(place)) {
+      prefs.end();
+      vh.file.close();
+      activePath->end();
+      applyTune(id, place);
+      beginPlaybackPath();
+      LOG_INFO("Autotune: %s, buffers in %s (cached)\n", render_path(id)->name(),
+               place_name(place));
+      return;
+    }
+  }
+
+  M5.Lcd.println("Calibrating...");
+  activePath->end();
+  applyTune(PATH_COUNT, PLACE_HEAP);
+  TuneConfig cfg;
+  cfg.first = video.hdr.total_frames / 4;
+  cfg.count = TUNE_FRAMES;
+  cfg.angle = angle;
+  cfg.heapReserve = TUNE_HEAP_RESERVE;
+  TuneResult r;
+  if (autotune(panel, video.hdr, readVideoFrame, &vh, cfg, &r)) {
+    applyTune(r.path, r.place);
+    prefs.putUInt("key", key);
+    prefs.putUChar("path", r.path);
+    prefs.putUChar("place", r.place);
+  }
+  prefs.end();
+  vh.file.close();
+  beginPlaybackPath();
+  clearScreen();
+}
+
+// ---- Picture-in-picture ----
+// Both streams run in turn on this core: the panel and its SPI bus have one
+// owner. The inset decodes after each shown main frame, inside its pacing.
+void pipBegin() {
+  if (pipMode != PIP_FILE && insetVideo.index) {
+    free(insetVideo.index);
+    insetVideo.index = nullptr;
+  }
+  if (pipMode == PIP_OFF) return;
+  if (panel.width() < panel.height()) {
+    LOG_WARN("PiP: landscape videos only\n");
+    return;
+  }
+  const char *path = VIDEO_FILE;
+  insetHandle.video = &video;                // the same clip shares the index
+  if (pipMode == PIP_FILE) {
+    if (!readVideoFile(pipPath, &insetVideo)) {
+      LOG_WARN("PiP: no video in %s\n", pipPath);
+      pipMode = PIP_OFF;
+      return;
+    }
+    path = pipPath;
+    insetHandle.video = &insetVideo;
+  }
+  insetHandle.file = LittleFS.open(path, "r");
+  const FileHeader &iv = insetHandle.video->hdr;
+  float angle = (iv.flags & FLAG_NATIVE) ? 0.0f : smoothAngle;
+  activePath->end();                         // restarted around the hole
+  if (!insetHandle.file || !inset.begin(panel, pip_rect(panel.width(), panel.height()), iv,
+                                        readVideoFrame, &insetHandle, pipFirst, angle)) {
+    LOG_WARN("PiP: can't show %s (%ux%u) in the corner\n", path, iv.width, iv.height);
+    if (insetHandle.file) insetHandle.file.close();
+    pipMode = PIP_OFF;
+  }
+  beginPlaybackPath();
+  clearScreen();
+  pipTicks = 0;
+  pipStartMs = millis();
+  if (inset.active()) {
+    LOG_INFO("PiP: %s from frame %u through %s\n", path, (unsigned)pipFirst, inset.pathName());
+  }
+}
+
+void pipEnd() {
+  if (!inset.active()) return;
+  uint32_t ms = millis() - pipStartMs;
+  const StreamStats &m = mainStream.stats, &i = inset.stream.stats;
+  LOG_INFO("PiP: main %u frames, %.2f ms mean, %.2f max; inset %u (%u decoded), "
+           "%.2f ms mean, %.2f max; %.1f fps combined\n",
+           (unsigned)m.shown, m.rendered ? m.sumUs / 1000.0f / m.rendered : 0.0f,
+           m.maxUs / 1000.0f, (unsigned)i.shown, (unsigned)i.rendered,
+           i.rendered ? i.sumUs / 1000.0f / i.rendered : 0.0f, i.maxUs / 1000.0f,
+           ms ? (m.shown + i.shown) * 1000.0f / ms : 0.0f);
+  inset.end();
+  insetHandle.file.close();
+  activePath->end();
+  beginPlaybackPath();
+}
+
+void pipCommand(const char *arg) {
+  if (!strcmp(arg, "off")) {
+    pipMode = PIP_OFF;
+  } else if (arg[0] == '/' && strlen(arg) < sizeof(pipPath)) {
+    strcpy(pipPath, arg);
+    pipMode = PIP_FILE;
+    pipFirst = 0;
+  } else if (!arg[0] || isdigit((unsigned char)arg[0])) {
+    float sec = atof(arg);
+    pipMode = PIP_SAME;
+    pipFirst = arg[0] ? (uint32_t)(sec * video.hdr.fps) : video.hdr.total_frames / 2;
+  } else {
+    LOG_WARN("pip: SEC | /file.bin | off\n");
+    return;
+  }
+  LOG_INFO("PiP: %s from the next pass\n", pipMode == PIP_OFF ? "off" : "on");
+}
+
+// Word kernels against their references on the loaded video
+void runKernelCheck() {
+  if (!video.index) {
+    LOG_WARN("kernels: no video loaded\n");
+    return;
+  }
+  VideoHandle vh = { &video, LittleFS.open(VIDEO_FILE, "r") };
+  if (!vh.file) {
+    LOG_WARN("kernels: cannot open video\n");
+    return;
+  }
+  BenchConfig cfg;
+  cfg.first = video.hdr.total_frames > BENCH_FIRST ? BENCH_FIRST : 0;
+  cfg.count = BENCH_FRAMES;
+  run_kernel_check(video.hdr, readVideoFrame, &vh, cfg);
+  vh.file.close();
+}
+
+// ---- Buttons: BtnA long = pause, short = invert; BtnB long = zoom, short = random colors ----
+void pollButtons() {
+  if (M5.BtnA.pressedFor(600) && !btnALongHandled) {
+    btnALongHandled = true;
+    inputEvent(INPUT_PAUSE);
+  }
+  if (M5.BtnA.wasReleased()) {
+    if (!btnALongHandled) inputEvent(INPUT_INVERT);
+    btnALongHandled = false;
+  }
+
+  if (M5.BtnB.pressedFor(600) && !btnBLongHandled) {
+    btnBLongHandled = true;
+    inputEvent(INPUT_ZOOM, zoomLevel >= 4 ? 1 : zoomLevel * 2);
+  }
+  if (M5.BtnB.wasReleased()) {
+    if (!btnBLongHandled) pickRandomColors();
+    btnBLongHandled = false;
+  }
+}
+
+// ---- Serial link handling ----
+// The log drain shares the port; a packet goes out in one piece
+void linkSend(uint8_t type, const uint8_t *payload, uint16_t len) {
+  log_port_lock();
+  link_send(Serial, type, txSeq++, payload, len);
+  log_port_unlock();
+}
+
+size_t linkWindow() {
+#ifdef STREAM_INPUT
+  if (linkMode == LINK_MODE_STREAM) return jitter.freeBytes();
+#endif
+  return linkMode == LINK_MODE_UPLOAD ? UPLOAD_WINDOW : 0;
+}
+
+void sendCredit() {
+  uint8_t p[11];
+  uint32_t limit = acceptedCost + linkWindow();
+  uint16_t frames = 0;
+  uint32_t used = 0;
+#ifdef STREAM_INPUT
+  frames = jitter.frames();
+  used = jitter.usedBytes();
+#endif
+  p[0] = rxExpectSeq;
+  memcpy(p + 1, &limit, 4);
+  memcpy(p + 5, &frames, 2);
+  memcpy(p + 7, &used, 4);
+  linkSend(PKT_CREDIT, p, sizeof(p));
+  lastCreditMs = millis();
+}
+
+void sendNak() {
+  uint32_t now = millis();
+  if (nakPending && now - lastNakMs < NAK_RETRY_MS) return;
+  linkSend(PKT_NAK, &rxExpectSeq, 1);
+  nakPending = true;
+  lastNakMs = now;
+  statNaks++;
+}
+
+void setLinkBaud(uint32_t baud) {
+  log_flush();
+  log_port_lock();
+  Serial.flush();
+  Serial.updateBaudRate(baud);
+  log_port_unlock();
+}
+
+void endUploadSession() {
+  upload_abort();
+  if (upload_incomplete(VIDEO_FILE)) videoChanged = true;   // patched half way: stop playing it
+  linkMode = 0;
+  setLinkBaud(LINK_BAUD);
+}
+
+void sendUploadDone(bool ok, uint64_t hash) {
+  uint8_t p[9];
+  p[0] = ok ? 1 : 0;
+  memcpy(p + 1, &hash, 8);
+  linkSend(PKT_UP_DONE, p, sizeof(p));
+}
+
+// ---- Upload: report hashes of the current file, chunk by chunk ----
+void sendChunkHashes() {
+  const uint16_t BATCH = 128;
+  uint8_t p[10 + BATCH * 8];
+  uint32_t oldSize = upload_old_size();
+  uint32_t chunk = upload_chunk_size();
+  uint32_t count = (oldSize + chunk - 1) / chunk;
+  uint32_t first = 0;
+  do {
+    uint16_t n = count - first < BATCH ? count - first : BATCH;
+    memcpy(p, &oldSize, 4);
+    memcpy(p + 4, &first, 4);
+    memcpy(p + 8, &n, 2);
+    for (uint16_t i = 0; i < n; i++) {
+      uint64_t h = upload_hash_chunk(first + i);
+      memcpy(p + 10 + i * 8, &h, 8);
+    }
+    linkSend(PKT_UP_HASHES, p, 10 + n * 8);
+    first += n;
+  } while (first < count);
+}
+
+void handleHello(const LinkParser &lp) {
+  uint8_t mode = lp.length() ? lp.payload()[0] : 0;
+  uint32_t baud = 0;
+  if (lp.length() >= 5) memcpy(&baud, lp.payload() + 1, 4);
+#ifndef STREAM_INPUT
+  if (mode == LINK_MODE_STREAM) {
+    LOG_WARN("Stream input not built in (use the 'stream' env)\n");
+    return;
+  }
+#endif
+  if (mode != LINK_MODE_STREAM && mode != LINK_MODE_UPLOAD) return;
+
+  upload_abort();
+  linkMode = mode;
+  acceptedCost = 0;
+  rxExpectSeq = lp.seq() + 1;
+  nakPending = false;
+#ifdef STREAM_INPUT
+  jitter.clear();
+  streamEnded = false;
+  streamState = STREAM_WAITING;
+#endif
+
+  uint8_t p[6];
+  uint32_t cap = linkWindow();
+  uint16_t maxPayload = MAX_RLE_SIZE;
+  memcpy(p, &cap, 4);
+  memcpy(p + 4, &maxPayload, 2);
+  linkSend(PKT_READY, p, sizeof(p));
+  if (baud) setLinkBaud(baud);           // host switches right after READY
+  sendCredit();
+}
+
+void handlePacket() {
+  const LinkParser &lp = *linkParser;
+  lastPacketMs = millis();
+
+  if (lp.type() == PKT_HELLO) { handleHello(lp); return; }   // new session
+  if (!linkMode) return;
+  if (lp.seq() != rxExpectSeq) { sendNak(); return; }
+
+  switch (lp.type()) {
+#ifdef STREAM_INPUT
+    case PKT_HEADER: {
+      if (lp.length() < sizeof(FileHeader)) break;
+      FileHeader hdr;
+      memcpy(&hdr, lp.payload(), sizeof(hdr));
+      bool resize = hdr.width != video.hdr.width || hdr.height != video.hdr.height;
+      video.hdr.width = hdr.width;
+      video.hdr.height = hdr.height;
+      video.hdr.total_frames = hdr.total_frames;
+      video.hdr.fps = hdr.fps ? hdr.fps : 15;
+      resize |= hdr.flags != video.hdr.flags;
+      video.hdr.flags = hdr.flags;
+      LOG_INFO("Stream: %ux%u, %u frames, %u fps\n",
+               video.hdr.width, video.hdr.height, video.hdr.total_frames, video.hdr.fps);
+      if (resize || !activePath) initVideoBuffers();
+      else mainStream.refs.reset(video.hdr.width, video.hdr.height);
+      streamState = STREAM_BUFFERING;
+      break;
+    }
+    case PKT_FRAME:
+      if (!jitter.push(lp.payload(), lp.length())) {   // host overran its credit
+        sendNak();
+        return;
+      }
+      acceptedCost += JitterBuffer::cost(lp.length());
+      break;
+    case PKT_END:
+      streamEnded = true;
+      break;
+#endif
+    case PKT_UP_BEGIN: {
+      uint32_t size = 0, chunk = 0;
+      if (lp.length() >= 8) {
+        memcpy(&size, lp.payload(), 4);
+        memcpy(&chunk, lp.payload() + 4, 4);
+      }
+      rxExpectSeq++;
+      if (!upload_open(VIDEO_FILE, size, chunk)) {
+        LOG_WARN("Upload: cannot open video file\n");
+        sendUploadDone(false, 0);
+        endUploadSession();
+        return;
+      }
+      LOG_INFO("Upload: %u -> %u bytes%s\n", upload_old_size(), size,
+               upload_in_place() ? " (in place, no room for a copy)" : "");
+      sendChunkHashes();
+      sendCredit();
+      return;
+    }
+    case PKT_UP_CHUNK: {
+      uint32_t index;
+      if (lp.length() < 4) break;
+      memcpy(&index, lp.payload(), 4);
+      if (!upload_write(index, lp.payload() + 4, lp.length() - 4)) {
+        LOG_WARN("Upload: write failed\n");
+        sendUploadDone(false, 0);
+        endUploadSession();
+        return;
+      }
+      acceptedCost += lp.length();
+      break;
+    }
+    case PKT_UP_END: {
+      uint32_t size = 0;
+      uint64_t expected = 0, actual = 0;
+      if (lp.length() >= 12) {
+        memcpy(&size, lp.payload(), 4);
+        memcpy(&expected, lp.payload() + 4, 8);
+      }
+      rxExpectSeq++;
+      sendCredit();
+      bool ok = upload_finish(size, expected, &actual);
+      sendUploadDone(ok, actual);
+      LOG_INFO("Upload %s: %u chunks sent, %u copied, %u KB written in %u flash writes\n",
+               ok ? "OK" : "FAILED", upload_chunks_written(), upload_chunks_copied(),
+               upload_flash_bytes() / 1024, upload_flash_writes());
+      endUploadSession();
+      if (ok) videoChanged = true;       // a failed copy leaves the old file
+      return;
+    }
+    default:
+      break;
+  }
+  rxExpectSeq++;
+  nakPending = false;
+  sendCredit();
+}
+
+// ---- Text commands typed into the serial monitor ----
+void handleCommand(const char *cmd) {
+#ifndef STREAM_INPUT
+  if (!strcmp(cmd, "bench") && !linkMode) {
+    runBench();
+    return;
+  }
+  if (!strcmp(cmd, "kernels") && !linkMode) {
+    runKernelCheck();
+    return;
+  }
+  if (!strcmp(cmd, "tune") && !linkMode) {
+    tuneRenderPath(true);
+    return;
+  }
+  if (!strncmp(cmd, "seek ", 5) && video.index && !linkMode) {
+    float sec = atof(cmd + 5);
+    seekEvent(sec > 0 ? (uint32_t)(sec * video.hdr.fps) : 0);
+    return;
+  }
+  if (!strncmp(cmd, "trace", 5) && (!cmd[5] || cmd[5] == ' ')) {
+    traceCommand(cmd[5] ? cmd + 6 : "");
+    return;
+  }
+  if (!strncmp(cmd, "pip", 3) && (!cmd[3] || cmd[3] == ' ') && video.index) {
+    pipCommand(cmd[3] ? cmd + 4 : "");
+    return;
+  }
+#else
+  if (!strcmp(cmd, "bench") || !strcmp(cmd, "kernels") || !strcmp(cmd, "tune")) {
+    LOG_WARN("%s: reads the LittleFS video, not in the stream build\n", cmd);
+    return;
+  }
+#endif
+  if (!strcmp(cmd, "log")) {
+    LogStats st = log_stats();
+    LOG_INFO("log: %u messages (%u bytes) dropped, peak %u of %u ring bytes\n",
+             (unsigned)st.dropped, (unsigned)st.droppedBytes, (unsigned)st.peak,
+             (unsigned)st.capacity);
+    return;
+  }
+  if (!strncmp(cmd, "zoom ", 5)) {
+    inputEvent(INPUT_ZOOM, atoi(cmd + 5));
+    return;
+  }
+  LOG_WARN("Unknown command: %s\n", cmd);
+}
+
+void pumpLink() {
+  uint8_t chunk[512];
+  int avail;
+  while ((avail = Serial.available()) > 0) {
+    size_t n = Serial.readBytes(chunk, avail < (int)sizeof(chunk) ? avail : sizeof(chunk));
+    statRxBytes += n;
+    size_t pos = 0;
+    while (pos < n) {
+      LinkParser::Result res;
+      pos += linkParser->consume(chunk + pos, n - pos, &res);
+      if (res == LinkParser::PACKET) handlePacket();
+      else if (res == LinkParser::CRC_ERROR && linkMode) sendNak();
+      else if (res == LinkParser::LINE) handleCommand(linkParser->line());
+    }
+  }
+}
+
+// ---- Poll the link; keeps credits flowing and times out dead uploads ----
+void serviceLink() {
+  pumpLink();
+  if (!linkMode) return;
+  uint32_t now = millis();
+  if (now - lastCreditMs >= CREDIT_INTERVAL_MS) sendCredit();   // recovers lost credits
+  if (linkMode == LINK_MODE_UPLOAD && now - lastPacketMs > UPLOAD_TIMEOUT_MS) {
+    LOG_WARN("Upload: timed out\n");
+    endUploadSession();
+  }
+}
+
+void setupLink() {
+  linkBuf = (uint8_t *)malloc(MAX_RLE_SIZE);
+  if (!linkBuf) errorHold("OOM: link buffer");
+  linkParser = new LinkParser(linkBuf, MAX_RLE_SIZE);
+}
+
+#ifdef STREAM_INPUT
+void reportStreamStats(uint32_t now) {
+  uint32_t dt = now - statLastMs;
+  if (dt < 1000) return;
+  LOG_INFO("[stream] %.1f kB/s, %.1f fps, buffer %u%% (%u frames, min %u), "
+           "underruns %u, crc %u, nak %u\n",
+           statRxBytes / (float)dt, statFrames * 1000.0f / dt,
+           (unsigned)(100 * jitter.usedBytes() / jitter.capacity()),
+           jitter.frames(), statMinFrames == 0xFFFF ? 0 : statMinFrames,
+           statUnderruns, linkParser->crcErrors, statNaks);
+  statRxBytes = statFrames = statUnderruns = statNaks = 0;
+  statMinFrames = 0xFFFF;
+  statLastMs = now;
+}
+
+void streamLoop() {
+  serviceLink();
+
+  uint32_t now = millis();
+  reportStreamStats(now);
+  if (linkMode != LINK_MODE_STREAM || streamState == STREAM_WAITING) return;
+
+  M5.update();
+  pollButtons();
+  updatePan();
+  uint32_t frameDelay = 1000 / video.hdr.fps;
+
+  if (streamState == STREAM_BUFFERING) {
+    uint32_t prefillFrames = JITTER_PREFILL_MS / frameDelay;
+    bool full = jitter.freeBytes() < JitterBuffer::cost(MAX_RLE_SIZE);
+    if (jitter.frames() >= prefillFrames || full || (streamEnded && jitter.frames())) {
+      streamState = STREAM_PLAYING;
+      nextFrameMs = now;
+    }
+    return;
+  }
+
+  if (paused || (int32_t)(now - nextFrameMs) < 0) return;
+
+  size_t rleSize;
+  if (!jitter.pop(mainStream.rle(), MAX_RLE_SIZE, &rleSize)) {
+    if (!streamEnded) statUnderruns++;
+    streamState = streamEnded ? STREAM_WAITING : STREAM_BUFFERING;   // hold last frame
+    return;
+  }
+  if (jitter.frames() < statMinFrames) statMinFrames = jitter.frames();
+  renderFrame(rleSize);
+  statFrames++;
+
+  nextFrameMs += frameDelay;
+  if ((int32_t)(millis() - nextFrameMs) > (int32_t)frameDelay) nextFrameMs = millis();
+}
+
+void setupStream() {
+  size_t cap = JITTER_BYTES_RAM;
+  uint8_t *mem = nullptr;
+  if (psramFound()) {
+    mem = (uint8_t *)ps_malloc(JITTER_BYTES_PSRAM);
+    if (mem) cap = JITTER_BYTES_PSRAM;
+  }
+  if (!mem) mem = (uint8_t *)malloc(cap);
+  if (!mem) errorHold("OOM: jitter buffer");
+  jitter.attach(mem, cap);
+  statLastMs = millis();
+
+  M5.Lcd.println("Waiting for stream...");
+  LOG_INFO("Stream input: %u baud, jitter buffer %u bytes\n", STREAM_BAUD, (unsigned)cap);
+}
+#endif
+
+#ifdef COOP_PLAYER
+// ---- Cooperative player: reader, decoder, renderer, input as tasks ----
+class DeviceClock : public CoopClock {
+ public:
+  uint32_t now() override { return now_us(); }
+  void idleUntil(uint32_t us) override {
+    int32_t wait = (int32_t)(us - now_us());
+    if (wait >= 1000) delay(wait / 1000);   // the core's other tasks run meanwhile
+    else yield();
+  }
+};
+
+static bool coopInput(void *ctx, RenderParams *p, bool *pause) {
+  M5.update();
+  pollButtons();
+  serviceLink();
+  p->fg = invertColors ? bgColor : fgColor;
+  p->bg = invertColors ? fgColor : bgColor;
+  *pause = paused;
+  return linkMode != LINK_MODE_UPLOAD;
+}
+
+// One pass over the video; false if it needs the blocking loop (vector and
+// indexed-colour files, zoomed view, input traces, picture-in-picture)
+bool coopPlay(VideoHandle &vh) {
+  if ((video.hdr.flags & (FLAG_VECTOR | FLAG_INDEXED)) || zoomLevel > 1 || traceMode != TRACE_OFF ||
+      pipMode != PIP_OFF) {
+    return false;
+  }
+  DeviceClock clock;
+  CoopConfig cfg;
+  cfg.count = video.hdr.total_frames;
+  cfg.angle = nativeBlit ? 0.0f : smoothAngle;
+  CoopHooks hooks;
+  hooks.input = coopInput;
+  RenderParams params = { fgColor, bgColor, cfg.angle, nullptr, 1, 0.5f, 0.5f };
+
+  activePath->end();                        // the player brings its own buffers
+  CoopPlayer player;
+  if (!player.begin(panel, video.hdr, readVideoFrame, &vh, video.index, clock, cfg, hooks,
+                    params)) {
+    beginPlaybackPath();
+    return false;
+  }
+  coopActive = true;
+  while (player.step()) {}
+  coopActive = false;
+  player.end();
+  beginPlaybackPath();
+
+  const FramePacer &p = player.pacer;
+  LOG_INFO("Played %u frames, dropped %u, late %u, resyncs %u (cooperative)\n",
+           (unsigned)p.shown, (unsigned)p.dropped, (unsigned)p.late, (unsigned)p.resyncs);
+  return true;
+}
+#endif
+
 void setup() {
   auto cfg = M5.config();
   M5.begin(cfg);
 
-  M5.Lcd.setRotation(3);                // landscape, USB on right
+  M5.Lcd.setRotation(LANDSCAPE_ROTATION);
   M5.Lcd.fillScreen(TFT_BLACK);
   M5.Lcd.setTextColor(TFT_WHITE);
   M5.Lcd.setTextSize(1);
   M5.Lcd.setCursor(0, 0);
 
-  Serial.begin(115200);
-  Serial.println("Bad Apple starting...");
+  Serial.setRxBufferSize(LINK_RX_BUFFER);
+  Serial.begin(LINK_BAUD);
+  log_begin();
+  LOG_INFO("Bad Apple starting...\n");
+  setupLink();
+
+#ifdef STREAM_INPUT
+  LittleFS.begin();                     // only needed for uploads here
+  smoothAngle = 90.0f;
+  setupStream();
+  return;
+#endif
 
   if (!LittleFS.begin()) errorHold("LittleFS mount failed");
 
-  // ---- Read video header + index ----
+  // ---- Set fixed rotation angle to fill screen (90°) ----
+  smoothAngle = 90.0f;   // rotate video 90° to match landscape display
+
+  // ---- Read video header + index, calibrate the render path ----
   M5.Lcd.println("Loading video...");
-  {
-    File vf = LittleFS.open(VIDEO_FILE, "r");
-    if (!vf) errorHold("Missing video file");
-    FileHeader hdr;
-    vf.read((uint8_t *)&hdr, sizeof(hdr));
-    vidW = hdr.width;
-    vidH = hdr.height;
-    totalFrames = hdr.total_frames;
-    vidFps = hdr.fps;
-    Serial.printf("Video: %ux%u, %u frames, %u fps\n", vidW, vidH, totalFrames, vidFps);
-
-    size_t indexSize = totalFrames * sizeof(uint32_t);
-    frameIndex = (uint32_t *)malloc(indexSize);        // use normal RAM
-    if (!frameIndex) { vf.close(); errorHold("OOM: index"); }
-    vf.read((uint8_t *)frameIndex, indexSize);
-    frameDataStart = sizeof(FileHeader) + indexSize;
-    vf.close();
+  if (!loadVideo()) {
+    M5.Lcd.println("No video - waiting for upload");
+    LOG_INFO("No video file; waiting for tools/upload_video.py\n");
+    return;
   }
+  tuneRenderPath(false);
 
-  // ---- Allocate buffers in normal RAM ----
-  size_t pixels = (size_t)vidW * vidH;
-  rleBuf = (uint8_t *)malloc(MAX_RLE_SIZE);
-  rgb565Buf = (uint16_t *)malloc(pixels * 2);
-  if (!rleBuf || !rgb565Buf) errorHold("OOM: buffers");
-
-  // ---- Create sprites (use normal RAM) ----
-  canvas.setPsram(false);
-  canvas.setColorDepth(16);
-  if (!canvas.createSprite(DISP_W, DISP_H)) errorHold("OOM: canvas sprite");
-
-  videoSprite.setPsram(false);
-  videoSprite.setColorDepth(16);
-  if (!videoSprite.createSprite(vidW, vidH)) errorHold("OOM: video sprite");
-
-  // ---- Set fixed rotation angle to fill screen (90°) ----
-  smoothAngle = 90.0f;   // rotate video 90° to match landscape display
+#ifdef BENCH_MODE
+  runBench();
+#endif
 
   M5.Lcd.fillScreen(TFT_BLACK);
-  Serial.println("Ready.");
+  LOG_INFO("Ready.\n");
 }
 
 void loop() {
-  File vf = LittleFS.open(VIDEO_FILE, "r");
-  if (!vf) { errorHold("Cannot open video"); return; }
+#ifdef STREAM_INPUT
+  streamLoop();
+  return;
+#endif
 
-  size_t pixels = (size_t)vidW * vidH;
-  uint32_t frameDelay = 1000 / vidFps;
+  // ---- Upload in progress / video replaced ----
+  while (linkMode == LINK_MODE_UPLOAD) { serviceLink(); delay(1); }
+  if (videoChanged) {
+    videoChanged = false;
+    smoothAngle = 90.0f;
+    if (loadVideo()) {
+      tuneRenderPath(false);
+      M5.Lcd.fillScreen(TFT_BLACK);
+    } else {
+      free(video.index);                 // belonged to the file that is gone
+      video.index = nullptr;
+      LOG_WARN("No video file; waiting for tools/upload_video.py\n");
+    }
+  }
+  if (!video.index) { serviceLink(); delay(10); return; }
 
-  bool btnALongHandled = false;
+  VideoHandle vh = { &video, LittleFS.open(VIDEO_FILE, "r") };
+  if (!vh.file) { errorHold("Cannot open video"); return; }
+  mainStream.attach(readVideoFrame, &vh);
+  mainStream.stats = StreamStats();
 
-  for (uint32_t frameIdx = 0; frameIdx < totalFrames; frameIdx++) {
-    uint32_t frameStart = millis();
-    M5.update();
+#ifdef COOP_PLAYER
+  if (coopPlay(vh)) {
+    vh.file.close();
+    clearScreen();
+    delay(1000);
+    return;
+  }
+#endif
 
-    // ---- BtnA: long = pause, short = invert ----
-    if (M5.BtnA.pressedFor(600) && !btnALongHandled) {
-      btnALongHandled = true;
-      paused = !paused;
-      if (paused) {
-        Serial.println("PAUSED");
-      } else {
-        Serial.println("RESUMED");
-      }
-    }
-    if (M5.BtnA.wasReleased()) {
-      if (!btnALongHandled) {
-        invertColors = !invertColors;
-        Serial.printf("Invert: %s\n", invertColors ? "ON" : "OFF");
-      }
-      btnALongHandled = false;
-    }
+  FramePacer pacer;
+  pacer.start(millis(), 1000 / video.hdr.fps, video.hdr.flags & FLAG_LAYERS);
+  // Encoder cost hints: start expensive frames early, in the slack of cheaper ones
+  CostHints hints;
+  hints.begin(video.index, video.hdr.total_frames, COST_HINT_US / 1000.0f);
+  uint32_t costs[CostHints::LOOKAHEAD];
+  bool lookahead = video.hdr.flags & FLAG_COST_HINTS;
+  catchUpTo = NO_SEEK;
+  traceBegin();
+  pipBegin();
 
-    // ---- BtnB: random contrasting colors ----
-    if (M5.BtnB.wasPressed()) {
-      pickRandomColors();
+  for (uint32_t frameIdx = 0; frameIdx < video.hdr.total_frames; frameIdx++) {
+    uint32_t turn = millis();
+    traceFrame = frameIdx;
+    M5.update();
+    if (replaying()) {
+      replayInputs(frameIdx);
+    } else {
+      pollButtons();
+      updatePan();
     }
+    serviceLink();
+    if (linkMode == LINK_MODE_UPLOAD) break;
 
-    // ---- Pause loop ----
+    // ---- Pause loop (a replay holds it as long as the recording did) ----
+    uint32_t pausedAt = millis();
     while (paused) {
       M5.update();
-      if (M5.BtnA.pressedFor(600) && !btnALongHandled) {
-        btnALongHandled = true;
-        paused = false;
-        Serial.println("RESUMED");
+      InputEvent e;
+      if (!replaying()) {
+        if (M5.BtnA.pressedFor(600) && !btnALongHandled) {
+          btnALongHandled = true;
+          inputEvent(INPUT_PAUSE);
+        }
+        scrubByTilt(frameIdx);
+      } else if (!replay.peek(frameIdx, &e)) {
+        paused = false;                     // the trace ends paused
+      } else if (millis() - pausedAt >= e.ms - pauseEventMs) {
+        replay.next(frameIdx, &e);
+        applyInput(e);
       }
       if (M5.BtnA.wasReleased()) btnALongHandled = false;
+      serviceLink();
+      if (linkMode == LINK_MODE_UPLOAD) paused = false;
       delay(30);
+      pacer.restart(millis());
+      turn = millis();
     }
 
+    // ---- Seek: restart at the keyframe before the target ----
+    if (seekTarget != NO_SEEK) {
+      catchUpTo = seekTarget;
+      seekTarget = NO_SEEK;
+      frameIdx = mainStream.seek(catchUpTo);       // refills the reference slots
+      traceFrame = frameIdx;
+    }
+
+    // ---- Frames up to the target decode unseen and unpaced (the preview stays up) ----
+    bool unseen = false;
+    if (catchUpTo != NO_SEEK) {
+      unseen = frameIdx < catchUpTo;
+      if (!unseen) {
+        catchUpTo = NO_SEEK;
+        pacer.restart(millis());
+        turn = millis();
+      }
+    }
+
+    // ---- Late: skip enhancement frames (layered files; replays show all) ----
+    // Nothing is coded against them, so a seek skips them too.
+    bool droppable = index_droppable(video.index[frameIdx]);
+    if (unseen ? droppable : !replaying() && pacer.drop(millis(), droppable)) continue;
+
     // ---- Read RLE frame ----
-    size_t frameOffset = frameIndex[frameIdx];
-    size_t nextOffset = (frameIdx + 1 < totalFrames)
-                            ? frameIndex[frameIdx + 1]
-                            : (vf.size() - frameDataStart);
-    size_t rleSize = nextOffset - frameOffset;
-    if (rleSize > MAX_RLE_SIZE) rleSize = MAX_RLE_SIZE;
-
-    vf.seek(frameDataStart + frameOffset);
-    if (vf.read(rleBuf, rleSize) != rleSize) break;
-
-    // ---- Decode ----
-    decode_bit_rle_to_rgb565(rleBuf, rleSize, rgb565Buf, pixels);
-
-    // ---- Render: copy to sprite → rotate into canvas → push to LCD ----
-    videoSprite.pushImage(0, 0, vidW, vidH, rgb565Buf);
-    canvas.fillSprite(TFT_BLACK);
-    videoSprite.pushRotateZoom(&canvas,
-                                DISP_W / 2, DISP_H / 2,
-                                smoothAngle,
-                                1.0f, 1.0f);
-    canvas.pushSprite(&M5.Lcd, 0, 0);
+    size_t rleSize;
+    if (!mainStream.read(frameIdx, &rleSize)) break;
+
+    panel.muted = unseen;
+    renderFrame(rleSize);
+    panel.muted = false;
+    if (unseen) continue;
+    if (inset.active()) {
+      uint16_t fg = invertColors ? bgColor : fgColor, bg = invertColors ? fgColor : bgColor;
+      if (!inset.show(pipTicks++, video.hdr.fps, fg, bg)) pipEnd();   // read error
+    }
 
     // ---- Frame timing ----
-    uint32_t elapsed = millis() - frameStart;
-    if (elapsed < frameDelay) delay(frameDelay - elapsed);
+    uint32_t now = millis();
+    uint32_t wait;
+    if (lookahead) {
+      hints.measured(frameIdx, now - turn);
+      wait = pacer.nextAhead(now, costs, hints.predict(frameIdx + 1, costs));
+    } else {
+      wait = pacer.next(now);
+    }
+    if (wait) delay(wait);
   }
 
-  vf.close();
-  canvas.fillSprite(TFT_BLACK);
-  canvas.pushSprite(&M5.Lcd, 0, 0);
+  pipEnd();
+  vh.file.close();
+  traceEnd();
+  if (pacer.dropped || pacer.resyncs || pacer.late) {
+    LOG_INFO("Played %u frames, dropped %u, late %u, resyncs %u, started early %u\n",
+             (unsigned)pacer.shown, (unsigned)pacer.dropped, (unsigned)pacer.late,
+             (unsigned)pacer.resyncs, (unsigned)pacer.ahead);
+  }
+  clearScreen();
   delay(1000);
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+#include <stdint.h>
+#include "codec.h"
+
+// ---- Frame pacing with load shedding ----
+// Frames are due one period apart. With `catchUp` (FLAG_LAYERS files), when
+// playback is more than half a period behind, droppable frames
+// (INDEX_DROPPABLE) are skipped to catch up; other frames are always shown.
+// If playback is still behind by more than MAX_BEHIND periods, the schedule
+// restarts from now, so an overloaded player slows down instead of bursting.
+// Without it, a late frame restarts the schedule at once: each frame waits
+// out only what is left of its own period and nothing plays back to back.
+// Times are in any unit: ms on the device, µs in the host simulator.
+class FramePacer {
+ public:
+  static const uint32_t MAX_BEHIND = 2;
+
+  void start(uint32_t now, uint32_t period, bool catchUp) {
+    due_ = now;
+    period_ = period;
+    catchUp_ = catchUp;
+    shown = dropped = late = resyncs = ahead = 0;
+  }
+
+  // Next frame is due now (after a pause), keeping the counters.
+  void restart(uint32_t now) { due_ = now; }
+
+  // Call before reading frame; true = skip it (it counts as played).
+  bool drop(uint32_t now, bool droppable) {
+    if (!catchUp_ || !droppable || (int32_t)(now - due_) <= (int32_t)(period_ / 2)) {
+      return false;
+    }
+    due_ += period_;
+    dropped++;
+    return true;
+  }
+
+  // Call after showing a frame; returns how long to wait for the next one.
+  uint32_t next(uint32_t now) {
+    shown++;
+    if ((int32_t)(now - due_) > (int32_t)period_) late++;
+    due_ += period_;
+    int32_t wait = (int32_t)(due_ - now);
+    if (!catchUp_ && wait < 0) {
+      due_ = now;
+    } else if (wait < -(int32_t)(period_ * MAX_BEHIND)) {
+      due_ = now;
+      resyncs++;
+    }
+    return wait > 0 ? (uint32_t)wait : 0;
+  }
+
+  // Like next(), given the predicted times of the coming frames (costs[0] is
+  // the next one). If starting on time would leave one of them finishing
+  // more than a period after it is due, the next frame starts early: at the
+  // latest time that keeps all n in time, but never before the one just
+  // shown is due.
+  uint32_t nextAhead(uint32_t now, const uint32_t *costs, int n) {
+    uint32_t wait = next(now);
+    int32_t start = INT32_MAX;       // latest start of costs[k], from due_
+    for (int k = n - 1; k >= 0; k--) {
+      int32_t deadline = (int32_t)(period_ * (k + 1));
+      if (start > deadline) start = deadline;
+      start -= (int32_t)costs[k];
+    }
+    if (start >= 0) return wait;
+    uint32_t early = (uint32_t)-start < period_ ? (uint32_t)-start : period_;
+    ahead++;
+    return wait > early ? wait - early : 0;
+  }
+
+  // When the next frame is due
+  uint32_t due() const { return due_; }
+
+  uint32_t shown = 0, dropped = 0;
+  uint32_t late = 0;       // shown more than a period after they were due
+  uint32_t resyncs = 0;
+  uint32_t ahead = 0;      // started early by nextAhead()
+
+ private:
+  uint32_t due_ = 0, period_ = 1;
+  bool catchUp_ = false;
+};
+
+// ---- Encoder cost hints (FLAG_COST_HINTS) ----
+// Per-frame times predicted by build_data.py, plus what frames have actually
+// taken beyond their hint so far (loop overhead, other work on the core, a
+// model that is off), for FramePacer::nextAhead().
+class CostHints {
+ public:
+  static const int LOOKAHEAD = 32;
+
+  // `step`: one hint step (COST_HINT_US) in pacer time units
+  void begin(const uint32_t *index, uint32_t frames, float step) {
+    index_ = index;
+    frames_ = frames;
+    step_ = step;
+    extra_ = 0.0f;
+  }
+
+  // Predicted times of frames next.. into costs[LOOKAHEAD]; returns how many
+  int predict(uint32_t next, uint32_t *costs) const {
+    int n = 0;
+    for (; n < LOOKAHEAD && next + n < frames_; n++) {
+      float t = (index_cost_hint(index_[next + n]) + 0.5f) * step_ + extra_;
+      costs[n] = t > 0.0f ? (uint32_t)(t + 0.5f) : 0;
+    }
+    return n;
+  }
+
+  // Frame `frame` took `took` from the start of its turn until shown
+  void measured(uint32_t frame, uint32_t took) {
+    uint32_t hint = index_cost_hint(index_[frame]);
+    if (hint) extra_ += 0.03125f * ((float)took - (hint + 0.5f) * step_ - extra_);
+  }
+
+ private:
+  const uint32_t *index_ = nullptr;
+  uint32_t frames_ = 0;
+  float step_ = 1.0f, extra_ = 0.0f;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- Panel-native RGB565 ----
+// The ST7789 takes RGB565 high byte first. Colours are swapped into that
+// order once, when they are picked, so every pixel buffer between decode
+// and SPI already holds the bytes the panel wants and pushes send them as
+// they are. All colours and pixels passed to a Panel are in this order.
+static inline uint16_t rgb565_to_panel(uint16_t c) { return (uint16_t)((c >> 8) | (c << 8)); }
+static inline uint16_t panel_to_rgb565(uint16_t c) { return rgb565_to_panel(c); }
+
+// ---- Screen rectangle ----
+struct PanelRect {
+  int16_t x, y, w, h;
+};
+
+// ---- LCD abstraction used by the render paths ----
+// Implemented by M5Panel (src/panel_m5.cpp) on the device and MockPanel
+// (src/host/mock_panel.cpp) in the host build.
+class Panel {
+ public:
+  virtual ~Panel() {}
+
+  virtual uint16_t width() const = 0;
+  virtual uint16_t height() const = 0;
+
+  // Hold the bus across several pushes (needed around DMA pushes)
+  virtual void beginWrite() {}
+  virtual void endWrite() {}
+
+  // Push a w x h block of panel-native pixels; returns once the data is sent.
+  virtual void pushBlock(int x, int y, int w, int h, const uint16_t *px) = 0;
+
+  // Start pushing a block by DMA; `px` must stay untouched until waitDMA().
+  virtual void pushBlockDMA(int x, int y, int w, int h, const uint16_t *px) {
+    pushBlock(x, y, w, h, px);
+  }
+  virtual void waitDMA() {}
+  virtual bool dmaBusy() { return false; }
+
+  virtual void fillScreen(uint16_t color) = 0;
+
+  // ---- Sprite canvas (the original M5GFX render path) ----
+  // Draw a frame rotated by `angle` around the canvas center, over black.
+  virtual bool composeRotateZoom16(const uint16_t *frame, int w, int h, float angle) = 0;
+  virtual bool composeRotateZoom1bpp(const uint8_t *bits, size_t stride, int w, int h,
+                                     float angle, uint16_t fg, uint16_t bg) = 0;
+  virtual void pushCanvas() = 0;
+  virtual void releaseSprites() = 0;
+  // Sprites created from now on go to PSRAM (true) or internal RAM
+  virtual void placeSprites(bool psram) {}
+  virtual size_t spriteBytes() const = 0;
+
+  // ---- Hardware scroll (ST7789 VSCRDEF/VSCSAD) ----
+  // The controller can show its RAM rotated along its scan direction:
+  // screen y in portrait, screen x in landscape. At offset s, screen line i
+  // along that axis shows RAM line (i + s) % lines, and pushBlock()
+  // coordinates are RAM coordinates. A picture that moved along the axis
+  // then only needs the lines that came into view pushed.
+  enum ScrollAxis { SCROLL_NONE, SCROLL_X, SCROLL_Y };
+  virtual ScrollAxis scrollAxis() const { return SCROLL_NONE; }
+  virtual void setScroll(uint16_t offset) {}
+
+  // ---- Seeking ----
+  // While muted, pushes are dropped: a seek decodes the frames from the
+  // keyframe up to its target without sending them. Sprites are still
+  // composed, so paths keep their pictures.
+  bool muted = false;
+
+  // ---- Picture-in-picture ----
+  // Pushes leave `hole` alone (w = 0: none), so the inset drawn there
+  // (pip.h) isn't overwritten by the video under it; fillScreen() still
+  // clears it. There is no hardware scroll while a hole is set.
+  PanelRect hole = { 0, 0, 0, 0 };
+
+  // Hash of what is on screen, 0 if the panel can't read it back
+  virtual uint32_t checksum() const { return 0; }
+
+  // ---- Counters ----
+  uint64_t spiBytes = 0;   // pixel data + window-setting commands
+  uint32_t pushes = 0;
+
+ protected:
+  // CASET + RASET + RAMWR with their parameters
+  static const uint32_t WINDOW_OVERHEAD = 11;
+  // VSCSAD with its parameter
+  static const uint32_t SCROLL_OVERHEAD = 3;
+
+  void count(int w, int h) {
+    spiBytes += (uint64_t)w * h * 2 + WINDOW_OVERHEAD;
+    pushes++;
+  }
+
+  // The parts of block (x, y, w, h) outside the hole, at most 4: the block
+  // itself when it misses the hole, none when the hole covers it
+  int visibleParts(int x, int y, int w, int h, PanelRect parts[4]) const {
+    int x1 = x + w, y1 = y + h, hx1 = hole.x + hole.w, hy1 = hole.y + hole.h;
+    if (!hole.w || !hole.h || x >= hx1 || x1 <= hole.x || y >= hy1 || y1 <= hole.y) {
+      parts[0] = { (int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h };
+      return 1;
+    }
+    int n = 0;
+    int top = y > hole.y ? y : hole.y, bottom = y1 < hy1 ? y1 : hy1;   // rows beside it
+    n += part(x, y, x1, hole.y, &parts[n]);
+    n += part(x, hy1, x1, y1, &parts[n]);
+    n += part(x, top, hole.x, bottom, &parts[n]);
+    n += part(hx1, top, x1, bottom, &parts[n]);
+    return n;
+  }
+
+ private:
+  static int part(int x0, int y0, int x1, int y1, PanelRect *out) {
+    if (x1 <= x0 || y1 <= y0) return 0;
+    *out = { (int16_t)x0, (int16_t)y0, (int16_t)(x1 - x0), (int16_t)(y1 - y0) };
+    return 1;
+  }
+};
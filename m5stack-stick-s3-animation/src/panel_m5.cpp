@@ -0,0 +1,141 @@
+#include "panel_m5.h"
+#include <string.h>
+
+// Around a hole, each part outside it is the whole block pushed through a
+// clip rectangle: M5GFX sends only the clipped pixels.
+static void clipTo(const PanelRect &part, bool holed) {
+  if (holed) M5.Lcd.setClipRect(part.x, part.y, part.w, part.h);
+}
+
+// Pixels are already in panel order (panel.h): passing them as swap565_t
+// makes M5GFX copy them to SPI without converting each one.
+void M5Panel::pushBlock(int x, int y, int w, int h, const uint16_t *px) {
+  if (muted) return;
+  PanelRect parts[4];
+  int n = visibleParts(x, y, w, h, parts);
+  for (int i = 0; i < n; i++) {
+    clipTo(parts[i], hole.w);
+    M5.Lcd.pushImage(x, y, w, h, (const lgfx::swap565_t *)px);
+    count(parts[i].w, parts[i].h);
+  }
+  if (hole.w) M5.Lcd.clearClipRect();
+}
+
+void M5Panel::pushBlockDMA(int x, int y, int w, int h, const uint16_t *px) {
+  if (muted) return;
+  PanelRect parts[4];
+  int n = visibleParts(x, y, w, h, parts);
+  for (int i = 0; i < n; i++) {
+    clipTo(parts[i], hole.w);
+    M5.Lcd.pushImageDMA(x, y, w, h, (const lgfx::swap565_t *)px);
+    count(parts[i].w, parts[i].h);
+  }
+  if (hole.w) M5.Lcd.clearClipRect();
+}
+
+void M5Panel::fillScreen(uint16_t color) {
+  M5.Lcd.fillScreen(panel_to_rgb565(color));
+  count(width(), height());
+}
+
+// ---- Sprites (internal RAM unless placed in PSRAM), created on first use ----
+bool M5Panel::ensureCanvas() {
+  if (canvasW_ == width() && canvasH_ == height()) return true;
+  canvas_.deleteSprite();
+  canvas_.setPsram(psram_);
+  canvas_.setColorDepth(16);
+  if (!canvas_.createSprite(width(), height())) { canvasW_ = canvasH_ = 0; return false; }
+  canvasW_ = width();
+  canvasH_ = height();
+  return true;
+}
+
+bool M5Panel::ensureSprite(M5Canvas &s, int depth, int w, int h) {
+  int &sw = depth == 1 ? video1W_ : video16W_;
+  int &sh = depth == 1 ? video1H_ : video16H_;
+  if (sw == w && sh == h) return true;
+  s.deleteSprite();
+  s.setPsram(psram_);
+  s.setColorDepth(depth);
+  if (!s.createSprite(w, h)) { sw = sh = 0; return false; }
+  sw = w;
+  sh = h;
+  return true;
+}
+
+bool M5Panel::composeRotateZoom16(const uint16_t *frame, int w, int h, float angle) {
+  if (!ensureCanvas() || !ensureSprite(video16_, 16, w, h)) return false;
+  // 16-bit sprites hold panel-order pixels too
+  memcpy(video16_.getBuffer(), frame, (size_t)w * h * 2);
+  canvas_.fillSprite(TFT_BLACK);
+  video16_.pushRotateZoom(&canvas_, canvasW_ / 2, canvasH_ / 2, angle, 1.0f, 1.0f);
+  return true;
+}
+
+bool M5Panel::composeRotateZoom1bpp(const uint8_t *bits, size_t stride, int w, int h,
+                                    float angle, uint16_t fg, uint16_t bg) {
+  if (!ensureCanvas() || !ensureSprite(video1_, 1, w, h)) return false;
+  // 1-bit sprites are packed MSB-first with (w + 7) / 8 bytes per row
+  memcpy(video1_.getBuffer(), bits, stride * h);
+  fg = panel_to_rgb565(fg);
+  bg = panel_to_rgb565(bg);
+  video1_.setPaletteColor(0, (bg >> 8) & 0xF8, (bg >> 3) & 0xFC, (bg << 3) & 0xF8);
+  video1_.setPaletteColor(1, (fg >> 8) & 0xF8, (fg >> 3) & 0xFC, (fg << 3) & 0xF8);
+  canvas_.fillSprite(TFT_BLACK);
+  video1_.pushRotateZoom(&canvas_, canvasW_ / 2, canvasH_ / 2, angle, 1.0f, 1.0f);
+  return true;
+}
+
+void M5Panel::pushCanvas() {
+  if (muted || !ensureCanvas()) return;
+  PanelRect parts[4];
+  int n = visibleParts(0, 0, canvasW_, canvasH_, parts);
+  for (int i = 0; i < n; i++) {
+    clipTo(parts[i], hole.w);
+    canvas_.pushSprite(&M5.Lcd, 0, 0);
+    count(parts[i].w, parts[i].h);
+  }
+  if (hole.w) M5.Lcd.clearClipRect();
+}
+
+void M5Panel::releaseSprites() {
+  video16_.deleteSprite();
+  video1_.deleteSprite();
+  canvas_.deleteSprite();
+  canvasW_ = canvasH_ = video16W_ = video16H_ = video1W_ = video1H_ = 0;
+}
+
+void M5Panel::placeSprites(bool psram) {
+  if (psram == psram_) return;
+  releaseSprites();
+  psram_ = psram;
+}
+
+size_t M5Panel::spriteBytes() const {
+  return (size_t)canvasW_ * canvasH_ * 2 + (size_t)video16W_ * video16H_ * 2 +
+         (size_t)(video1W_ + 7) / 8 * video1H_;
+}
+
+// ---- Hardware scroll ----
+// The scroll area is the band of the controller's memory rows the panel
+// shows. VSCSAD counts memory rows, which run against the screen axis in
+// the rotations that set MADCTL MY (M5GFX rotations 2 and 3).
+void M5Panel::setScroll(uint16_t offset) {
+  const auto &cfg = M5.Lcd.getPanel()->config();
+  uint16_t lines = cfg.panel_height;
+  offset %= lines;
+  if (((M5.Lcd.getRotation() + cfg.offset_rotation) & 3) >= 2) offset = (lines - offset) % lines;
+  M5.Lcd.startWrite();
+  if (!scrollArea_) {
+    M5.Lcd.writeCommand(0x33);          // VSCRDEF: top fixed, scrolled, bottom fixed rows
+    M5.Lcd.writeData16(cfg.offset_y);
+    M5.Lcd.writeData16(lines);
+    M5.Lcd.writeData16(cfg.memory_height - lines - cfg.offset_y);
+    spiBytes += 7;
+    scrollArea_ = true;
+  }
+  M5.Lcd.writeCommand(0x37);            // VSCSAD: memory row shown first
+  M5.Lcd.writeData16(cfg.offset_y + offset);
+  M5.Lcd.endWrite();
+  spiBytes += SCROLL_OVERHEAD;
+}
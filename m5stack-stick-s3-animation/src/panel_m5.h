@@ -0,0 +1,47 @@
+#pragma once
+#include <M5Unified.h>
+#include "panel.h"
+
+// ---- Panel on the M5 LCD, with the M5GFX sprites of the rotate paths ----
+class M5Panel : public Panel {
+ public:
+  uint16_t width() const override { return M5.Lcd.width(); }
+  uint16_t height() const override { return M5.Lcd.height(); }
+
+  void beginWrite() override { M5.Lcd.startWrite(); }
+  void endWrite() override { M5.Lcd.endWrite(); }
+
+  void pushBlock(int x, int y, int w, int h, const uint16_t *px) override;
+  void pushBlockDMA(int x, int y, int w, int h, const uint16_t *px) override;
+  void waitDMA() override { M5.Lcd.waitDMA(); }
+  bool dmaBusy() override { return M5.Lcd.dmaBusy(); }
+  void fillScreen(uint16_t color) override;
+
+  bool composeRotateZoom16(const uint16_t *frame, int w, int h, float angle) override;
+  bool composeRotateZoom1bpp(const uint8_t *bits, size_t stride, int w, int h,
+                             float angle, uint16_t fg, uint16_t bg) override;
+  void pushCanvas() override;
+  void releaseSprites() override;
+  void placeSprites(bool psram) override;
+  size_t spriteBytes() const override;
+
+  // Along the controller's memory rows: y in portrait, x in landscape
+  ScrollAxis scrollAxis() const override {
+    if (hole.w) return SCROLL_NONE;
+    return (M5.Lcd.getRotation() & 1) ? SCROLL_X : SCROLL_Y;
+  }
+  void setScroll(uint16_t offset) override;
+
+ private:
+  bool ensureCanvas();
+  bool ensureSprite(M5Canvas &s, int depth, int w, int h);
+
+  M5Canvas canvas_;        // full-screen buffer
+  M5Canvas video16_;       // RGB565 video frame
+  M5Canvas video1_;        // 1-bit palette video frame
+  int canvasW_ = 0, canvasH_ = 0;
+  int video16W_ = 0, video16H_ = 0;
+  int video1W_ = 0, video1H_ = 0;
+  bool psram_ = false;
+  bool scrollArea_ = false;  // VSCRDEF sent
+};
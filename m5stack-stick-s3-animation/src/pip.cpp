@@ -0,0 +1,139 @@
+#include "pip.h"
+#include <stdlib.h>
+#include "platform.h"
+
+// ---- Window ----
+void PanelWindow::pushBlock(int x, int y, int w, int h, const uint16_t *px) {
+  if (muted) return;
+  PanelRect hole = parent_.hole;
+  parent_.hole.w = 0;               // the hole is kept for this
+  parent_.pushBlock(rect_.x + x, rect_.y + y, w, h, px);
+  parent_.hole = hole;
+  count(w, h);
+}
+
+void PanelWindow::pushBlockDMA(int x, int y, int w, int h, const uint16_t *px) {
+  if (muted) return;
+  PanelRect hole = parent_.hole;
+  parent_.hole.w = 0;
+  parent_.pushBlockDMA(rect_.x + x, rect_.y + y, w, h, px);
+  parent_.hole = hole;
+  count(w, h);
+}
+
+void PanelWindow::fillScreen(uint16_t color) {
+  uint16_t *line = (uint16_t *)malloc((size_t)rect_.w * 2);
+  if (!line) return;
+  for (int x = 0; x < rect_.w; x++) line[x] = color;
+  for (int y = 0; y < rect_.h; y++) pushBlock(0, y, rect_.w, 1, line);
+  free(line);
+}
+
+// ---- Decode stream ----
+bool DecodeStream::begin(const FileHeader &v) {
+  v_ = v;
+  refs.reset(v.width, v.height);
+  if (!rle_) rle_ = (uint8_t *)malloc(MAX_RLE_SIZE);
+  return rle_ != nullptr;
+}
+
+void DecodeStream::end() {
+  free(rle_);
+  rle_ = nullptr;
+  refs.reset(0, 0);
+}
+
+bool DecodeStream::read(uint32_t idx, size_t *len) {
+  return read_ && idx < v_.total_frames && read_(ctx_, idx, rle_, MAX_RLE_SIZE, len);
+}
+
+uint32_t DecodeStream::keyframe(uint32_t frame) {
+  return find_keyframe(read_, ctx_, frame, rle_, MAX_RLE_SIZE);
+}
+
+uint32_t DecodeStream::seek(uint32_t frame) {
+  uint32_t key = keyframe(frame);
+  if (v_.flags & FLAG_REFS) {
+    refs.reset(v_.width, v_.height);
+    prime_refs(refs, read_, ctx_, key, rle_, MAX_RLE_SIZE);
+  }
+  return key;
+}
+
+void DecodeStream::render(RenderPath *path, Panel &panel, size_t len, RenderParams p) {
+  p.refs = (v_.flags & FLAG_REFS) ? &refs : nullptr;
+  uint32_t t0 = now_us();
+  path->render(rle_, len, p, nullptr);
+  uint32_t us = now_us() - t0;
+  stats.rendered++;
+  if (!panel.muted) stats.shown++;
+  stats.sumUs += us;
+  if (us > stats.maxUs) stats.maxUs = us;
+}
+
+// ---- Inset ----
+static const uint32_t CATCH_UP_FRAMES = 8;     // decoded in a row before looking for a keyframe
+
+bool Inset::begin(Panel &panel, PanelRect rect, const FileHeader &v, FrameReader read,
+                  void *ctx, uint32_t first, float angle) {
+  end();
+  window_ = new PanelWindow(panel, rect);
+  // shrunk to fit, or as it is when it already does
+  static const RenderPathId CANDIDATES[] = { PATH_VECTOR, PATH_SHRINK, PATH_ROW_STRIP };
+  for (RenderPathId id : CANDIDATES) {
+    path_ = new_render_path(id);
+    if (path_->supports(*window_, v, angle)) break;
+    delete path_;
+    path_ = nullptr;
+  }
+  if (!path_ || !stream.begin(v) || !path_->begin(*window_, v)) {
+    end();
+    return false;
+  }
+  stream.attach(read, ctx);
+  stream.stats = StreamStats();
+  parent_ = &panel;
+  panel.hole = rect;
+  angle_ = angle;
+  first_ = first % v.total_frames;
+  next_ = stream.seek(first_);
+  return true;
+}
+
+void Inset::end() {
+  if (parent_) parent_->hole = PanelRect{ 0, 0, 0, 0 };
+  parent_ = nullptr;
+  if (path_) {
+    path_->end();
+    delete path_;
+    path_ = nullptr;
+  }
+  delete window_;
+  window_ = nullptr;
+  stream.end();
+}
+
+bool Inset::show(uint32_t ticks, uint16_t mainFps, uint16_t fg, uint16_t bg) {
+  const FileHeader &v = stream.header();
+  uint32_t fps = v.fps ? v.fps : mainFps;
+  uint32_t target = (first_ + (uint64_t)ticks * fps / (mainFps ? mainFps : fps)) % v.total_frames;
+  if (next_ && target == next_ - 1) return true;          // a slower inset holds its frame
+  // Back (wrapped), or far enough behind that a keyframe may be closer
+  if (target < next_ || (target - next_ > CATCH_UP_FRAMES && stream.keyframe(target) > next_)) {
+    next_ = stream.seek(target);
+  }
+  RenderParams p = { fg, bg, angle_, nullptr, 1, 0.5f, 0.5f };
+  for (; next_ <= target; next_++) {
+    if (!frame(next_, next_ == target, p)) return false;
+  }
+  return true;
+}
+
+bool Inset::frame(uint32_t idx, bool shown, const RenderParams &p) {
+  size_t len;
+  if (!stream.read(idx, &len)) return false;
+  window_->muted = !shown;
+  stream.render(path_, *window_, len, p);
+  window_->muted = false;
+  return true;
+}
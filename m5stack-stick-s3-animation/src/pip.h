@@ -0,0 +1,121 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "bench.h"
+#include "render.h"
+
+// ---- Picture-in-picture: a second video in a corner of the screen ----
+// Each decode stream is share-nothing: its own reader context, frame
+// buffer, reference slots and render path instance. Two streams can
+// interleave on one core, as the player runs them, or decode on two.
+
+// Where the inset goes: the bottom-right 1/PIP_SCALE of a w x h screen
+static const int PIP_SCALE = 3;
+static inline PanelRect pip_rect(uint16_t w, uint16_t h) {
+  int16_t iw = w / PIP_SCALE, ih = h / PIP_SCALE;
+  return PanelRect{ (int16_t)(w - iw), (int16_t)(h - ih), iw, ih };
+}
+
+// ---- A rectangle of another panel, drawn into the parent's hole ----
+// The render paths see a small panel; pushes land in `rect` of the parent
+// and go into its hole (panel.h). No sprites, no hardware scroll.
+class PanelWindow : public Panel {
+ public:
+  PanelWindow(Panel &parent, PanelRect rect) : parent_(parent), rect_(rect) {}
+
+  uint16_t width() const override { return rect_.w; }
+  uint16_t height() const override { return rect_.h; }
+
+  void beginWrite() override { parent_.beginWrite(); }
+  void endWrite() override { parent_.endWrite(); }
+  void pushBlock(int x, int y, int w, int h, const uint16_t *px) override;
+  void pushBlockDMA(int x, int y, int w, int h, const uint16_t *px) override;
+  void waitDMA() override { parent_.waitDMA(); }
+  bool dmaBusy() override { return parent_.dmaBusy(); }
+  void fillScreen(uint16_t color) override;
+
+  bool composeRotateZoom16(const uint16_t *, int, int, float) override { return false; }
+  bool composeRotateZoom1bpp(const uint8_t *, size_t, int, int, float, uint16_t,
+                             uint16_t) override {
+    return false;
+  }
+  void pushCanvas() override {}
+  void releaseSprites() override {}
+  size_t spriteBytes() const override { return 0; }
+
+ private:
+  Panel &parent_;
+  PanelRect rect_;
+};
+
+// ---- One decode stream ----
+struct StreamStats {
+  uint32_t shown = 0;       // frames pushed
+  uint32_t rendered = 0;    // ... and decoded unseen (seeks, catching up)
+  uint64_t sumUs = 0;       // render time over all of them
+  uint32_t maxUs = 0;
+};
+
+class DecodeStream {
+ public:
+  ~DecodeStream() { end(); }
+
+  // Frame buffer (kept across videos) and reference slots for `v`; false on OOM
+  bool begin(const FileHeader &v);
+  void end();
+  // Where read() fetches frames from
+  void attach(FrameReader read, void *ctx) { read_ = read; ctx_ = ctx; }
+
+  const FileHeader &header() const { return v_; }
+  uint8_t *rle() { return rle_; }
+
+  // Frame `idx` into rle(); false on read error
+  bool read(uint32_t idx, size_t *len);
+  // Keyframe to decode from to reach `frame`; seek() also refills the
+  // reference slots for starting there
+  uint32_t keyframe(uint32_t frame);
+  uint32_t seek(uint32_t frame);
+  // Render `len` bytes of rle() through `path` (refs are the stream's own)
+  // and count it; a muted panel counts as unseen.
+  void render(RenderPath *path, Panel &panel, size_t len, RenderParams p);
+
+  RefStore refs;
+  StreamStats stats;
+
+ private:
+  FileHeader v_ = {};
+  FrameReader read_ = nullptr;
+  void *ctx_ = nullptr;
+  uint8_t *rle_ = nullptr;
+};
+
+// ---- The inset: a stream playing in a window through a path of its own ----
+class Inset {
+ public:
+  ~Inset() { end(); }
+
+  // `v` through `read`/`ctx` in `rect` of `panel` from frame `first`, which
+  // becomes the parent's hole. False if no path shows it there (or OOM).
+  bool begin(Panel &panel, PanelRect rect, const FileHeader &v, FrameReader read, void *ctx,
+             uint32_t first, float angle);
+  void end();
+  bool active() const { return window_ != nullptr; }
+
+  // Show the frame `ticks` frames of the main video after the start (at
+  // `mainFps`), decoding the ones in between unseen; wraps at the end.
+  // False on read error.
+  bool show(uint32_t ticks, uint16_t mainFps, uint16_t fg, uint16_t bg);
+
+  const char *pathName() const { return path_ ? path_->name() : "-"; }
+  uint32_t position() const { return next_ ? next_ - 1 : 0; }
+  DecodeStream stream;
+
+ private:
+  bool frame(uint32_t idx, bool shown, const RenderParams &p);
+
+  Panel *parent_ = nullptr;
+  PanelWindow *window_ = nullptr;
+  RenderPath *path_ = nullptr;
+  float angle_ = 0.0f;
+  uint32_t first_ = 0, next_ = 0;      // next frame to decode
+};
@@ -0,0 +1,76 @@
+#include "platform.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+const char *place_name(BufferPlace p) {
+  static const char *const names[PLACE_COUNT] = { "heap", "internal", "dma", "psram" };
+  return p < PLACE_COUNT ? names[p] : "?";
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "logger.h"
+
+uint32_t now_us() { return micros(); }
+
+uint32_t cycle_count() { return ESP.getCycleCount(); }
+
+uint32_t free_heap() { return ESP.getFreeHeap(); }
+
+void *alloc_large(size_t bytes) {
+  void *p = psramFound() ? ps_malloc(bytes) : nullptr;
+  return p ? p : malloc(bytes);
+}
+
+bool place_available(BufferPlace p) {
+  return p != PLACE_PSRAM || psramFound();
+}
+
+void *alloc_in(BufferPlace p, size_t bytes) {
+  switch (p) {
+    case PLACE_INTERNAL: return heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    case PLACE_DMA:      return heap_caps_malloc(bytes, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+    case PLACE_PSRAM:    return psramFound() ? heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM) : nullptr;
+    default:             return malloc(bytes);
+  }
+}
+
+// Report output: queued for the log drain, waiting for room (logger.h)
+void log_printf(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  log_vemit(true, fmt, ap);
+  va_end(ap);
+}
+
+#else
+#include <chrono>
+
+uint32_t now_us() {
+  using namespace std::chrono;
+  static const steady_clock::time_point t0 = steady_clock::now();
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now() - t0).count();
+}
+
+uint32_t cycle_count() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t free_heap() { return 0; }
+
+void *alloc_large(size_t bytes) { return malloc(bytes); }
+
+bool place_available(BufferPlace p) { return p < PLACE_COUNT; }
+
+void *alloc_in(BufferPlace p, size_t bytes) { return malloc(bytes); }
+
+void log_printf(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- Small platform shim shared by device and host builds ----
+
+uint32_t now_us();
+
+// Free-running counter for short measurements: CPU cycles on the device,
+// nanoseconds on the host. Wraps; only differences are meaningful.
+uint32_t cycle_count();
+
+// Free internal heap in bytes (0 where not meaningful, e.g. on the host)
+uint32_t free_heap();
+
+// Big, rarely-touched buffers: PSRAM when present, else the heap. free() it.
+void *alloc_large(size_t bytes);
+
+// ---- Buffer placement (render path buffers, see autotune.h) ----
+enum BufferPlace {
+  PLACE_HEAP,        // plain malloc, wherever the allocator puts it
+  PLACE_INTERNAL,    // internal DRAM
+  PLACE_DMA,         // DMA-capable internal RAM
+  PLACE_PSRAM,       // external PSRAM: roomy, slower, no DMA from it
+  PLACE_COUNT
+};
+
+const char *place_name(BufferPlace p);
+
+// False where the memory doesn't exist (PSRAM on boards without it). The
+// host has one heap and reports every placement, all backed by malloc.
+bool place_available(BufferPlace p);
+
+// `bytes` in `p`, null if they don't fit there. free() it.
+void *alloc_in(BufferPlace p, size_t bytes);
+
+// Report output (bench and tune tables, model lines): never dropped. On the
+// device it goes through the log ring (logger.h), waiting for room.
+void log_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
@@ -0,0 +1,827 @@
+#include "render.h"
+#include <stdlib.h>
+#include <string.h>
+#include "indexed.h"
+#include "platform.h"
+#include "vector.h"
+
+static void addTime(uint32_t *acc, uint32_t since) {
+  *acc += now_us() - since;
+}
+
+// ---- Expand + rotate display rows [y0, y0+rows) from a 1-bpp frame ----
+void compose_strip(const uint8_t *bits, size_t stride, uint16_t srcW, uint16_t srcH,
+                          const QuarterMap &inv, uint16_t *strip, uint16_t dstW,
+                          int y0, int rows, uint16_t fg, uint16_t bg) {
+  for (int r = 0; r < rows; r++) {
+    int dy = y0 + r;
+    // source position of (0, dy) and its step per display x
+    int sx = inv.bx * dy + inv.cx;
+    int sy = inv.by * dy + inv.cy;
+    uint16_t *out = strip + r * dstW;
+    for (int dx = 0; dx < dstW; dx++, sx += inv.ax, sy += inv.ay) {
+      if ((unsigned)sx >= srcW || (unsigned)sy >= srcH) {
+        out[dx] = 0x0000;
+      } else {
+        out[dx] = (bits[sy * stride + (sx >> 3)] & (0x80 >> (sx & 7))) ? fg : bg;
+      }
+    }
+  }
+}
+
+void compose_strip_scaled(const uint8_t *bits, size_t stride, uint16_t bitsW, uint16_t bitsH,
+                          uint16_t mapW, uint16_t mapH, const QuarterMap &inv,
+                          uint16_t *strip, uint16_t dstW, int y0, int rows,
+                          uint16_t fg, uint16_t bg) {
+  for (int r = 0; r < rows; r++) {
+    int sx = inv.bx * (y0 + r) + inv.cx;
+    int sy = inv.by * (y0 + r) + inv.cy;
+    uint16_t *out = strip + r * dstW;
+    for (int dx = 0; dx < dstW; dx++, sx += inv.ax, sy += inv.ay) {
+      if ((unsigned)sx >= mapW || (unsigned)sy >= mapH) {
+        out[dx] = 0x0000;
+        continue;
+      }
+      int bx = sx * bitsW / mapW, by = sy * bitsH / mapH;
+      out[dx] = (bits[by * stride + (bx >> 3)] & (0x80 >> (bx & 7))) ? fg : bg;
+    }
+  }
+}
+
+bool show_thumbnail(Panel &panel, const FileHeader &v, const ThumbTrack &t,
+                    const uint8_t *bits, float angle, uint16_t fg, uint16_t bg) {
+  uint16_t w = panel.width(), h = panel.height();
+  QuarterMap m;
+  if (!quarter_map(angle, v.width, v.height, w, h, &m)) return false;
+  QuarterMap inv = quarter_map_inverse(m);
+  uint16_t *strip = (uint16_t *)malloc((size_t)STRIP_ROWS * w * 2);
+  if (!strip) return false;
+  for (int y0 = 0; y0 < h; y0 += STRIP_ROWS) {
+    int rows = h - y0 < STRIP_ROWS ? h - y0 : STRIP_ROWS;
+    compose_strip_scaled(bits, thumb_stride(t), t.width, t.height, v.width, v.height, inv,
+                         strip, w, y0, rows, fg, bg);
+    panel.pushBlock(0, y0, w, rows, strip);
+  }
+  free(strip);
+  return true;
+}
+
+// ---- Original path: sprite copy + pushRotateZoom ----
+class RotateZoomPath : public RenderPath {
+ public:
+  const char *name() const override { return "rotate-zoom"; }
+
+  bool supports(const Panel &panel, const FileHeader &v, float angle) const override {
+    return !(v.flags & FLAG_VECTOR);
+  }
+
+  bool begin(Panel &panel, const FileHeader &v) override {
+    panel_ = &panel;
+    v_ = v;
+    palette_ = IndexedPalette();
+    panel.placeSprites(place == PLACE_PSRAM);
+    frame_ = (uint16_t *)allocBuffer((size_t)v.width * v.height * 2);
+    return frame_ != nullptr;
+  }
+
+  void end() override {
+    free(frame_);
+    frame_ = nullptr;
+    panel_->releaseSprites();
+  }
+
+  void render(const uint8_t *rle, size_t rleLen, const RenderParams &p, StageTimes *t) override {
+    uint32_t t0 = now_us();
+    decodeFrame(rle, rleLen, p);
+    uint32_t t1 = now_us();
+    panel_->composeRotateZoom16(frame_, v_.width, v_.height, p.angle);
+    uint32_t t2 = now_us();
+    panel_->pushCanvas();
+    if (t) {
+      t->decodeUs += t1 - t0;
+      t->composeUs += t2 - t1;
+      addTime(&t->pushUs, t2);
+    }
+  }
+
+  size_t bufferBytes() const override {
+    return (size_t)v_.width * v_.height * 2 + panel_->spriteBytes();
+  }
+
+  // sprite copy + canvas clear + rotated draw
+  uint32_t composePixels() const override {
+    return (uint32_t)v_.width * v_.height * 2 + (uint32_t)panel_->width() * panel_->height();
+  }
+
+ private:
+  Panel *panel_ = nullptr;
+  FileHeader v_ = {};
+  uint16_t *frame_ = nullptr;
+  uint16_t fg_ = 0, bg_ = 0;      // colours `frame_` is painted in
+  IndexedPalette palette_ = {};   // FLAG_INDEXED files: the current scene's
+
+  void decodeFrame(const uint8_t *rle, size_t rleLen, const RenderParams &p) {
+    if (v_.flags & FLAG_INDEXED) {
+      decode_indexed_to_rgb565(rle, rleLen, frame_, v_.width, v_.height, &palette_);
+      return;
+    }
+    if (const uint8_t *ref = prepareRefs(rle, rleLen, p)) {
+      expand_1bpp_to_rgb565(ref, p.refs->stride(), v_.width, v_.height, frame_, p.fg, p.bg);
+    } else if (frame_is_delta(rle, rleLen) && (p.fg != fg_ || p.bg != bg_)) {
+      recolor_rgb565(frame_, v_.width, v_.height, v_.width, fg_, p.fg, p.bg);
+    }
+    decode_bit_rle_to_rgb565(rle, rleLen, frame_, v_.width, v_.height, p.fg, p.bg);
+    fg_ = p.fg;
+    bg_ = p.bg;
+  }
+};
+
+// ---- Hardware scroll for the paths that hold the whole screen ----
+// When a FRAME_SCROLL delta moves the video along the panel's scroll axis
+// (panel.h), the offset moves instead and only the lines that came into
+// view are pushed. Full pushes go through the current offset too, so the
+// RAM stays rotated until end() puts the offset back.
+class ScrollPush {
+ public:
+  // On an x axis, lines are columns, gathered STRIP_ROWS at a time
+  bool begin(Panel &panel, BufferPlace place) {
+    panel_ = &panel;
+    w_ = panel.width();
+    h_ = panel.height();
+    axis_ = panel.scrollAxis();
+    lines_ = axis_ == Panel::SCROLL_X ? w_ : h_;
+    offset_ = 0;
+    shown_ = false;
+    if (axis_ == Panel::SCROLL_X) cols_ = (uint16_t *)alloc_in(place, (size_t)STRIP_ROWS * h_ * 2);
+    return axis_ != Panel::SCROLL_X || cols_;
+  }
+
+  void end() {
+    if (offset_) panel_->setScroll(0);
+    offset_ = 0;
+    free(cols_);
+    cols_ = nullptr;
+  }
+
+  Panel::ScrollAxis axis() const { return axis_; }
+
+  // Push a whole-screen picture. When it is the last one pushed moved by
+  // (dx, dy) -- what is at p came from p + (dx, dy) -- and that is along the
+  // scroll axis, only the new lines go out.
+  void push(const uint16_t *pic, int dx, int dy) {
+    if (panel_->muted) {              // seeking: the next picture shown goes out whole
+      shown_ = false;
+      return;
+    }
+    int k = axis_ == Panel::SCROLL_X && !dy ? dx : axis_ == Panel::SCROLL_Y && !dx ? dy : 0;
+    if (shown_ && k && k > -lines_ && k < lines_) {
+      offset_ = (offset_ + k + lines_) % lines_;
+      panel_->setScroll(offset_);
+      if (k > 0) pushLines(pic, lines_ - k, k);
+      else pushLines(pic, 0, -k);
+    } else {
+      pushLines(pic, 0, lines_);
+    }
+    shown_ = true;
+  }
+
+  size_t bufferBytes() const { return cols_ ? (size_t)STRIP_ROWS * h_ * 2 : 0; }
+
+ private:
+  // Screen lines [first, first + n) to the RAM lines showing them
+  void pushLines(const uint16_t *pic, int first, int n) {
+    if (!offset_ && n == lines_) {
+      panel_->pushBlock(0, 0, w_, h_, pic);
+      return;
+    }
+    while (n > 0) {
+      int line = (first + offset_) % lines_;
+      int run = n < lines_ - line ? n : lines_ - line;
+      if (axis_ == Panel::SCROLL_Y) {
+        panel_->pushBlock(0, line, w_, run, pic + first * w_);
+      } else {
+        if (run > STRIP_ROWS) run = STRIP_ROWS;
+        for (int y = 0; y < h_; y++) memcpy(cols_ + y * run, pic + y * w_ + first, run * 2);
+        panel_->pushBlock(line, 0, run, h_, cols_);
+      }
+      first += run;
+      n -= run;
+    }
+  }
+
+  Panel *panel_ = nullptr;
+  uint16_t w_ = 0, h_ = 0;
+  Panel::ScrollAxis axis_ = Panel::SCROLL_NONE;
+  int lines_ = 0, offset_ = 0;
+  bool shown_ = false;              // the panel holds the last picture pushed
+  uint16_t *cols_ = nullptr;
+};
+
+// ---- Native profile: frame already matches the panel ----
+class NativePath : public RenderPath {
+ public:
+  const char *name() const override { return "native"; }
+
+  bool supports(const Panel &panel, const FileHeader &v, float angle) const override {
+    return !(v.flags & FLAG_VECTOR) && (v.flags & FLAG_NATIVE) &&
+           v.width == panel.width() && v.height == panel.height();
+  }
+
+  bool begin(Panel &panel, const FileHeader &v) override {
+    panel_ = &panel;
+    v_ = v;
+    palette_ = IndexedPalette();
+    frame_ = (uint16_t *)allocBuffer((size_t)v.width * v.height * 2);
+    if (!frame_ || !scroll_.begin(panel, place)) { end(); return false; }
+    return true;
+  }
+
+  void end() override {
+    free(frame_);
+    frame_ = nullptr;
+    scroll_.end();
+  }
+
+  void render(const uint8_t *rle, size_t rleLen, const RenderParams &p, StageTimes *t) override {
+    uint32_t t0 = now_us();
+    // a recolour repaints the whole picture
+    int dy = p.fg == fg_ && p.bg == bg_ ? frame_scroll(rle, rleLen) : 0;
+    decodeFrame(rle, rleLen, p);
+    uint32_t t1 = now_us();
+    scroll_.push(frame_, 0, dy);
+    if (t) {
+      t->decodeUs += t1 - t0;
+      addTime(&t->pushUs, t1);
+    }
+  }
+
+  size_t bufferBytes() const override {
+    return (size_t)v_.width * v_.height * 2 + scroll_.bufferBytes();
+  }
+  uint32_t composePixels() const override { return 0; }
+
+ private:
+  Panel *panel_ = nullptr;
+  FileHeader v_ = {};
+  uint16_t *frame_ = nullptr;
+  uint16_t fg_ = 0, bg_ = 0;      // colours `frame_` is painted in
+  IndexedPalette palette_ = {};
+  ScrollPush scroll_;
+
+  void decodeFrame(const uint8_t *rle, size_t rleLen, const RenderParams &p) {
+    if (v_.flags & FLAG_INDEXED) {
+      decode_indexed_to_rgb565(rle, rleLen, frame_, v_.width, v_.height, &palette_);
+      return;
+    }
+    if (const uint8_t *ref = prepareRefs(rle, rleLen, p)) {
+      expand_1bpp_to_rgb565(ref, p.refs->stride(), v_.width, v_.height, frame_, p.fg, p.bg);
+    } else if (frame_is_delta(rle, rleLen) && (p.fg != fg_ || p.bg != bg_)) {
+      recolor_rgb565(frame_, v_.width, v_.height, v_.width, fg_, p.fg, p.bg);
+    }
+    decode_bit_rle_to_rgb565(rle, rleLen, frame_, v_.width, v_.height, p.fg, p.bg);
+    fg_ = p.fg;
+    bg_ = p.bg;
+  }
+};
+
+// ---- Decode straight into the rotated canvas ----
+class FusedRotatePath : public RenderPath {
+ public:
+  const char *name() const override { return "fused-rotate"; }
+
+  bool supports(const Panel &panel, const FileHeader &v, float angle) const override {
+    QuarterMap m;
+    return RenderPath::supports(panel, v, angle) &&
+           quarter_map(angle, v.width, v.height, panel.width(), panel.height(), &m);
+  }
+
+  bool begin(Panel &panel, const FileHeader &v) override {
+    panel_ = &panel;
+    v_ = v;
+    w_ = panel.width();
+    h_ = panel.height();
+    canvas_ = (uint16_t *)allocBuffer((size_t)w_ * h_ * 2);
+    if (!canvas_ || !scroll_.begin(panel, place)) { end(); return false; }
+    memset(canvas_, 0, (size_t)w_ * h_ * 2);    // letterbox stays black
+    angle_ = -1.0f;
+    return true;
+  }
+
+  void end() override {
+    free(canvas_);
+    canvas_ = nullptr;
+    scroll_.end();
+  }
+
+  void render(const uint8_t *rle, size_t rleLen, const RenderParams &p, StageTimes *t) override {
+    uint32_t t0 = now_us();
+    // the panel scrolls whole lines, so the video must span the scroll axis
+    bool same = p.angle == angle_ && p.fg == fg_ && p.bg == bg_ && spans_;
+    int dy = same ? frame_scroll(rle, rleLen) : 0;
+    if (p.angle != angle_) {
+      // the old picture is dropped, so this shows garbage until the next keyframe
+      quarter_map(p.angle, v_.width, v_.height, w_, h_, &map_);
+      memset(canvas_, 0, (size_t)w_ * h_ * 2);
+      angle_ = p.angle;
+      int x0, y0, x1, y1;
+      videoRect(&x0, &y0, &x1, &y1);
+      spans_ = scroll_.axis() == Panel::SCROLL_X ? x0 <= 0 && x1 >= w_ - 1
+                                                  : y0 <= 0 && y1 >= h_ - 1;
+    }
+    if (const uint8_t *ref = prepareRefs(rle, rleLen, p)) {
+      expand_1bpp_rotated(ref, p.refs->stride(), v_.width, v_.height, map_, canvas_, w_, h_,
+                          p.fg, p.bg);
+    } else if (frame_is_delta(rle, rleLen) && (p.fg != fg_ || p.bg != bg_)) {
+      recolorVideo(p);
+    }
+    fg_ = p.fg;
+    bg_ = p.bg;
+    decode_bit_rle_rotated(rle, rleLen, v_.width, v_.height, map_, canvas_, w_, h_, p.fg, p.bg);
+    uint32_t t1 = now_us();
+    scroll_.push(canvas_, map_.bx * dy, map_.by * dy);
+    if (t) {
+      t->decodeUs += t1 - t0;      // decode and rotate are one pass here
+      addTime(&t->pushUs, t1);
+    }
+  }
+
+  size_t bufferBytes() const override { return (size_t)w_ * h_ * 2 + scroll_.bufferBytes(); }
+  uint32_t composePixels() const override { return 0; }
+
+ private:
+  Panel *panel_ = nullptr;
+  FileHeader v_ = {};
+  uint16_t w_ = 0, h_ = 0;
+  uint16_t *canvas_ = nullptr;
+  QuarterMap map_ = {};
+  float angle_ = -1.0f;
+  uint16_t fg_ = 0, bg_ = 0;
+  ScrollPush scroll_;
+  bool spans_ = false;            // the video covers the scroll axis
+
+  // Display rectangle of the video, unclipped
+  void videoRect(int *x0, int *y0, int *x1, int *y1) const {
+    *x0 = map_.cx;
+    *y0 = map_.cy;
+    *x1 = map_.ax * (v_.width - 1) + map_.bx * (v_.height - 1) + map_.cx;
+    *y1 = map_.ay * (v_.width - 1) + map_.by * (v_.height - 1) + map_.cy;
+    if (*x0 > *x1) { int t = *x0; *x0 = *x1; *x1 = t; }
+    if (*y0 > *y1) { int t = *y0; *y0 = *y1; *y1 = t; }
+  }
+
+  // Recolour the on-screen part of the video, leaving the letterbox black
+  void recolorVideo(const RenderParams &p) {
+    int x0, y0, x1, y1;
+    videoRect(&x0, &y0, &x1, &y1);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= w_) x1 = w_ - 1;
+    if (y1 >= h_) y1 = h_ - 1;
+    if (x0 > x1 || y0 > y1) return;
+    recolor_rgb565(canvas_ + y0 * w_ + x0, x1 - x0 + 1, y1 - y0 + 1, w_, fg_, p.fg, p.bg);
+  }
+};
+
+// ---- 1-bpp frame, expanded and rotated one strip at a time ----
+class RowStripPath : public RenderPath {
+ public:
+  explicit RowStripPath(bool dma) : dma_(dma) {}
+
+  const char *name() const override { return dma_ ? "dma-pingpong" : "row-strip"; }
+
+  // SPI DMA can't read PSRAM
+  bool placeable(BufferPlace p) const override { return !dma_ || p != PLACE_PSRAM; }
+
+  bool supports(const Panel &panel, const FileHeader &v, float angle) const override {
+    QuarterMap m;
+    return RenderPath::supports(panel, v, angle) &&
+           quarter_map(angle, v.width, v.height, panel.width(), panel.height(), &m);
+  }
+
+  bool begin(Panel &panel, const FileHeader &v) override {
+    panel_ = &panel;
+    v_ = v;
+    w_ = panel.width();
+    h_ = panel.height();
+    stride_ = bitmap_stride(v.width);
+    bits_ = (uint8_t *)allocBuffer(bitmap_bytes(v.width, v.height));
+    for (int i = 0; i < (dma_ ? 2 : 1); i++) {
+      strip_[i] = (uint16_t *)allocBuffer((size_t)w_ * STRIP_ROWS * 2);
+    }
+    if (!bits_ || !strip_[0] || (dma_ && !strip_[1])) { end(); return false; }
+    return true;
+  }
+
+  void end() override {
+    free(bits_);
+    bits_ = nullptr;
+    for (int i = 0; i < 2; i++) { free(strip_[i]); strip_[i] = nullptr; }
+  }
+
+  void render(const uint8_t *rle, size_t rleLen, const RenderParams &p, StageTimes *t) override {
+    uint32_t t0 = now_us();
+    if (const uint8_t *ref = prepareRefs(rle, rleLen, p)) memcpy(bits_, ref, stride_ * v_.height);
+    decode_bit_rle_to_1bpp(rle, rleLen, bits_, v_.width, v_.height, stride_);
+    uint32_t decodeUs = now_us() - t0;
+
+    QuarterMap m;
+    quarter_map(p.angle, v_.width, v_.height, w_, h_, &m);
+    QuarterMap inv = quarter_map_inverse(m);
+
+    uint32_t composeUs = 0, pushUs = 0;
+    if (dma_) panel_->beginWrite();
+    int k = 0;
+    for (int y = 0; y < h_; y += STRIP_ROWS, k ^= 1) {
+      int rows = h_ - y < STRIP_ROWS ? h_ - y : STRIP_ROWS;
+      uint16_t *strip = strip_[dma_ ? k : 0];
+      // with DMA, this overlaps the previous strip's transfer
+      uint32_t c0 = now_us();
+      compose_strip(bits_, stride_, v_.width, v_.height, inv, strip, w_, y, rows, p.fg, p.bg);
+      uint32_t c1 = now_us();
+      composeUs += c1 - c0;
+      if (dma_) {
+        panel_->waitDMA();
+        panel_->pushBlockDMA(0, y, w_, rows, strip);
+      } else {
+        panel_->pushBlock(0, y, w_, rows, strip);
+      }
+      pushUs += now_us() - c1;
+    }
+    if (dma_) {
+      uint32_t w0 = now_us();
+      panel_->waitDMA();
+      panel_->endWrite();
+      pushUs += now_us() - w0;
+    }
+    if (t) {
+      t->decodeUs += decodeUs;
+      t->composeUs += composeUs;
+      t->pushUs += pushUs;
+    }
+  }
+
+  size_t bufferBytes() const override {
+    return stride_ * v_.height + (dma_ ? 2 : 1) * (size_t)w_ * STRIP_ROWS * 2;
+  }
+
+  uint32_t composePixels() const override { return (uint32_t)w_ * h_; }
+
+ private:
+  bool dma_;
+  Panel *panel_ = nullptr;
+  FileHeader v_ = {};
+  uint16_t w_ = 0, h_ = 0;
+  size_t stride_ = 0;
+  uint8_t *bits_ = nullptr;
+  uint16_t *strip_[2] = { nullptr, nullptr };
+};
+
+// ---- 1-bit palette sprite rotated by M5GFX ----
+class Palette1bppPath : public RenderPath {
+ public:
+  const char *name() const override { return "1bpp-palette"; }
+
+  bool begin(Panel &panel, const FileHeader &v) override {
+    panel_ = &panel;
+    v_ = v;
+    stride_ = bitmap_stride(v.width);
+    panel.placeSprites(place == PLACE_PSRAM);
+    bits_ = (uint8_t *)allocBuffer(bitmap_bytes(v.width, v.height));
+    return bits_ != nullptr;
+  }
+
+  void end() override {
+    free(bits_);
+    bits_ = nullptr;
+    panel_->releaseSprites();
+  }
+
+  void render(const uint8_t *rle, size_t rleLen, const RenderParams &p, StageTimes *t) override {
+    uint32_t t0 = now_us();
+    if (const uint8_t *ref = prepareRefs(rle, rleLen, p)) memcpy(bits_, ref, stride_ * v_.height);
+    decode_bit_rle_to_1bpp(rle, rleLen, bits_, v_.width, v_.height, stride_);
+    uint32_t t1 = now_us();
+    panel_->composeRotateZoom1bpp(bits_, stride_, v_.width, v_.height, p.angle, p.fg, p.bg);
+    uint32_t t2 = now_us();
+    panel_->pushCanvas();
+    if (t) {
+      t->decodeUs += t1 - t0;
+      t->composeUs += t2 - t1;
+      addTime(&t->pushUs, t2);
+    }
+  }
+
+  size_t bufferBytes() const override {
+    return stride_ * v_.height + panel_->spriteBytes();
+  }
+
+  // canvas clear + rotated draw (the bitmap is memcpy'd into the sprite)
+  uint32_t composePixels() const override {
+    return (uint32_t)panel_->width() * panel_->height() * 2;
+  }
+
+ private:
+  Panel *panel_ = nullptr;
+  FileHeader v_ = {};
+  size_t stride_ = 0;
+  uint8_t *bits_ = nullptr;
+};
+
+// ---- Zoom + pan: decode only the source rows the view can see ----
+// The view is a (display / zoom) window of the unzoomed picture, so in
+// source space it covers a band of rows. Intra frames and reference deltas
+// decode just that band (plus a margin for panning) through the row index;
+// plain deltas keep updating whatever band was last decoded, since the rows
+// outside it no longer hold the previous picture. Pans past the margin in a
+// delta file show stale rows until the next keyframe.
+class ZoomPath : public RenderPath {
+ public:
+  const char *name() const override { return "zoom"; }
+
+  bool supports(const Panel &panel, const FileHeader &v, float angle) const override {
+    QuarterMap m;
+    return RenderPath::supports(panel, v, angle) &&
+           quarter_map(angle, v.width, v.height, panel.width(), panel.height(), &m);
+  }
+
+  bool begin(Panel &panel, const FileHeader &v) override {
+    panel_ = &panel;
+    v_ = v;
+    w_ = panel.width();
+    h_ = panel.height();
+    stride_ = bitmap_stride(v.width);
+    bits_ = (uint8_t *)allocBuffer(bitmap_bytes(v.width, v.height));
+    strip_ = (uint16_t *)allocBuffer((size_t)w_ * STRIP_ROWS * 2);
+    if (!bits_ || !strip_) { end(); return false; }
+    memset(bits_, 0, stride_ * v.height);
+    validFirst_ = validEnd_ = 0;
+    return true;
+  }
+
+  void end() override {
+    free(bits_);
+    bits_ = nullptr;
+    free(strip_);
+    strip_ = nullptr;
+  }
+
+  void render(const uint8_t *rle, size_t rleLen, const RenderParams &p, StageTimes *t) override {
+    uint32_t t0 = now_us();
+    QuarterMap m;
+    quarter_map(p.angle, v_.width, v_.height, w_, h_, &m);
+    QuarterMap inv = quarter_map_inverse(m);
+    int z = p.zoom > 1 ? p.zoom : 1;
+    int ox, oy;
+    viewOrigin(p, z, &ox, &oy);
+
+    uint16_t first, end;
+    visibleRows(inv, ox, oy, z, &first, &end);
+    if (frame_is_key(rle, rleLen)) {
+      uint16_t margin = (end - first) / 4;
+      validFirst_ = first > margin ? first - margin : 0;
+      validEnd_ = end + margin < v_.height ? end + margin : v_.height;
+    } else if (validFirst_ >= validEnd_) {
+      validFirst_ = 0;               // no keyframe yet: keep the whole picture
+      validEnd_ = v_.height;
+    }
+    if (const uint8_t *ref = prepareRefs(rle, rleLen, p)) memcpy(bits_, ref, stride_ * v_.height);
+    decode_bit_rle_rows_to_1bpp(rle, rleLen, bits_, v_.width, v_.height, stride_,
+                                validFirst_, validEnd_);
+    uint32_t decodeUs = now_us() - t0;
+
+    uint32_t composeUs = 0, pushUs = 0;
+    for (int y = 0; y < h_; y += STRIP_ROWS) {
+      int rows = h_ - y < STRIP_ROWS ? h_ - y : STRIP_ROWS;
+      uint32_t c0 = now_us();
+      composeStrip(inv, ox, oy, z, y, rows, p.fg, p.bg);
+      uint32_t c1 = now_us();
+      composeUs += c1 - c0;
+      panel_->pushBlock(0, y, w_, rows, strip_);
+      pushUs += now_us() - c1;
+    }
+    if (t) {
+      t->decodeUs += decodeUs;
+      t->composeUs += composeUs;
+      t->pushUs += pushUs;
+    }
+  }
+
+  size_t bufferBytes() const override {
+    return bitmap_bytes(v_.width, v_.height) + (size_t)w_ * STRIP_ROWS * 2;
+  }
+
+  uint32_t composePixels() const override { return (uint32_t)w_ * h_; }
+
+ private:
+  // Top-left of the view in unzoomed display pixels, kept on screen
+  void viewOrigin(const RenderParams &p, int z, int *ox, int *oy) const {
+    int vw = w_ / z, vh = h_ / z;
+    int x = (int)(p.panX * w_) - vw / 2;
+    int y = (int)(p.panY * h_) - vh / 2;
+    *ox = x < 0 ? 0 : x > w_ - vw ? w_ - vw : x;
+    *oy = y < 0 ? 0 : y > h_ - vh ? h_ - vh : y;
+  }
+
+  // Source rows under the view: map its corners back through the rotation
+  void visibleRows(const QuarterMap &inv, int ox, int oy, int z,
+                   uint16_t *first, uint16_t *end) const {
+    int x1 = ox + (w_ + z - 1) / z - 1, y1 = oy + (h_ + z - 1) / z - 1;
+    int a = inv.ay * ox + inv.by * oy + inv.cy;
+    int b = inv.ay * x1 + inv.by * y1 + inv.cy;
+    int lo = a < b ? a : b, hi = a < b ? b : a;
+    *first = lo < 0 ? 0 : lo > v_.height ? v_.height : lo;
+    *end = hi + 1 < 0 ? 0 : hi + 1 > v_.height ? v_.height : hi + 1;
+  }
+
+  void composeStrip(const QuarterMap &inv, int ox, int oy, int z, int y0, int rows,
+                    uint16_t fg, uint16_t bg) {
+    for (int r = 0; r < rows; r++) {
+      int vy = oy + (y0 + r) / z;
+      uint16_t *out = strip_ + r * w_;
+      int sx = inv.ax * ox + inv.bx * vy + inv.cx;
+      int sy = inv.ay * ox + inv.by * vy + inv.cy;
+      // each source pixel covers z display pixels
+      for (int dx = 0; dx < w_; sx += inv.ax, sy += inv.ay) {
+        uint16_t c = 0x0000;
+        if ((unsigned)sx < v_.width && (unsigned)sy < v_.height) {
+          c = (bits_[sy * stride_ + (sx >> 3)] & (0x80 >> (sx & 7))) ? fg : bg;
+        }
+        for (int k = 0; k < z && dx < w_; k++) out[dx++] = c;
+      }
+    }
+  }
+
+  Panel *panel_ = nullptr;
+  FileHeader v_ = {};
+  uint16_t w_ = 0, h_ = 0;
+  size_t stride_ = 0;
+  uint8_t *bits_ = nullptr;
+  uint16_t *strip_ = nullptr;
+  uint16_t validFirst_ = 0, validEnd_ = 0;   // rows holding the current picture
+};
+
+// ---- Videos bigger than the panel: 1-bpp frame shrunk into strips ----
+// For picture-in-picture, where the panel is a small window of the real
+// one (pip.h): the video is shrunk by the smallest whole factor that fits
+// it, nearest neighbour. Videos that fit take the other paths.
+class ShrinkPath : public RenderPath {
+ public:
+  const char *name() const override { return "shrink"; }
+  bool insetOnly() const override { return true; }
+
+  bool supports(const Panel &panel, const FileHeader &v, float angle) const override {
+    QuarterMap m;
+    return RenderPath::supports(panel, v, angle) &&
+           quarter_map(angle, v.width, v.height, panel.width(), panel.height(), &m) &&
+           factor(m, v, panel.width(), panel.height()) > 1;
+  }
+
+  bool begin(Panel &panel, const FileHeader &v) override {
+    panel_ = &panel;
+    v_ = v;
+    w_ = panel.width();
+    h_ = panel.height();
+    stride_ = bitmap_stride(v.width);
+    bits_ = (uint8_t *)allocBuffer(bitmap_bytes(v.width, v.height));
+    strip_ = (uint16_t *)allocBuffer((size_t)w_ * STRIP_ROWS * 2);
+    if (!bits_ || !strip_) { end(); return false; }
+    return true;
+  }
+
+  void end() override {
+    free(bits_);
+    bits_ = nullptr;
+    free(strip_);
+    strip_ = nullptr;
+  }
+
+  void render(const uint8_t *rle, size_t rleLen, const RenderParams &p, StageTimes *t) override {
+    uint32_t t0 = now_us();
+    if (const uint8_t *ref = prepareRefs(rle, rleLen, p)) memcpy(bits_, ref, stride_ * v_.height);
+    decode_bit_rle_to_1bpp(rle, rleLen, bits_, v_.width, v_.height, stride_);
+    uint32_t decodeUs = now_us() - t0;
+
+    // the map places the shrunk picture; samples come from the full one
+    QuarterMap m;
+    quarter_map(p.angle, v_.width, v_.height, w_, h_, &m);
+    int k = factor(m, v_, w_, h_);
+    uint16_t sw = (v_.width + k - 1) / k, sh = (v_.height + k - 1) / k;
+    quarter_map(p.angle, sw, sh, w_, h_, &m);
+    QuarterMap inv = quarter_map_inverse(m);
+
+    uint32_t composeUs = 0, pushUs = 0;
+    for (int y = 0; y < h_; y += STRIP_ROWS) {
+      int rows = h_ - y < STRIP_ROWS ? h_ - y : STRIP_ROWS;
+      uint32_t c0 = now_us();
+      compose_strip_scaled(bits_, stride_, v_.width, v_.height, sw, sh, inv, strip_, w_, y, rows,
+                           p.fg, p.bg);
+      uint32_t c1 = now_us();
+      composeUs += c1 - c0;
+      panel_->pushBlock(0, y, w_, rows, strip_);
+      pushUs += now_us() - c1;
+    }
+    if (t) {
+      t->decodeUs += decodeUs;
+      t->composeUs += composeUs;
+      t->pushUs += pushUs;
+    }
+  }
+
+  size_t bufferBytes() const override {
+    return bitmap_bytes(v_.width, v_.height) + (size_t)w_ * STRIP_ROWS * 2;
+  }
+
+  uint32_t composePixels() const override { return (uint32_t)w_ * h_; }
+
+ private:
+  // Smallest whole factor the turned video fits the panel at
+  static int factor(const QuarterMap &m, const FileHeader &v, uint16_t w, uint16_t h) {
+    int dw = m.ax ? v.width : v.height, dh = m.ax ? v.height : v.width;
+    int kx = (dw + w - 1) / w, ky = (dh + h - 1) / h;
+    return kx > ky ? kx : ky;
+  }
+
+  Panel *panel_ = nullptr;
+  FileHeader v_ = {};
+  uint16_t w_ = 0, h_ = 0;
+  size_t stride_ = 0;
+  uint8_t *bits_ = nullptr;
+  uint16_t *strip_ = nullptr;
+};
+
+// ---- Vector outlines: polygons filled straight into the display canvas ----
+// Any angle and zoom; the picture is rasterized at display resolution.
+class VectorPath : public RenderPath {
+ public:
+  const char *name() const override { return "vector"; }
+
+  bool supports(const Panel &panel, const FileHeader &v, float angle) const override {
+    return (v.flags & FLAG_VECTOR) != 0;
+  }
+
+  bool begin(Panel &panel, const FileHeader &v) override {
+    panel_ = &panel;
+    v_ = v;
+    w_ = panel.width();
+    h_ = panel.height();
+    canvas_ = (uint16_t *)allocBuffer((size_t)w_ * h_ * 2);
+    if (!canvas_ || !raster_.begin()) { end(); return false; }
+    return true;
+  }
+
+  void end() override {
+    free(canvas_);
+    canvas_ = nullptr;
+    raster_.end();
+  }
+
+  void render(const uint8_t *rle, size_t rleLen, const RenderParams &p, StageTimes *t) override {
+    uint32_t t0 = now_us();
+    VectorXform x = vector_xform(p.angle, v_.width, v_.height, w_, h_, p.zoom, p.panX, p.panY);
+    raster_.fill(rle, rleLen, x, canvas_, w_, h_, p.fg, p.bg);
+    uint32_t t1 = now_us();
+    panel_->pushBlock(0, 0, w_, h_, canvas_);
+    if (t) {
+      t->decodeUs += t1 - t0;
+      addTime(&t->pushUs, t1);
+    }
+  }
+
+  size_t bufferBytes() const override {
+    return (size_t)w_ * h_ * 2 + raster_.bufferBytes();
+  }
+
+  uint32_t composePixels() const override { return 0; }
+
+ private:
+  Panel *panel_ = nullptr;
+  FileHeader v_ = {};
+  uint16_t w_ = 0, h_ = 0;
+  uint16_t *canvas_ = nullptr;
+  VectorRaster raster_;
+};
+
+// ---- Registry ----
+// Paths keep all their state in the instance; only the sprite paths share
+// the panel's sprites, so they are one per panel.
+RenderPath *new_render_path(RenderPathId id) {
+  switch (id) {
+    case PATH_ROTATE_ZOOM:  return new RotateZoomPath;
+    case PATH_NATIVE:       return new NativePath;
+    case PATH_FUSED_ROTATE: return new FusedRotatePath;
+    case PATH_ROW_STRIP:    return new RowStripPath(false);
+    case PATH_PALETTE_1BPP: return new Palette1bppPath;
+    case PATH_DMA_PINGPONG: return new RowStripPath(true);
+    case PATH_ZOOM:         return new ZoomPath;
+    case PATH_VECTOR:       return new VectorPath;
+    case PATH_SHRINK:       return new ShrinkPath;
+    default:                return nullptr;
+  }
+}
+
+RenderPath *render_path(RenderPathId id) {
+  static RenderPath *paths[PATH_COUNT] = {};
+  if (id < 0 || id >= PATH_COUNT) return nullptr;
+  if (!paths[id]) paths[id] = new_render_path(id);
+  return paths[id];
+}
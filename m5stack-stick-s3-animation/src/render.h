@@ -0,0 +1,116 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "codec.h"
+#include "panel.h"
+#include "platform.h"
+
+// ---- Render paths: bit-RLE frame in, pixels on the panel out ----
+
+struct RenderParams {
+  uint16_t fg;       // colour of 1-bits, panel byte order (swapped already when inverted)
+  uint16_t bg;
+  float angle;       // clockwise rotation of the video on the display
+  RefStore *refs;    // long-term reference slots, null if the file has none
+  uint8_t zoom;      // PATH_ZOOM magnification; 0/1 shows the whole picture
+  float panX, panY;  // centre of the zoomed view, 0..1 across the display
+};
+
+struct StageTimes {
+  uint32_t decodeUs = 0;
+  uint32_t composeUs = 0;   // copy/rotate/expand into what gets pushed
+  uint32_t pushUs = 0;      // SPI transfer (or waiting for DMA)
+};
+
+class RenderPath {
+ public:
+  virtual ~RenderPath() {}
+  virtual const char *name() const = 0;
+
+  // False if the path can't show this video at this angle on `panel`.
+  // Only PATH_VECTOR takes FLAG_VECTOR files, and only the paths that
+  // decode to RGB565 (rotate-zoom, native) take FLAG_INDEXED ones.
+  virtual bool supports(const Panel &panel, const FileHeader &v, float angle) const {
+    return !(v.flags & (FLAG_VECTOR | FLAG_INDEXED));
+  }
+
+  // True for paths only picture-in-picture insets use (pip.h): never picked
+  // or tuned for the main video, nor in its checks and predictions.
+  virtual bool insetOnly() const { return false; }
+
+  // Allocate buffers; false on OOM.
+  virtual bool begin(Panel &panel, const FileHeader &v) = 0;
+  virtual void end() = 0;
+
+  // `t` may be null when nobody is measuring.
+  virtual void render(const uint8_t *rle, size_t rleLen,
+                      const RenderParams &p, StageTimes *t) = 0;
+
+  // Where begin() puts the path's buffers (sprites: PSRAM or not); set it
+  // before begin(). False from placeable() if the path can't work from there.
+  BufferPlace place = PLACE_HEAP;
+  virtual bool placeable(BufferPlace p) const { return true; }
+
+  // Bytes of frame/strip/sprite buffers this path holds while active.
+  virtual size_t bufferBytes() const = 0;
+
+  // Pixels written per frame after decode (sprite copies, rotation,
+  // strip expansion); feeds the cost model.
+  virtual uint32_t composePixels() const = 0;
+
+ protected:
+  // Keeps FRAME_STORE pictures and returns the picture a FRAME_REF frame is
+  // XORed onto (null for other frames); the path loads it into its state.
+  static const uint8_t *prepareRefs(const uint8_t *rle, size_t rleLen, const RenderParams &p) {
+    if (!p.refs) return nullptr;
+    p.refs->store(rle, rleLen);
+    return p.refs->reference(rle, rleLen);
+  }
+
+  void *allocBuffer(size_t bytes) const { return alloc_in(place, bytes); }
+};
+
+enum RenderPathId {
+  PATH_ROTATE_ZOOM,    // decode → sprite → pushRotateZoom into canvas → push canvas (+ indexed)
+  PATH_NATIVE,         // decode → push 1:1 (native-profile files, + indexed)
+  PATH_FUSED_ROTATE,   // decode straight into the rotated canvas → push canvas
+  PATH_ROW_STRIP,      // decode to 1-bpp → expand+rotate strip by strip → push strips
+  PATH_PALETTE_1BPP,   // decode to 1-bit palette sprite → pushRotateZoom → push canvas
+  PATH_DMA_PINGPONG,   // row-strip with two strip buffers, pushed by DMA
+  PATH_ZOOM,           // decode the visible rows only → scale + rotate strips → push
+  PATH_VECTOR,         // scanline-fill polygon outlines into the canvas → push (FLAG_VECTOR)
+  PATH_SHRINK,         // decode to 1-bpp → shrink + rotate strips → push (PiP insets)
+  PATH_COUNT
+};
+
+// The player's instance of each path (bench, tune and playback share them)
+RenderPath *render_path(RenderPathId id);
+
+// A path of its own, for a second decode stream (pip.h); delete it
+RenderPath *new_render_path(RenderPathId id);
+
+// ---- Strips (row-strip, dma-pingpong, zoom, the cooperative player) ----
+static const uint16_t STRIP_ROWS = 16;      // 240 x 16 x 2 = 7.5 KB per strip
+
+// Expand + rotate display rows [y0, y0+rows) of a 1-bpp frame into `strip`
+// (dstW pixels per row) through the inverse quarter map `inv`; black
+// outside the video.
+void compose_strip(const uint8_t *bits, size_t stride, uint16_t srcW, uint16_t srcH,
+                   const QuarterMap &inv, uint16_t *strip, uint16_t dstW,
+                   int y0, int rows, uint16_t fg, uint16_t bg);
+
+// Same, with `inv` mapping the display onto a mapW x mapH picture that the
+// bitsW x bitsH `bits` are sampled into, nearest neighbour (thumbnails
+// scaled up, PiP insets shrunk)
+void compose_strip_scaled(const uint8_t *bits, size_t stride, uint16_t bitsW, uint16_t bitsH,
+                          uint16_t mapW, uint16_t mapH, const QuarterMap &inv,
+                          uint16_t *strip, uint16_t dstW, int y0, int rows,
+                          uint16_t fg, uint16_t bg);
+
+// ---- Scrub preview ----
+// Show thumbnail `bits` (FLAG_THUMBS track `t`) scaled up to where the
+// video sits on screen at `angle`, nearest neighbour, in STRIP_ROWS strips.
+// The panel's scroll offset must be 0 (no path running, or one just begun).
+// False if the angle isn't a quarter turn or the strip doesn't fit.
+bool show_thumbnail(Panel &panel, const FileHeader &v, const ThumbTrack &t,
+                    const uint8_t *bits, float angle, uint16_t fg, uint16_t bg);
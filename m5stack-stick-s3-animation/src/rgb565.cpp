@@ -0,0 +1,145 @@
+#include "rgb565.h"
+
+// Runs shorter than this are written pixel by pixel: the word loop's
+// alignment head and tail would cost more than they save.
+static const size_t MIN_WORD_RUN = 8;
+
+// ---- Portable ----
+void fill565_portable(uint16_t *dst, uint16_t color, size_t n) {
+  if (n < MIN_WORD_RUN) {
+    while (n--) *dst++ = color;
+    return;
+  }
+  if ((uintptr_t)dst & 2) { *dst++ = color; n--; }
+  uint32_t c2 = color * 0x00010001u;     // same in both halves: no byte-order concern
+  uint32_t *w = (uint32_t *)dst;
+  for (size_t i = n >> 1; i; i--) *w++ = c2;
+  if (n & 1) *(uint16_t *)w = color;
+}
+
+void xor565_portable(uint16_t *dst, uint16_t flip, size_t n) {
+  if (n < MIN_WORD_RUN) {
+    while (n--) *dst++ ^= flip;
+    return;
+  }
+  if ((uintptr_t)dst & 2) { *dst++ ^= flip; n--; }
+  uint32_t f2 = flip * 0x00010001u;
+  uint32_t *w = (uint32_t *)dst;
+  for (size_t i = n >> 1; i; i--) *w++ ^= f2;
+  if (n & 1) *(uint16_t *)w ^= flip;
+}
+
+// ---- Dither pattern rows ----
+// The four colours of a pattern row become two words (pixel pairs), stored
+// alternately; the same loop serves every target.
+static inline uint32_t pair565(uint16_t first, uint16_t second) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return (uint32_t)first << 16 | second;
+#else
+  return (uint32_t)second << 16 | first;
+#endif
+}
+
+void pattern565(uint16_t *dst, uint8_t row, unsigned phase, size_t n, uint16_t fg, uint16_t bg) {
+  uint16_t c[4];                     // colour of dst[i] for i & 3
+  for (unsigned i = 0; i < 4; i++) c[i] = (row & (0x8 >> ((phase + i) & 3))) ? fg : bg;
+  if (n < MIN_WORD_RUN) {
+    for (size_t i = 0; i < n; i++) dst[i] = c[i & 3];
+    return;
+  }
+  unsigned at = 0;
+  if ((uintptr_t)dst & 2) { *dst++ = c[at++]; n--; }
+  uint32_t w0 = pair565(c[at], c[(at + 1) & 3]), w1 = pair565(c[(at + 2) & 3], c[(at + 3) & 3]);
+  uint32_t *w = (uint32_t *)dst;
+  for (size_t i = n >> 2; i; i--, w += 2) {
+    w[0] = w0;
+    w[1] = w1;
+  }
+  dst = (uint16_t *)w;
+  for (size_t i = 0; i < (n & 3); i++) dst[i] = c[(at + i) & 3];
+}
+
+#if defined(__XTENSA__) && defined(RGB565_ASM)
+// ---- Xtensa LX6 (opt-in: -DRGB565_ASM, not yet verified on a device) ----
+// LX6 has no 64-bit stores, so the loops are unrolled over 32-bit ones
+// instead. `loopgtz` skips the body when the count is 0. It also
+// overwrites LBEG/LEND/LCOUNT, which GCC has no clobber names for, so each
+// block saves them first and restores them (then `isync`) on the way out,
+// leaving any zero-overhead loop of the compiler's around it intact. Not
+// yet the default: run `kernels` on the device with this build first.
+void fill565(uint16_t *dst, uint16_t color, size_t n) {
+  if (n < MIN_WORD_RUN) {
+    while (n--) *dst++ = color;
+    return;
+  }
+  if ((uintptr_t)dst & 2) { *dst++ = color; n--; }
+  uint32_t c2 = color * 0x00010001u;
+  uint32_t *w = (uint32_t *)dst;
+  size_t words = n >> 1;
+  uint32_t blocks = words >> 2;
+  uint32_t lb, le, lc;
+  __asm__ volatile(
+      "rsr %[lb], lbeg\n\t"
+      "rsr %[le], lend\n\t"
+      "rsr %[lc], lcount\n\t"
+      "loopgtz %[blocks], 1f\n\t"
+      "s32i %[c], %[w], 0\n\t"
+      "s32i %[c], %[w], 4\n\t"
+      "s32i %[c], %[w], 8\n\t"
+      "s32i %[c], %[w], 12\n\t"
+      "addi %[w], %[w], 16\n"
+      "1:\n\t"
+      "wsr %[lc], lcount\n\t"
+      "wsr %[lb], lbeg\n\t"
+      "wsr %[le], lend\n\t"
+      "isync\n"
+      : [w] "+a"(w), [lb] "=&a"(lb), [le] "=&a"(le), [lc] "=&a"(lc)
+      : [blocks] "a"(blocks), [c] "a"(c2)
+      : "memory");
+  for (words &= 3; words; words--) *w++ = c2;
+  if (n & 1) *(uint16_t *)w = color;
+}
+
+void xor565(uint16_t *dst, uint16_t flip, size_t n) {
+  if (n < MIN_WORD_RUN) {
+    while (n--) *dst++ ^= flip;
+    return;
+  }
+  if ((uintptr_t)dst & 2) { *dst++ ^= flip; n--; }
+  uint32_t f2 = flip * 0x00010001u;
+  uint32_t *w = (uint32_t *)dst;
+  size_t words = n >> 1;
+  uint32_t blocks = words >> 1;
+  uint32_t t0, t1, lb, le, lc;
+  __asm__ volatile(
+      "rsr %[lb], lbeg\n\t"
+      "rsr %[le], lend\n\t"
+      "rsr %[lc], lcount\n\t"
+      "loopgtz %[blocks], 1f\n\t"
+      "l32i %[t0], %[w], 0\n\t"
+      "l32i %[t1], %[w], 4\n\t"
+      "xor %[t0], %[t0], %[f]\n\t"
+      "xor %[t1], %[t1], %[f]\n\t"
+      "s32i %[t0], %[w], 0\n\t"
+      "s32i %[t1], %[w], 4\n\t"
+      "addi %[w], %[w], 8\n"
+      "1:\n\t"
+      "wsr %[lc], lcount\n\t"
+      "wsr %[lb], lbeg\n\t"
+      "wsr %[le], lend\n\t"
+      "isync\n"
+      : [w] "+a"(w), [t0] "=&a"(t0), [t1] "=&a"(t1), [lb] "=&a"(lb), [le] "=&a"(le),
+        [lc] "=&a"(lc)
+      : [blocks] "a"(blocks), [f] "a"(f2)
+      : "memory");
+  if (words & 1) *w++ ^= f2;
+  if (n & 1) *(uint16_t *)w ^= flip;
+}
+
+bool rgb565_kernels_native() { return true; }
+
+#else
+void fill565(uint16_t *dst, uint16_t color, size_t n) { fill565_portable(dst, color, n); }
+void xor565(uint16_t *dst, uint16_t flip, size_t n) { xor565_portable(dst, flip, n); }
+bool rgb565_kernels_native() { return false; }
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- RGB565 run kernels ----
+// What the RGB565 decoders spend their time in: filling a run of pixels
+// with one colour (intra frames) or XORing it with fg^bg (delta frames).
+//
+// fill565/xor565 are the kernels the decoders use: the portable versions
+// (plain C++ word stores) unless the build defines RGB565_ASM, which on
+// Xtensa (ESP32) swaps in hand-written zero-overhead `loopgtz` loops of
+// aligned 32-bit loads/stores, 8 pixels per iteration for fills and 4 for
+// XORs. The portable versions are the reference for the Xtensa ones.
+
+void fill565(uint16_t *dst, uint16_t color, size_t n);
+void xor565(uint16_t *dst, uint16_t flip, size_t n);
+
+void fill565_portable(uint16_t *dst, uint16_t color, size_t n);
+void xor565_portable(uint16_t *dst, uint16_t flip, size_t n);
+
+// True when fill565/xor565 are the Xtensa kernels
+bool rgb565_kernels_native();
+
+// Dither pattern run: dst[i] gets fg where bit 0x8 >> ((phase + i) & 3) of
+// `row` is set, bg elsewhere (portable word stores on every target)
+void pattern565(uint16_t *dst, uint8_t row, unsigned phase, size_t n, uint16_t fg, uint16_t bg);
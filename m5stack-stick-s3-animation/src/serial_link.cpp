@@ -0,0 +1,112 @@
+#include "serial_link.h"
+#include <Arduino.h>
+
+uint16_t link_crc16(const uint8_t *data, size_t len, uint16_t crc) {
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+void link_send(Stream &s, uint8_t type, uint8_t seq,
+               const uint8_t *payload, uint16_t len) {
+  uint8_t hdr[LINK_HEADER_SIZE] = {
+    LINK_SYNC0, LINK_SYNC1, type, seq, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8)
+  };
+  uint16_t crc = link_crc16(hdr + 2, 4);
+  crc = link_crc16(payload, len, crc);
+  uint8_t tail[2] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+  s.write(hdr, sizeof(hdr));
+  if (len) s.write(payload, len);
+  s.write(tail, sizeof(tail));
+}
+
+// Collect printable text outside packets; true when a line ends.
+bool LinkParser::textByte(uint8_t b) {
+  if (b == '\r' || b == '\n') {
+    if (!lineLen_) return false;
+    line_[lineLen_] = 0;
+    lineLen_ = 0;
+    return true;
+  }
+  if (b >= 0x20 && b < 0x7F && lineLen_ < sizeof(line_) - 1) line_[lineLen_++] = b;
+  else lineLen_ = 0;                  // binary noise: drop the partial line
+  return false;
+}
+
+size_t LinkParser::consume(const uint8_t *data, size_t n, Result *res) {
+  *res = NONE;
+  size_t i = 0;
+  while (i < n) {
+    uint8_t b = data[i];
+    switch (state_) {
+      case S_SYNC0:
+        i++;
+        if (b == LINK_SYNC0) {
+          state_ = S_SYNC1;
+          lineLen_ = 0;
+          break;
+        }
+        skippedBytes++;
+        if (textByte(b)) {
+          *res = LINE;
+          return i;
+        }
+        break;
+      case S_SYNC1:
+        if (b == LINK_SYNC1) {
+          state_ = S_TYPE;
+        } else if (b != LINK_SYNC0) {
+          skippedBytes += 2;
+          state_ = S_SYNC0;
+        } else {
+          skippedBytes++;
+        }
+        i++;
+        break;
+      case S_TYPE: type_ = b; state_ = S_SEQ; i++; break;
+      case S_SEQ:  seq_ = b;  state_ = S_LEN0; i++; break;
+      case S_LEN0: len_ = b;  state_ = S_LEN1; i++; break;
+      case S_LEN1:
+        len_ |= (uint16_t)b << 8;
+        i++;
+        if (len_ > cap_) {          // can't be a real packet: resync
+          skippedBytes += LINK_HEADER_SIZE;
+          state_ = S_SYNC0;
+          break;
+        }
+        got_ = 0;
+        state_ = len_ ? S_PAYLOAD : S_CRC0;
+        break;
+      case S_PAYLOAD: {
+        size_t take = n - i;
+        if (take > (size_t)(len_ - got_)) take = len_ - got_;
+        memcpy(buf_ + got_, data + i, take);
+        got_ += take;
+        i += take;
+        if (got_ == len_) state_ = S_CRC0;
+        break;
+      }
+      case S_CRC0: crc_ = b; state_ = S_CRC1; i++; break;
+      case S_CRC1: {
+        crc_ |= (uint16_t)b << 8;
+        i++;
+        state_ = S_SYNC0;
+        uint8_t hdr[4] = { type_, seq_, (uint8_t)(len_ & 0xFF), (uint8_t)(len_ >> 8) };
+        uint16_t crc = link_crc16(hdr, 4);
+        crc = link_crc16(buf_, len_, crc);
+        if (crc == crc_) {
+          *res = PACKET;
+        } else {
+          crcErrors++;
+          *res = CRC_ERROR;
+        }
+        return i;
+      }
+    }
+  }
+  return i;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+class Stream;
+
+// ---- Framed serial link (host <-> device) ----
+//
+// Packet layout (both directions):
+//   uint8   0xA5, 0x5A        -- sync
+//   uint8   type
+//   uint8   seq               -- per-direction sequence number, wraps at 256
+//   uint16  len               -- payload length (LE)
+//   uint8   payload[len]
+//   uint16  crc               -- CRC-16/CCITT-FALSE over type..payload (LE)
+//
+// Anything between packets (e.g. Serial.printf log lines) is skipped by the
+// parser, so logging and data can share the same UART. Host -> device text
+// lines (typed into a serial monitor) are handed out as commands.
+
+static const uint8_t LINK_SYNC0 = 0xA5;
+static const uint8_t LINK_SYNC1 = 0x5A;
+static const size_t LINK_HEADER_SIZE = 6;   // sync + type + seq + len
+static const size_t LINK_OVERHEAD = LINK_HEADER_SIZE + 2;
+
+enum LinkPacketType : uint8_t {
+  // host -> device
+  PKT_HELLO  = 0x01,   // uint8 mode [, uint32 baud]; starts a new session
+  PKT_HEADER = 0x02,   // FileHeader (12 bytes)
+  PKT_FRAME  = 0x03,   // one encoded frame
+  PKT_END    = 0x04,   // end of stream
+  PKT_UP_BEGIN = 0x05, // uint32 new size, uint32 chunk size
+  PKT_UP_CHUNK = 0x06, // uint32 chunk index, chunk data
+  PKT_UP_END   = 0x07, // uint32 final size, uint64 FNV-1a of the whole file
+  // device -> host
+  PKT_READY  = 0x81,   // uint32 buffer bytes, uint16 max payload
+  PKT_CREDIT = 0x82,   // uint8 next seq, uint32 credit limit, uint16 frames, uint32 bytes
+  PKT_NAK    = 0x83,   // uint8 next expected seq
+  PKT_UP_HASHES = 0x84, // uint32 old size, uint32 first chunk, uint16 n, uint64 hash[n]
+  PKT_UP_DONE   = 0x85, // uint8 ok, uint64 FNV-1a of the file as written
+};
+
+enum LinkMode : uint8_t {
+  LINK_MODE_STREAM = 1,
+  LINK_MODE_UPLOAD = 2,
+};
+
+uint16_t link_crc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
+
+// Write one packet to the stream.
+void link_send(Stream &s, uint8_t type, uint8_t seq,
+               const uint8_t *payload, uint16_t len);
+
+class LinkParser {
+ public:
+  enum Result { NONE, PACKET, CRC_ERROR, LINE };
+
+  LinkParser(uint8_t *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  // Consume bytes until a packet completes or input runs out.
+  // Returns the number of bytes consumed; *res tells whether a packet
+  // (or a corrupted one, or a text line) ended at that point.
+  size_t consume(const uint8_t *data, size_t n, Result *res);
+
+  void reset() { state_ = S_SYNC0; }
+
+  uint8_t type() const { return type_; }
+  uint8_t seq() const { return seq_; }
+  uint16_t length() const { return len_; }
+  const uint8_t *payload() const { return buf_; }
+  const char *line() const { return line_; }     // valid after LINE
+
+  uint32_t crcErrors = 0;
+  uint32_t skippedBytes = 0;   // bytes outside packets (noise, log text)
+
+ private:
+  enum State { S_SYNC0, S_SYNC1, S_TYPE, S_SEQ, S_LEN0, S_LEN1, S_PAYLOAD, S_CRC0, S_CRC1 };
+  uint8_t *buf_;
+  size_t cap_;
+  State state_ = S_SYNC0;
+  uint8_t type_ = 0, seq_ = 0;
+  uint16_t len_ = 0, got_ = 0, crc_ = 0;
+  char line_[32] = {};
+  uint8_t lineLen_ = 0;
+
+  bool textByte(uint8_t b);
+};
@@ -0,0 +1,216 @@
+#include "upload_rx.h"
+#include <LittleFS.h>
+#include <unistd.h>
+
+static File oldFile;                   // the current video, read for hashes and copies
+static File newFile;                   // the replacement, written front to back
+static char upPath[64];
+static char tmpPath[72];               // upPath + ".new"
+static char partPath[72];              // upPath + ".part": patched half way
+static bool upActive = false;
+static bool inPlace = false;           // no room for a copy: patch upPath itself
+static uint32_t upOldSize = 0;
+static uint32_t upNewSize = 0;
+static uint32_t upChunk = UPLOAD_CHUNK;
+static uint32_t nextChunk = 0;         // first chunk not yet in newFile
+
+// ---- Write coalescing ----
+static uint8_t *writeBuf = nullptr;
+static size_t writeLen = 0;
+
+static uint32_t chunksWritten = 0;
+static uint32_t chunksCopied = 0;
+static uint32_t flashWrites = 0;
+static uint32_t flashBytes = 0;
+
+uint64_t fnv1a64(const uint8_t *data, size_t len, uint64_t h) {
+  for (size_t i = 0; i < len; i++) {
+    h ^= data[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static bool flushWrites() {
+  if (!writeLen) return true;
+  bool ok = newFile.write(writeBuf, writeLen) == writeLen;
+  flashWrites++;
+  flashBytes += writeLen;
+  writeLen = 0;
+  return ok;
+}
+
+static bool append(const uint8_t *data, size_t len) {
+  if (writeLen + len > UPLOAD_WRITE_BUF && !flushWrites()) return false;
+  memcpy(writeBuf + writeLen, data, len);
+  writeLen += len;
+  return true;
+}
+
+static size_t freeBytes() {
+  return LittleFS.totalBytes() - LittleFS.usedBytes();
+}
+
+// Start patching the old file at chunk `index`, the first changed one.
+// LittleFS keeps the old blocks from there on until the file is closed, so
+// the rest of the file must fit in free space; the writes then go front to
+// back to the end as for a copy, one pass over that tail.
+static bool patchFrom(uint32_t index) {
+  uint32_t from = index * upChunk;
+  uint32_t end = upNewSize > upOldSize ? upNewSize : upOldSize;
+  if (from > upOldSize || end - from + 2 * (size_t)UPLOAD_CHUNK > freeBytes()) return false;
+  newFile = LittleFS.open(upPath, "r+");
+  if (!newFile || !newFile.seek(from)) return false;
+  nextChunk = index;
+  return true;
+}
+
+// A file patched half way holds new chunks up to some point and old ones
+// after it: fine to upload into again, not to play. The marker goes down
+// before closing the patch commits it.
+static void closePatch() {
+  File f = LittleFS.open(partPath, "w");
+  f.close();
+  newFile.close();
+}
+
+// Copy unchanged chunks [nextChunk, end) of the old file, stopping at `size`
+static bool copyOld(uint32_t end, uint32_t size) {
+  for (; nextChunk < end; nextChunk++) {
+    uint32_t off = nextChunk * upChunk;
+    if (off >= size) break;
+    size_t len = size - off < upChunk ? size - off : upChunk;
+    if (off + len > upOldSize) return false;      // the host skipped a chunk we never had
+    if (writeLen + len > UPLOAD_WRITE_BUF && !flushWrites()) return false;
+    if (!oldFile.seek(off) || oldFile.read(writeBuf + writeLen, len) != len) return false;
+    writeLen += len;
+    chunksCopied++;
+  }
+  return true;
+}
+
+bool upload_open(const char *path, uint32_t newSize, uint32_t chunkSize) {
+  upload_abort();
+  if (!chunkSize || chunkSize > UPLOAD_WRITE_BUF) return false;
+  writeBuf = (uint8_t *)malloc(UPLOAD_WRITE_BUF);
+  if (!writeBuf) return false;
+
+  strncpy(upPath, path, sizeof(upPath) - 1);
+  snprintf(tmpPath, sizeof(tmpPath), "%s.new", upPath);
+  snprintf(partPath, sizeof(partPath), "%s.part", upPath);
+  LittleFS.remove(tmpPath);               // left over from an interrupted upload
+
+  // The new file is written next to the old one. If both do not fit, the
+  // old one is patched instead, once the first changed chunk shows how much
+  // of it has to be rewritten (patchFrom).
+  upOldSize = 0;
+  oldFile = LittleFS.open(path, "r");
+  if (oldFile) upOldSize = oldFile.size();
+  inPlace = newSize + 2 * (size_t)UPLOAD_CHUNK > freeBytes();     // + metadata blocks
+  if (inPlace && !oldFile) { upload_abort(); return false; }
+  if (!inPlace) {
+    newFile = LittleFS.open(tmpPath, "w");
+    if (!newFile) { upload_abort(); return false; }
+  }
+
+  upNewSize = newSize;
+  upChunk = chunkSize;
+  nextChunk = 0;
+  writeLen = 0;
+  chunksWritten = chunksCopied = flashWrites = flashBytes = 0;
+  upActive = true;
+  return true;
+}
+
+bool upload_active() { return upActive; }
+bool upload_in_place() { return inPlace; }
+uint32_t upload_old_size() { return upOldSize; }
+uint32_t upload_chunk_size() { return upChunk; }
+uint32_t upload_chunks_written() { return chunksWritten; }
+uint32_t upload_chunks_copied() { return chunksCopied; }
+uint32_t upload_flash_writes() { return flashWrites; }
+uint32_t upload_flash_bytes() { return flashBytes; }
+
+uint64_t upload_hash_chunk(uint32_t index) {
+  uint32_t off = index * upChunk;
+  if (off >= upOldSize) return FNV64_OFFSET;
+  size_t len = upOldSize - off < upChunk ? upOldSize - off : upChunk;
+  oldFile.seek(off);
+  size_t n = oldFile.read(writeBuf, len);
+  return fnv1a64(writeBuf, n);
+}
+
+bool upload_write(uint32_t index, const uint8_t *data, size_t len) {
+  if (!upActive || len > upChunk || index < nextChunk) return false;
+  if (inPlace && !newFile && !patchFrom(index)) return false;
+  if (!copyOld(index, UINT32_MAX) || !append(data, len)) return false;
+  nextChunk = index + 1;
+  chunksWritten++;
+  return true;
+}
+
+bool upload_finish(uint32_t size, uint64_t expected, uint64_t *actual) {
+  *actual = 0;
+  if (!upActive) return false;
+  bool ok;
+  if (inPlace && !newFile) {
+    ok = size <= upOldSize;              // no chunk changed: at most cut short
+  } else {
+    ok = copyOld((size + upChunk - 1) / upChunk, size) && flushWrites();
+  }
+  if (inPlace && newFile) closePatch();
+  newFile.close();
+  oldFile.close();
+  if (inPlace && ok && size < upOldSize) {
+    char vfsPath[80];
+    snprintf(vfsPath, sizeof(vfsPath), "/littlefs%s", upPath);
+    if (truncate(vfsPath, size) != 0) ok = false;
+  }
+
+  uint64_t h = FNV64_OFFSET;
+  File f = LittleFS.open(inPlace ? upPath : tmpPath, "r");
+  if (!f) ok = false;
+  while (f && f.position() < f.size()) {
+    size_t n = f.read(writeBuf, UPLOAD_WRITE_BUF);
+    if (!n) break;
+    h = fnv1a64(writeBuf, n, h);
+  }
+  if (f) {
+    if (f.size() != size) ok = false;
+    f.close();
+  }
+  *actual = h;
+  ok = ok && h == expected;
+
+  // LittleFS renames atomically over an existing file
+  if (!inPlace) {
+    if (ok && !LittleFS.rename(tmpPath, upPath)) ok = false;
+    if (!ok) LittleFS.remove(tmpPath);
+  }
+  if (ok) LittleFS.remove(partPath);
+
+  free(writeBuf);
+  writeBuf = nullptr;
+  upActive = false;
+  return ok;
+}
+
+bool upload_incomplete(const char *path) {
+  char p[72];
+  snprintf(p, sizeof(p), "%s.part", path);
+  return LittleFS.exists(p);
+}
+
+void upload_abort() {
+  if (oldFile) oldFile.close();
+  if (newFile && inPlace) {
+    closePatch();
+  } else if (newFile) {
+    newFile.close();
+    LittleFS.remove(tmpPath);
+  }
+  free(writeBuf);
+  writeBuf = nullptr;
+  writeLen = 0;
+  upActive = false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- Incremental content upload ----
+//
+// The host asks for FNV-1a 64 hashes of every chunk of the current file,
+// diffs them against the new file and sends only the changed chunks, in
+// order. The device writes the new file front to back next to the old one
+// (`path` + ".new"), copying unchanged chunks from the old file, in appends
+// of up to UPLOAD_WRITE_BUF bytes; once its hash checks out it is renamed
+// over the old file. LittleFS is copy-on-write, so writing into the middle
+// of the old file would rewrite everything after each change instead.
+//
+// If the two do not fit side by side, the old file is patched: from the
+// first changed chunk to the end it is rewritten in one pass, which needs
+// only that tail in free space (LittleFS frees the old blocks on close).
+// Otherwise the upload is refused and the old file left alone. A patch
+// that fails half way leaves `path` + ".part" behind: the file then mixes
+// new and old chunks, which a repeated upload completes but the player
+// must not load (upload_incomplete).
+
+static const uint32_t UPLOAD_CHUNK = 4096;        // = flash sector size
+static const size_t UPLOAD_WRITE_BUF = 16384;
+static const uint64_t FNV64_OFFSET = 0xcbf29ce484222325ULL;
+
+uint64_t fnv1a64(const uint8_t *data, size_t len, uint64_t h = FNV64_OFFSET);
+
+// Start replacing `path` with a file of `newSize` bytes.
+bool upload_open(const char *path, uint32_t newSize, uint32_t chunkSize);
+bool upload_active();
+bool upload_in_place();             // patching the old file, no room for a copy
+uint32_t upload_old_size();
+uint32_t upload_chunk_size();
+
+// Hash of chunk `index` of the file as it was when the upload started.
+uint64_t upload_hash_chunk(uint32_t index);
+
+bool upload_write(uint32_t index, const uint8_t *data, size_t len);
+
+// Copy the remaining unchanged chunks, flush and re-hash the new file; if
+// it is `size` bytes with hash `expected`, it replaces the old one and
+// true is returned. Otherwise it is deleted and the old file is kept (or,
+// patched in place, marked incomplete).
+bool upload_finish(uint32_t size, uint64_t expected, uint64_t *actual);
+
+// Deletes the half-written new file; the old one is kept. A patch that
+// was under way is marked incomplete.
+void upload_abort();
+
+// Whether an in-place patch of `path` stopped half way.
+bool upload_incomplete(const char *path);
+
+// Totals for the last upload (for the log line).
+uint32_t upload_chunks_written();   // received over the link
+uint32_t upload_chunks_copied();    // unchanged, copied from the old file
+uint32_t upload_flash_writes();
+uint32_t upload_flash_bytes();
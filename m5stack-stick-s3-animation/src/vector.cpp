@@ -0,0 +1,148 @@
+#include "vector.h"
+#include <math.h>
+#include <stdlib.h>
+
+static const int SUB = 16;      // vertex precision: 1/16 pixel
+
+VectorXform vector_xform(float angle, uint16_t srcW, uint16_t srcH,
+                         uint16_t dstW, uint16_t dstH,
+                         uint8_t zoom, float panX, float panY) {
+  float r = angle * (float)M_PI / 180.0f;
+  float cs = cosf(r), sn = sinf(r);
+  // fit as the nearest quarter turn would, so 90° on a 135x240 picture is 1:1
+  bool sideways = ((int)lroundf(angle / 90.0f) & 1) != 0;
+  float rw = sideways ? srcH : srcW, rh = sideways ? srcW : srcH;
+  float s = dstW / rw < dstH / rh ? dstW / rw : dstH / rh;
+
+  // zoomed view: keep it on screen
+  float z = zoom > 1 ? zoom : 1;
+  float hw = dstW / (2 * z), hh = dstH / (2 * z);
+  float px = panX * dstW, py = panY * dstH;
+  px = px < hw ? hw : px > dstW - hw ? dstW - hw : px;
+  py = py < hh ? hh : py > dstH - hh ? dstH - hh : py;
+
+  // d = ((R * (p - srcCentre)) * s + dstCentre - pan) * z + dstCentre
+  float k = s * z;
+  VectorXform x;
+  x.a = cs * k;
+  x.b = -sn * k;
+  x.d = sn * k;
+  x.e = cs * k;
+  x.c = -(x.a * srcW + x.b * srcH) / 2 + (dstW / 2.0f - px) * z + dstW / 2.0f;
+  x.f = -(x.d * srcW + x.e * srcH) / 2 + (dstH / 2.0f - py) * z + dstH / 2.0f;
+  return x;
+}
+
+bool VectorRaster::begin() {
+  if (!edges_) edges_ = (Edge *)malloc(sizeof(Edge) * MAX_VECTOR_EDGES);
+  if (!active_) active_ = (uint16_t *)malloc(sizeof(uint16_t) * MAX_VECTOR_EDGES);
+  if (!edges_ || !active_) { end(); return false; }
+  return true;
+}
+
+void VectorRaster::end() {
+  free(edges_);
+  edges_ = nullptr;
+  free(active_);
+  active_ = nullptr;
+}
+
+size_t VectorRaster::bufferBytes() const {
+  return edges_ ? (sizeof(Edge) + sizeof(uint16_t)) * MAX_VECTOR_EDGES : 0;
+}
+
+// Scanline j samples y = j + 0.5, i.e. j*SUB + SUB/2 in vertex units
+static inline int32_t first_scanline(int32_t y) {
+  return (y - SUB / 2 + SUB - 1) >> 4;    // ceil((y - SUB/2) / SUB)
+}
+
+bool VectorRaster::addEdge(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t dstH) {
+  if (y0 == y1) return true;              // horizontal: never crosses a scanline centre
+  if (y0 > y1) {
+    int32_t t = x0; x0 = x1; x1 = t;
+    t = y0; y0 = y1; y1 = t;
+  }
+  int32_t js = first_scanline(y0), je = first_scanline(y1);
+  if (js < 0) js = 0;
+  if (je > dstH) je = dstH;
+  if (js >= je) return true;
+  if (count_ >= MAX_VECTOR_EDGES) return false;
+  Edge &e = edges_[count_++];
+  e.dxdy = (int32_t)(((int64_t)(x1 - x0) << 16) / (y1 - y0));
+  int32_t dy = js * SUB + SUB / 2 - y0;
+  e.x = (int32_t)(((int64_t)x0 << 12) + (int64_t)e.dxdy * dy / SUB);
+  e.yStart = (int16_t)js;
+  e.yEnd = (int16_t)je;
+  return true;
+}
+
+int VectorRaster::byStart(const void *a, const void *b) {
+  return ((const Edge *)a)->yStart - ((const Edge *)b)->yStart;
+}
+
+bool VectorRaster::fill(const uint8_t *frame, size_t len, const VectorXform &xf,
+                        uint16_t *canvas, uint16_t dstW, uint16_t dstH,
+                        uint16_t fg, uint16_t bg) {
+  for (size_t i = 0, n = (size_t)dstW * dstH; i < n; i++) canvas[i] = bg;
+  count_ = 0;
+  if (len < 3 || !edges_) return false;
+
+  // ---- Edge table ----
+  uint16_t polys = frame[1] | (frame[2] << 8);
+  size_t pos = 3;
+  for (uint16_t p = 0; p < polys; p++) {
+    if (pos + 4 > len) return false;
+    uint16_t n = frame[pos] | (frame[pos + 1] << 8);
+    int x = frame[pos + 2], y = frame[pos + 3];
+    pos += 4;
+    if (!n || pos + 2 * (size_t)(n - 1) > len) return false;
+    int32_t fx = lroundf((xf.a * x + xf.b * y + xf.c) * SUB);
+    int32_t fy = lroundf((xf.d * x + xf.e * y + xf.f) * SUB);
+    int32_t px = fx, py = fy;
+    for (uint16_t i = 1; i <= n; i++) {
+      int32_t qx = fx, qy = fy;      // closing edge back to the first vertex
+      if (i < n) {
+        x += (int8_t)frame[pos];
+        y += (int8_t)frame[pos + 1];
+        pos += 2;
+        qx = lroundf((xf.a * x + xf.b * y + xf.c) * SUB);
+        qy = lroundf((xf.d * x + xf.e * y + xf.f) * SUB);
+      }
+      if (!addEdge(px, py, qx, qy, dstH)) return false;
+      px = qx;
+      py = qy;
+    }
+  }
+  qsort(edges_, count_, sizeof(Edge), byStart);
+
+  // ---- Scanlines: active edges sorted by x, even-odd spans ----
+  uint32_t next = 0, nActive = 0;
+  int y = count_ ? edges_[0].yStart : dstH;
+  for (; y < dstH && (next < count_ || nActive); y++) {
+    uint32_t keep = 0;
+    for (uint32_t i = 0; i < nActive; i++) {
+      if (edges_[active_[i]].yEnd > y) active_[keep++] = active_[i];
+    }
+    nActive = keep;
+    while (next < count_ && edges_[next].yStart == y) active_[nActive++] = (uint16_t)next++;
+    // insertion sort: the order barely changes between scanlines
+    for (uint32_t i = 1; i < nActive; i++) {
+      uint16_t e = active_[i];
+      int32_t ex = edges_[e].x;
+      uint32_t j = i;
+      for (; j > 0 && edges_[active_[j - 1]].x > ex; j--) active_[j] = active_[j - 1];
+      active_[j] = e;
+    }
+    uint16_t *row = canvas + (size_t)y * dstW;
+    for (uint32_t i = 0; i + 1 < nActive; i += 2) {
+      // pixels whose centre lies in [xa, xb)
+      int32_t xa = (edges_[active_[i]].x + 0x7FFF) >> 16;
+      int32_t xb = (edges_[active_[i + 1]].x + 0x7FFF) >> 16;
+      if (xa < 0) xa = 0;
+      if (xb > dstW) xb = dstW;
+      for (int32_t x = xa; x < xb; x++) row[x] = fg;
+    }
+    for (uint32_t i = 0; i < nActive; i++) edges_[active_[i]].x += edges_[active_[i]].dxdy;
+  }
+  return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// ---- Vector outline frames (FLAG_VECTOR, written by tools/vectorize.py) ----
+// Frame: uint8 type (0), uint16 polygon count, then per polygon uint16 n,
+// uint8 x0, uint8 y0 and n-1 x {int8 dx, int8 dy}. Coordinates are pixel
+// corners of the source picture; polygons close implicitly and fill even-odd.
+
+static const uint16_t MAX_VECTOR_EDGES = 2048;   // the encoder keeps frames within this
+
+// Source picture corner (x, y) -> display (a*x + b*y + c, d*x + e*y + f)
+struct VectorXform {
+  float a, b, c;
+  float d, e, f;
+};
+
+// Rotate the picture clockwise by `angle` about its centre, scale it to fit
+// dstW x dstH at the nearest quarter turn, centre it, then zoom by `zoom`
+// around the view centre (panX, panY), 0..1 across the display.
+VectorXform vector_xform(float angle, uint16_t srcW, uint16_t srcH,
+                         uint16_t dstW, uint16_t dstH,
+                         uint8_t zoom, float panX, float panY);
+
+// Integer edge-table scanline fill straight into an RGB565 canvas
+class VectorRaster {
+ public:
+  ~VectorRaster() { end(); }
+
+  bool begin();
+  void end();
+
+  // Paint the frame over the whole dstW x dstH canvas (bg, then fg spans).
+  // False if the frame is malformed or has more than MAX_VECTOR_EDGES edges.
+  bool fill(const uint8_t *frame, size_t len, const VectorXform &x,
+            uint16_t *canvas, uint16_t dstW, uint16_t dstH, uint16_t fg, uint16_t bg);
+
+  // Edges of the last frame that crossed at least one scanline
+  uint32_t edges() const { return count_; }
+
+  size_t bufferBytes() const;
+
+ private:
+  struct Edge {
+    int32_t x;        // 16.16 pixels at the current scanline
+    int32_t dxdy;     // 16.16 pixels per scanline
+    int16_t yStart;   // first scanline
+    int16_t yEnd;     // one past the last
+  };
+
+  bool addEdge(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t dstH);
+  static int byStart(const void *a, const void *b);
+
+  Edge *edges_ = nullptr;
+  uint16_t *active_ = nullptr;
+  uint32_t count_ = 0;
+};
@@ -0,0 +1,154 @@
+"""Sliding-window bitrate cap for build_data.py --rate-cap.
+
+A constant-rate reader (flash at a sustained read speed, or the serial link
+at baud/10 bytes/s) falls behind whenever a run of heavy frames needs more
+bytes than it delivers in the same time. cap_frames() encodes the frames in
+order so that no `window` consecutive frames cost more than `cap` bytes,
+where a frame costs its payload plus a fixed per-frame overhead (jitter
+buffer bookkeeping, row index). A frame that would break the cap is
+degraded, in order of preference:
+
+  1. an intra frame that does not fit becomes a delta (the keyframe moves
+     to the next frame where it fits)
+  2. short runs of changed pixels are left out of the delta (despeckling
+     the change mask at growing thresholds)
+  3. only a band of rows is updated; the next band follows in the next
+     frame, so a hard cut is painted over several frames
+
+Every frame is coded against the picture the device actually shows, so
+whatever a capped frame leaves out is carried by the following deltas and
+the error fades once the content calms down.
+"""
+from container import FRAME_DELTA
+
+DROP_RUNS = [2, 3, 4, 6, 10]
+
+
+def window_sums(costs, window):
+    """Bytes of frames i-window+1..i, for every i."""
+    out = []
+    total = 0
+    for i, c in enumerate(costs):
+        total += c
+        if i >= window:
+            total -= costs[i - window]
+        out.append(total)
+    return out
+
+
+def peak_window(costs, window):
+    """(bytes, last frame) of the heaviest window."""
+    sums = window_sums(costs, window)
+    i = max(range(len(sums)), key=sums.__getitem__)
+    return sums[i], i
+
+
+def drop_short_changes(mask, min_run):
+    """Clear runs of changed pixels shorter than `min_run`."""
+    out = list(mask)
+    i, n = 0, len(out)
+    while i < n:
+        if not out[i]:
+            i += 1
+            continue
+        j = i
+        while j < n and out[j]:
+            j += 1
+        if j - i < min_run:
+            out[i:j] = [0] * (j - i)
+        i = j
+    return out
+
+
+def _band(mask, width, row0, rows):
+    """mask with everything outside rows [row0, row0 + rows) cleared."""
+    a, b = row0 * width, (row0 + rows) * width
+    return [0] * a + list(mask[a:b]) + [0] * (len(mask) - b)
+
+
+class CapStats:
+    def __init__(self):
+        self.keys = 0
+        self.late_keys = 0        # keyframes moved because intra did not fit
+        self.despeckled = 0
+        self.banded = 0
+        self.max_seek = 0
+        self.wrong = 0            # pixels shown differently from the source
+        self.pixels = 0
+
+
+def cap_frames(frame_bits, width, height, compress, window, cap, overhead=0, max_seek=None):
+    """Frames coded under the cap, and CapStats.
+
+    frame_bits: source pictures (flat 0/1); compress(bits) -> intra bit-RLE.
+    Raises ValueError if even an empty delta does not fit.
+    """
+    def delta(mask):
+        data = compress(mask)
+        return bytes([data[0] | FRAME_DELTA]) + data[1:]
+
+    stats = CapStats()
+    costs = []
+    frames = []
+    shown = None
+    since_key = 0
+    band_row = 0
+    for i, bits in enumerate(frame_bits):
+        allowance = cap - overhead - sum(costs[max(0, i - window + 1):])
+        intra = compress(bits)
+        if shown is None:
+            if len(intra) > allowance:
+                raise ValueError(f'frame 0 needs {len(intra) + overhead} bytes, cap is {cap}')
+            frame, shown, since_key = intra, list(bits), 0
+            stats.keys += 1
+        else:
+            mask = [a ^ b for a, b in zip(shown, bits)]
+            full = delta(mask)
+            want_key = len(intra) <= len(full) or (max_seek is not None and since_key >= max_seek)
+            frame = None
+            if want_key:
+                if len(intra) <= allowance:
+                    frame, shown, since_key = intra, list(bits), 0
+                    stats.keys += 1
+                else:
+                    stats.late_keys += 1
+            if frame is None and len(full) <= allowance:
+                frame, shown = full, list(bits)
+            if frame is None:
+                for q in DROP_RUNS:
+                    m = drop_short_changes(mask, q)
+                    d = delta(m)
+                    if len(d) <= allowance:
+                        frame = d
+                        stats.despeckled += 1
+                        break
+            if frame is None:
+                # largest band of rows from band_row that fits
+                lo, hi = 0, height - band_row
+                best = None
+                while lo < hi:
+                    mid = (lo + hi + 1) // 2
+                    d = delta(_band(mask, width, band_row, mid))
+                    if len(d) <= allowance:
+                        lo, best = mid, d
+                    else:
+                        hi = mid - 1
+                if best is None:
+                    best = delta([0] * len(mask))
+                    if len(best) > allowance:
+                        raise ValueError(f'frame {i}: cap {cap} leaves {allowance + overhead} '
+                                         f'bytes, an empty delta needs {len(best) + overhead}')
+                m = _band(mask, width, band_row, lo)
+                band_row = (band_row + lo) % height if lo < height - band_row else 0
+                frame = best
+                stats.banded += 1
+            if frame is not intra:
+                if frame is not full:
+                    shown = [a ^ b for a, b in zip(shown, m)]
+                since_key += 1
+        stats.max_seek = max(stats.max_seek, since_key)
+        stats.wrong += sum(a != b for a, b in zip(shown, bits))
+        stats.pixels += len(bits)
+        frames.append(frame)
+        costs.append(len(frame) + overhead)
+    return frames, stats
@@ -6,11 +6,29 @@ Generates:
   data/bad_apple_audio.raw — unsigned 8-bit PCM, 8kHz, mono
 
 Bit-RLE format per frame:
-  uint8_t  first_bit       — value of the first run (0 or 1)
+  uint8_t  type            — bit 0: value of the first run, bit 1: delta frame
   uint16_t run_lengths[]   — alternating run lengths (LE), until all pixels consumed
 
+Delta frames code the XOR with the previous frame. With --max-seek the
+encoder places keyframes (intra frames) at scene cuts and wherever else they
+minimise the file size, keeping every frame within N deltas of a keyframe.
+
+Profiles:
+  legacy     --width x --height (default 180x135), rotated/fitted by the firmware
+  landscape  240x135, the panel as the firmware drives it — blitted 1:1
+  portrait   135x240, the panel's native orientation — blitted 1:1
+
 Usage:
   python tools/build_data.py "video.mp4" --width 180 --height 135 --fps 15
+  python tools/build_data.py "video.mp4" --profile landscape --compare
+  python tools/build_data.py "video.mp4" --max-seek 30 --seek-curve
+  python tools/build_data.py "video.mp4" --target-size auto
+  python tools/build_data.py "video.mp4" --max-seek 30 --rate-cap 60000
+  python tools/build_data.py "video.mp4" --fps 15 --max-seek 30 --base-fps 7.5
+  python tools/build_data.py "video.mp4" --profile portrait --max-seek 30 --scroll 0.5
+  python tools/build_data.py "video.mp4" --max-seek 30 --thumbs 1
+  python tools/build_data.py "video.mp4" --profile landscape --max-seek 30 --dither
+  python tools/build_data.py "clip.mp4" --profile landscape --max-seek 30 --colors 8
 """
 import os
 import sys
@@ -20,6 +38,30 @@ import subprocess
 import struct
 from PIL import Image
 
+from container import (FLAG_COST_HINTS, FLAG_DELTA, FLAG_DITHER, FLAG_INDEXED, FLAG_LAYERS,
+                       FLAG_NATIVE, FLAG_REFS, FLAG_ROW_INDEX, FLAG_THUMBS, FLAG_VECTOR,
+                       FRAME_DELTA, FRAME_PATTERN, FRAME_REF, FRAME_ROWS,
+                       FRAME_STORE, MAX_FRAME_BYTES, MAX_PALETTE, MAX_REF_SLOTS,
+                       bit_rle_decode, header_size, index_entry, indexed_decode, run_lengths,
+                       scroll_rows, slots_end)
+from bitrate import cap_frames
+from cost_hints import default_path, hints_for
+from dither import dither, gray_level, pattern_compress
+from keyframes import max_seek_of, place_keyframes, scene_cuts, seek_curve
+from palette import (SAMPLE_FRAMES, SCENE_CUT, indexed_compress, map_image, scene_palette,
+                     scene_starts)
+from palette import signature as colour_signature
+from rate_control import (DELTA_SEEKS, DESPECKLE, LOSSY_MAX_SEEK, VECTOR_TOLERANCES,
+                          audio_size, choose, container_bytes, despeckle, ladder, load_model,
+                          pixel_error, video_budget, DEFAULT_MODEL)
+from references import BLOCK, choose_references, signature
+from scroll import Scroller, mark_scroll, spi_rows
+from serial_link import FRAME_OVERHEAD
+from thumbnails import DEFAULT_SCALE, track_for
+from vectorize import decode_polygons, rasterize, vectorize_frame
+
+PARTITIONS_CSV = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'partitions.csv')
+
 # Find ffmpeg: check PATH, then known winget location
 FFMPEG = 'ffmpeg'
 _winget_ffmpeg = os.path.expandvars(
@@ -35,6 +77,16 @@ if os.path.isdir(_winget_ffmpeg):
                     break
 
 
+# Display the firmware drives (M5StickC Plus2 ST7789, landscape)
+DISP_W, DISP_H = 240, 135
+
+PROFILES = {
+    'legacy': None,                 # --width/--height, firmware rotates
+    'landscape': (DISP_W, DISP_H),
+    'portrait': (DISP_H, DISP_W),
+}
+
+
 def image_to_bits(img, width, height, threshold=128):
     """Convert image to flat list of 0/1 values (row-major)."""
     img = img.convert('L').resize((width, height))
@@ -46,6 +98,12 @@ def image_to_bits(img, width, height, threshold=128):
     return bits
 
 
+def image_to_levels(img, width, height):
+    """Convert image to flat list of dither levels 0..16 (row-major, 16 = black)."""
+    img = img.convert('L').resize((width, height))
+    return [gray_level(g) for g in img.tobytes()]
+
+
 def bit_rle_compress(bits):
     """Compress a flat bit list with bit-level RLE.
 
@@ -74,58 +132,657 @@ def bit_rle_compress(bits):
     return bytes(out)
 
 
+def delta_compress(prev_bits, bits):
+    """Bit-RLE of the XOR with the previous frame, tagged as a delta frame."""
+    data = bit_rle_compress([a ^ b for a, b in zip(prev_bits, bits)])
+    return bytes([data[0] | FRAME_DELTA]) + data[1:]
+
+
+def ref_delta_compress(ref_bits, bits, slot):
+    """Delta against long-term reference `slot` (holding ref_bits)."""
+    data = bit_rle_compress([a ^ b for a, b in zip(ref_bits, bits)])
+    return bytes([data[0] | FRAME_DELTA | FRAME_REF, slot]) + data[1:]
+
+
+def store_compress(intra, slot):
+    """Intra frame that is also kept in `slot`."""
+    return bytes([intra[0] | FRAME_STORE, slot]) + intra[1:]
+
+
+def ref_store_compress(ref_bits, bits, ref, store):
+    """Delta against slot `ref` whose picture is then kept in slot `store`."""
+    data = bit_rle_compress([a ^ b for a, b in zip(ref_bits, bits)])
+    return bytes([data[0] | FRAME_DELTA | FRAME_REF | FRAME_STORE, ref, store]) + data[1:]
+
+
+def add_row_index(frame, width, height, k):
+    """Insert a row-restart entry every `k` rows, so a player can decode a
+    band of rows without walking the runs above it."""
+    hdr = header_size(frame)
+    runs = run_lengths(frame)
+    entries = []
+    run, start = 0, 0
+    for row in range(k, height, k):
+        target = row * width
+        while run < len(runs) and start + runs[run] <= target:
+            start += runs[run]
+            run += 1
+        skip = target - start if run < len(runs) else 0
+        entries.append(struct.pack('<HH', run, skip))
+    at = slots_end(frame)
+    return (bytes([frame[0] | FRAME_ROWS]) + frame[1:at] + bytes([k, len(entries)])
+            + b''.join(entries) + frame[hdr:])
+
+
+def scale_filter(width, height, fit):
+    """ffmpeg filter fitting the source into width x height."""
+    if fit == 'stretch':
+        return f'scale={width}:{height}'
+    if fit == 'crop':
+        return (f'scale={width}:{height}:force_original_aspect_ratio=increase,'
+                f'crop={width}:{height}')
+    # pad with white: bright pixels encode as 0 and show as the background colour
+    return (f'scale={width}:{height}:force_original_aspect_ratio=decrease,'
+            f'pad={width}:{height}:(ow-iw)/2:(oh-ih)/2:color=white')
+
+
+def extract_frames(input_path, tmp, fps, vf):
+    if os.path.exists(tmp):
+        shutil.rmtree(tmp)
+    os.makedirs(tmp)
+    subprocess.check_call([
+        FFMPEG, '-y', '-i', input_path,
+        '-vf', vf,
+        '-r', str(fps),
+        os.path.join(tmp, 'frame_%06d.png')
+    ])
+    return sorted(f for f in os.listdir(tmp) if f.endswith('.png'))
+
+
+def encode_frames(tmp, files, width, height, deltas=False, min_run=0, scroll=None,
+                  shifts=None, dithered=False):
+    """Intra-code every frame; with deltas=True also return each frame's
+    delta against its predecessor (None for frame 0) and its bits.
+    min_run > 1 despeckles each picture first (lossy). scroll = tolerance
+    replaces pictures that scroll by the exact scroll (lossy, scroll.py) and
+    appends each frame's shift to `shifts`. dithered=True halftones the
+    greys and codes flat ones as pattern runs (dither.py)."""
+    compressed_frames = []
+    delta_frames = []
+    frame_bits = []
+    prev = None
+    scroller = Scroller(width, height, scroll) if scroll is not None else None
+    for idx, fn in enumerate(files):
+        if idx % 500 == 0:
+            print(f'  Frame {idx}/{len(files)}...')
+        img = Image.open(os.path.join(tmp, fn))
+        if dithered:
+            levels = image_to_levels(img, width, height)
+            bits = dither(levels, width)
+            compressed_frames.append(pattern_compress(levels, bits, width))
+            if deltas:
+                delta_frames.append(pattern_compress(levels, bits, width, prev)
+                                    if prev else None)
+                prev = bits
+                frame_bits.append(bytes(bits))
+            continue
+        bits = image_to_bits(img, width, height)
+        if min_run > 1:
+            bits = despeckle(bits, min_run)
+        if scroller:
+            bits, dy = scroller.step(bits)
+            shifts.append(dy)
+        compressed_frames.append(bit_rle_compress(bits))
+        if deltas:
+            delta_frames.append(delta_compress(prev, bits) if prev else None)
+            prev = bits
+            frame_bits.append(bytes(bits))
+    if deltas:
+        return compressed_frames, delta_frames, frame_bits
+    return compressed_frames
+
+
+def encode_indexed(tmp, files, width, height, colors, max_seek, cut):
+    """Frames as runs of palette indices, `colors` colours per scene
+    (palette.py). Scene starts are keyframes; with max_seek the others are
+    placed as for bit-RLE, without it every frame is intra."""
+    def load(fn):
+        return Image.open(os.path.join(tmp, fn)).convert('RGB').resize((width, height))
+
+    starts = scene_starts([colour_signature(load(fn)) for fn in files], cut)
+    intra, delta = [], []
+    for s, e in zip(starts, starts[1:] + [len(files)]):
+        sample = files[s:e:max(1, (e - s) // SAMPLE_FRAMES)]
+        palette = scene_palette([load(fn) for fn in sample], colors)
+        prev = None
+        for fn in files[s:e]:
+            indices = map_image(load(fn), palette)
+            intra.append(indexed_compress(indices, palette))
+            delta.append(indexed_compress(indices, prev=prev) if prev is not None else None)
+            got = indexed_decode(intra[-1], len(indices))[0]
+            if prev is not None and got == indices:
+                got = indexed_decode(delta[-1], len(indices), prev)[0]
+            if got != indices:
+                raise ValueError(f'frame {len(intra) - 1}: indexed runs do not decode back')
+            prev = indices
+        if s // 500 != e // 500:
+            print(f'  Frame {e}/{len(files)}...')
+    if max_seek is None:
+        print(f'  Scenes: {len(starts)}; all {len(intra)} frames intra')
+        return intra
+    intra_sizes = [len(f) for f in intra]
+    delta_sizes = [len(f) if f else 0 for f in delta]   # scene starts are forced keyframes
+    keys, total = place_keyframes(intra_sizes, delta_sizes, max_seek, set(starts))
+    key_set = set(keys)
+    print(f'  Scenes: {len(starts)}; keyframes: {len(keys)}, max seek '
+          f'{max_seek_of(keys, len(intra))} frames')
+    print(f'  Intra only {sum(intra_sizes):,} bytes -> with deltas {total:,} bytes')
+    return [intra[i] if i in key_set else delta[i] for i in range(len(intra))]
+
+
+def plan_references(intra, delta, frame_bits, width, height, slots, min_gap):
+    """Key-frame coding of every frame with long-term references.
+
+    Returns (key_frames, stores): key_frames[i] is the smallest standalone
+    coding of frame i -- intra, intra + store into a slot, or a delta
+    against a resident slot; stores are the frames that must stay intra.
+    A stored frame is dropped again unless its users save more than forcing
+    it to be intra costs.
+    """
+    sigs = [signature(b, width, height) for b in frame_bits]
+    blocks = -(-width // BLOCK) * -(-height // BLOCK)
+    stores, options = choose_references(sigs, slots, min_gap, max(1, blocks * 2 // 100))
+    key_frames = list(intra)
+    users = {f: [] for f in stores}
+    for i, opts in enumerate(options):
+        if i in stores:
+            continue
+        for slot, f in opts:
+            data = ref_delta_compress(frame_bits[f], frame_bits[i], slot)
+            if len(data) < len(key_frames[i]):
+                key_frames[i] = data
+                best = f
+        if key_frames[i] is not intra[i]:
+            users[best].append(i)
+
+    for f, slot in sorted(stores.items()):
+        saved = sum(len(intra[i]) - len(key_frames[i]) for i in users[f])
+        forced = len(intra[f]) + 2 - min(len(intra[f]), len(delta[f]) if delta[f] else len(intra[f]))
+        if saved > forced:
+            key_frames[f] = store_compress(intra[f], slot)
+            continue
+        del stores[f]
+        for i in users[f]:
+            key_frames[i] = intra[i]
+    return key_frames, set(stores)
+
+
+SEEK_CURVE_LIMITS = [0, 1, 2, 4, 8, 15, 30, 60, 120, 300, None]
+
+
+def print_seek_curve(intra, key, delta, fps, forced=()):
+    key_sizes = [len(f) for f in key]
+    delta_sizes = [0] + [len(f) for f in delta[1:]]
+    print('\nSize vs seek latency (seek = deltas decoded after the keyframe):')
+    print(f'  {"max seek":>9} {"seek ms":>8} {"keyframes":>10} {"bytes":>11} {"vs intra":>9}')
+    base = sum(len(f) for f in intra)
+    for limit, keys, total, actual in seek_curve(key_sizes, delta_sizes, SEEK_CURVE_LIMITS,
+                                                 forced):
+        label = 'none' if limit is None else str(limit)
+        print(f'  {label:>9} {actual * 1000 / fps:>8.0f} {keys:>10} {total:>11,} '
+              f'{100 * total / base:>8.1f}%')
+
+
+def choose_keyframes(intra, key, delta, max_seek, forced=(), avoid=()):
+    """Mix key and delta frames; returns the frames to store.
+
+    key[i] is frame i's standalone coding (intra, or with long-term
+    references a store/ref-delta frame); frames in `forced` stay key frames,
+    frames in `avoid` stay deltas where max_seek allows.
+    """
+    intra_sizes = [len(f) for f in intra]
+    key_sizes = [len(f) for f in key]
+    delta_sizes = [0] + [len(f) for f in delta[1:]]
+    cuts = scene_cuts(intra_sizes, delta_sizes)
+    keys, total = place_keyframes(key_sizes, delta_sizes, max_seek, forced, avoid)
+    key_set = set(keys)
+    print(f'  Scene cuts (delta >= intra): {len(cuts)}; keyframes: {len(keys)} '
+          f'({len(key_set.intersection(cuts))} on cuts), max seek '
+          f'{max_seek_of(keys, len(intra))} frames')
+    refs = sum(1 for i in keys if key[i][0] & FRAME_REF)
+    if forced or refs:
+        print(f'  Long-term references: {len(forced)} stored, {refs} keyframes coded against them')
+    print(f'  Intra only {sum(intra_sizes):,} bytes -> with deltas {total:,} bytes')
+    return [key[i] if i in key_set else delta[i] for i in range(len(intra))]
+
+
+def rate_capped(args, frame_bits):
+    """Delta coding under --rate-cap (see bitrate.py)."""
+    window = args.cap_window or args.fps
+    cap = args.rate_cap * window // args.fps
+    overhead = FRAME_OVERHEAD
+    if args.row_index:
+        overhead += 2 + 4 * ((args.height - 1) // args.row_index)
+    print(f'Rate cap: {cap:,} bytes per {window} frames ({args.rate_cap:,} B/s, '
+          f'{overhead} bytes/frame overhead), max seek {args.max_seek}...')
+    try:
+        frames, st = cap_frames(frame_bits, args.width, args.height, bit_rle_compress,
+                                window, cap, overhead, args.max_seek)
+    except ValueError as e:
+        sys.exit(f'--rate-cap too low: {e}')
+    print(f'  keyframes: {st.keys} ({st.late_keys} postponed to fit); capped frames: '
+          f'{st.despeckled} despeckled, {st.banded} updated in bands')
+    print(f'  max seek {st.max_seek} frames; pixels off vs. source: '
+          f'{100 * st.wrong / st.pixels:.3f}%')
+    return frames
+
+
+def encode_layers(frame_bits, fps, base_fps, max_seek):
+    """Base layer at `base_fps` plus droppable frames in between.
+
+    Base frames alternate between reference slots 0 and 1: each is intra or
+    a delta against the previous base picture's slot, and is kept in the
+    other slot. The frames in between are coded against the latest base
+    slot (or intra) and stored nowhere, so the player may skip them.
+    Returns (frames, droppable flags)."""
+    n = len(frame_bits)
+    base = [i for i in range(n)
+            if i == 0 or int(i * base_fps / fps) != int((i - 1) * base_fps / fps)]
+    intra = [bit_rle_compress(frame_bits[i]) for i in base]
+    key_sizes = [len(f) + 1 for f in intra]
+    delta_sizes = [0] + [len(delta_compress(frame_bits[a], frame_bits[b])) + 2
+                         for a, b in zip(base, base[1:])]
+    keys, _ = place_keyframes(key_sizes, delta_sizes, max_seek)
+    keys = set(keys)
+
+    frames = [None] * n
+    droppable = [True] * n
+    for j, i in enumerate(base):
+        slot = j % 2
+        if j in keys:
+            frames[i] = store_compress(intra[j], slot)
+        else:
+            frames[i] = ref_store_compress(frame_bits[base[j - 1]], frame_bits[i], 1 - slot, slot)
+        droppable[i] = False
+        end = base[j + 1] if j + 1 < len(base) else n
+        for e in range(i + 1, end):
+            own = bit_rle_compress(frame_bits[e])
+            ref = ref_delta_compress(frame_bits[i], frame_bits[e], slot)
+            frames[e] = own if len(own) <= len(ref) else ref
+    total = sum(len(f) for f in frames)
+    print(f'  Layers: base {len(base)} frames @ {base_fps:g} fps ({len(keys)} keyframes), '
+          f'{n - len(base)} droppable; {total:,} bytes')
+    return frames, droppable
+
+
+def frame_cost(width, height, native):
+    """Rough per-frame work of the firmware render path.
+
+    Returns (pixel writes, SPI bytes). Legacy frames are decoded, copied into
+    the video sprite, the canvas is cleared, the sprite is rotated into it and
+    the whole canvas is pushed; native frames are decoded and pushed as is.
+    """
+    pixels = width * height
+    if native:
+        return pixels * 2, pixels * 2
+    disp = DISP_W * DISP_H
+    return pixels * 2 + disp * 2, disp * 2
+
+
+def print_profile_comparison(rows):
+    print('\nProfile comparison:')
+    print(f'  {"profile":<10} {"size":>9} {"bytes":>11} {"avg/frame":>10} '
+          f'{"px writes/frame":>16} {"SPI bytes/frame":>16}')
+    for name, w, h, frames, native in rows:
+        total = sum(len(f) for f in frames)
+        writes, spi = frame_cost(w, h, native)
+        print(f'  {name:<10} {f"{w}x{h}":>9} {total:>11,} {total / len(frames):>10.0f} '
+              f'{writes:>16,} {spi:>16,}')
+
+
+def extract_cached(args, fps, width, height, vf):
+    """extract_frames, skipped when args.tmp already holds these settings."""
+    if getattr(args, 'extracted', None) != (fps, width, height):
+        extract_frames(args.input, args.tmp, fps, vf)
+        args.extracted = (fps, width, height)
+    return sorted(f for f in os.listdir(args.tmp) if f.endswith('.png'))
+
+
+def rung_codings(bits, width, height):
+    """Codings of one (fps, size) rung for rate control, best first:
+    (label, settings, bytes, pixel error)."""
+    n = len(bits)
+    intra = [bit_rle_compress(b) for b in bits]
+    intra_sizes = [len(f) for f in intra]
+    yield 'intra', {}, container_bytes(sum(intra_sizes), n), 0.0
+
+    delta_sizes = [0] + [len(delta_compress(a, b)) for a, b in zip(bits, bits[1:])]
+    for limit, _, total, _ in seek_curve(intra_sizes, delta_sizes, DELTA_SEEKS):
+        yield f'delta max-seek {limit}', {'max_seek': limit}, container_bytes(total, n), 0.0
+
+    for q in DESPECKLE:
+        clean = [despeckle(b, q) for b in bits]
+        sizes = [len(bit_rle_compress(b)) for b in clean]
+        deltas = [0] + [len(delta_compress(a, b)) for a, b in zip(clean, clean[1:])]
+        _, total = place_keyframes(sizes, deltas, LOSSY_MAX_SEEK)
+        yield (f'despeckle {q} + delta', {'min_run': q, 'max_seek': LOSSY_MAX_SEEK},
+               container_bytes(total, n), pixel_error(bits, clean))
+
+    if width <= 255 and height <= 255:
+        for tol in VECTOR_TOLERANCES:
+            frames = [vectorize_frame(b, width, height, tol)[0] for b in bits]
+            sample = range(0, n, 25)
+            back = [rasterize(decode_polygons(frames[i]), width, height) for i in sample]
+            yield (f'vector tol {tol}', {'vector': tol},
+                   container_bytes(sum(len(f) for f in frames), n),
+                   pixel_error([bits[i] for i in sample], back))
+
+
+def search_target_size(args, native, budget):
+    """Rate control: settings of the best coding that fits `budget` bytes."""
+    def rungs():
+        for fps, scale in ladder(args.fps, native):
+            w = max(8, round(args.width * scale))
+            h = max(8, round(args.height * scale))
+            vf = scale_filter(w, h, args.fit) if native else f'scale={w}:{h}'
+            print(f'  Trying {w}x{h} @ {fps} fps...')
+            files = extract_cached(args, fps, w, h, vf)
+            bits = [image_to_bits(Image.open(os.path.join(args.tmp, fn)), w, h) for fn in files]
+            yield (fps, w, h), rung_codings(bits, w, h)
+
+    found = choose(budget, rungs())
+    if not found:
+        return None
+    (fps, w, h), label, settings, size, error, tried = found
+    print(f'\n  {"fps":>4} {"size":>9} {"coding":<24} {"bytes":>11} {"px error":>9}')
+    for (tf, tw, th), tlabel, tsize, terror in tried:
+        mark = '*' if (tf, tw, th, tlabel) == (fps, w, h, label) else ' '
+        print(f'{mark} {tf:>4} {f"{tw}x{th}":>9} {tlabel:<24} {tsize:>11,} {100 * terror:>8.2f}%')
+    settings = dict(settings, fps=fps, width=w, height=h)
+    print(f'  Chosen: {w}x{h} @ {fps} fps, {label}: {size:,} of {budget:,} bytes, '
+          f'pixel error {100 * error:.2f}%')
+    return settings
+
+
 def main():
     p = argparse.ArgumentParser(description='Build Bad Apple data files')
     p.add_argument('input', help='Input video file (mp4)')
     p.add_argument('--width', type=int, default=180)
     p.add_argument('--height', type=int, default=135)
     p.add_argument('--fps', type=int, default=15)
+    p.add_argument('--profile', choices=sorted(PROFILES), default='legacy',
+                   help='legacy: --width x --height, rotated on device; '
+                        'landscape/portrait: native panel size, blitted 1:1')
+    p.add_argument('--fit', choices=['pad', 'crop', 'stretch'], default='pad',
+                   help='How native profiles fit the source aspect ratio')
+    p.add_argument('--compare', action='store_true',
+                   help='Also encode the legacy profile and compare size/frame cost')
+    p.add_argument('--max-seek', type=int, default=None, metavar='N',
+                   help='Use delta frames, with at most N deltas after each keyframe')
+    p.add_argument('--seek-curve', action='store_true',
+                   help='Print total size against the maximum seek distance')
+    p.add_argument('--ref-slots', type=int, default=0, metavar='K',
+                   help=f'Long-term reference slots for recurring shots (0-{MAX_REF_SLOTS}, '
+                        'needs --max-seek; ~4 KB of device RAM each)')
+    p.add_argument('--ref-gap', type=float, default=2.0, metavar='SEC',
+                   help='Only reference frames at least this far back')
+    p.add_argument('--row-index', type=int, default=0, metavar='K',
+                   help='Add a row-restart index every K rows to each frame, so zoomed '
+                        'playback only decodes the visible rows (0 = off)')
+    p.add_argument('--vector', type=float, default=None, metavar='TOL',
+                   help='Experimental: store polygon outlines traced within TOL pixels '
+                        'instead of bit-RLE (see tools/vectorize.py)')
+    p.add_argument('--despeckle', type=int, default=0, metavar='N',
+                   help='Lossy: flip runs shorter than N pixels to their surroundings')
+    p.add_argument('--target-size', default=None, metavar='BYTES|auto',
+                   help='Rate control: pick resolution, fps and coding to fit BYTES of '
+                        'video (auto = LittleFS partition minus audio)')
+    p.add_argument('--model', default=None, metavar='FILE',
+                   help='Device bench log with `model ...` lines for the playback estimate '
+                        'and the per-frame cost hints')
+    p.add_argument('--no-cost-hints', action='store_true',
+                   help='Leave the predicted frame times out of the frame index')
+    p.add_argument('--rate-cap', type=int, default=None, metavar='BYTES_PER_SEC',
+                   help='Cap the bytes of every --cap-window frames to this rate, spending '
+                        'quality on the frames that would exceed it (needs --max-seek)')
+    p.add_argument('--cap-window', type=int, default=None, metavar='N',
+                   help='Frames per rate-cap window (default: one second)')
+    p.add_argument('--base-fps', type=float, default=None, metavar='F',
+                   help='Temporal layers: base layer at F fps, the other frames droppable '
+                        'when the player is late (needs --max-seek, counted in base frames)')
+    p.add_argument('--scroll', type=float, default=None, metavar='PCT',
+                   help='Mark frames that are the previous one moved vertically (within PCT %% '
+                        'of pixels, lossy) so the player scrolls the panel instead of '
+                        'pushing them (needs --max-seek)')
+    p.add_argument('--thumbs', type=float, default=None, metavar='SEC',
+                   help='Add a thumbnail track, one every SEC seconds, for instant scrub '
+                        'previews (not counted by --target-size)')
+    p.add_argument('--thumb-scale', type=int, default=DEFAULT_SCALE, metavar='N',
+                   help='Video pixels per thumbnail pixel, each way')
+    p.add_argument('--dither', action='store_true',
+                   help='Ordered-dither greys instead of thresholding; flat greys are coded '
+                        'as pattern runs (needs firmware that reads FLAG_DITHER)')
+    p.add_argument('--colors', type=int, default=None, metavar='N',
+                   help=f'Indexed colour: N (2..{MAX_PALETTE}) colours picked per scene instead '
+                        'of 1-bit frames (needs firmware that reads FLAG_INDEXED)')
+    p.add_argument('--scene-cut', type=float, default=SCENE_CUT, metavar='D',
+                   help='With --colors: mean colour change (0..255) that starts a new scene '
+                        'and palette')
     p.add_argument('--audio-rate', type=int, default=8000,
                    help='Audio sample rate (Hz)')
     p.add_argument('--tmp', default='tmp_frames')
     p.add_argument('--data-dir', default='data')
     args = p.parse_args()
 
+    native = PROFILES[args.profile] is not None
+    if native:
+        args.width, args.height = PROFILES[args.profile]
+        vf = scale_filter(args.width, args.height, args.fit)
+    else:
+        vf = f'scale={args.width}:{args.height}'
     total_pixels = args.width * args.height
+    flags = FLAG_NATIVE if native else 0
 
     os.makedirs(args.data_dir, exist_ok=True)
 
     # --- Extract frames ---
-    if os.path.exists(args.tmp):
-        shutil.rmtree(args.tmp)
-    os.makedirs(args.tmp)
-
-    print(f'Extracting frames at {args.width}x{args.height} @ {args.fps}fps...')
-    subprocess.check_call([
-        FFMPEG, '-y', '-i', args.input,
-        '-vf', f'scale={args.width}:{args.height}',
-        '-r', str(args.fps),
-        os.path.join(args.tmp, 'frame_%06d.png')
-    ])
-
-    files = sorted(f for f in os.listdir(args.tmp) if f.endswith('.png'))
+    print(f'Extracting frames at {args.width}x{args.height} @ {args.fps}fps '
+          f'({args.profile} profile)...')
+    files = extract_cached(args, args.fps, args.width, args.height, vf)
     frame_count = len(files)
     print(f'Extracted {frame_count} frames')
 
+    # --- Rate control: pick settings, then encode with them as usual ---
+    if args.target_size is not None:
+        if args.max_seek is not None or args.vector is not None or args.despeckle or \
+                args.dither or args.colors is not None:
+            p.error('--target-size picks --max-seek/--vector/--despeckle itself '
+                    '(and does not dither or use colour)')
+        audio = audio_size(frame_count, args.fps, args.audio_rate)
+        if args.target_size == 'auto':
+            budget = video_budget(PARTITIONS_CSV, audio)
+            print(f'Rate control: {budget:,} bytes for video '
+                  f'(LittleFS partition, less {audio:,} bytes of audio)')
+        else:
+            budget = int(args.target_size, 0)
+            print(f'Rate control: {budget:,} bytes for video')
+        settings = search_target_size(args, native, budget)
+        if settings is None:
+            p.error('nothing fits the budget; lower --audio-rate or raise --target-size')
+        args.fps, args.width, args.height = settings['fps'], settings['width'], settings['height']
+        args.max_seek = settings.get('max_seek')
+        args.despeckle = settings.get('min_run', 0)
+        args.vector = settings.get('vector')
+        vf = scale_filter(args.width, args.height, args.fit) if native \
+            else f'scale={args.width}:{args.height}'
+        total_pixels = args.width * args.height
+        files = extract_cached(args, args.fps, args.width, args.height, vf)
+        frame_count = len(files)
+
     # --- Build video binary with bit-level RLE ---
-    print('Packing frames with per-frame bit-RLE...')
-    compressed_frames = []
-    total_rle = 0
-    for idx, fn in enumerate(files):
-        if idx % 500 == 0:
-            print(f'  Frame {idx}/{frame_count}...')
-        img = Image.open(os.path.join(args.tmp, fn))
-        bits = image_to_bits(img, args.width, args.height)
-        compressed = bit_rle_compress(bits)
-        compressed_frames.append(compressed)
-        total_rle += len(compressed)
+    if args.colors is None:
+        print('Packing frames with per-frame bit-RLE...')
+    droppable = [False] * frame_count
+    use_deltas = args.max_seek is not None or args.seek_curve
+    if not 0 <= args.ref_slots <= MAX_REF_SLOTS:
+        p.error(f'--ref-slots must be 0..{MAX_REF_SLOTS}')
+    if args.ref_slots and args.max_seek is None:
+        p.error('--ref-slots needs --max-seek')
+    if args.row_index and (not 0 < args.row_index < 256 or
+                           (args.height - 1) // args.row_index > 255):
+        p.error('--row-index must be 1..255 with at most 255 entries per frame')
+    if args.vector is not None and (use_deltas or args.row_index):
+        p.error('--vector frames are all intra: drop --max-seek/--seek-curve/--row-index')
+    if args.vector is not None and (args.width > 255 or args.height > 255):
+        p.error('--vector needs width and height <= 255')
+    if args.rate_cap is not None and (args.max_seek is None or args.ref_slots or
+                                      args.vector is not None):
+        p.error('--rate-cap needs --max-seek, without --ref-slots/--vector')
+    if args.base_fps is not None and (args.max_seek is None or args.ref_slots or
+                                      args.rate_cap is not None or args.vector is not None):
+        p.error('--base-fps needs --max-seek, without --ref-slots/--rate-cap/--vector')
+    if args.base_fps is not None and not 0 < args.base_fps < args.fps:
+        p.error('--base-fps must be below --fps')
+    if args.scroll is not None and (args.max_seek is None or args.rate_cap is not None or
+                                    args.base_fps is not None):
+        p.error('--scroll needs --max-seek, without --rate-cap/--base-fps')
+    if args.dither and (args.despeckle or args.ref_slots or args.vector is not None or
+                        args.rate_cap is not None or args.base_fps is not None or
+                        args.scroll is not None):
+        p.error('--dither codes its own runs: drop --despeckle/--ref-slots/--vector/'
+                '--rate-cap/--base-fps/--scroll')
+    if args.colors is not None and not 2 <= args.colors <= MAX_PALETTE:
+        p.error(f'--colors must be 2..{MAX_PALETTE}')
+    if args.colors is not None and (args.seek_curve or args.ref_slots or args.row_index or
+                                    args.vector is not None or args.despeckle or
+                                    args.rate_cap is not None or args.base_fps is not None or
+                                    args.scroll is not None or args.dither or
+                                    args.thumbs is not None or args.compare):
+        p.error('--colors takes --max-seek only: drop the 1-bit options')
+    if args.max_seek is not None and args.max_seek < 0:
+        p.error('--max-seek must be >= 0')
+    shifts = []
+    if args.colors is not None:
+        print(f'Packing frames as runs of palette indices ({args.colors} colours per scene)...')
+        compressed_frames = encode_indexed(args.tmp, files, args.width, args.height,
+                                           args.colors, args.max_seek, args.scene_cut)
+        flags |= FLAG_INDEXED
+        if any(cf[0] & FRAME_DELTA for cf in compressed_frames):
+            flags |= FLAG_DELTA
+    elif use_deltas:
+        compressed_frames, delta_frames, frame_bits = encode_frames(
+            args.tmp, files, args.width, args.height, deltas=True, min_run=args.despeckle,
+            scroll=args.scroll, shifts=shifts, dithered=args.dither)
+        key_frames, stores = compressed_frames, set()
+        if args.ref_slots:
+            print(f'Searching for recurring shots ({args.ref_slots} reference slots)...')
+            key_frames, stores = plan_references(
+                compressed_frames, delta_frames, frame_bits, args.width, args.height,
+                args.ref_slots, max(1, round(args.ref_gap * args.fps)))
+        if args.rate_cap is None and args.base_fps is None:
+            del frame_bits
+    else:
+        compressed_frames = encode_frames(args.tmp, files, args.width, args.height,
+                                          min_run=args.despeckle, dithered=args.dither)
+    total_rle = sum(len(cf) for cf in compressed_frames)
 
-    raw_bits = frame_count * (total_pixels + 7) // 8
-    print(f'  Bit-RLE total: {total_rle:,} bytes (raw 1-bit would be {raw_bits:,}, '
-          f'ratio {100*total_rle/raw_bits:.1f}%)')
+    if args.colors is None:
+        raw_bits = frame_count * (total_pixels + 7) // 8
+        print(f'  Bit-RLE total: {total_rle:,} bytes (raw 1-bit would be {raw_bits:,}, '
+              f'ratio {100*total_rle/raw_bits:.1f}%)')
+    else:
+        raw = frame_count * total_pixels * 2
+        print(f'  Indexed total: {total_rle:,} bytes (raw RGB565 would be {raw:,}, '
+              f'ratio {100*total_rle/raw:.1f}%)')
+
+    if args.compare and native:
+        ref_tmp = args.tmp + '_legacy'
+        ref_w, ref_h = 180, 135
+        print(f'Encoding legacy {ref_w}x{ref_h} profile for comparison...')
+        ref_files = extract_frames(args.input, ref_tmp, args.fps, f'scale={ref_w}:{ref_h}')
+        ref_frames = encode_frames(ref_tmp, ref_files, ref_w, ref_h)
+        shutil.rmtree(ref_tmp)
+        print_profile_comparison([
+            ('legacy', ref_w, ref_h, ref_frames, False),
+            (args.profile, args.width, args.height, compressed_frames, True),
+        ])
+
+    if args.seek_curve:
+        print_seek_curve(compressed_frames, key_frames, delta_frames, args.fps, stores)
+    if args.max_seek is not None and args.colors is None:    # indexed: placed already
+        if args.rate_cap is not None:
+            compressed_frames = rate_capped(args, frame_bits)
+        elif args.base_fps is not None:
+            compressed_frames, droppable = encode_layers(frame_bits, args.fps, args.base_fps,
+                                                         args.max_seek)
+            flags |= FLAG_REFS | FLAG_LAYERS
+        else:
+            print(f'Placing keyframes (max seek {args.max_seek} frames)...')
+            # scroll frames only scroll as deltas
+            compressed_frames = choose_keyframes(compressed_frames, key_frames, delta_frames,
+                                                 args.max_seek, stores,
+                                                 {i for i, dy in enumerate(shifts) if dy})
+        if shifts:
+            compressed_frames = [mark_scroll(cf, dy) for cf, dy in zip(compressed_frames, shifts)]
+            marked = [scroll_rows(cf) for cf in compressed_frames]
+            rows = spi_rows(marked, args.height)
+            print(f'  Scroll frames: {sum(map(bool, marked))} (tolerance {args.scroll}%); a '
+                  f'scrolling player pushes {100 * rows / (args.height * frame_count):.1f}% '
+                  f'of the video rows')
+        if any(cf[0] & FRAME_DELTA for cf in compressed_frames):
+            flags |= FLAG_DELTA
+        if any(cf[0] & FRAME_STORE for cf in compressed_frames):
+            flags |= FLAG_REFS
+
+    if any(cf[0] & FRAME_PATTERN for cf in compressed_frames):
+        flags |= FLAG_DITHER
+    if args.dither or args.colors is not None:
+        big = sum(len(cf) > MAX_FRAME_BYTES for cf in compressed_frames)
+        if big:
+            print(f'  WARNING: {big} frames exceed the player\'s {MAX_FRAME_BYTES:,}-byte '
+                  f'frame buffer; lower the resolution')
+
+    if args.row_index:
+        before = sum(len(cf) for cf in compressed_frames)
+        compressed_frames = [add_row_index(cf, args.width, args.height, args.row_index)
+                             for cf in compressed_frames]
+        flags |= FLAG_ROW_INDEX
+        after = sum(len(cf) for cf in compressed_frames)
+        print(f'  Row index every {args.row_index} rows: +{after - before:,} bytes '
+              f'({100 * (after - before) / before:.1f}%)')
+
+    # Thumbnails of the pictures as coded (before tracing outlines)
+    thumb_track = b''
+    if args.thumbs is not None:
+        if args.thumbs <= 0 or args.thumb_scale < 1:
+            p.error('--thumbs must be positive and --thumb-scale at least 1')
+        every = max(1, round(args.thumbs * args.fps))
+        thumb_track = track_for(compressed_frames, args.width, args.height, every,
+                                args.thumb_scale)
+        flags |= FLAG_THUMBS
+        print(f'  Thumbnail track: every {every} frames, {len(thumb_track):,} bytes')
+
+    if args.vector is not None:
+        print(f'Tracing outlines (tolerance {args.vector} px)...')
+        vector_frames = [vectorize_frame(bit_rle_decode(cf, total_pixels), args.width,
+                                         args.height, args.vector)[0]
+                         for cf in compressed_frames]
+        total_vec = sum(len(vf) for vf in vector_frames)
+        print(f'  Vector total: {total_vec:,} bytes ({100 * total_vec / total_rle:.1f}% of bit-RLE)')
+        compressed_frames = vector_frames
+        flags |= FLAG_VECTOR
+
+    # Predicted device time per frame, stored in the index for the player's lookahead
+    model = load_model(args.model) if args.model else DEFAULT_MODEL
+    path = default_path(flags)
+    hints, times = hints_for(compressed_frames, args.width, args.height, flags, model)
+    if args.no_cost_hints:
+        hints = [0] * frame_count
+    else:
+        flags |= FLAG_COST_HINTS
 
     # Calculate frame offsets (relative to start of frame data section)
-    offset = 0
+    offset = len(thumb_track)
     frame_offsets = []
     for cf in compressed_frames:
         frame_offsets.append(offset)
@@ -137,19 +794,28 @@ def main():
         #   uint16 width, uint16 height, uint32 frames, uint16 fps, uint16 flags
         out.write(struct.pack('<HHIHH',
                               args.width, args.height,
-                              frame_count, args.fps, 0))
+                              frame_count, args.fps, flags))
 
         # Frame index: frame_count * 4 bytes
-        for off in frame_offsets:
-            out.write(struct.pack('<I', off))
+        for off, drop, hint in zip(frame_offsets, droppable, hints):
+            out.write(struct.pack('<I', index_entry(off, drop, hint)))
 
-        # Frame data
+        # Frame data, after the thumbnail track
+        out.write(thumb_track)
         for cf in compressed_frames:
             out.write(cf)
 
     video_size = os.path.getsize(video_path)
     print(f'Video: {video_path} — {video_size:,} bytes ({video_size/1024/1024:.2f} MB)')
 
+    budget = 1000 / args.fps
+    print(f'Predicted playback ({path} path{", calibrated" if args.model else ""}): '
+          f'{sum(times) / len(times):.1f} ms/frame mean, {max(times):.1f} ms max, '
+          f'budget {budget:.1f} ms')
+    over = sum(t > budget for t in times)
+    if over:
+        print(f'  {over} frames predicted over budget')
+
     # --- Extract audio as unsigned 8-bit PCM ---
     audio_path = os.path.join(args.data_dir, 'bad_apple_audio.raw')
     print(f'Extracting audio at {args.audio_rate}Hz, unsigned 8-bit mono...')
@@ -163,12 +829,11 @@ def main():
         audio_path
     ])
 
-    audio_size = os.path.getsize(audio_path)
-    print(f'Audio: {audio_path} — {audio_size:,} bytes ({audio_size/1024/1024:.2f} MB)')
+    audio_bytes = os.path.getsize(audio_path)
+    print(f'Audio: {audio_path} — {audio_bytes:,} bytes ({audio_bytes/1024/1024:.2f} MB)')
 
-    total = video_size + audio_size
-    partition_size = 0x5F0000  # from partitions.csv
-    usable = int(partition_size * 0.95)  # LittleFS overhead
+    total = video_size + audio_bytes
+    usable = video_budget(PARTITIONS_CSV, 0)
     print(f'\nTotal data: {total:,} bytes ({total/1024/1024:.2f} MB)')
     print(f'LittleFS usable: ~{usable:,} bytes ({usable/1024/1024:.2f} MB)')
     if total > usable:
@@ -0,0 +1,261 @@
+"""Read the bad_apple.bin video container.
+
+Layout (see README "Data format"):
+  Header (12 bytes): uint16 width, uint16 height, uint32 frames, uint16 fps, uint16 flags
+  Frame index:       uint32 offset[frames] (relative to the frame data section;
+                     bit 31 marks a droppable frame in FLAG_LAYERS files,
+                     bits 24..30 hold a cost hint in FLAG_COST_HINTS files)
+  Frame data:        per-frame encoded payloads, after the thumbnail track in
+                     FLAG_THUMBS files (see thumbnails.py)
+"""
+import struct
+
+HEADER_FMT = '<HHIHH'
+HEADER_SIZE = struct.calcsize(HEADER_FMT)
+
+# Header flags (must match src/codec.h)
+FLAG_NATIVE = 0x0001   # frames are in panel orientation/size: no rotate/scale
+FLAG_DELTA = 0x0002    # some frames are deltas against the previous frame
+FLAG_REFS = 0x0004     # frames use long-term reference slots
+FLAG_ROW_INDEX = 0x0008  # frames carry row-restart indexes
+FLAG_VECTOR = 0x0010   # frames are polygon outlines (see vectorize.py), not bit-RLE
+FLAG_LAYERS = 0x0020   # base layer + droppable frames nothing is coded against
+FLAG_COST_HINTS = 0x0040  # index entries carry predicted frame times
+FLAG_THUMBS = 0x0080   # thumbnail track opens the frame data section
+FLAG_DITHER = 0x0100   # frames may hold dither pattern runs (see dither.py)
+FLAG_INDEXED = 0x0200  # frames are palette-indexed colour (see palette.py), not bit-RLE
+
+INDEX_DROPPABLE = 0x80000000
+INDEX_OFFSET_MASK = 0x00FFFFFF
+INDEX_HINT_SHIFT = 24
+COST_HINT_MS = 0.5     # one hint step; hints saturate at 127 steps
+
+# Frame type byte: bit 0 = first run's bit, bit 1 = delta (XOR) frame,
+# bit 2 = delta against a reference slot (uint8 slot follows),
+# bit 3 = keep this intra frame in a slot (uint8 slot follows),
+# bit 4 = row-restart index follows the slot bytes: uint8 K, uint8 n,
+#         n x (uint16 run, uint16 skip) -- row (i+1)*K starts `skip` pixels
+#         into run number `run`,
+# bit 5 = (plain delta) the picture is the previous one moved up by an int8
+#         number of rows (down if negative), after the slot bytes; see scroll.py
+# bit 6 = run words with bit 15 set are dither pattern runs: level k in
+#         bits 11..14, length in bits 0..10; see dither.py
+# bit 7 = (FLAG_INDEXED) uint8 n + n x uint16 RGB565 palette after the slot
+#         bytes; the words are indexed runs (see palette.py)
+FRAME_DELTA = 0x02
+FRAME_REF = 0x04
+FRAME_STORE = 0x08
+FRAME_ROWS = 0x10
+FRAME_SCROLL = 0x20
+FRAME_PATTERN = 0x40
+FRAME_PALETTE = 0x80
+MAX_REF_SLOTS = 8
+MAX_FRAME_BYTES = 16384  # the player's frame buffer (MAX_RLE_SIZE in src/codec.h)
+
+RUN_PATTERN = 0x8000
+RUN_LEVEL_SHIFT = 11
+RUN_PATTERN_LENGTH = 0x07FF
+# Level k sets pixel (x, y) where BAYER4[y & 3][x & 3] < k
+BAYER4 = ((0, 8, 2, 10), (12, 4, 14, 6), (3, 11, 1, 9), (15, 7, 13, 5))
+
+# Indexed runs: palette index in bits 12..15, length in bits 0..11; a zero
+# word is followed by a uint16 count of pixels kept (delta frames)
+MAX_PALETTE = 16
+INDEX_SHIFT = 12
+INDEX_RUN_LENGTH = 0x0FFF
+
+
+class Container:
+    def __init__(self, width, height, fps, flags, frames, header=b'', droppable=None,
+                 hints=None, thumbs=b''):
+        self.width = width
+        self.height = height
+        self.fps = fps
+        self.flags = flags
+        self.frames = frames    # list of bytes, one per frame
+        self.header = header    # raw 12-byte header as stored
+        self.droppable = droppable or [False] * len(frames)
+        self.hints = hints or [0] * len(frames)   # cost hint steps, 0 = none
+        self.thumbs = thumbs    # raw thumbnail track (bytes before frame 0)
+
+    @property
+    def total_pixels(self):
+        return self.width * self.height
+
+
+def read_container(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    width, height, count, fps, flags = struct.unpack_from(HEADER_FMT, data)
+    entries = struct.unpack_from(f'<{count}I', data, HEADER_SIZE)
+    offsets = [e & INDEX_OFFSET_MASK for e in entries]
+    start = HEADER_SIZE + 4 * count
+    ends = offsets[1:] + [len(data) - start]
+    frames = [data[start + a:start + b] for a, b in zip(offsets, ends)]
+    return Container(width, height, fps, flags, frames, data[:HEADER_SIZE],
+                     [bool(e & INDEX_DROPPABLE) for e in entries],
+                     [e >> INDEX_HINT_SHIFT & 0x7F for e in entries],
+                     data[start:start + offsets[0]] if count else b'')
+
+
+def index_entry(offset, droppable=False, hint=0):
+    if offset > INDEX_OFFSET_MASK:
+        raise ValueError(f'frame offset {offset:,} is past 16 MB')
+    return offset | (INDEX_DROPPABLE if droppable else 0) | min(hint, 0x7F) << INDEX_HINT_SHIFT
+
+
+def cost_hint(ms):
+    """Index hint steps for a predicted frame time."""
+    return min(0x7F, max(1, round(ms / COST_HINT_MS)))
+
+
+def is_delta(frame):
+    return bool(frame) and bool(frame[0] & FRAME_DELTA)
+
+
+def slots_end(frame):
+    """Bytes before the row index (or the runs)."""
+    if not frame:
+        return 0
+    return (1 + bool(frame[0] & FRAME_REF) + bool(frame[0] & FRAME_STORE)
+            + bool(frame[0] & FRAME_SCROLL))
+
+
+def header_size(frame):
+    """Bytes before the first run."""
+    at = slots_end(frame)
+    if frame and frame[0] & FRAME_ROWS:
+        at += 2 + 4 * frame[at + 1]
+    if frame and frame[0] & FRAME_PALETTE:
+        at += 1 + 2 * frame[at]
+    return at
+
+
+def ref_slot(frame):
+    return frame[1] if frame and frame[0] & FRAME_REF else None
+
+
+def store_slot(frame):
+    if not frame or not frame[0] & FRAME_STORE:
+        return None
+    return frame[1 + bool(frame[0] & FRAME_REF)]
+
+
+def scroll_rows(frame):
+    """Rows a FRAME_SCROLL delta moved the picture up by, 0 for other frames."""
+    if not frame or not frame[0] & FRAME_SCROLL:
+        return 0
+    return struct.unpack_from('<b', frame, slots_end(frame) - 1)[0]
+
+
+def run_words(frame):
+    """The frame's run words as stored."""
+    hdr = header_size(frame)
+    return [w for (w,) in struct.iter_unpack('<H', frame[hdr:hdr + (len(frame) - hdr) // 2 * 2])]
+
+
+def run_lengths(frame):
+    """Pixels each run word covers (pattern runs included)."""
+    patterns = bool(frame) and frame[0] & FRAME_PATTERN
+    return [w & RUN_PATTERN_LENGTH if patterns and w & RUN_PATTERN else w
+            for w in run_words(frame)]
+
+
+def dither_bits(level, start, n, width):
+    """Pixels start..start+n of a width-wide picture at dither `level`."""
+    return [int(BAYER4[i // width & 3][i % width & 3] < level) for i in range(start, start + n)]
+
+
+def bit_rle_decode(frame, total_pixels, prev=None, width=None):
+    """Decode one bit-RLE frame to a flat list of 0/1 values.
+
+    Delta frames are applied to `prev` (the previous decoded frame, or the
+    reference slot's picture for FRAME_REF frames). Frames with dither
+    pattern runs need the picture `width`.
+    """
+    if not frame:
+        return [0] * total_pixels
+    patterns = bool(frame[0] & FRAME_PATTERN)
+    if patterns and not width:
+        raise ValueError('dither pattern frames need the picture width')
+    bit = frame[0] & 1
+    bits = []
+    spans = []          # pattern runs, set in delta frames too
+    for word in run_words(frame):
+        if patterns and word & RUN_PATTERN:
+            n = word & RUN_PATTERN_LENGTH
+            spans.append((len(bits), len(bits) + n))
+            bits.extend(dither_bits(word >> RUN_LEVEL_SHIFT & 0x0F, len(bits), n, width))
+        else:
+            bits.extend([bit] * word)
+        bit ^= 1
+    del bits[total_pixels:]
+    bits.extend([0] * (total_pixels - len(bits)))
+    if is_delta(frame):
+        base = prev if prev is not None else [0] * total_pixels
+        runs = bits
+        bits = [a ^ b for a, b in zip(base, runs)]
+        for a, b in spans:
+            bits[a:b] = runs[a:b]
+    return bits
+
+
+def frame_palette(frame):
+    """RGB565 palette a FRAME_PALETTE frame carries, None for other frames."""
+    if not frame or not frame[0] & FRAME_PALETTE:
+        return None
+    at = slots_end(frame)
+    return list(struct.unpack_from(f'<{frame[at]}H', frame, at + 1))
+
+
+def indexed_lengths(frame):
+    """Pixels each run of an indexed frame covers (keep runs included)."""
+    lengths = []
+    words = iter(run_words(frame))
+    for word in words:
+        lengths.append(word & INDEX_RUN_LENGTH if word else next(words, 0))
+    return lengths
+
+
+def indexed_decode(frame, total_pixels, prev=None, palette=None):
+    """Decode one indexed frame to (flat list of palette indices, palette).
+
+    Delta frames keep the pixels of `prev`; frames without a palette of
+    their own use `palette`.
+    """
+    palette = frame_palette(frame) or palette or []
+    out = list(prev) if prev is not None and is_delta(frame) else []
+    at = 0
+    words = iter(run_words(frame))
+    for word in words:
+        if not word:
+            at += next(words, 0)
+            continue
+        n = word & INDEX_RUN_LENGTH
+        out[at:at + n] = [word >> INDEX_SHIFT] * n
+        at += n
+    if not is_delta(frame):
+        out[at:] = [0] * (total_pixels - at)
+    del out[total_pixels:]
+    return out, palette
+
+
+class FrameDecoder:
+    """Decodes a frame sequence, tracking the previous picture and the
+    long-term reference slots."""
+
+    def __init__(self, total_pixels, width=None):
+        self.total_pixels = total_pixels
+        self.width = width
+        self.prev = None
+        self.slots = {}
+
+    def decode(self, frame):
+        slot = ref_slot(frame)
+        base = self.slots.get(slot) if slot is not None else self.prev
+        bits = bit_rle_decode(frame, self.total_pixels, base, self.width)
+        slot = store_slot(frame)
+        if slot is not None:
+            self.slots[slot] = bits
+        self.prev = bits
+        return bits
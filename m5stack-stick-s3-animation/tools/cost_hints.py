@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Per-frame cost hints in the frame index (FLAG_COST_HINTS).
+
+Bits 24..30 of each index entry hold the predicted device time of the frame
+(read, decode, compose and push on the player's default path) in 0.5 ms
+steps, from the same model as src/cost_model.*. The player looks a few
+frames ahead and starts an expensive frame early, during the slack left by
+cheaper ones, instead of finding out it is late after decoding it.
+
+build_data.py writes the hints from the default model (or --model). This
+tool re-hints an existing container, e.g. with the `model ...` lines of a
+device bench run, or strips them for firmware that predates them.
+
+Usage:
+  python tools/cost_hints.py data/bad_apple.bin --model bench.log
+  python tools/cost_hints.py data/bad_apple.bin -o hinted.bin
+  python tools/cost_hints.py data/bad_apple.bin --strip
+"""
+import argparse
+import struct
+
+from container import (COST_HINT_MS, FLAG_COST_HINTS, FLAG_NATIVE, FLAG_VECTOR, HEADER_FMT,
+                       HEADER_SIZE, INDEX_OFFSET_MASK, INDEX_DROPPABLE, cost_hint,
+                       header_size, index_entry, read_container)
+from rate_control import DEFAULT_MODEL, frame_times, load_model
+
+
+def default_path(flags):
+    """Path the player picks for a file (angle 90 for non-native files)."""
+    return 'vector' if flags & FLAG_VECTOR else 'native' if flags & FLAG_NATIVE else 'rotate-zoom'
+
+
+def hints_for(frames, width, height, flags, model=DEFAULT_MODEL):
+    """(hint steps, predicted ms) per frame."""
+    times = frame_times(model, default_path(flags), frames, width, height, header_size)
+    return [cost_hint(t) for t in times], times
+
+
+def main():
+    p = argparse.ArgumentParser(description='Write predicted frame times into the frame index')
+    p.add_argument('input', help='bad_apple.bin')
+    p.add_argument('-o', '--output', default=None, help='Write here instead of in place')
+    p.add_argument('--model', default=None, metavar='FILE',
+                   help='Device bench log with `model ...` lines (default: built-in figures)')
+    p.add_argument('--strip', action='store_true', help='Remove the hints')
+    args = p.parse_args()
+
+    c = read_container(args.input)
+    with open(args.input, 'rb') as f:
+        data = bytearray(f.read())
+    n = len(c.frames)
+    entries = struct.unpack_from(f'<{n}I', data, HEADER_SIZE)
+    if args.strip:
+        hints, flags = [0] * n, c.flags & ~FLAG_COST_HINTS
+    else:
+        model = load_model(args.model) if args.model else DEFAULT_MODEL
+        hints, times = hints_for(c.frames, c.width, c.height, c.flags, model)
+        flags = c.flags | FLAG_COST_HINTS
+        budget = 1000 / c.fps
+        print(f'{default_path(c.flags)} path{", calibrated" if args.model else ""}: '
+              f'{sum(times) / n:.1f} ms/frame mean, {max(times):.1f} ms max, '
+              f'budget {budget:.1f} ms, {sum(t > budget for t in times)} frames over')
+        print(f'  hints {min(hints)}..{max(hints)} x {COST_HINT_MS} ms'
+              f'{", some saturated" if max(hints) == 0x7F else ""}')
+    struct.pack_into(HEADER_FMT, data, 0, c.width, c.height, n, c.fps, flags)
+    struct.pack_into(f'<{n}I', data, HEADER_SIZE,
+                     *[index_entry(e & INDEX_OFFSET_MASK, bool(e & INDEX_DROPPABLE), h)
+                       for e, h in zip(entries, hints)])
+    out = args.output or args.input
+    with open(out, 'wb') as f:
+        f.write(data)
+    print(f'{out}: {"hints removed" if args.strip else f"{n} frames hinted"}')
+
+
+if __name__ == '__main__':
+    main()
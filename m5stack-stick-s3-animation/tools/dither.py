@@ -0,0 +1,106 @@
+"""Ordered-dither halftones stored as pattern runs (FLAG_DITHER).
+
+Thresholding keeps Bad Apple's silhouettes but drops every grey. A 4x4
+Bayer dither keeps 17 levels, but its pixels alternate every one or two
+columns: as plain bit-RLE that is a run per pixel or two, frames outgrow
+the player's 16 KB buffer and decoding goes pixel by pixel. A flat area of
+one grey level dithers to the same pattern wherever it lies, so the
+encoder stores it as a pattern run instead ("the next n pixels show level
+k", FRAME_PATTERN, see container.py). The player fills such spans a word
+at a time from its table of pattern rows (src/codec.cpp), so halftones stay
+compact and decode at run speed.
+
+Levels 0 and 16 are plain black and white. A span of one level becomes a
+pattern run only where that takes fewer words than its plain runs, and in
+delta frames only where the picture changed. build_data.py --dither encodes with this.
+"""
+from itertools import groupby
+
+from container import (BAYER4, FRAME_DELTA, FRAME_PATTERN, RUN_LEVEL_SHIFT,
+                       RUN_PATTERN, RUN_PATTERN_LENGTH)
+
+LEVELS = 16             # pattern levels 1..15 are stored; 0 and 16 are plain
+MAX_PLAIN = 0x7FFF      # plain runs must leave bit 15 clear in pattern frames
+
+
+def gray_level(gray):
+    """Dither level 0..16 of a 0..255 grey value (16 = black, all pixels set)."""
+    return ((255 - gray) * LEVELS + 127) // 255
+
+
+def dither(levels, width):
+    """1-bit picture of a level map: pixel set where the Bayer threshold is below its level."""
+    return [int(BAYER4[i // width & 3][i % width & 3] < k) for i, k in enumerate(levels)]
+
+
+def _segments(levels, bits, plain, prev):
+    """(level, start, end) in raster order; level None for plain pixels."""
+    at = 0
+    for k, group in groupby(levels):
+        n = len(list(group))
+        end = at + n
+        pattern = 0 < k < LEVELS
+        if pattern and prev is not None and bits[at:end] == prev[at:end]:
+            pattern = False             # unchanged: a 0-run keeps it for less
+        elif pattern:
+            # a pattern run (plus a likely 0-run to regain the alternation)
+            # must beat the plain runs it replaces
+            runs = 1 + sum(a != b for a, b in zip(plain[at:end - 1], plain[at + 1:end]))
+            pattern = runs > (n + RUN_PATTERN_LENGTH - 1) // RUN_PATTERN_LENGTH + 1
+        yield (k if pattern else None), at, end
+        at = end
+
+
+def pattern_compress(levels, bits, width, prev=None):
+    """Frame for picture `bits` (= dither(levels, width)), intra or, against
+    `prev`, a delta. Runs of one level become pattern runs; the rest is the
+    usual alternating runs (of the XOR with `prev` for deltas). Frames with
+    no span worth a pattern come out as plain bit-RLE."""
+    plain = bits if prev is None else [a ^ b for a, b in zip(prev, bits)]
+    words = []
+    first = None            # value of the first run
+    expect = 0              # value of the run the next word stands for
+
+    def emit_plain(value, n):
+        nonlocal expect, first
+        if first is None:
+            first = expect = value
+        if value != expect:
+            words.append(0)
+            expect ^= 1
+        while n > MAX_PLAIN:
+            words.extend((MAX_PLAIN, 0))
+            n -= MAX_PLAIN
+        words.append(n)
+        expect ^= 1
+
+    def emit_pattern(k, n):
+        nonlocal expect, first
+        if first is None:
+            first = expect = 0
+        while n:
+            m = min(n, RUN_PATTERN_LENGTH)
+            words.append(RUN_PATTERN | k << RUN_LEVEL_SHIFT | m)
+            expect ^= 1
+            n -= m
+
+    patterns = False
+    for k, start, end in _segments(levels, bits, plain, prev):
+        if k is None:
+            for value, group in groupby(plain[start:end]):
+                emit_plain(value, len(list(group)))
+        else:
+            emit_pattern(k, end - start)
+            patterns = True
+    # plain runs after a pattern may split where the levels change: join them
+    joined = []
+    for w in words:
+        if joined and not w & RUN_PATTERN and len(joined) >= 2 and joined[-1] == 0 and \
+                not joined[-2] & RUN_PATTERN and joined[-2] + w <= MAX_PLAIN:
+            joined[-2] += w
+            joined.pop()
+        else:
+            joined.append(w)
+    kind = (first or 0) | (FRAME_DELTA if prev is not None else 0) | \
+        (FRAME_PATTERN if patterns else 0)
+    return bytes([kind]) + b''.join(w.to_bytes(2, 'little') for w in joined)
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Input traces (src/input_trace.h): button and tilt events for replay.
+
+The player records one with the serial command `trace rec` (the next pass
+goes to /input.trace) and replays it with `trace play`; the host build
+replays the same file with `bad_apple_host replay VIDEO --input TRACE`.
+Each event is applied before the frame it was recorded on, so a replay is
+the same pass on every build.
+
+This tool prints a trace as text (the same lines as `trace show` on the
+device) and builds one from text, to script a scenario or edit a recording:
+
+  frame ms name [x y z]      # name: invert pause colors zoom tilt seek
+  120 4000 invert
+  300 10000 colors 0x1ff8 0x0800   # fg, bg in panel byte order
+  450 15000 zoom 2
+  451 15033 tilt 250 -120 980      # accelerometer, mg
+  900 30000 seek 150               # to frame x + 65536 * y
+
+Usage:
+  python tools/input_trace.py show data/input.trace
+  python tools/input_trace.py build scenario.txt -o data/input.trace
+(pio run -t uploadfs puts data/input.trace on the device.)
+"""
+import argparse
+import struct
+import sys
+
+MAGIC = b'BAIT'
+VERSION = 1
+HEADER_FMT = '<4sHH'
+EVENT_FMT = '<IIBxhhh'
+EVENT_SIZE = struct.calcsize(EVENT_FMT)
+TYPES = {'invert': 1, 'pause': 2, 'colors': 3, 'zoom': 4, 'tilt': 5, 'seek': 6}
+NAMES = {v: k for k, v in TYPES.items()}
+
+
+def read_trace(path):
+    """[(frame, ms, type, x, y, z)]"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    size = struct.calcsize(HEADER_FMT)
+    magic, version, _ = struct.unpack_from(HEADER_FMT, data) if len(data) >= size else (b'', 0, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError(f'{path}: not an input trace (version {VERSION})')
+    n = (len(data) - size) // EVENT_SIZE
+    return [struct.unpack_from(EVENT_FMT, data, size + i * EVENT_SIZE) for i in range(n)]
+
+
+def write_trace(path, events):
+    with open(path, 'wb') as f:
+        f.write(struct.pack(HEADER_FMT, MAGIC, VERSION, 0))
+        for e in events:
+            f.write(struct.pack(EVENT_FMT, *e))
+
+
+def _int16(text):
+    v = int(text, 0)
+    if not -0x8000 <= v <= 0xFFFF:
+        raise ValueError(f'{text} does not fit 16 bits')
+    return v - 0x10000 if v >= 0x8000 else v
+
+
+def parse_line(line):
+    """One text event, None for blank and comment lines."""
+    words = line.split('#', 1)[0].split()
+    if not words:
+        return None
+    if len(words) < 3 or len(words) > 6 or words[2] not in TYPES:
+        raise ValueError(f'expected "frame ms name [x y z]": {line.strip()}')
+    xyz = [_int16(w) for w in words[3:]] + [0] * (6 - len(words))
+    return (int(words[0], 0), int(words[1], 0), TYPES[words[2]], *xyz)
+
+
+def format_event(e):
+    frame, ms, kind, x, y, z = e
+    return f'{frame} {ms} {NAMES.get(kind, "?")} {x} {y} {z}'
+
+
+def main():
+    p = argparse.ArgumentParser(description='Show or build input traces for replay')
+    sub = p.add_subparsers(dest='cmd', required=True)
+    s = sub.add_parser('show', help='Print a trace as text')
+    s.add_argument('trace')
+    b = sub.add_parser('build', help='Write a trace from text lines ("-" reads stdin)')
+    b.add_argument('text')
+    b.add_argument('-o', '--output', required=True)
+    args = p.parse_args()
+
+    if args.cmd == 'show':
+        try:
+            events = read_trace(args.trace)
+        except ValueError as e:
+            p.error(str(e))
+        for e in events:
+            print(format_event(e))
+        return
+
+    src = sys.stdin if args.text == '-' else open(args.text)
+    events = []
+    with src:
+        for n, line in enumerate(src, 1):
+            try:
+                e = parse_line(line)
+            except ValueError as err:
+                p.error(f'line {n}: {err}')
+            if e:
+                events.append(e)
+    # frames only go back after a seek, times never
+    if any(b[1] < a[1] for a, b in zip(events, events[1:])):
+        p.error('events must be in time order')
+    write_trace(args.output, events)
+    print(f'{args.output}: {len(events)} events over {events[-1][1] if events else 0} ms')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,83 @@
+"""Keyframe placement for delta-coded videos.
+
+Every frame can be stored intra (self-contained bit-RLE) or as a delta
+against the previous frame. Deltas are small inside a scene and larger than
+an intra frame across a hard cut. place_keyframes() picks the intra frames
+that minimise the total size while no frame is more than `max_seek` deltas
+away from the keyframe it is decoded from (the cost of seeking to it).
+"""
+
+
+def scene_cuts(intra_sizes, delta_sizes):
+    """Frames where the delta is no smaller than coding the frame intra."""
+    return [i for i in range(1, len(intra_sizes)) if delta_sizes[i] >= intra_sizes[i]]
+
+
+def place_keyframes(intra_sizes, delta_sizes, max_seek=None, forced=(), avoid=()):
+    """Return (keyframe indices, total bytes) of the smallest valid layout.
+
+    intra_sizes[i] / delta_sizes[i] are the encoded sizes of frame i either
+    way (delta_sizes[0] is ignored: frame 0 is always a keyframe). With
+    max_seek=None the seek distance is unbounded. Frames in `forced` are
+    always keyframes; frames in `avoid` only when max_seek leaves no other
+    choice.
+    """
+    n = len(intra_sizes)
+    if n == 0:
+        return [], 0
+    span = n if max_seek is None else max_seek + 1    # frames per keyframe group
+
+    # prefix[i] = sum of delta sizes of frames < i
+    prefix = [0] * (n + 1)
+    for i in range(1, n):
+        prefix[i + 1] = prefix[i] + delta_sizes[i]
+
+    # outweighs any saving, so an avoided keyframe is only taken when forced
+    penalty = sum(intra_sizes) + prefix[n] + 1 if avoid else 0
+
+    def group(k, end):
+        """Bytes for keyframe k followed by deltas up to end (exclusive)."""
+        return intra_sizes[k] + prefix[end] - prefix[k + 1] + (penalty if k in avoid else 0)
+
+    # latest[e] = last forced keyframe before e: no group may span it
+    latest = [0] * (n + 1)
+    for e in range(1, n + 1):
+        latest[e] = e - 1 if e - 1 in forced else latest[e - 1]
+
+    # best[e] = smallest size of frames [0, e) where frame e starts a new group
+    inf = float('inf')
+    best = [inf] * (n + 1)
+    prev = [0] * (n + 1)
+    best[0] = 0
+    for e in range(1, n + 1):
+        for k in range(max(latest[e], e - span), e):
+            if best[k] == inf:
+                continue
+            cost = best[k] + group(k, e)
+            if cost < best[e]:
+                best[e] = cost
+                prev[e] = k
+
+    keys = []
+    e = n
+    while e > 0:
+        e = prev[e]
+        keys.append(e)
+    keys.reverse()
+    return keys, best[n] - penalty * sum(1 for k in keys if k in avoid)
+
+
+def max_seek_of(keys, n):
+    """Largest number of deltas any frame needs after its keyframe."""
+    bounds = list(keys) + [n]
+    return max(b - a - 1 for a, b in zip(bounds, bounds[1:]))
+
+
+def seek_curve(intra_sizes, delta_sizes, limits, forced=()):
+    """[(max_seek limit, keyframe count, total bytes, actual max seek)]."""
+    n = len(intra_sizes)
+    rows = []
+    for limit in limits:
+        keys, total = place_keyframes(intra_sizes, delta_sizes, limit, forced)
+        rows.append((limit, len(keys), total, max_seek_of(keys, n)))
+    return rows
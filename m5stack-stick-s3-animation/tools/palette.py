@@ -0,0 +1,132 @@
+"""Indexed-colour clips with a palette per scene (FLAG_INDEXED).
+
+Clips drawn in a few flat colours keep their look with 4-16 of them, and
+their frames still come out as long runs. build_data.py --colors N cuts the
+clip into scenes where the picture changes abruptly, picks N colours per
+scene (median cut over a sample of its frames) and codes every frame as
+runs of palette indices:
+
+  uint16 word     palette index in bits 12..15, run length in bits 0..11
+  0, uint16 n     keep n pixels of the previous picture (delta frames)
+
+Every intra frame carries its scene's palette (FRAME_PALETTE: uint8 n, then
+n x uint16 RGB565), so any keyframe decodes on its own, and scene starts are
+always intra. The player fills each run through the palette as a lookup
+table (src/indexed.*), so a new scene costs it a table swap.
+"""
+import struct
+from itertools import groupby
+
+from PIL import Image
+
+from container import FRAME_DELTA, FRAME_PALETTE, INDEX_RUN_LENGTH, INDEX_SHIFT
+
+SCENE_CUT = 64.0        # mean colour change (0..255) between frames that starts a scene
+SAMPLE_FRAMES = 8       # frames of a scene its palette is picked from
+MAX_KEEP = 0xFFFF
+
+
+def rgb565(r, g, b):
+    return (r & 0xF8) << 8 | (g & 0xFC) << 3 | b >> 3
+
+
+def rgb888(c):
+    """RGB565 widened back to 8 bits per channel."""
+    r, g, b = c >> 11, c >> 5 & 0x3F, c & 0x1F
+    return (r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2)
+
+
+def signature(img):
+    """Tiny colour thumbnail, for telling scenes apart."""
+    return img.convert('RGB').resize((16, 16)).tobytes()
+
+
+def scene_starts(signatures, cut=SCENE_CUT):
+    """First frame of each scene: where the thumbnail changes by more than
+    `cut` on average."""
+    starts = [0]
+    for i in range(1, len(signatures)):
+        a, b = signatures[i - 1], signatures[i]
+        if sum(abs(x - y) for x, y in zip(a, b)) / len(a) > cut:
+            starts.append(i)
+    return starts
+
+
+def scene_palette(images, colors):
+    """Up to `colors` RGB565 colours for a scene, by median cut over its
+    sample `images` (RGB, all the same size)."""
+    w, h = images[0].size
+    strip = Image.new('RGB', (w, h * len(images)))
+    for i, img in enumerate(images):
+        strip.paste(img, (0, i * h))
+    q = strip.quantize(colors, method=Image.Quantize.MEDIANCUT)
+    flat = q.getpalette()
+    used = sorted(i for _, i in q.getcolors(256))
+    palette = []
+    for i in used:
+        c = rgb565(*flat[3 * i:3 * i + 3])
+        if c not in palette:
+            palette.append(c)
+    return palette
+
+
+def map_image(img, palette):
+    """Palette index of every pixel (nearest colour, no dithering)."""
+    flat = [v for c in palette for v in rgb888(c)]
+    pimg = Image.new('P', (1, 1))
+    # repeat the palette over all 256 entries: a padded black would win ties
+    pimg.putpalette((flat * (256 // len(palette) + 1))[:768])
+    q = img.convert('RGB').quantize(palette=pimg, dither=Image.Dither.NONE)
+    n = len(palette)
+    return [i % n for i in q.tobytes()]
+
+
+def _paint_over(span, last):
+    """Whether painting unchanged pixels takes fewer words than keeping them
+    (a keep is two words): at most one run once merged with `last`."""
+    runs = [v for v, _ in groupby(span)]
+    return len(runs) - (runs[0] == last) <= 1 and len(span) <= INDEX_RUN_LENGTH
+
+
+def _paint(words, value, n):
+    while n:
+        m = min(n, INDEX_RUN_LENGTH)
+        words.append(value << INDEX_SHIFT | m)
+        n -= m
+
+
+def indexed_compress(indices, palette=None, prev=None):
+    """Frame for picture `indices`: intra (with `palette`) or, against the
+    previous picture `prev`, a delta of paint and keep runs."""
+    kind = (FRAME_DELTA if prev is not None else 0) | (FRAME_PALETTE if palette else 0)
+    out = bytearray([kind])
+    if palette:
+        out.append(len(palette))
+        out += struct.pack(f'<{len(palette)}H', *palette)
+    words = []
+    if prev is None:
+        for value, group in groupby(indices):
+            _paint(words, value, len(list(group)))
+    else:
+        at = 0
+        last = None         # colour of the paint run just written
+        for same, group in groupby(a == b for a, b in zip(prev, indices)):
+            n = len(list(group))
+            span = indices[at:at + n]
+            if same and not _paint_over(span, last):
+                last = None
+                while n:
+                    m = min(n, MAX_KEEP)
+                    words.extend((0, m))
+                    n -= m
+                    at += m
+                continue
+            for value, run in groupby(span):
+                k = len(list(run))
+                if value == last and (words[-1] & INDEX_RUN_LENGTH) + k <= INDEX_RUN_LENGTH:
+                    words[-1] += k          # same colour as the run before: one word
+                else:
+                    _paint(words, value, k)
+                last = value
+            at += n
+    return bytes(out) + struct.pack(f'<{len(words)}H', *words)
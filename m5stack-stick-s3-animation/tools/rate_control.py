@@ -0,0 +1,179 @@
+"""Target-size rate control for build_data.py --target-size.
+
+Walks a quality ladder from best to worst and stops at the first rung whose
+encoding fits the byte budget:
+
+  rungs     (fps, scale) -- full resolution first, then smaller pictures,
+            then lower frame rates
+  per rung  lossless codings first (intra only, then deltas with the
+            shortest keyframe interval that fits), then lossy ones (run
+            despeckling at growing thresholds, vector outlines at growing
+            tolerances), of which the one with the lowest pixel error wins
+
+The budget defaults to the LittleFS partition in partitions.csv, less
+filesystem overhead and the audio track. Playback cost of the result is
+predicted with the same model as src/cost_model.* (default coefficients, or
+`model ...` lines from a device bench run).
+"""
+import math
+import re
+
+LITTLEFS_USABLE = 0.95        # LittleFS metadata/wear overhead
+HEADER_BYTES = 12
+
+DELTA_SEEKS = [15, 30, 60, 120]
+DESPECKLE = [2, 3, 4, 6]
+VECTOR_TOLERANCES = [0.5, 1.0, 2.0]
+LOSSY_MAX_SEEK = 60
+LOWER_FPS = [12, 10, 8]
+SCALES = [1.0, 0.85, 0.7, 0.55]
+
+
+def partition_size(csv_path, subtype='spiffs'):
+    """Size of the data partition the firmware mounts as LittleFS."""
+    with open(csv_path) as f:
+        for line in f:
+            cols = [c.strip() for c in line.split('#')[0].split(',')]
+            if len(cols) >= 5 and cols[2] == subtype:
+                return int(cols[4], 0)
+    raise ValueError(f'no {subtype} partition in {csv_path}')
+
+
+def audio_size(frames, fps, rate):
+    """Bytes of unsigned 8-bit mono PCM covering the video."""
+    return math.ceil(frames / fps * rate)
+
+
+def video_budget(csv_path, audio_bytes):
+    return int(partition_size(csv_path) * LITTLEFS_USABLE) - audio_bytes
+
+
+def ladder(fps, native):
+    """(fps, scale) rungs, best first. Native profiles keep the panel size."""
+    scales = [1.0] if native else SCALES
+    rungs = [(fps, s) for s in scales]
+    rungs += [(f, scales[-1]) for f in LOWER_FPS if f < fps]
+    return rungs
+
+
+def container_bytes(frames_bytes, frame_count):
+    return HEADER_BYTES + 4 * frame_count + frames_bytes
+
+
+# ---- Despeckling (the lossy knob for bit-RLE) ----
+
+def despeckle(bits, min_run):
+    """Flip runs shorter than `min_run` pixels to the surrounding value.
+
+    Fewer, longer runs: smaller intra frames and calmer deltas, at the cost
+    of thin lines and specks."""
+    runs = []
+    prev, n = bits[0], 0
+    for b in bits:
+        if b == prev:
+            n += 1
+        else:
+            runs.append((prev, n))
+            prev, n = b, 1
+    runs.append((prev, n))
+    out = []
+    i = 0
+    while i < len(runs):
+        value, n = runs[i]
+        if n < min_run and out and i + 1 < len(runs):
+            # absorb this run and the next (same value as the previous)
+            pv, pn = out[-1]
+            out[-1] = (pv, pn + n + runs[i + 1][1])
+            i += 2
+            continue
+        if out and out[-1][0] == value:
+            out[-1] = (value, out[-1][1] + n)
+        else:
+            out.append((value, n))
+        i += 1
+    flat = []
+    for value, n in out:
+        flat.extend([value] * n)
+    return flat
+
+
+def pixel_error(a_frames, b_frames):
+    wrong = total = 0
+    for a, b in zip(a_frames, b_frames):
+        wrong += sum(x != y for x, y in zip(a, b))
+        total += len(a)
+    return wrong / total if total else 0.0
+
+
+# ---- Search ----
+
+def choose(budget, rung_options):
+    """First rung with a fitting coding.
+
+    rung_options yields (rung, options) where options is a list of
+    (label, settings, size, error) in preference order; lossless codings
+    have error 0 and are taken in order, lossy ones by lowest error.
+    Returns (rung, label, settings, size, error, tried) or None.
+    """
+    tried = []
+    for rung, options in rung_options:
+        fitting = []
+        for label, settings, size, error in options:
+            tried.append((rung, label, size, error))
+            if size <= budget:
+                if error == 0:
+                    return rung, label, settings, size, error, tried
+                fitting.append((error, label, settings, size))
+        if fitting:
+            error, label, settings, size = min(fitting, key=lambda f: f[0])
+            return rung, label, settings, size, error, tried
+    return None
+
+
+# ---- Playback cost (same model as src/cost_model.*) ----
+
+DISP_W, DISP_H = 240, 135
+CPU_MHZ = 240
+
+# mirrors cost_model_defaults(): (run, fill, compose, spi) cycles
+DEFAULT_MODEL = {
+    'read': (48000.0, 20.0),
+    'rotate-zoom': (40.0, 2.0, 20.0, 48.0),
+    'native': (40.0, 2.0, 0.0, 48.0),
+    'vector': (60.0, 3.0, 0.0, 48.0),
+}
+
+
+def load_model(path):
+    """Default model, overridden by `model ...` lines from a device bench log."""
+    model = dict(DEFAULT_MODEL)
+    with open(path) as f:
+        for line in f:
+            m = re.search(r'model read op=([\d.]+) byte=([\d.]+)', line)
+            if m:
+                model['read'] = (float(m.group(1)), float(m.group(2)))
+                continue
+            m = re.search(r'model path (\S+) run=([\d.]+) fill=([\d.]+) '
+                          r'compose=([\d.]+) spi=([\d.]+)', line)
+            if m:
+                model[m.group(1)] = tuple(float(g) for g in m.groups()[1:])
+    return model
+
+
+def frame_times(model, path, frames, width, height, header_size):
+    """Predicted ms per frame (read, decode, compose and push) on `path`."""
+    op, per_byte = model['read']
+    run, fill, compose, spi = model[path]
+    pixels = width * height
+    if path == 'native':
+        compose_px, spi_bytes = 0, pixels * 2 + 11
+    elif path == 'vector':
+        compose_px, spi_bytes = 0, DISP_W * DISP_H * 2 + 11
+    else:   # sprite copy + canvas clear + rotated draw, then the canvas
+        compose_px, spi_bytes = pixels * 2 + DISP_W * DISP_H, DISP_W * DISP_H * 2 + 11
+    fixed = fill * pixels + compose * compose_px + spi * spi_bytes + op
+    times = []
+    for f in frames:
+        runs = max(0, len(f) - header_size(f)) // 2
+        times.append((fixed + per_byte * len(f) + run * runs) / CPU_MHZ / 1000)
+    return times
@@ -0,0 +1,72 @@
+"""Long-term reference selection for recurring shots.
+
+Bad Apple returns to near-identical poses and backgrounds long after they
+were last on screen, where a delta against the previous frame doesn't help.
+The encoder keeps up to MAX_REF_SLOTS pictures resident on the device and
+codes later frames as deltas against the closest one.
+
+Similarity is judged on a coarse block signature (majority bit per
+BLOCK x BLOCK block), so the whole clip can be searched quickly; candidate
+matches are then priced exactly by the caller.
+"""
+
+BLOCK = 8
+
+
+def popcount(x):
+    return bin(x).count('1')
+
+
+def signature(bits, width, height, block=BLOCK):
+    """Coarse bitmap as an int: one bit per block, set if mostly 1s."""
+    sig = 0
+    for by in range(0, height, block):
+        for bx in range(0, width, block):
+            ones = total = 0
+            for y in range(by, min(by + block, height)):
+                row = bits[y * width + bx:y * width + min(bx + block, width)]
+                ones += sum(row)
+                total += len(row)
+            sig = (sig << 1) | (2 * ones > total)
+    return sig
+
+
+def choose_references(sigs, slots, min_gap, max_dist, candidates=2):
+    """Plan which frames are kept in which slot, and what each frame may use.
+
+    A frame is stored when nothing resident resembles it and it recurs at
+    least `min_gap` frames later; the least recently used slot is replaced.
+    Returns (stores, options): stores maps frame -> slot, options[i] lists
+    up to `candidates` (slot, stored frame) pairs resident at frame i whose
+    signature is within `max_dist` blocks.
+    """
+    n = len(sigs)
+    recurs = [False] * n
+    for i in range(n):
+        for j in range(i + min_gap, n):
+            if popcount(sigs[i] ^ sigs[j]) <= max_dist:
+                recurs[i] = True
+                break
+
+    resident = {}            # slot -> stored frame
+    last_used = {}           # slot -> frame it was last useful for
+    stores = {}
+    options = [[] for _ in range(n)]
+    for i in range(n):
+        near = sorted((popcount(sigs[i] ^ sigs[f]), slot, f)
+                      for slot, f in resident.items() if i - f >= min_gap)
+        near = [(slot, f) for d, slot, f in near if d <= max_dist][:candidates]
+        if near:
+            options[i] = near
+            last_used[near[0][0]] = i
+            continue
+        if not recurs[i]:
+            continue
+        if len(resident) < slots:
+            slot = len(resident)
+        else:
+            slot = min(resident, key=lambda s: last_used.get(s, resident[s]))
+        resident[slot] = i
+        last_used[slot] = i
+        stores[i] = slot
+    return stores, options
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Vertical-scroll frames (FRAME_SCROLL) for the panel's hardware scroll.
+
+A picture that is the previous one moved up or down by a few rows (credits,
+pans over a still) can be shown by moving the ST7789's scroll offset and
+pushing only the rows that came into view. This pass finds such frames,
+replaces each with exactly the moved previous picture plus the new rows
+from the source (lossy within --tolerance), and marks the delta with the
+shift. The runs stay the XOR with the previous picture, so every decoder
+still plays the file; the saving is SPI time on the paths that hold the
+whole screen (native, fused-rotate), not bytes.
+
+build_data.py runs it with --scroll TOL. This tool converts an existing
+container; frames that scroll become deltas, the rest keep their coding:
+  python tools/scroll.py data/bad_apple.bin -o scrolled.bin --tolerance 0.5
+"""
+import argparse
+import struct
+
+from container import (FLAG_COST_HINTS, FLAG_DELTA, FLAG_DITHER, FLAG_INDEXED, FLAG_LAYERS,
+                       FLAG_REFS, FLAG_ROW_INDEX, FLAG_VECTOR, FRAME_DELTA, FRAME_REF,
+                       FRAME_ROWS, FRAME_SCROLL, HEADER_FMT, FrameDecoder, index_entry, is_delta,
+                       read_container, scroll_rows, slots_end)
+from cost_hints import hints_for
+
+MAX_ROWS = 24          # largest shift searched, rows per frame
+
+
+def _rows(bits, width, height):
+    """Rows as ints (one byte per pixel), for XOR + popcount."""
+    return [int.from_bytes(bytes(bits[y * width:(y + 1) * width]), 'big')
+            for y in range(height)]
+
+
+def _error(prev, cur, dy, limit):
+    """Pixels of `cur` that differ from `prev` moved up by dy, over the rows
+    both cover; stops counting past `limit`."""
+    height = len(cur)
+    err = 0
+    for y in range(max(0, -dy), min(height, height - dy)):
+        err += bin(cur[y] ^ prev[y + dy]).count('1')
+        if err > limit:
+            break
+    return err
+
+
+def find_scroll(prev, cur, width, height, tolerance, max_rows=MAX_ROWS):
+    """Shift dy (rows moved up, negative = down) that turns picture `prev`
+    into `cur` with at most `tolerance` % of the overlapping pixels wrong,
+    0 if none explains the change better than leaving the picture still."""
+    still = _error(prev, cur, 0, width * height)
+    if not still:
+        return 0
+    best, best_err = 0, still
+    for d in range(1, min(max_rows, height - 1) + 1):
+        for dy in (d, -d):
+            limit = min(best_err - 1, tolerance / 100 * width * (height - d))
+            err = _error(prev, cur, dy, limit)
+            if err <= limit:
+                best, best_err = dy, err
+    return best
+
+
+class Scroller:
+    """Runs the pass one frame at a time (build_data.py encodes as it reads)."""
+
+    def __init__(self, width, height, tolerance, max_rows=MAX_ROWS):
+        self.width, self.height = width, height
+        self.tolerance, self.max_rows = tolerance, max_rows
+        self.prev = None        # previous returned picture and its rows
+        self.prev_rows = None
+
+    def step(self, bits):
+        """(picture, dy): `bits` or, if it scrolls, the exact scroll of the
+        previous picture with the new rows from `bits`."""
+        w, h = self.width, self.height
+        cur = _rows(bits, w, h)
+        dy = 0
+        if self.prev is not None:
+            dy = find_scroll(self.prev_rows, cur, w, h, self.tolerance, self.max_rows)
+        if dy > 0:
+            bits = self.prev[dy * w:] + bytes(bits[(h - dy) * w:])
+        elif dy < 0:
+            bits = bytes(bits[:-dy * w]) + self.prev[:(h + dy) * w]
+        if dy:
+            cur = _rows(bits, w, h)
+        self.prev, self.prev_rows = bytes(bits), cur
+        return self.prev, dy
+
+
+def scroll_pass(frame_bits, width, height, tolerance, max_rows=MAX_ROWS):
+    """Replace frames that scroll within `tolerance` by the exact scroll.
+
+    Returns (pictures, shifts): shifts[i] is frame i's dy against the
+    previous returned picture, 0 where it doesn't scroll."""
+    s = Scroller(width, height, tolerance, max_rows)
+    return tuple(map(list, zip(*[s.step(bits) for bits in frame_bits])))
+
+
+def mark_scroll(frame, dy):
+    """Tag a plain delta frame with its shift (other frames are returned as is)."""
+    if not dy or not is_delta(frame) or frame[0] & FRAME_REF:
+        return frame
+    at = slots_end(frame)
+    return bytes([frame[0] | FRAME_SCROLL]) + frame[1:at] + struct.pack('<b', dy) + frame[at:]
+
+
+def spi_rows(shifts, height):
+    """Rows a hardware-scrolling player pushes instead of `height` per frame."""
+    return sum(abs(dy) if dy else height for dy in shifts)
+
+
+def main():
+    # build_data imports this module
+    from build_data import add_row_index, bit_rle_compress, delta_compress
+
+    p = argparse.ArgumentParser(description='Mark vertically scrolling frames for hardware scroll')
+    p.add_argument('input', help='bad_apple.bin (bit-RLE, without reference slots)')
+    p.add_argument('-o', '--output', required=True)
+    p.add_argument('--tolerance', type=float, default=0.0, metavar='PCT',
+                   help='Pixels allowed to differ from an exact scroll, %% of the picture')
+    p.add_argument('--max-rows', type=int, default=MAX_ROWS, metavar='N',
+                   help='Largest shift to look for, rows per frame (at most 127)')
+    args = p.parse_args()
+
+    c = read_container(args.input)
+    if c.flags & (FLAG_VECTOR | FLAG_REFS | FLAG_LAYERS | FLAG_DITHER):
+        p.error('vector, reference-slot, layered and dithered files: rebuild with '
+                'build_data.py --scroll')
+    if c.flags & FLAG_INDEXED:
+        p.error('indexed-colour files are not scrolled')
+    if not 0 < args.max_rows <= 127:
+        p.error('--max-rows must be 1..127')
+    dec = FrameDecoder(c.total_pixels, c.width)
+    source = [bytes(dec.decode(f)) for f in c.frames]
+    pictures, shifts = scroll_pass(source, c.width, c.height, args.tolerance, args.max_rows)
+
+    frames = []
+    for i, (f, bits) in enumerate(zip(c.frames, pictures)):
+        if i and (is_delta(f) or shifts[i]):
+            frames.append(mark_scroll(delta_compress(pictures[i - 1], bits), shifts[i]))
+        else:
+            frames.append(bit_rle_compress(bits))
+    if c.flags & FLAG_ROW_INDEX:
+        k = next(f[slots_end(f)] for f in c.frames if f and f[0] & FRAME_ROWS)
+        frames = [add_row_index(f, c.width, c.height, k) for f in frames]
+    flags = c.flags & ~FLAG_DELTA
+    if any(f[0] & FRAME_DELTA for f in frames):
+        flags |= FLAG_DELTA
+    hints = [0] * len(frames)
+    if flags & FLAG_COST_HINTS:
+        hints = hints_for(frames, c.width, c.height, flags)[0]
+    offsets = []
+    offset = 0
+    for f in frames:
+        offsets.append(offset)
+        offset += len(f)
+    with open(args.output, 'wb') as out:
+        out.write(struct.pack(HEADER_FMT, c.width, c.height, len(frames), c.fps, flags))
+        out.write(struct.pack(f'<{len(frames)}I',
+                              *[index_entry(len(c.thumbs) + o, hint=h)      # track stays in front
+                                for o, h in zip(offsets, hints)]))
+        out.write(c.thumbs)
+        for f in frames:
+            out.write(f)
+
+    marked = sum(bool(f[0] & FRAME_SCROLL) for f in frames)
+    wrong = sum(a != b for s, d in zip(source, pictures) if s != d for a, b in zip(s, d))
+    rows = spi_rows([scroll_rows(f) for f in frames], c.height)
+    print(f'Scroll: {marked} of {len(frames)} frames scroll (tolerance {args.tolerance}%), '
+          f'{100 * wrong / (c.total_pixels * len(frames)):.3f}% pixels off vs. source')
+    print(f'  video rows pushed by a scrolling player: {rows:,} of {c.height * len(frames):,} '
+          f'({100 * rows / (c.height * len(frames)):.1f}%)')
+    size = sum(len(f) for f in c.frames)
+    print(f'  {args.output}: {offset:,} bytes of frames vs {size:,}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,266 @@
+"""Framed serial link shared by the host tools and the device (src/serial_link.h).
+
+Packet layout (both directions):
+  uint8   0xA5, 0x5A   sync
+  uint8   type
+  uint8   seq          per-direction sequence number, wraps at 256
+  uint16  len          payload length (LE)
+  uint8   payload[len]
+  uint16  crc          CRC-16/CCITT-FALSE over type..payload (LE)
+
+Bytes outside packets are device log text and are handed back as such.
+"""
+import collections
+import struct
+import time
+
+SYNC = b'\xA5\x5A'
+
+# host -> device
+PKT_HELLO = 0x01
+PKT_HEADER = 0x02
+PKT_FRAME = 0x03
+PKT_END = 0x04
+PKT_UP_BEGIN = 0x05
+PKT_UP_CHUNK = 0x06
+PKT_UP_END = 0x07
+# device -> host
+PKT_READY = 0x81
+PKT_CREDIT = 0x82
+PKT_NAK = 0x83
+PKT_UP_HASHES = 0x84
+PKT_UP_DONE = 0x85
+
+MODE_STREAM = 1
+MODE_UPLOAD = 2
+
+# Jitter-buffer bytes charged per frame on top of its payload.
+FRAME_OVERHEAD = 2
+
+RETRANSMIT_TIMEOUT = 1.0
+HELLO_RETRY = 0.5
+
+
+def _crc16_table():
+    table = []
+    for i in range(256):
+        crc = i << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+        table.append(crc & 0xFFFF)
+    return table
+
+
+_CRC16_TABLE = _crc16_table()
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)."""
+    table = _CRC16_TABLE
+    for b in data:
+        crc = ((crc << 8) & 0xFFFF) ^ table[(crc >> 8) ^ b]
+    return crc
+
+
+FNV64_OFFSET = 0xcbf29ce484222325
+FNV64_PRIME = 0x100000001b3
+
+
+def fnv1a64(data, h=FNV64_OFFSET):
+    """FNV-1a 64 of upload chunks and whole files (src/upload_rx.cpp)."""
+    for b in data:
+        h = ((h ^ b) * FNV64_PRIME) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def build_packet(ptype, seq, payload=b''):
+    body = struct.pack('<BBH', ptype, seq & 0xFF, len(payload)) + payload
+    return SYNC + body + struct.pack('<H', crc16(body))
+
+
+def seq_before(a, b):
+    """True if sequence number a precedes b (mod 256)."""
+    return 0 < ((b - a) & 0xFF) < 128
+
+
+class Parser:
+    """Incremental packet parser.
+
+    feed() returns a list of events:
+      ('packet', type, seq, payload)
+      ('crc_error', type, seq)
+      ('text', bytes)            bytes found between packets
+    """
+
+    def __init__(self, max_payload=65535):
+        self.max_payload = max_payload
+        self.buf = bytearray()
+        self.crc_errors = 0
+
+    def feed(self, data):
+        self.buf.extend(data)
+        events = []
+        while True:
+            i = self.buf.find(SYNC)
+            if i < 0:
+                # keep a trailing 0xA5 in case the sync is split
+                keep = 1 if self.buf[-1:] == SYNC[:1] else 0
+                if len(self.buf) > keep:
+                    events.append(('text', bytes(self.buf[:len(self.buf) - keep])))
+                    del self.buf[:len(self.buf) - keep]
+                break
+            if i:
+                events.append(('text', bytes(self.buf[:i])))
+                del self.buf[:i]
+            if len(self.buf) < 6:
+                break
+            ptype, seq, length = struct.unpack_from('<BBH', self.buf, 2)
+            if length > self.max_payload:
+                del self.buf[:2]          # false sync
+                continue
+            if len(self.buf) < 8 + length:
+                break
+            body = bytes(self.buf[2:6 + length])
+            (crc,) = struct.unpack_from('<H', self.buf, 6 + length)
+            del self.buf[:8 + length]
+            if crc == crc16(body):
+                events.append(('packet', ptype, seq, body[4:]))
+            else:
+                self.crc_errors += 1
+                events.append(('crc_error', ptype, seq))
+        return events
+
+
+class LinkSender:
+    """Host end of a link session: go-back-N resend under device credits.
+
+    Packets the sender doesn't handle itself (e.g. upload replies) go to
+    `on_packet_hook(type, payload)`.
+    """
+
+    def __init__(self, ser, verbose=True):
+        self.ser = ser
+        self.parser = Parser()
+        self.seq = 0
+        self.retained = collections.deque()   # [seq, cost, raw, sent]
+        self.acked_cost = 0
+        self.inflight_cost = 0
+        self.limit = 0
+        self.capacity = 0
+        self.dev_frames = 0
+        self.dev_bytes = 0
+        self.last_progress = time.monotonic()
+        self.ready = False
+        self.text = b''
+        self.verbose = verbose
+        self.on_packet_hook = None
+        # statistics (reset every report)
+        self.stat_bytes = 0
+        self.stat_frames = 0
+        self.stat_resends = 0
+        self.total_resends = 0
+
+    # ---- device -> host ----
+    def poll(self, timeout=0.0):
+        old = self.ser.timeout
+        self.ser.timeout = timeout
+        data = self.ser.read(max(1, self.ser.in_waiting))
+        self.ser.timeout = old
+        for ev in self.parser.feed(data):
+            if ev[0] == 'text':
+                self.on_text(ev[1])
+            elif ev[0] == 'packet':
+                self.on_packet(ev[1], ev[3])
+
+    def on_text(self, data):
+        self.text += data
+        *lines, self.text = self.text.split(b'\n')
+        for line in lines:
+            if self.verbose:
+                print('device:', line.decode('utf-8', 'replace').rstrip())
+
+    def on_packet(self, ptype, payload):
+        if ptype == PKT_READY:
+            self.capacity, _max_payload = struct.unpack_from('<IH', payload)
+            self.ready = True
+        elif ptype == PKT_CREDIT:
+            nxt, limit, frames, used = struct.unpack_from('<BIHI', payload)
+            self.ack(nxt)
+            self.limit = limit
+            self.dev_frames, self.dev_bytes = frames, used
+        elif ptype == PKT_NAK:
+            self.ack(payload[0])
+            self.rewind()
+        elif self.on_packet_hook:
+            self.on_packet_hook(ptype, payload)
+
+    def ack(self, nxt):
+        while self.retained and seq_before(self.retained[0][0], nxt):
+            _seq, cost, _raw, sent = self.retained.popleft()
+            self.acked_cost += cost
+            if sent:
+                self.inflight_cost -= cost
+            self.last_progress = time.monotonic()
+
+    def rewind(self):
+        """Go-back-N: everything not yet acked gets sent again."""
+        for entry in self.retained:
+            if entry[3]:
+                self.stat_resends += 1
+                self.total_resends += 1
+            entry[3] = False
+        self.inflight_cost = 0
+        self.last_progress = time.monotonic()
+
+    # ---- host -> device ----
+    def queue(self, ptype, payload=b'', cost=0):
+        raw = build_packet(ptype, self.seq, payload)
+        self.retained.append([self.seq, cost, raw, False])
+        self.seq = (self.seq + 1) & 0xFF
+
+    def pending(self):
+        return sum(1 for e in self.retained if not e[3])
+
+    def drain(self, until=None, timeout=30.0):
+        """Pump and poll until everything is acked and `until()` holds."""
+        deadline = time.monotonic() + timeout
+        while self.retained or (until and not until()):
+            if time.monotonic() > deadline:
+                raise TimeoutError('device stopped responding')
+            self.pump()
+            self.poll(0.002)
+
+    def pump(self):
+        """Send retained packets that fit the device's credit."""
+        for entry in self.retained:
+            if entry[3]:
+                continue
+            if self.acked_cost + self.inflight_cost + entry[1] > self.limit:
+                break
+            self.ser.write(entry[2])
+            self.stat_bytes += len(entry[2])
+            if entry[1]:
+                self.stat_frames += 1
+            entry[3] = True
+            self.inflight_cost += entry[1]
+        if self.retained and time.monotonic() - self.last_progress > RETRANSMIT_TIMEOUT:
+            self.rewind()
+
+    def hello(self, mode, baud=0):
+        """Start a session; with `baud`, both ends switch speed after READY."""
+        self.seq = 0
+        self.retained.clear()
+        self.acked_cost = self.inflight_cost = self.limit = 0
+        self.ready = False
+        last = 0.0
+        while not self.ready:
+            if time.monotonic() - last > HELLO_RETRY:
+                self.ser.write(build_packet(PKT_HELLO, self.seq,
+                                            struct.pack('<BI', mode, baud)))
+                last = time.monotonic()
+            self.poll(0.05)
+        if baud:
+            time.sleep(0.05)    # let the device finish sending at the old rate
+            self.ser.baudrate = baud
+        self.seq = 1
+        self.last_progress = time.monotonic()
@@ -0,0 +1,445 @@
+#!/usr/bin/env python3
+"""Pty-based device simulator for the serial link.
+
+Behaves like the firmware on the other end of a pseudo-terminal: same packet
+handling, credits, NAKs, jitter buffer, prefill and frame pacing for stream
+input, and chunk hashing / copy-and-rename writes for uploads (the
+--partition file stands in for /bad_apple.bin on the data partition).
+Frames are decoded with the bit-RLE reference decoder to catch corruption
+(indexed-colour frames have their runs counted).
+
+Usage (Linux):
+  python tools/stream_sim.py --baud 1500000
+  python tools/stream_video.py /dev/pts/N data/bad_apple.bin
+
+  python tools/stream_sim.py --partition sim_part.bin
+  python tools/upload_video.py /dev/pts/N data/bad_apple.bin
+"""
+import argparse
+import collections
+import os
+import pty
+import random
+import select
+import struct
+import time
+import tty
+
+from container import (FLAG_INDEXED, HEADER_FMT, HEADER_SIZE, bit_rle_decode, indexed_lengths,
+                       run_lengths)
+from serial_link import (Parser, build_packet, FRAME_OVERHEAD, MODE_STREAM,
+                         MODE_UPLOAD, PKT_HELLO, PKT_HEADER, PKT_FRAME,
+                         PKT_END, PKT_UP_BEGIN, PKT_UP_CHUNK, PKT_UP_END,
+                         PKT_READY, PKT_CREDIT, PKT_NAK, PKT_UP_HASHES,
+                         PKT_UP_DONE, fnv1a64)
+
+PREFILL_MS = 500
+NAK_RETRY = 0.1
+CREDIT_INTERVAL = 0.1
+MAX_PAYLOAD = 16384
+UPLOAD_WINDOW = 12288
+UPLOAD_WRITE_BUF = 16384
+SECTOR = 4096
+
+
+class Partition:
+    """File standing in for the video file on the data partition.
+
+    Uploads write a new file next to it and rename it over the old one, as
+    src/upload_rx.cpp does on LittleFS. When `--space` leaves no room for
+    both, the old file is patched from the first changed chunk to the end
+    instead, if that tail fits; a patch cut short leaves `path`.part."""
+
+    def __init__(self, path, space):
+        self.path = path
+        self.tmp = path + '.new'
+        self.part = path + '.part'
+        self.space = space
+        if not os.path.exists(path):
+            open(path, 'wb').close()
+        self.old = self.new = None
+        self.in_place = False
+        self.flash_writes = 0
+        self.bytes_written = 0
+
+    def free(self):
+        return self.space - os.path.getsize(self.path) if self.space else float('inf')
+
+    def open(self, new_size):
+        """Returns the size of the old file."""
+        self.in_place = new_size + 2 * SECTOR > self.free()
+        self.old = open(self.path, 'rb')
+        self.new = None if self.in_place else open(self.tmp, 'wb')
+        self.new_size = new_size
+        self.flash_writes = self.bytes_written = 0
+        return os.path.getsize(self.path)
+
+    def patch(self, off):
+        """Start patching the old file at `off`; False if the tail from
+        there does not fit next to it."""
+        old_size = os.path.getsize(self.path)
+        if off > old_size or max(self.new_size, old_size) - off + 2 * SECTOR > self.free():
+            return False
+        self.new = open(self.path, 'r+b')
+        self.new.seek(off)
+        return True
+
+    def close_patch(self):
+        open(self.part, 'wb').close()       # before the mix is committed
+        self.new.close()
+        self.new = None
+
+    def read(self, off, n):
+        self.old.seek(off)
+        return self.old.read(n)
+
+    def append(self, data):
+        self.new.write(data)
+        self.flash_writes += 1
+        self.bytes_written += len(data)
+
+    def abort(self):
+        self.old.close()
+        if self.in_place and self.new:
+            self.close_patch()
+        elif self.new:
+            self.new.close()
+            os.remove(self.tmp)
+
+    def finish(self, size, expected):
+        self.old.close()
+        if self.in_place:
+            if self.new:
+                self.close_patch()
+            if size < os.path.getsize(self.path):
+                os.truncate(self.path, size)
+        else:
+            self.new.close()
+        with open(self.path if self.in_place else self.tmp, 'rb') as f:
+            data = f.read()
+        h = fnv1a64(data)
+        ok = len(data) == size and h == expected
+        if not self.in_place:
+            if ok:
+                os.replace(self.tmp, self.path)
+            else:
+                os.remove(self.tmp)
+        if ok and os.path.exists(self.part):
+            os.remove(self.part)
+        return ok, h
+
+
+class Device:
+    def __init__(self, fd, args):
+        self.fd = fd
+        self.args = args
+        self.parser = Parser(MAX_PAYLOAD)
+        self.capacity = args.buffer
+        self.partition = Partition(args.partition, args.space) if args.partition else None
+        self.baud = args.baud
+        self.mode = 0
+        self.txseq = 0
+        self.reset()
+        self.fps = 15
+        self.pixels = 0
+        self.width = 0
+        self.indexed = False
+        self.stats_reset(time.monotonic())
+        self.decode_errors = 0
+        self.played = 0
+
+    def reset(self):
+        self.jitter = collections.deque()
+        self.used = 0
+        self.accepted_cost = 0
+        self.expect = 0
+        self.ended = False
+        self.state = 'waiting'
+        self.nak_pending = False
+        self.last_nak = 0.0
+        self.last_credit = 0.0
+
+    def stats_reset(self, now):
+        self.stat_rx = self.stat_frames = self.stat_underruns = self.stat_naks = 0
+        self.stat_min = None
+        self.stat_last = now
+
+    def send(self, ptype, payload=b''):
+        os.write(self.fd, build_packet(ptype, self.txseq, payload))
+        self.txseq = (self.txseq + 1) & 0xFF
+
+    def log(self, line):
+        print(line)
+        os.write(self.fd, line.encode() + b'\n')
+
+    def window(self):
+        if self.mode == MODE_UPLOAD:
+            return UPLOAD_WINDOW
+        return self.capacity - self.used if self.mode == MODE_STREAM else 0
+
+    def credit(self):
+        limit = self.accepted_cost + self.window()
+        self.send(PKT_CREDIT, struct.pack('<BIHI', self.expect, limit,
+                                          len(self.jitter), self.used))
+        self.last_credit = time.monotonic()
+
+    def nak(self):
+        now = time.monotonic()
+        if self.nak_pending and now - self.last_nak < NAK_RETRY:
+            return
+        self.send(PKT_NAK, bytes([self.expect]))
+        self.nak_pending = True
+        self.last_nak = now
+        self.stat_naks += 1
+
+    def on_packet(self, ptype, seq, payload):
+        if ptype == PKT_HELLO:
+            mode = payload[0] if payload else 0
+            baud = struct.unpack_from('<I', payload, 1)[0] if len(payload) >= 5 else 0
+            if mode == MODE_UPLOAD and not self.partition:
+                self.log('Upload: no --partition file given')
+                return
+            self.reset()
+            self.mode = mode
+            self.expect = (seq + 1) & 0xFF
+            self.send(PKT_READY, struct.pack('<IH', self.window(), MAX_PAYLOAD))
+            if baud:
+                self.baud = baud
+            self.credit()
+            return
+        if not self.mode:
+            return
+        if seq != self.expect:
+            self.nak()
+            return
+        if ptype == PKT_HEADER:
+            w, h, frames, fps, flags = struct.unpack_from(HEADER_FMT, payload[:HEADER_SIZE])
+            self.fps = fps or 15
+            self.pixels = w * h
+            self.width = w
+            self.indexed = bool(flags & FLAG_INDEXED)
+            self.log(f'Stream: {w}x{h}, {frames} frames, {self.fps} fps')
+            self.state = 'buffering'
+        elif ptype == PKT_FRAME:
+            cost = len(payload) + FRAME_OVERHEAD
+            if cost > self.capacity - self.used:
+                self.nak()
+                return
+            self.jitter.append(payload)
+            self.used += cost
+            self.accepted_cost += cost
+        elif ptype == PKT_END:
+            self.ended = True
+        elif ptype == PKT_UP_BEGIN:
+            size, chunk = struct.unpack_from('<II', payload)
+            self.expect = (self.expect + 1) & 0xFF
+            self.upload_begin(size, chunk)
+            self.credit()
+            return
+        elif ptype == PKT_UP_CHUNK:
+            (index,) = struct.unpack_from('<I', payload)
+            self.upload_write(index, payload[4:])
+            self.accepted_cost += len(payload)
+        elif ptype == PKT_UP_END:
+            size, expected = struct.unpack_from('<IQ', payload)
+            self.expect = (self.expect + 1) & 0xFF
+            self.credit()
+            self.upload_end(size, expected)
+            return
+        self.expect = (self.expect + 1) & 0xFF
+        self.nak_pending = False
+        self.credit()
+
+    # ---- upload: same copying and coalescing as src/upload_rx.cpp ----
+    def upload_begin(self, size, chunk):
+        self.chunk = chunk
+        self.old_size = self.partition.open(size)
+        self.wbuf = bytearray()
+        self.next_chunk = 0
+        self.chunks_written = self.chunks_copied = 0
+        self.log(f'Upload: {self.old_size} -> {size} bytes'
+                 + (' (in place, no room for a copy)' if self.partition.in_place else ''))
+        count = (self.old_size + chunk - 1) // chunk
+        first = 0
+        while True:
+            n = min(128, count - first)
+            hashes = b''.join(struct.pack('<Q', fnv1a64(self.partition.read(
+                (first + i) * chunk, chunk))) for i in range(n))
+            self.send(PKT_UP_HASHES, struct.pack('<IIH', self.old_size, first, n) + hashes)
+            first += n
+            if first >= count:
+                break
+
+    def upload_append(self, data):
+        if len(self.wbuf) + len(data) > UPLOAD_WRITE_BUF:
+            self.upload_flush()
+        self.wbuf.extend(data)
+
+    def upload_flush(self):
+        if self.wbuf:
+            self.partition.append(bytes(self.wbuf))
+            self.wbuf = bytearray()
+
+    def upload_copy(self, end, size):
+        """Copies unchanged chunks [next_chunk, end) up to `size` bytes."""
+        while self.next_chunk < end:
+            off = self.next_chunk * self.chunk
+            if off >= size:
+                break
+            n = min(self.chunk, size - off)
+            if off + n > self.old_size:
+                return False
+            self.upload_append(self.partition.read(off, n))
+            self.chunks_copied += 1
+            self.next_chunk += 1
+        return True
+
+    def upload_write(self, index, data):
+        if (self.partition.in_place and not self.partition.new and index >= self.next_chunk
+                and self.partition.patch(index * self.chunk)):
+            self.next_chunk = index
+        if (index < self.next_chunk or not self.partition.new
+                or not self.upload_copy(index, float('inf'))):
+            self.log('Upload: write failed')
+            self.send(PKT_UP_DONE, struct.pack('<BQ', 0, 0))
+            self.partition.abort()
+            self.mode = 0
+            return
+        self.upload_append(data)
+        self.next_chunk = index + 1
+        self.chunks_written += 1
+
+    def upload_end(self, size, expected):
+        if self.partition.in_place and not self.partition.new:
+            ok, h = self.partition.finish(size, expected)   # no chunk changed
+        elif self.upload_copy((size + self.chunk - 1) // self.chunk, size):
+            self.upload_flush()
+            ok, h = self.partition.finish(size, expected)
+        else:
+            self.partition.abort()
+            ok, h = False, 0
+        self.send(PKT_UP_DONE, struct.pack('<BQ', ok, h))
+        self.log(f'Upload {"OK" if ok else "FAILED"}: {self.chunks_written} chunks sent, '
+                 f'{self.chunks_copied} copied, {self.partition.bytes_written // 1024} KB '
+                 f'written in {self.partition.flash_writes} flash writes')
+        self.mode = 0
+        self.baud = self.args.baud
+
+    def receive(self, data):
+        if self.args.corrupt and random.random() < self.args.corrupt * len(data):
+            i = random.randrange(len(data))
+            data = data[:i] + bytes([data[i] ^ 0x55]) + data[i + 1:]
+        self.stat_rx += len(data)
+        for ev in self.parser.feed(data):
+            if ev[0] == 'packet':
+                self.on_packet(*ev[1:])
+            elif ev[0] == 'crc_error':
+                self.nak()
+
+    def play(self, now):
+        """Returns the time the next frame is due (or None when idle)."""
+        frame_delay = 1.0 / self.fps
+        if self.state == 'buffering':
+            prefill = int(PREFILL_MS / 1000 * self.fps)
+            full = self.capacity - self.used < MAX_PAYLOAD + FRAME_OVERHEAD
+            if len(self.jitter) >= prefill or full or (self.ended and self.jitter):
+                self.state = 'playing'
+                self.next_frame = now
+            else:
+                return None
+        if self.state != 'playing':
+            return None
+        if now < self.next_frame:
+            return self.next_frame
+        if not self.jitter:
+            if not self.ended:
+                self.stat_underruns += 1
+            self.state = 'waiting' if self.ended else 'buffering'
+            return None
+        frame = self.jitter.popleft()
+        self.used -= len(frame) + FRAME_OVERHEAD
+        if self.stat_min is None or len(self.jitter) < self.stat_min:
+            self.stat_min = len(self.jitter)
+        if self.indexed:
+            if sum(indexed_lengths(frame)) != self.pixels:
+                self.decode_errors += 1
+        else:
+            bits = bit_rle_decode(frame, self.pixels, width=self.width)
+            runs_total = sum(run_lengths(frame))
+            if runs_total != self.pixels or len(bits) != self.pixels:
+                self.decode_errors += 1
+        if self.args.decode_ms:
+            time.sleep(self.args.decode_ms / 1000)
+        self.played += 1
+        self.stat_frames += 1
+        self.next_frame += frame_delay
+        if time.monotonic() - self.next_frame > frame_delay:
+            self.next_frame = time.monotonic()
+        return self.next_frame
+
+    def report(self, now):
+        dt = now - self.stat_last
+        if dt < 1.0 or self.mode != MODE_STREAM:
+            return
+        self.log(f'[stream] {self.stat_rx / dt / 1000:.1f} kB/s, '
+                 f'{self.stat_frames / dt:.1f} fps, '
+                 f'buffer {100 * self.used // self.capacity}% ({len(self.jitter)} frames, '
+                 f'min {self.stat_min or 0}), underruns {self.stat_underruns}, '
+                 f'crc {self.parser.crc_errors}, nak {self.stat_naks}, '
+                 f'played {self.played}, decode errors {self.decode_errors}')
+        self.stats_reset(now)
+
+
+def main():
+    p = argparse.ArgumentParser(description='Simulate the stream firmware on a pty')
+    p.add_argument('--baud', type=int, default=1500000,
+                   help='Emulated link speed (10 bits per byte)')
+    p.add_argument('--buffer', type=int, default=256 * 1024,
+                   help='Jitter buffer bytes (PSRAM build: 256K, RAM: 32K)')
+    p.add_argument('--decode-ms', type=float, default=0.0,
+                   help='Emulated per-frame decode+render time')
+    p.add_argument('--partition',
+                   help='File standing in for the video file (enables uploads)')
+    p.add_argument('--space', type=int, default=0,
+                   help='Bytes of the data partition the video may use (0 = unlimited)')
+    p.add_argument('--corrupt', type=float, default=0.0,
+                   help='Probability of corrupting a received chunk')
+    args = p.parse_args()
+
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    tty.setraw(master)
+    print(f'Device pty: {os.ttyname(slave)}', flush=True)
+
+    dev = Device(master, args)
+    budget = 0.0
+    last = time.monotonic()
+    while True:
+        bytes_per_sec = dev.baud / 10
+        now = time.monotonic()
+        budget = min(budget + (now - last) * bytes_per_sec, bytes_per_sec * 0.01)
+        last = now
+
+        due = dev.play(now)
+        timeout = 0.005 if due is None else max(0.0, min(0.005, due - time.monotonic()))
+        r, _, _ = select.select([master], [], [], timeout)
+        if r and budget >= 1:
+            try:
+                data = os.read(master, int(budget))
+            except OSError:
+                data = b''
+            if data:
+                budget -= len(data)
+                dev.receive(data)
+
+        now = time.monotonic()
+        if dev.mode and now - dev.last_credit >= CREDIT_INTERVAL:
+            dev.credit()
+        dev.report(now)
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
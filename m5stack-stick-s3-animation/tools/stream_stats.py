@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Stream analyzer: byte rate of a bad_apple.bin over sliding windows.
+
+Reports the mean and peak rate, the heaviest windows and frames, and for a
+constant-rate reader (--rate, or --baud for the serial link at 10 bits per
+byte) the start-up delay and buffer it needs to never run dry. With
+--cap the peak window is checked against a cap as build_data.py --rate-cap
+enforces it, and the exit status is 1 if it is exceeded.
+
+Usage:
+  python tools/stream_stats.py data/bad_apple.bin
+  python tools/stream_stats.py data/bad_apple.bin --baud 1500000
+  python tools/stream_stats.py data/bad_apple.bin --cap 40000 --window 10
+"""
+import argparse
+import sys
+
+from bitrate import peak_window, window_sums
+from container import read_container
+from serial_link import FRAME_OVERHEAD
+
+PREFILL_MS = 500          # JITTER_PREFILL_MS in src/main.cpp
+
+
+def link_needs(costs, fps, rate):
+    """(start-up delay s, peak buffered bytes) for a reader delivering
+    `rate` bytes/s while frames are consumed at `fps`. The buffer figure
+    assumes flow control: each frame is sent as late as it can still be
+    on time."""
+    delay = 0.0
+    total = 0
+    for i, c in enumerate(costs):
+        total += c
+        delay = max(delay, total / rate - i / fps)
+    n = len(costs)
+    due = [delay + i / fps for i in range(n)]
+    start = [0.0] * n
+    t = float('inf')
+    for i in range(n - 1, -1, -1):
+        t = min(t, due[i]) - costs[i] / rate
+        start[i] = t
+    peak = 0
+    for i in range(n):
+        held = 0
+        for j in range(i + 1, n):
+            if start[j] >= due[i]:
+                break
+            held += min(costs[j], (due[i] - start[j]) * rate)
+        peak = max(peak, held)
+    return delay, int(peak)
+
+
+def main():
+    p = argparse.ArgumentParser(description='Byte-rate analysis of a video container')
+    p.add_argument('input', help='bad_apple.bin')
+    p.add_argument('--window', type=int, default=None, metavar='N',
+                   help='Window length in frames (default: one second)')
+    p.add_argument('--overhead', type=int, default=FRAME_OVERHEAD,
+                   help='Bytes charged per frame on top of its payload')
+    p.add_argument('--rate', type=float, default=None, metavar='BYTES_PER_SEC',
+                   help='Constant reader rate to check start-up delay and buffer against')
+    p.add_argument('--baud', type=int, default=None,
+                   help='Serial link speed (rate = baud / 10)')
+    p.add_argument('--cap', type=int, default=None, metavar='BYTES',
+                   help='Fail if any window holds more than BYTES')
+    p.add_argument('--top', type=int, default=5, help='Heaviest frames to list')
+    args = p.parse_args()
+
+    c = read_container(args.input)
+    window = args.window or c.fps
+    costs = [len(f) + args.overhead for f in c.frames]
+    n = len(costs)
+    seconds = n / c.fps
+    total = sum(costs)
+    peak, end = peak_window(costs, window)
+    per_sec = window / c.fps
+
+    print(f'{args.input}: {n} frames @ {c.fps} fps, {total:,} bytes '
+          f'(+{args.overhead} per frame)')
+    print(f'  mean   {total / seconds / 1000:8.1f} kB/s  {total / n:8.0f} B/frame')
+    print(f'  peak   {peak / per_sec / 1000:8.1f} kB/s  {peak:8,} B in {window} frames '
+          f'ending at frame {end} ({end / c.fps:.1f} s), {peak * seconds / total / per_sec:.1f}x mean')
+    sums = window_sums(costs, window)
+    for pct in (50, 90, 99):
+        v = sorted(sums)[min(n - 1, n * pct // 100)]
+        print(f'  p{pct:<4}  {v / per_sec / 1000:8.1f} kB/s')
+    heavy = sorted(range(n), key=lambda i: -costs[i])[:args.top]
+    print('  heaviest frames: ' + ', '.join(f'{i} ({costs[i]:,} B)' for i in heavy))
+
+    rate = args.rate or (args.baud / 10 if args.baud else None)
+    if rate:
+        delay, buffered = link_needs(costs, c.fps, rate)
+        print(f'  at {rate / 1000:.1f} kB/s: start-up delay {delay * 1000:.0f} ms '
+              f'(device prefill {PREFILL_MS} ms), peak buffer {buffered:,} bytes')
+        if total / seconds > rate:
+            print('  mean rate exceeds the link: playback cannot keep up')
+
+    if args.cap is not None:
+        over = [i for i, s in enumerate(sums) if s > args.cap]
+        if over:
+            print(f'FAIL: {len(over)} windows over the {args.cap:,}-byte cap '
+                  f'(first ends at frame {over[0]}, {sums[over[0]]:,} bytes)')
+            sys.exit(1)
+        print(f'OK: every {window}-frame window within {args.cap:,} bytes '
+              f'({100 * peak / args.cap:.0f}% at peak)')
+
+
+if __name__ == '__main__':
+    main()
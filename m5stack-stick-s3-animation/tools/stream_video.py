@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Stream a video container to the device over USB serial.
+
+The device must run the `stream` firmware environment (-DSTREAM_INPUT).
+Frames are sent as framed packets (tools/serial_link.py) under credit-based
+flow control: the device advertises how many jitter-buffer bytes it can
+accept, and corrupted or out-of-order packets are resent (go-back-N).
+
+Usage:
+  python tools/stream_video.py /dev/ttyUSB0 data/bad_apple.bin --baud 1500000
+  python tools/stream_sim.py            # prints a pty path to stream into
+"""
+import argparse
+import sys
+import time
+
+import serial
+
+from container import read_container
+from serial_link import (LinkSender, FRAME_OVERHEAD, MODE_STREAM, PKT_HEADER,
+                         PKT_FRAME, PKT_END)
+
+
+def main():
+    p = argparse.ArgumentParser(description='Stream video frames to the device')
+    p.add_argument('port', help='Serial port (or pty from stream_sim.py)')
+    p.add_argument('input', nargs='?', default='data/bad_apple.bin',
+                   help='Video container (bad_apple.bin)')
+    p.add_argument('--baud', type=int, default=1500000)
+    p.add_argument('--rtscts', action='store_true',
+                   help='Also enable RTS/CTS hardware flow control')
+    p.add_argument('--loop', action='store_true', help='Repeat the clip forever')
+    p.add_argument('--frames', type=int, default=0, help='Stop after N frames')
+    p.add_argument('--quiet', action='store_true', help='Hide device log lines')
+    args = p.parse_args()
+
+    video = read_container(args.input)
+    frames = video.frames[:args.frames] if args.frames else video.frames
+    print(f'{args.input}: {video.width}x{video.height}, {len(frames)} frames, '
+          f'{video.fps} fps')
+
+    ser = serial.Serial(args.port, args.baud, timeout=0, rtscts=args.rtscts,
+                        write_timeout=5)
+    tx = LinkSender(ser, verbose=not args.quiet)
+    print('Waiting for device...')
+    tx.hello(MODE_STREAM)
+    print(f'Device ready, jitter buffer {tx.capacity:,} bytes')
+
+    tx.queue(PKT_HEADER, video.header)
+    start = last_report = time.monotonic()
+    sent_total = 0
+    idx = 0
+    finished = False
+    while True:
+        # keep a small backlog queued; credits decide what actually goes out
+        while not finished and tx.pending() < 8:
+            if idx >= len(frames):
+                if args.loop:
+                    idx = 0
+                else:
+                    tx.queue(PKT_END)
+                    finished = True
+                    break
+            tx.queue(PKT_FRAME, frames[idx], len(frames[idx]) + FRAME_OVERHEAD)
+            idx += 1
+        tx.pump()
+        tx.poll(0.002)
+
+        now = time.monotonic()
+        if now - last_report >= 1.0:
+            dt = now - last_report
+            sent_total += tx.stat_bytes
+            occ = 100 * tx.dev_bytes / tx.capacity if tx.capacity else 0
+            print(f'[host] {tx.stat_bytes / dt / 1024:.1f} kB/s, '
+                  f'{tx.stat_frames / dt:.1f} frames/s sent, '
+                  f'device buffer {occ:.0f}% ({tx.dev_frames} frames), '
+                  f'resends {tx.stat_resends}')
+            tx.stat_bytes = tx.stat_frames = tx.stat_resends = 0
+            last_report = now
+
+        if finished and not tx.retained and tx.dev_frames == 0:
+            break
+
+    elapsed = time.monotonic() - start
+    sent_total += tx.stat_bytes
+    print(f'Done: {sent_total:,} bytes in {elapsed:.1f} s '
+          f'({sent_total / elapsed / 1024:.1f} kB/s avg), '
+          f'{tx.total_resends} resends, {tx.parser.crc_errors} bad device packets')
+
+
+if __name__ == '__main__':
+    try:
+        main()
+    except KeyboardInterrupt:
+        sys.exit(1)
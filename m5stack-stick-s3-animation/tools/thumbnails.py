@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Thumbnail track (FLAG_THUMBS) for instant scrub previews.
+
+Seeking in a delta-coded file means decoding from the keyframe before the
+target, too slow to follow a scrub. The track holds a tiny 1-bpp picture of
+every `interval`-th frame, all the same size, at the start of the frame
+data section (frame 0's index offset points past it). The player shows the
+nearest one at once and decodes the target frame unseen behind it.
+
+Track: uint16 width, uint16 height, uint16 interval, uint16 count, then
+`count` pictures of `height` rows of ceil(width / 8) bytes, MSB = leftmost
+pixel. A thumbnail pixel is set when most of the frame pixels it stands
+for are -- the ones the player's nearest-neighbour upscale maps onto it.
+
+build_data.py adds one with --thumbs SEC. This tool adds, replaces or
+removes the track of an existing container:
+  python tools/thumbnails.py data/bad_apple.bin --every 1 --scale 4
+  python tools/thumbnails.py data/bad_apple.bin --strip
+"""
+import argparse
+import struct
+
+from container import (FLAG_INDEXED, FLAG_THUMBS, FLAG_VECTOR, HEADER_FMT, HEADER_SIZE,
+                       INDEX_OFFSET_MASK, FrameDecoder, read_container)
+
+TRACK_FMT = '<HHHH'
+TRACK_HEADER = struct.calcsize(TRACK_FMT)
+DEFAULT_SCALE = 4      # video pixels per thumbnail pixel, each way
+
+
+def thumb_size(width, height, scale=DEFAULT_SCALE):
+    return max(1, -(-width // scale)), max(1, -(-height // scale))
+
+
+def _span(t, n, size):
+    """Source pixels [a, b) that thumbnail pixel t of n maps from (x * n // size == t)."""
+    return -(-t * size // n), -(-(t + 1) * size // n)
+
+
+def downscale(bits, width, height, tw, th):
+    """Packed tw x th thumbnail of a 0/1 picture: majority of each box."""
+    stride = (tw + 7) // 8
+    out = bytearray(stride * th)
+    cols = [_span(tx, tw, width) for tx in range(tw)]
+    for ty in range(th):
+        y0, y1 = _span(ty, th, height)
+        rows = [bits[y * width:(y + 1) * width] for y in range(y0, y1)]
+        for tx, (x0, x1) in enumerate(cols):
+            on = sum(sum(r[x0:x1]) for r in rows)
+            if 2 * on > (y1 - y0) * (x1 - x0):
+                out[ty * stride + tx // 8] |= 0x80 >> (tx & 7)
+    return bytes(out)
+
+
+def build_track(pictures, width, height, interval, scale=DEFAULT_SCALE):
+    """Track bytes from the decoded pictures of frames 0, interval, 2 * interval..."""
+    tw, th = thumb_size(width, height, scale)
+    body = b''.join(downscale(bits, width, height, tw, th) for bits in pictures)
+    return struct.pack(TRACK_FMT, tw, th, interval, len(pictures)) + body
+
+
+def parse_track(track):
+    """(width, height, interval, [thumbnail bytes]), None without a track."""
+    if len(track) < TRACK_HEADER:
+        return None
+    tw, th, interval, count = struct.unpack_from(TRACK_FMT, track)
+    size = (tw + 7) // 8 * th
+    if not count or not interval or TRACK_HEADER + count * size > len(track):
+        return None
+    return tw, th, interval, [track[TRACK_HEADER + i * size:TRACK_HEADER + (i + 1) * size]
+                              for i in range(count)]
+
+
+def track_for(frames, width, height, every_frames, scale=DEFAULT_SCALE):
+    """Track for bit-RLE frames, one thumbnail per `every_frames`."""
+    dec = FrameDecoder(width * height, width)
+    pictures = []
+    for i, f in enumerate(frames):
+        bits = dec.decode(f)
+        if i % every_frames == 0:
+            pictures.append(bits)
+    return build_track(pictures, width, height, every_frames, scale)
+
+
+def main():
+    p = argparse.ArgumentParser(description='Add or remove the scrub thumbnail track')
+    p.add_argument('input', help='bad_apple.bin (bit-RLE)')
+    p.add_argument('-o', '--output', default=None, help='Write here instead of in place')
+    p.add_argument('--every', type=float, default=1.0, metavar='SEC',
+                   help='Seconds between thumbnails')
+    p.add_argument('--scale', type=int, default=DEFAULT_SCALE, metavar='N',
+                   help='Video pixels per thumbnail pixel, each way')
+    p.add_argument('--strip', action='store_true', help='Remove the track')
+    args = p.parse_args()
+
+    c = read_container(args.input)
+    with open(args.input, 'rb') as f:
+        data = f.read()
+    n = len(c.frames)
+    if args.strip:
+        track, flags = b'', c.flags & ~FLAG_THUMBS
+    else:
+        if c.flags & FLAG_VECTOR:
+            p.error('vector files: rebuild with build_data.py --thumbs')
+        if c.flags & FLAG_INDEXED:
+            p.error('indexed-colour files have no thumbnail track')
+        if args.scale < 1:
+            p.error('--scale must be at least 1')
+        every = max(1, round(args.every * c.fps))
+        track = track_for(c.frames, c.width, c.height, every, args.scale)
+        flags = c.flags | FLAG_THUMBS
+    shift = len(track) - len(c.thumbs)
+    entries = struct.unpack_from(f'<{n}I', data, HEADER_SIZE)
+    if n and (entries[-1] & INDEX_OFFSET_MASK) + shift > INDEX_OFFSET_MASK:
+        p.error('frame offsets would pass 16 MB')
+    start = HEADER_SIZE + 4 * n
+    out = args.output or args.input
+    with open(out, 'wb') as f:
+        f.write(struct.pack(HEADER_FMT, c.width, c.height, n, c.fps, flags))
+        f.write(struct.pack(f'<{n}I', *[e + shift for e in entries]))
+        f.write(track)
+        f.write(data[start + len(c.thumbs):])
+
+    if args.strip:
+        print(f'{out}: thumbnail track removed ({len(c.thumbs):,} bytes)')
+        return
+    tw, th, interval, thumbs = parse_track(track)
+    print(f'{out}: {len(thumbs)} thumbnails of {tw}x{th}, every {interval} frames, '
+          f'{len(track):,} bytes ({100 * len(track) / (len(data) + shift):.1f}% of the file)')
+
+
+if __name__ == '__main__':
+    main()
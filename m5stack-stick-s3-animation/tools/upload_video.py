@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Incrementally update the video file on the device over USB serial.
+
+Instead of rebuilding and flashing the whole LittleFS image, the device
+reports an FNV-1a 64 hash for every 4 KB chunk of its current
+/bad_apple.bin; only chunks whose hash differs are sent. The device builds
+the new file next to the old one from these and its unchanged chunks and
+replaces the old file once the hash of the complete file checks out. With
+no room for both, it patches the old file from the first changed chunk on,
+or refuses the upload if even that tail does not fit.
+
+Usage:
+  python tools/upload_video.py /dev/ttyUSB0 data/bad_apple.bin --fast-baud 921600
+  python tools/stream_sim.py --partition sim_part.bin   # host-only check
+  python tools/upload_video.py /dev/pts/N data/bad_apple.bin
+"""
+import argparse
+import struct
+import sys
+import time
+
+import serial
+
+from serial_link import (LinkSender, MODE_UPLOAD, PKT_UP_BEGIN, PKT_UP_CHUNK,
+                         PKT_UP_END, PKT_UP_HASHES, PKT_UP_DONE, fnv1a64)
+
+
+class Upload:
+    def __init__(self):
+        self.old_size = None
+        self.hashes = {}
+        self.done = None         # (ok, hash)
+
+    def on_packet(self, ptype, payload):
+        if ptype == PKT_UP_HASHES:
+            old_size, first, n = struct.unpack_from('<IIH', payload)
+            self.old_size = old_size
+            for i, (h,) in enumerate(struct.iter_unpack('<Q', payload[10:10 + 8 * n])):
+                self.hashes[first + i] = h
+        elif ptype == PKT_UP_DONE:
+            ok, h = struct.unpack_from('<BQ', payload)
+            self.done = (bool(ok), h)
+
+    def have_hashes(self, chunk):
+        if self.old_size is None:
+            return False
+        return len(self.hashes) == (self.old_size + chunk - 1) // chunk
+
+
+def main():
+    p = argparse.ArgumentParser(description='Upload changed chunks of the video')
+    p.add_argument('port', help='Serial port (or pty from stream_sim.py)')
+    p.add_argument('input', nargs='?', default='data/bad_apple.bin')
+    p.add_argument('--baud', type=int, default=115200,
+                   help='Baud the firmware is running at (115200, stream env 1500000)')
+    p.add_argument('--fast-baud', type=int, default=921600,
+                   help='Switch both ends to this baud for the transfer (0 = keep)')
+    p.add_argument('--chunk', type=int, default=4096,
+                   help='Chunk size; keep it a multiple of the 4 KB flash sector')
+    p.add_argument('--full', action='store_true', help='Send every chunk')
+    p.add_argument('--quiet', action='store_true', help='Hide device log lines')
+    args = p.parse_args()
+
+    with open(args.input, 'rb') as f:
+        data = f.read()
+    chunks = [data[i:i + args.chunk] for i in range(0, len(data), args.chunk)]
+    local_hashes = [fnv1a64(c) for c in chunks]
+    file_hash = fnv1a64(data)
+    print(f'{args.input}: {len(data):,} bytes, {len(chunks)} chunks of {args.chunk}')
+
+    ser = serial.Serial(args.port, args.baud, timeout=0, write_timeout=5)
+    tx = LinkSender(ser, verbose=not args.quiet)
+    up = Upload()
+    tx.on_packet_hook = up.on_packet
+
+    start = time.monotonic()
+    print('Waiting for device...')
+    tx.hello(MODE_UPLOAD, args.fast_baud if args.fast_baud != args.baud else 0)
+
+    # ---- Ask for the device's chunk hashes ----
+    tx.queue(PKT_UP_BEGIN, struct.pack('<II', len(data), args.chunk))
+    tx.drain(until=lambda: up.have_hashes(args.chunk) or up.done, timeout=120)
+    if up.done:
+        print('Device refused the upload (file or space problem)')
+        return 1
+    t_hash = time.monotonic() - start
+
+    changed = [i for i in range(len(chunks))
+               if args.full or up.hashes.get(i) != local_hashes[i]]
+    print(f'Device file: {up.old_size:,} bytes; {len(changed)}/{len(chunks)} chunks changed')
+
+    # ---- Send changed chunks (credits keep at most one window in flight) ----
+    # The device answers early with a failure when a write fails or there is
+    # no room to patch its file; it stops acking then, so don't wait for it.
+    sent = 0
+    for i in changed:
+        if up.done:
+            break
+        payload = struct.pack('<I', i) + chunks[i]
+        tx.queue(PKT_UP_CHUNK, payload, len(payload))
+        while tx.pending() > 4 and not up.done:
+            tx.pump()
+            tx.poll(0.002)
+        sent += len(chunks[i])
+    if not up.done:
+        tx.queue(PKT_UP_END, struct.pack('<IQ', len(data), file_hash))
+    deadline = time.monotonic() + 120
+    while up.done is None:
+        if time.monotonic() > deadline:
+            raise TimeoutError('device stopped responding')
+        tx.pump()
+        tx.poll(0.002)
+
+    elapsed = time.monotonic() - start
+    ok, h = up.done
+    if args.fast_baud and args.fast_baud != args.baud:
+        ser.baudrate = args.baud
+    print(f'{"OK" if ok else "FAILED"}: sent {sent:,} of {len(data):,} bytes '
+          f'({100 * sent / max(1, len(data)):.1f}%) in {elapsed:.1f} s '
+          f'(hashing {t_hash:.1f} s), {tx.total_resends} resends, '
+          f'device hash {h:016x}')
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    try:
+        sys.exit(main())
+    except KeyboardInterrupt:
+        sys.exit(1)
@@ -0,0 +1,271 @@
+"""Vector-outline frames: trace each picture's contours into polygons.
+
+Bad Apple is mostly silhouettes, so a frame is well described by the
+outlines of its black regions. Contours are traced along pixel edges (so at
+tolerance 0 the polygons reproduce the bitmap exactly under an even-odd fill
+sampled at pixel centres), then simplified with Douglas-Peucker.
+
+Frame payload (header flag FLAG_VECTOR, see README "Data format"):
+  uint8  type = 0
+  uint16 polygon count
+  per polygon: uint16 n, uint8 x0, uint8 y0, (n-1) x (int8 dx, int8 dy)
+Coordinates are pixel corners of the source picture (0..width, 0..height);
+polygons close implicitly and are filled even-odd.
+
+Converts an existing container:
+    python tools/vectorize.py data/bad_apple.bin -o data/bad_apple_vec.bin --tolerance 1
+"""
+import argparse
+import math
+import struct
+
+from container import (FLAG_COST_HINTS, FLAG_DELTA, FLAG_INDEXED, FLAG_LAYERS, FLAG_REFS,
+                       FLAG_ROW_INDEX, FLAG_VECTOR, HEADER_FMT, FrameDecoder, index_entry,
+                       read_container)
+from cost_hints import hints_for
+
+MAX_EDGES = 2048          # must match MAX_VECTOR_EDGES in src/vector.h
+_TO_ASCII = bytes.maketrans(b'\x00\x01', b'01')
+
+
+def bits_to_rows(bits, width, height):
+    """Rows as ints, bit x = pixel x."""
+    rows = []
+    for y in range(height):
+        row = bytes(bits[y * width:(y + 1) * width]).translate(_TO_ASCII)[::-1]
+        rows.append(int(row, 2) if row else 0)
+    return rows
+
+
+def _runs(mask):
+    """(start, end) of each run of set bits."""
+    out = []
+    while mask:
+        low = (mask & -mask).bit_length() - 1
+        t = mask >> low
+        n = ((~t) & (t + 1)).bit_length() - 1
+        out.append((low, low + n))
+        mask &= ~(((1 << n) - 1) << low)
+    return out
+
+
+def trace_contours(rows, width, height):
+    """Closed loops of pixel-corner points around the set pixels, filled
+    region on the right of the direction of travel (y down)."""
+    out_edges = {}
+
+    def add(a, b):
+        out_edges.setdefault(a, []).append(b)
+
+    prev = 0
+    for y in range(height + 1):
+        cur = rows[y] if y < height else 0
+        for a, b in _runs(cur & ~prev):           # top edges, heading right
+            add((a, y), (b, y))
+        for a, b in _runs(prev & ~cur):           # bottom edges, heading left
+            add((b, y), (a, y))
+        if y < height:
+            for a, b in _runs(cur):
+                add((a, y + 1), (a, y))           # left side, heading up
+                add((b, y), (b, y + 1))           # right side, heading down
+        prev = cur
+
+    loops = []
+    while out_edges:
+        start = next(iter(out_edges))
+        loop = [start]
+        p = start
+        while True:
+            nxt = out_edges[p].pop()
+            if not out_edges[p]:
+                del out_edges[p]
+            if nxt == start:
+                break
+            loop.append(nxt)
+            p = nxt
+        loops.append(loop)
+    return loops
+
+
+def _drop_collinear(loop):
+    n = len(loop)
+    out = []
+    for i in range(n):
+        (ax, ay), (bx, by), (cx, cy) = loop[i - 1], loop[i], loop[(i + 1) % n]
+        if (bx - ax) * (cy - by) != (by - ay) * (cx - bx):
+            out.append(loop[i])
+    return out
+
+
+def _dp(points, tol2):
+    """Douglas-Peucker on an open chain (endpoints kept)."""
+    keep = [False] * len(points)
+    keep[0] = keep[-1] = True
+    stack = [(0, len(points) - 1)]
+    while stack:
+        i, j = stack.pop()
+        (ax, ay), (bx, by) = points[i], points[j]
+        dx, dy = bx - ax, by - ay
+        len2 = dx * dx + dy * dy
+        best, at = -1.0, -1
+        for k in range(i + 1, j):
+            px, py = points[k]
+            cross = (px - ax) * dy - (py - ay) * dx
+            d2 = cross * cross / len2 if len2 else (px - ax) ** 2 + (py - ay) ** 2
+            if d2 > best:
+                best, at = d2, k
+        if at >= 0 and best > tol2:
+            keep[at] = True
+            stack.append((i, at))
+            stack.append((at, j))
+    return [p for p, k in zip(points, keep) if k]
+
+
+def simplify(loop, tolerance):
+    """Fewer vertices within `tolerance` pixels; None if the loop vanishes."""
+    loop = _drop_collinear(loop)
+    if tolerance > 0 and len(loop) > 3:
+        # split the closed loop at the vertex farthest from the first
+        fx, fy = loop[0]
+        far = max(range(len(loop)), key=lambda k: (loop[k][0] - fx) ** 2 + (loop[k][1] - fy) ** 2)
+        tol2 = tolerance * tolerance
+        a = _dp(loop[:far + 1], tol2)
+        b = _dp(loop[far:] + loop[:1], tol2)
+        loop = a[:-1] + b[:-1]
+    return loop if len(loop) >= 3 else None
+
+
+def _split_long(loop):
+    """Insert points so every step fits an int8."""
+    out = []
+    n = len(loop)
+    for i in range(n):
+        (ax, ay), (bx, by) = loop[i], loop[(i + 1) % n]
+        out.append((ax, ay))
+        steps = (max(abs(bx - ax), abs(by - ay)) + 126) // 127 - 1
+        for s in range(1, steps + 1):
+            out.append((ax + (bx - ax) * s // (steps + 1), ay + (by - ay) * s // (steps + 1)))
+    return out
+
+
+def encode_polygons(polys):
+    out = bytearray([0])
+    out += struct.pack('<H', len(polys))
+    for poly in polys:
+        poly = _split_long(poly)
+        out += struct.pack('<HBB', len(poly), poly[0][0], poly[0][1])
+        for (ax, ay), (bx, by) in zip(poly, poly[1:]):
+            out += struct.pack('<bb', bx - ax, by - ay)
+    return bytes(out)
+
+
+def decode_polygons(frame):
+    (count,) = struct.unpack_from('<H', frame, 1)
+    pos = 3
+    polys = []
+    for _ in range(count):
+        n, x, y = struct.unpack_from('<HBB', frame, pos)
+        pos += 4
+        poly = [(x, y)]
+        for _ in range(n - 1):
+            dx, dy = struct.unpack_from('<bb', frame, pos)
+            pos += 2
+            x, y = x + dx, y + dy
+            poly.append((x, y))
+        polys.append(poly)
+    return polys
+
+
+def edge_count(polys):
+    return sum(len(_split_long(p)) for p in polys)
+
+
+def vectorize_frame(bits, width, height, tolerance):
+    """Encoded vector frame; tolerance grows until the edge table fits."""
+    loops = trace_contours(bits_to_rows(bits, width, height), width, height)
+    tol = tolerance
+    while True:
+        polys = [p for p in (simplify(l, tol) for l in loops) if p]
+        if edge_count(polys) <= MAX_EDGES:
+            return encode_polygons(polys), tol
+        tol = max(tol * 1.5, 0.5)
+
+
+def rasterize(polys, width, height):
+    """Even-odd fill sampled at pixel centres; flat 0/1 list (reference)."""
+    bits = [0] * (width * height)
+    for y in range(height):
+        yc = y + 0.5
+        xs = []
+        for poly in polys:
+            n = len(poly)
+            for i in range(n):
+                (ax, ay), (bx, by) = poly[i], poly[(i + 1) % n]
+                if (ay <= yc) != (by <= yc):
+                    xs.append(ax + (yc - ay) * (bx - ax) / (by - ay))
+        xs.sort()
+        for a, b in zip(xs[::2], xs[1::2]):
+            # pixels whose centre x + 0.5 lies in [a, b)
+            for x in range(max(0, math.ceil(a - 0.5)), min(width, math.ceil(b - 0.5))):
+                bits[y * width + x] = 1
+    return bits
+
+
+def main():
+    p = argparse.ArgumentParser(description='Convert a bit-RLE container to vector outlines')
+    p.add_argument('input', help='bad_apple.bin (any profile; deltas and references are decoded)')
+    p.add_argument('-o', '--output', required=True)
+    p.add_argument('--tolerance', type=float, default=1.0,
+                   help='Max outline deviation in pixels (0 = exact)')
+    p.add_argument('--check', type=int, default=50, metavar='N',
+                   help='Rasterize every Nth frame back and report pixel error (0 = off)')
+    args = p.parse_args()
+
+    c = read_container(args.input)
+    if c.width > 255 or c.height > 255:
+        p.error('vector frames need width and height <= 255')
+    if c.flags & FLAG_INDEXED:
+        p.error('indexed-colour files have no 1-bit picture to trace')
+    dec = FrameDecoder(c.total_pixels, c.width)
+    frames = []
+    raised = 0
+    wrong = checked = 0
+    for i, f in enumerate(c.frames):
+        bits = dec.decode(f)
+        vf, tol = vectorize_frame(bits, c.width, c.height, args.tolerance)
+        raised += tol > args.tolerance
+        frames.append(vf)
+        if args.check and i % args.check == 0:
+            back = rasterize(decode_polygons(vf), c.width, c.height)
+            wrong += sum(a != b for a, b in zip(bits, back))
+            checked += c.total_pixels
+
+    flags = (c.flags & ~(FLAG_DELTA | FLAG_REFS | FLAG_ROW_INDEX | FLAG_LAYERS)) | FLAG_VECTOR
+    hints = [0] * len(frames)
+    if flags & FLAG_COST_HINTS:     # re-predicted for the vector path
+        hints = hints_for(frames, c.width, c.height, flags)[0]
+    offsets = []
+    offset = 0
+    for f in frames:
+        offsets.append(offset)
+        offset += len(f)
+    with open(args.output, 'wb') as out:
+        out.write(struct.pack(HEADER_FMT, c.width, c.height, len(frames), c.fps, flags))
+        out.write(struct.pack(f'<{len(frames)}I',
+                              *[index_entry(len(c.thumbs) + o, hint=h)      # track stays in front
+                                for o, h in zip(offsets, hints)]))
+        out.write(c.thumbs)
+        for f in frames:
+            out.write(f)
+
+    rle = sum(len(f) for f in c.frames)
+    print(f'Vector: {offset:,} bytes vs {rle:,} bit-RLE ({100 * offset / rle:.1f}%), '
+          f'tolerance {args.tolerance}')
+    if raised:
+        print(f'  {raised} frames needed a higher tolerance to fit {MAX_EDGES} edges')
+    if checked:
+        print(f'  pixel error on every {args.check}th frame: {100 * wrong / checked:.2f}%')
+
+
+if __name__ == '__main__':
+    main()